@@ -18,16 +18,114 @@
 //     # a<b<d, a<c<d, c<d, d<c
 //     Conflicting requirements for: c,d
 //     Result: a,b,c,d
+// Run with `--benchmark` to time the algorithm on large generated graphs instead.
 
 
+#include "utils/clock.h"
+#include "utils/random_generators.h"
 #include "utils/transitive_closure.h"
 
+#include <algorithm>
 #include <map>
 #include <set>
+#include <string_view>
 #include <utility>
 
-IMP_MAIN(,)
+// Times `TransitiveClosure` on several kinds of generated graphs, up to 100k nodes (10k for the chain, which needs the most memory).
+static void RunBenchmark()
 {
+    struct GraphKind
+    {
+        std::string_view name;
+        // The largest node count to try.
+        std::size_t max_n = 0;
+        // Adds the successors of `a` to `out`, in any order.
+        std::function<void(std::size_t n, std::size_t a, Random::SplitMix64 &gen, std::vector<std::size_t> &out)> make_edges;
+    };
+
+    const GraphKind graph_kinds[] = {
+        // The worst case for the memory usage: every node reaches every node before it, so the bits need `n^2/16` bytes.
+        {"chain", 10000, [](std::size_t n, std::size_t a, Random::SplitMix64 &gen, std::vector<std::size_t> &out)
+        {
+            (void)n;
+            (void)gen;
+            if (a > 0)
+                out.push_back(a - 1);
+        }},
+        // An acyclic graph, with edges to the nearby nodes.
+        {"local dag", 100000, [](std::size_t n, std::size_t a, Random::SplitMix64 &gen, std::vector<std::size_t> &out)
+        {
+            (void)n;
+            for (int i = 0; i < 4 && a > 0; i++)
+                out.push_back(a - 1 - gen() % std::min(a, std::size_t(1000)));
+        }},
+        // Independent clusters of 1000 nodes, with cycles.
+        {"clusters", 100000, [](std::size_t n, std::size_t a, Random::SplitMix64 &gen, std::vector<std::size_t> &out)
+        {
+            std::size_t cluster_start = a / 1000 * 1000;
+            std::size_t cluster_size = std::min(n - cluster_start, std::size_t(1000));
+            for (int i = 0; i < 2; i++)
+                out.push_back(cluster_start + gen() % cluster_size);
+        }},
+        // Random edges everywhere, which merge most of the graph into one component.
+        {"random", 100000, [](std::size_t n, std::size_t a, Random::SplitMix64 &gen, std::vector<std::size_t> &out)
+        {
+            (void)a;
+            for (int i = 0; i < 3; i++)
+                out.push_back(gen() % n);
+        }},
+    };
+
+    for (const GraphKind &kind : graph_kinds)
+    {
+        for (std::size_t n : {1000, 10000, 100000})
+        {
+            if (n > kind.max_n)
+                continue;
+
+            // Generate the graph. The callback needs the successors in ascending order.
+            std::vector<std::vector<std::size_t>> graph(n);
+            std::size_t num_edges = 0;
+            for (std::size_t a = 0; a < n; a++)
+            {
+                Random::SplitMix64 gen = Random::SplitMix64::ForIndex(42, a);
+                kind.make_edges(n, a, gen, graph[a]);
+                std::sort(graph[a].begin(), graph[a].end());
+                graph[a].erase(std::unique(graph[a].begin(), graph[a].end()), graph[a].end());
+                num_edges += graph[a].size();
+            }
+
+            std::uint64_t start_time = Clock::Time();
+            TransitiveClosure::Data data = TransitiveClosure::Compute(n, [&](std::size_t a, TransitiveClosure::next_func_t func)
+            {
+                for (std::size_t b : graph[a])
+                    func(b);
+            });
+            std::uint64_t compute_time = Clock::Time();
+            std::size_t num_unordered_pairs = data.FindUnorderedComponentPairs();
+            std::uint64_t pairs_time = Clock::Time();
+
+            std::size_t num_words = 0;
+            for (const auto &comp : data.components)
+                num_words += comp.next_bits.size();
+
+            std::cout << FMT("{:>9} n={:<6} edges={:<6} components={:<6} compute={:>8.2f}ms  unordered_pairs={:>8.2f}ms ({})  bits={:.1f}MB\n",
+                kind.name, n, num_edges, data.components.size(),
+                Clock::TicksToSeconds(compute_time - start_time) * 1000, Clock::TicksToSeconds(pairs_time - compute_time) * 1000, num_unordered_pairs,
+                num_words * sizeof(std::uint64_t) / 1e6
+            );
+        }
+    }
+}
+
+IMP_MAIN(argc, argv)
+{
+    if (argc == 2 && std::string_view(argv[1]) == "--benchmark")
+    {
+        RunBenchmark();
+        return 0;
+    }
+
     std::string line;
     while (std::cout << "# ", std::getline(std::cin, line))
     {
@@ -78,7 +176,14 @@ IMP_MAIN(,)
             if (index_to_char.empty())
                 continue;
 
-            TransitiveClosure::Data data = TransitiveClosure::Compute(index_to_char.size(), [&](std::size_t a, std::size_t b){return pairs.contains({index_to_char[a], index_to_char[b]});});
+            TransitiveClosure::Data data = TransitiveClosure::Compute(index_to_char.size(), [&](std::size_t a, TransitiveClosure::next_func_t func)
+            {
+                for (std::size_t b = 0; b < index_to_char.size(); b++)
+                {
+                    if (pairs.contains({index_to_char[a], index_to_char[b]}))
+                        func(b);
+                }
+            });
 
             // std::cout << data.DebugToString() << '\n';
 
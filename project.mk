@@ -67,6 +67,40 @@ ifeq ($(APP),tests)
 ALLOW_PCH := 0# Force disable PCH for tests, it doesn't make much sense there.
 endif
 
+# Packs the assets into a single file, see `src/utils/asset_pack.h`.
+$(call Project,exe,pack_assets)
+$(call ProjectSetting,sources,src/interface/messagebox.cpp src/program/errors.cpp src/utils/archive.cpp src/utils/asset_pack.cpp src/utils/filesystem.cpp)
+$(call ProjectSetting,source_dirs,tools/pack_assets)
+$(call ProjectSetting,libs,*)
+$(call ProjectSetting,bad_lib_flags,-Dmain=%>>>-DIMP_ENTRY_POINT_OVERRIDE=%)
+
+# Measures the texture atlas build time on a synthetic set of images, see `tools/bench_atlas/main.cpp`.
+$(call Project,exe,bench_atlas)
+$(call ProjectSetting,sources,src/graphics/image_kernels.cpp src/graphics/texture_atlas.cpp src/interface/messagebox.cpp src/program/errors.cpp src/third_party_connectors/stb.cpp src/utils/archive.cpp src/utils/packing.cpp)
+$(call ProjectSetting,source_dirs,tools/bench_atlas)
+$(call ProjectSetting,libs,*)
+$(call ProjectSetting,bad_lib_flags,-Dmain=%>>>-DIMP_ENTRY_POINT_OVERRIDE=%)
+
+# Compares the vectorized image kernels against plain per-pixel loops, see `tools/bench_image_kernels/main.cpp`.
+$(call Project,exe,bench_image_kernels)
+$(call ProjectSetting,sources,src/graphics/image_kernels.cpp src/interface/messagebox.cpp src/program/errors.cpp src/third_party_connectors/stb.cpp)
+$(call ProjectSetting,source_dirs,tools/bench_image_kernels)
+$(call ProjectSetting,libs,*)
+$(call ProjectSetting,bad_lib_flags,-Dmain=%>>>-DIMP_ENTRY_POINT_OVERRIDE=%)
+
+
+# --- Asset pack ---
+
+# Don't let the asset sync erase the pack and the atlas cache.
+ASSETS_IGNORED_PATTERNS += /assets.pack /*.atlas
+
+# Packs `assets/assets` into `assets.pack` next to the executable. The game prefers it to the loose files, if it exists.
+# Remove the file manually to go back to the loose files.
+.PHONY: pack-assets
+pack-assets: build-pack_assets
+	$(call log_now,[Packing] $(BIN_DIR)/$(os_mode_string)/assets.pack)
+	@$(call proj_output_filename,pack_assets) $(call quote,$(proj_dir)/assets/assets) $(call quote,$(BIN_DIR)/$(os_mode_string)/assets.pack)
+
 
 # --- Codegen ---
 
@@ -4,8 +4,13 @@
 #include "audio/context.h"
 #include "audio/errors.h"
 #include "audio/global_sound_loader.h"
+#include "audio/mixer_source.h"
+#include "audio/mixer.h"
+#include "audio/ogg_decoder.h"
 #include "audio/openal.h"
 #include "audio/parameters.h"
+#include "audio/sound_conversion.h"
 #include "audio/sound.h"
 #include "audio/source_manager.h"
 #include "audio/source.h"
+#include "audio/streaming_source.h"
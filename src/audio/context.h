@@ -1,5 +1,8 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
 #include <optional>
 #include <tuple>
 #include <utility>
@@ -7,6 +10,7 @@
 
 #include "audio/openal.h"
 #include "macros/finally.h"
+#include "strings/format.h"
 
 namespace Audio
 {
@@ -42,32 +46,17 @@ namespace Audio
         {
             ALCdevice *device = nullptr;
             ALCcontext *context = nullptr;
+            bool loopback = false;
         };
         Data data;
 
-      public:
-        Context() {}
-
-        using attribute_list_t = std::vector<ContextAttr>;
-
-        // Creates a context with the default configuration.
-        Context(decltype(nullptr)) : Context(attribute_list_t{}) {}
-
-        // Creates a context with the specified configuration.
-        // Note that we pass the vector by value, because we need to append a null element at the end before passing it to AL.
-        Context(attribute_list_t attributes)
+        // Creates a context on the device, and makes it current. Takes ownership of the device, even if this throws.
+        void Init(ALCdevice *device, std::vector<ContextAttr> attributes)
         {
             constexpr int required_major = 1, required_minor = 1;
 
-            // Stop if a context already exists.
-            if (instance)
-                throw std::runtime_error("Attempt to create multiple OpenAL contexts.");
-
-            // Open device.
-            data.device = alcOpenDevice(nullptr);
-            if (!data.device)
-                throw std::runtime_error("Unable to create an OpenAL device.");
-            FINALLY_ON_THROW{alcCloseDevice(data.device);};
+            data.device = device;
+            FINALLY_ON_THROW{alcCloseDevice(data.device); data = {};};
 
             // Get dynamic library version, stop if it's too old.
             ALCint lib_major, lib_minor;
@@ -94,6 +83,83 @@ namespace Audio
             instance = this;
         }
 
+      public:
+        Context() {}
+
+        using attribute_list_t = std::vector<ContextAttr>;
+
+        // Creates a context with the default configuration.
+        Context(decltype(nullptr)) : Context(attribute_list_t{}) {}
+
+        // Creates a context with the specified configuration.
+        // Note that we pass the vector by value, because we need to append a null element at the end before passing it to AL.
+        Context(attribute_list_t attributes)
+        {
+            // Stop if a context already exists.
+            if (instance)
+                throw std::runtime_error("Attempt to create multiple OpenAL contexts.");
+
+            // Open device.
+            ALCdevice *device = alcOpenDevice(nullptr);
+            if (!device)
+                throw std::runtime_error("Unable to create an OpenAL device.");
+
+            Init(device, std::move(attributes));
+        }
+
+        // Emscripten's AL doesn't support this.
+        #ifdef ALC_SOFT_loopback
+        // Creates a context on a loopback device, which doesn't need any audio hardware.
+        // The playback advances only when `RenderSamples()` is called. This is useful for testing, and for recording the output.
+        // The output is always 16-bit stereo.
+        [[nodiscard]] static Context Loopback(int sampling_rate, attribute_list_t attributes = {})
+        {
+            if (instance)
+                throw std::runtime_error("Attempt to create multiple OpenAL contexts.");
+
+            ALCdevice *device = alcLoopbackOpenDeviceSOFT(nullptr);
+            if (!device)
+                throw std::runtime_error("Unable to create an OpenAL loopback device.");
+
+            if (!alcIsRenderFormatSupportedSOFT(device, sampling_rate, ALC_STEREO_SOFT, ALC_SHORT_SOFT))
+            {
+                alcCloseDevice(device);
+                throw std::runtime_error(FMT("The OpenAL loopback device doesn't support 16-bit stereo at {} Hz.", sampling_rate));
+            }
+
+            attributes.push_back({ALC_FORMAT_CHANNELS_SOFT, ALC_STEREO_SOFT});
+            attributes.push_back({ALC_FORMAT_TYPE_SOFT, ALC_SHORT_SOFT});
+            attributes.push_back({ALC_FREQUENCY, sampling_rate});
+
+            Context ret;
+            ret.Init(device, std::move(attributes));
+            ret.data.loopback = true;
+            return ret;
+        }
+
+        // Advances the playback of a loopback context, writing `block_count` stereo blocks (pairs of samples) to `target`.
+        // If `target` is null, the output is discarded.
+        void RenderSamples(std::int16_t *target, int block_count)
+        {
+            if (!data.loopback)
+                throw std::runtime_error("Attempt to render samples from a non-loopback OpenAL context.");
+
+            if (target)
+            {
+                alcRenderSamplesSOFT(data.device, target, block_count);
+                return;
+            }
+
+            std::int16_t buffer[1024];
+            while (block_count > 0)
+            {
+                int step = std::min(block_count, int(std::size(buffer) / 2));
+                alcRenderSamplesSOFT(data.device, buffer, step);
+                block_count -= step;
+            }
+        }
+        #endif
+
         Context(Context &&other) noexcept : data(std::exchange(other.data, {}))
         {
             if (instance == &other)
@@ -143,6 +209,17 @@ namespace Audio
             return data.context;
         }
 
+        // The output sampling rate of the device, or 0 if the context is null.
+        // Sounds at this rate can be played without resampling, see `ConvertSound()`.
+        [[nodiscard]] int SamplingRate() const
+        {
+            if (!data.device)
+                return 0;
+            ALCint ret = 0;
+            alcGetIntegerv(data.device, ALC_FREQUENCY, 1, &ret);
+            return ret;
+        }
+
         // This also seems to be a part of the HRTF extension, that the Emscripten's AL doesn't have.
         #ifdef ALC_HRTF_SOFT
         // Changes configuration for an existing context.
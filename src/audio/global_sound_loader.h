@@ -1,16 +1,26 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <map>
 #include <optional>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "audio/buffer.h"
 #include "audio/sound.h"
+#include "audio/sound_conversion.h"
 #include "meta/common.h"
 #include "meta/const_string.h"
 #include "program/errors.h"
+#include "stream/input.h"
+#include "stream/output.h"
+#include "utils/hash.h"
+#include "utils/thread_pool.h"
 
 // Provides singletones to conveniently load sounds.
 
@@ -70,34 +80,234 @@ namespace Audio::GlobalData
         return Sound<Name>();
     }
 
-    // Loads (or reloads) all files requested with `Audio::GlobalData::Sound()`. Consider using the simplified overload, defined below.
-    // The number of channels and the file format can be overridden by the `Sound()` calls.
-    // `get_stream` is called repeatedly for all needed files.
-    inline void Load(std::optional<Channels> channels, Format format, std::function<Stream::Input(const std::string &name, std::optional<Channels> channels, Format format)> get_stream)
+    using get_stream_func_t = std::function<Stream::Input(const std::string &name, std::optional<Channels> channels, Format format)>;
+
+    namespace impl
     {
-        for (auto &[name, data] : impl::GetAutoLoadedBuffers())
+        struct PendingSound
+        {
+            AutoLoadedBuffer *target = nullptr;
+            std::optional<Channels> channels;
+            Format format = wav;
+            Stream::ReadOnlyData file; // The encoded file.
+            std::uint64_t hash = 0; // The hash of the file contents and the loading parameters, for the cache.
+            Audio::Sound sound; // The decoded and converted sound.
+            bool decoded = false; // Whether `sound` was filled. We can't check `sound` itself, since empty sounds are null.
+        };
+
+        inline constexpr char sound_cache_magic[8] = {'I','M','P','-','S','N','D','C'};
+        inline constexpr std::uint32_t sound_cache_version = 3;
+
+        // Reads all requested files to memory. `get_stream` is only called on this thread, so it doesn't need to be thread-safe.
+        [[nodiscard]] inline std::vector<PendingSound> CollectSounds(std::optional<Channels> channels, Format format, const get_stream_func_t &get_stream)
         {
-            std::optional<Channels> file_channels = data.channels_override ? data.channels_override : channels;
-            Format file_format = data.format_override.value_or(format);
-            data.buffer = Audio::Sound(file_format, file_channels, get_stream(name, file_channels, file_format));
+            std::vector<PendingSound> ret;
+            for (auto &[name, data] : GetAutoLoadedBuffers())
+            {
+                PendingSound &sound = ret.emplace_back();
+                sound.target = &data;
+                sound.channels = data.channels_override ? data.channels_override : channels;
+                sound.format = data.format_override.value_or(format);
+                sound.file = get_stream(name, sound.channels, sound.format).ReadToMemory();
+            }
+            return ret;
+        }
+
+        // Decodes the sounds that aren't decoded yet, and converts them to `target_format`, in parallel.
+        inline void DecodeSounds(std::vector<PendingSound> &list, const SoundFormat &target_format, ThreadPool &thread_pool)
+        {
+            thread_pool.Run(list.size(), [&](std::size_t i)
+            {
+                PendingSound &sound = list[i];
+                if (!sound.decoded)
+                {
+                    sound.sound = ConvertSound(Audio::Sound(sound.format, sound.channels, sound.file, target_format.resolution.value_or(bits_16)), target_format);
+                    sound.decoded = true;
+                }
+            });
         }
+
+        // Uploads the decoded sounds to the buffers. This has to happen on the thread that owns the OpenAL context.
+        inline void UploadSounds(std::vector<PendingSound> &list)
+        {
+            for (PendingSound &sound : list)
+                sound.target->buffer = sound.sound;
+        }
+
+        [[nodiscard]] inline std::uint64_t HashSoundInputs(const PendingSound &sound, const SoundFormat &target_format)
+        {
+            Hash::Stable hash;
+            hash.AppendInt<std::uint32_t>(sound_cache_version).AppendInt<std::uint8_t>(sound.format).AppendInt<std::uint8_t>(sound.channels.value_or(Channels(0)));
+            hash.AppendInt<std::int32_t>(target_format.sampling_rate.value_or(0)).AppendInt<std::uint8_t>(target_format.channel_count.value_or(Channels(0)));
+            hash.AppendInt<std::uint8_t>(target_format.resolution.value_or(BitResolution(0)));
+            hash.AppendBytes(sound.file.data(), sound.file.size());
+            return hash.Result();
+        }
+
+        // Fills the sounds that have a matching entry in the cache. Returns false if some entries in the cache are unused or damaged.
+        // The cache format is: the magic, the version, the number of entries, then for each entry:
+        // the input hash, the sampling rate, the channel count, the resolution, the size in bytes (all little-endian), then the samples in the native byte order.
+        inline bool LoadSoundCache(const std::string &cache_file_name, std::vector<PendingSound> &list)
+        {
+            try
+            {
+                Stream::Input input(cache_file_name);
+
+                char magic[sizeof sound_cache_magic];
+                input.Read(magic, sizeof magic);
+                if (std::memcmp(magic, sound_cache_magic, sizeof magic) != 0)
+                    return false;
+                if (input.ReadLittle<std::uint32_t>() != sound_cache_version)
+                    return false;
+
+                // Several sounds can have the same hash if they are loaded from identical files.
+                std::unordered_map<std::uint64_t, std::vector<PendingSound *>> sounds_by_hash;
+                for (PendingSound &sound : list)
+                    sounds_by_hash[sound.hash].push_back(&sound);
+
+                bool all_used = true;
+
+                std::uint32_t num_entries = input.ReadLittle<std::uint32_t>();
+                for (std::uint32_t i = 0; i < num_entries; i++)
+                {
+                    std::uint64_t hash = input.ReadLittle<std::uint64_t>();
+                    int sampling_rate = input.ReadLittle<std::int32_t>();
+                    auto channel_count = Channels(input.ReadLittle<std::uint8_t>());
+                    auto resolution = BitResolution(input.ReadLittle<std::uint8_t>());
+                    std::uint64_t byte_size = input.ReadLittle<std::uint64_t>();
+
+                    auto it = sounds_by_hash.find(hash);
+                    // Empty sounds can have a zero sampling rate, e.g. after `ConvertSound()`.
+                    bool valid_format = (channel_count == mono || channel_count == stereo) && (resolution == bits_8 || resolution == bits_16) && (sampling_rate > 0 || byte_size == 0);
+                    if (it == sounds_by_hash.end() || !valid_format || byte_size % GetBytesPerBlock(resolution, channel_count) != 0 || byte_size > input.RemainingBytes())
+                    {
+                        all_used = false;
+                        input.Skip(byte_size);
+                        continue;
+                    }
+
+                    Audio::Sound sound(sampling_rate, channel_count, resolution, byte_size / GetBytesPerBlock(resolution, channel_count));
+                    input.Read(sound.RawUntypedData(), byte_size);
+                    for (PendingSound *target : it->second)
+                    {
+                        target->sound = sound;
+                        target->decoded = true;
+                    }
+                    sounds_by_hash.erase(it); // Duplicate entries are treated as unused.
+                }
+
+                input.ExpectEnd();
+                return all_used;
+            }
+            catch (...)
+            {
+                // Throw away whatever was loaded before the error.
+                for (PendingSound &sound : list)
+                {
+                    sound.sound = {};
+                    sound.decoded = false;
+                }
+                return false;
+            }
+        }
+
+        // Failing to write the cache is not an error.
+        inline void SaveSoundCache(const std::string &cache_file_name, const std::vector<PendingSound> &list)
+        {
+            try
+            {
+                // Skip the duplicate sounds.
+                std::vector<const PendingSound *> unique_sounds;
+                std::unordered_set<std::uint64_t> hashes;
+                for (const PendingSound &sound : list)
+                {
+                    if (hashes.insert(sound.hash).second)
+                        unique_sounds.push_back(&sound);
+                }
+
+                Stream::Output output(cache_file_name);
+                output.WriteString(sound_cache_magic, sizeof sound_cache_magic);
+                output.WriteLittle<std::uint32_t>(sound_cache_version);
+                output.WriteLittle<std::uint32_t>(unique_sounds.size());
+                for (const PendingSound *sound_ptr : unique_sounds)
+                {
+                    const PendingSound &sound = *sound_ptr;
+                    output.WriteLittle<std::uint64_t>(sound.hash);
+                    output.WriteLittle<std::int32_t>(sound.sound.SamplingRate());
+                    output.WriteLittle<std::uint8_t>(sound.sound.ChannelCount());
+                    output.WriteLittle<std::uint8_t>(sound.sound.Resolution());
+                    output.WriteLittle<std::uint64_t>(sound.sound.ByteSize());
+                    output.WriteBytes(sound.sound.RawUntypedData(), sound.sound.ByteSize());
+                }
+                output.Flush();
+            }
+            catch (...) {}
+        }
+
+        [[nodiscard]] inline get_stream_func_t GetStreamWithPrefix(std::string prefix)
+        {
+            return [prefix = std::move(prefix)](const std::string &name, std::optional<Channels> channels, Format format) -> Stream::Input
+            {
+                (void)channels;
+                const char *ext = "";
+                switch (format)
+                {
+                    case wav: ext = ".wav"; break;
+                    case ogg: ext = ".ogg"; break;
+                }
+                return prefix + name + ext;
+            };
+        }
+    }
+
+    // Loads (or reloads) all files requested with `Audio::GlobalData::Sound()`. Consider using the simplified overload, defined below.
+    // The number of channels and the file format can be overridden by the `Sound()` calls.
+    // `get_stream` is called repeatedly for all needed files, on the calling thread.
+    // The files are decoded in parallel on `thread_pool`, then uploaded to OpenAL on the calling thread.
+    // The sounds are converted to `target_format` before uploading, see `ConvertSound()`. Set its sampling rate to `Context::SamplingRate()`
+    //   to spare OpenAL from resampling them on the fly. Note that `channels` is the expected channel count of the files, and a mismatch is an error,
+    //   while `target_format.channel_count` mixes the sounds up or down.
+    inline void Load(std::optional<Channels> channels, Format format, const get_stream_func_t &get_stream, const SoundFormat &target_format = {}, ThreadPool &thread_pool = ThreadPool::Global())
+    {
+        std::vector<impl::PendingSound> list = impl::CollectSounds(channels, format, get_stream);
+        impl::DecodeSounds(list, target_format, thread_pool);
+        impl::UploadSounds(list);
     }
 
     // Same, but the sounds are loaded from files named `prefix + name + ext`,
     // where `name` comes from the `Sound()` call, and `ext` is determined from the format (`.wav` or `.ogg`).
-    inline void Load(std::optional<Channels> channels, Format format, const std::string &prefix)
+    inline void Load(std::optional<Channels> channels, Format format, const std::string &prefix, const SoundFormat &target_format = {}, ThreadPool &thread_pool = ThreadPool::Global())
     {
-        Load(channels, format, [&prefix](const std::string &name, std::optional<Channels> channels, Format format) -> Stream::Input
+        Load(channels, format, impl::GetStreamWithPrefix(prefix), target_format, thread_pool);
+    }
+
+    // Same as `Load()`, but caches the decoded sounds in a file.
+    // The sounds whose files (and loading parameters) didn't change since the cache was written are loaded from it, without decoding them.
+    // The rest are decoded as usual, and the file is rewritten. Failing to read or write the file is not an error.
+    // The samples are stored uncompressed, so the file can be much larger than the sounds themselves.
+    inline void LoadCached(const std::string &cache_file_name, std::optional<Channels> channels, Format format, const get_stream_func_t &get_stream, const SoundFormat &target_format = {}, ThreadPool &thread_pool = ThreadPool::Global())
+    {
+        std::vector<impl::PendingSound> list = impl::CollectSounds(channels, format, get_stream);
+        for (impl::PendingSound &sound : list)
+            sound.hash = impl::HashSoundInputs(sound, target_format);
+
+        bool cache_up_to_date = impl::LoadSoundCache(cache_file_name, list);
+        for (const impl::PendingSound &sound : list)
         {
-            (void)channels;
-            const char *ext = "";
-            switch (format)
-            {
-                case wav: ext = ".wav"; break;
-                case ogg: ext = ".ogg"; break;
-            }
-            return prefix + name + ext;
-        });
+            if (!sound.decoded)
+                cache_up_to_date = false;
+        }
+
+        impl::DecodeSounds(list, target_format, thread_pool);
+        if (!cache_up_to_date)
+            impl::SaveSoundCache(cache_file_name, list);
+        impl::UploadSounds(list);
+    }
+
+    // Same, but the sounds are loaded from files named `prefix + name + ext`, like in `Load()`.
+    inline void LoadCached(const std::string &cache_file_name, std::optional<Channels> channels, Format format, const std::string &prefix, const SoundFormat &target_format = {}, ThreadPool &thread_pool = ThreadPool::Global())
+    {
+        LoadCached(cache_file_name, channels, format, impl::GetStreamWithPrefix(prefix), target_format, thread_pool);
     }
 }
 
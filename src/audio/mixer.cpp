@@ -0,0 +1,538 @@
+#include "mixer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <vector>
+
+#include "program/errors.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AUDIO_MIXER_SSE2 1
+#include <emmintrin.h>
+#else
+#define AUDIO_MIXER_SSE2 0
+#endif
+
+namespace Audio
+{
+    // Positions in sounds are measured in blocks, as 32.32 fixed-point numbers.
+    static constexpr int fixed_point_bits = 32;
+    static constexpr std::uint64_t fixed_point_one = std::uint64_t(1) << fixed_point_bits;
+
+    struct Mixer::VoiceData
+    {
+        const Sound *sound = nullptr; // Null if the voice is free.
+        std::uint32_t generation = 0; // Incremented when the voice is freed, to invalidate the handles.
+        std::uint64_t start_index = 0; // The number of voices started before this one. Used to find the oldest voice.
+
+        std::uint64_t position = 0;
+
+        float volume = 1;
+        float raw_pitch = 1;
+        float priority = 0;
+        bool loop = false;
+
+        fvec3 pos;
+        bool relative = false;
+        float rolloff_factor = 1;
+        float ref_distance = 1;
+        float max_distance = std::numeric_limits<float>::infinity();
+
+        // The left and right gain at the end of the last `Render()`.
+        // The next `Render()` interpolates from it to the new gain, to avoid clicks when the parameters change.
+        fvec2 gain;
+        bool gain_valid = false; // False until the first `Render()`.
+    };
+
+    struct Mixer::Data
+    {
+        int sampling_rate = 0;
+
+        std::vector<VoiceData> voices;
+        std::size_t active_voices = 0;
+        std::uint64_t next_start_index = 0;
+        Stats stats;
+
+        float default_rolloff_fac = 1;
+        float default_ref_dist = 1;
+        float default_max_dist = std::numeric_limits<float>::infinity();
+
+        float volume = 1;
+        fvec3 listener_pos;
+        fvec3 listener_right = fvec3(1, 0, 0);
+
+        std::vector<float> accumulator; // Interleaved stereo. Reused between the renders.
+
+        void Free(VoiceData &voice)
+        {
+            voice.sound = nullptr;
+            voice.generation++;
+            active_voices--;
+        }
+
+        // Returns the left and right gain of the voice, for its current parameters.
+        [[nodiscard]] fvec2 ComputeGain(const VoiceData &voice) const
+        {
+            float gain = volume * voice.volume;
+            if (voice.sound->ChannelCount() == stereo)
+                return fvec2(gain);
+
+            // The relative positions are already in the listener space, so they don't need to be rotated.
+            fvec3 dir = voice.relative ? voice.pos : voice.pos - listener_pos;
+            fvec3 right = voice.relative ? fvec3(1, 0, 0) : listener_right;
+            float dist = dir.len();
+
+            // The `inverse` clamped model. Same as OpenAL, if the parameters make the gain impossible to compute, we don't attenuate.
+            float clamped_dist = std::min(std::max(dist, voice.ref_distance), voice.max_distance);
+            float denominator = voice.ref_distance + voice.rolloff_factor * (clamped_dist - voice.ref_distance);
+            if (voice.ref_distance > 0 && denominator > 0)
+                gain *= voice.ref_distance / denominator;
+
+            // Equal-power panning.
+            float pan = dist > 0 ? std::clamp(dir.dot(right) / dist, -1.f, 1.f) : 0.f;
+            float angle = (pan + 1) * (std::numbers::pi_v<float> / 4);
+            return fvec2(std::cos(angle), std::sin(angle)) * gain;
+        }
+
+        // Returns a free voice, or steals one. Returns null if the new voice should be rejected.
+        [[nodiscard]] VoiceData *Allocate(float priority)
+        {
+            VoiceData *ret = nullptr;
+
+            if (active_voices < voices.size())
+            {
+                ret = &*std::find_if(voices.begin(), voices.end(), [](const VoiceData &voice){return !voice.sound;});
+            }
+            else
+            {
+                float ret_loudness = 0;
+                for (VoiceData &voice : voices)
+                {
+                    float loudness = ComputeGain(voice).max();
+                    if (!ret
+                        || voice.priority < ret->priority
+                        || (voice.priority == ret->priority && (loudness < ret_loudness || (loudness == ret_loudness && voice.start_index < ret->start_index))))
+                    {
+                        ret = &voice;
+                        ret_loudness = loudness;
+                    }
+                }
+
+                if (!ret || ret->priority > priority)
+                {
+                    stats.rejected_voices++;
+                    return nullptr;
+                }
+
+                Free(*ret);
+                stats.stolen_voices++;
+            }
+
+            std::uint32_t generation = ret->generation;
+            *ret = {};
+            ret->generation = generation;
+            ret->start_index = next_start_index++;
+            ret->priority = priority;
+            ret->rolloff_factor = default_rolloff_fac;
+            ret->ref_distance = default_ref_dist;
+            ret->max_distance = default_max_dist;
+
+            active_voices++;
+            stats.started_voices++;
+            return ret;
+        }
+
+        // Mixes the next `count` blocks of the voice into `target`. Returns false if the voice finished playing.
+        bool MixVoice(VoiceData &voice, float *target, std::size_t count);
+    };
+
+
+    // The mixing kernels. All of them add to the interleaved stereo `target`.
+    // The gain at the output block `i` is `gain + gain_step * (first + i)`. The vectorized and scalar code computes it in the same way,
+    // so the result doesn't depend on the alignment and the length of the spans.
+
+    [[nodiscard]] static float SampleToFloat(std::int16_t sample)
+    {
+        return sample;
+    }
+    [[nodiscard]] static float SampleToFloat(std::uint8_t sample)
+    {
+        return float((int(sample) - 128) * 256);
+    }
+
+    // Mixes `count` blocks of a 16-bit sound, when the voice plays at the output sampling rate, and no interpolation is needed.
+    template <int ChannelCount>
+    static void MixUnresampled(float *target, const std::int16_t *source, std::size_t count, fvec2 gain, fvec2 gain_step, std::size_t first)
+    {
+        std::size_t i = 0;
+
+        #if AUDIO_MIXER_SSE2
+        const __m128 four = _mm_set1_ps(4);
+        if constexpr (ChannelCount == 1)
+        {
+            __m128 gain_l = _mm_set1_ps(gain.x), gain_r = _mm_set1_ps(gain.y);
+            __m128 step_l = _mm_set1_ps(gain_step.x), step_r = _mm_set1_ps(gain_step.y);
+            __m128 index = _mm_setr_ps(float(first), float(first + 1), float(first + 2), float(first + 3));
+
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128i raw = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(source + i));
+                __m128 samples = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(raw, raw), 16));
+                __m128 l = _mm_mul_ps(samples, _mm_add_ps(gain_l, _mm_mul_ps(step_l, index)));
+                __m128 r = _mm_mul_ps(samples, _mm_add_ps(gain_r, _mm_mul_ps(step_r, index)));
+                _mm_storeu_ps(target + i * 2,     _mm_add_ps(_mm_loadu_ps(target + i * 2),     _mm_unpacklo_ps(l, r)));
+                _mm_storeu_ps(target + i * 2 + 4, _mm_add_ps(_mm_loadu_ps(target + i * 2 + 4), _mm_unpackhi_ps(l, r)));
+                index = _mm_add_ps(index, four);
+            }
+        }
+        else
+        {
+            __m128 gain_lr = _mm_setr_ps(gain.x, gain.y, gain.x, gain.y);
+            __m128 step_lr = _mm_setr_ps(gain_step.x, gain_step.y, gain_step.x, gain_step.y);
+            __m128 index = _mm_setr_ps(float(first), float(first), float(first + 1), float(first + 1));
+            const __m128 two = _mm_set1_ps(2);
+
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i * 2));
+                __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(raw, raw), 16));
+                __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(raw, raw), 16));
+                lo = _mm_mul_ps(lo, _mm_add_ps(gain_lr, _mm_mul_ps(step_lr, index)));
+                hi = _mm_mul_ps(hi, _mm_add_ps(gain_lr, _mm_mul_ps(step_lr, _mm_add_ps(index, two))));
+                _mm_storeu_ps(target + i * 2,     _mm_add_ps(_mm_loadu_ps(target + i * 2),     lo));
+                _mm_storeu_ps(target + i * 2 + 4, _mm_add_ps(_mm_loadu_ps(target + i * 2 + 4), hi));
+                index = _mm_add_ps(index, four);
+            }
+        }
+        #endif
+
+        for (; i < count; i++)
+        {
+            float index = float(first + i);
+            float gain_l = gain.x + gain_step.x * index;
+            float gain_r = gain.y + gain_step.y * index;
+            if constexpr (ChannelCount == 1)
+            {
+                float sample = source[i];
+                target[i * 2] += sample * gain_l;
+                target[i * 2 + 1] += sample * gain_r;
+            }
+            else
+            {
+                target[i * 2] += float(source[i * 2]) * gain_l;
+                target[i * 2 + 1] += float(source[i * 2 + 1]) * gain_r;
+            }
+        }
+    }
+
+    // Mixes `count` blocks of any sound with linear interpolation, starting at `position` and advancing by `step` per output block.
+    // All blocks at the positions we visit must exist. When interpolating past the last block, we use the first one if `loop` is true, or silence otherwise.
+    // Returns the new position.
+    template <typename T, int ChannelCount>
+    static std::uint64_t MixResampled(float *target, const T *source, std::size_t block_count, bool loop,
+        std::uint64_t position, std::uint64_t step, std::size_t count, fvec2 gain, fvec2 gain_step, std::size_t first)
+    {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            std::size_t block = std::size_t(position >> fixed_point_bits);
+            float frac = float(position & (fixed_point_one - 1)) * (1.f / float(fixed_point_one));
+
+            const T *a = source + block * ChannelCount;
+            const T *b = block + 1 < block_count ? a + ChannelCount : loop ? source : nullptr;
+
+            float index = float(first + i);
+            float gain_l = gain.x + gain_step.x * index;
+            float gain_r = gain.y + gain_step.y * index;
+
+            float samples[ChannelCount];
+            for (int c = 0; c < ChannelCount; c++)
+            {
+                float value_a = SampleToFloat(a[c]);
+                float value_b = b ? SampleToFloat(b[c]) : 0.f;
+                samples[c] = value_a + (value_b - value_a) * frac;
+            }
+
+            target[i * 2] += samples[0] * gain_l;
+            target[i * 2 + 1] += samples[ChannelCount - 1] * gain_r;
+
+            position += step;
+        }
+        return position;
+    }
+
+    // Converts the accumulated samples to 16 bits, with rounding and saturation.
+    static void ConvertToInt16(std::int16_t *target, const float *source, std::size_t count)
+    {
+        std::size_t i = 0;
+
+        #if AUDIO_MIXER_SSE2
+        const __m128 min = _mm_set1_ps(-32768), max = _mm_set1_ps(32767);
+        for (; i + 8 <= count; i += 8)
+        {
+            // Clamp before converting, since the conversion turns the large values into INT_MIN.
+            __m128i lo = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(source + i), min), max));
+            __m128i hi = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(source + i + 4), min), max));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(target + i), _mm_packs_epi32(lo, hi));
+        }
+        #endif
+
+        for (; i < count; i++)
+            target[i] = std::int16_t(std::lrint(std::min(std::max(source[i], -32768.f), 32767.f)));
+    }
+
+    bool Mixer::Data::MixVoice(VoiceData &voice, float *target, std::size_t count)
+    {
+        const Sound &sound = *voice.sound;
+        std::size_t block_count = sound.BlockCount();
+        std::uint64_t end = std::uint64_t(block_count) << fixed_point_bits;
+
+        fvec2 target_gain = ComputeGain(voice);
+        fvec2 gain = voice.gain_valid ? voice.gain : target_gain;
+        fvec2 gain_step = (target_gain - gain) / float(count);
+        voice.gain = target_gain;
+        voice.gain_valid = true;
+
+        // Limit the step, to avoid overflowing the position.
+        double step_double = double(voice.raw_pitch) * sound.SamplingRate() / sampling_rate * double(fixed_point_one);
+        std::uint64_t step = step_double >= 1 ? std::uint64_t(std::llround(std::min(step_double, double(fixed_point_one) * (1 << 16)))) : 1;
+
+        std::size_t i = 0;
+        while (i < count)
+        {
+            if (voice.position >= end)
+            {
+                if (!voice.loop || block_count == 0)
+                    return false;
+                voice.position %= end;
+            }
+
+            // Mix until the end of the sound or the end of the output, whichever comes first.
+            std::size_t segment = std::size_t(std::min(std::uint64_t(count - i), (end - voice.position + step - 1) / step));
+
+            if (sound.Resolution() == bits_16 && step == fixed_point_one && (voice.position & (fixed_point_one - 1)) == 0)
+            {
+                const std::int16_t *source = sound.Data<std::int16_t>() + (voice.position >> fixed_point_bits) * sound.ChannelCount();
+                if (sound.ChannelCount() == mono)
+                    MixUnresampled<1>(target + i * 2, source, segment, gain, gain_step, i);
+                else
+                    MixUnresampled<2>(target + i * 2, source, segment, gain, gain_step, i);
+                voice.position += std::uint64_t(segment) << fixed_point_bits;
+            }
+            else
+            {
+                auto Mix = [&]<typename T, int ChannelCount>
+                {
+                    voice.position = MixResampled<T, ChannelCount>(target + i * 2, sound.Data<T>(), block_count, voice.loop, voice.position, step, segment, gain, gain_step, i);
+                };
+                if (sound.Resolution() == bits_16)
+                    sound.ChannelCount() == mono ? Mix.operator()<std::int16_t, 1>() : Mix.operator()<std::int16_t, 2>();
+                else
+                    sound.ChannelCount() == mono ? Mix.operator()<std::uint8_t, 1>() : Mix.operator()<std::uint8_t, 2>();
+            }
+
+            i += segment;
+        }
+
+        // Free the voice as soon as possible, rather than at the next render.
+        return voice.loop || voice.position < end;
+    }
+
+
+    Mixer::VoiceData *Mixer::Voice::Get() const
+    {
+        if (!mixer)
+            return nullptr;
+        VoiceData &voice = mixer->voices[index];
+        return voice.sound && voice.generation == generation ? &voice : nullptr;
+    }
+
+    bool Mixer::Voice::IsPlaying() const
+    {
+        return bool(Get());
+    }
+
+    Mixer::Voice &Mixer::Voice::volume(float v)
+    {
+        if (VoiceData *voice = Get())
+            voice->volume = v;
+        return *this;
+    }
+    Mixer::Voice &Mixer::Voice::pitch(float p)
+    {
+        return raw_pitch(std::exp2(p));
+    }
+    Mixer::Voice &Mixer::Voice::raw_pitch(float p)
+    {
+        if (VoiceData *voice = Get())
+            voice->raw_pitch = p;
+        return *this;
+    }
+    Mixer::Voice &Mixer::Voice::loop(bool l)
+    {
+        if (VoiceData *voice = Get())
+            voice->loop = l;
+        return *this;
+    }
+    Mixer::Voice &Mixer::Voice::pos(fvec3 p)
+    {
+        if (VoiceData *voice = Get())
+            voice->pos = p;
+        return *this;
+    }
+    Mixer::Voice &Mixer::Voice::relative(bool r)
+    {
+        if (VoiceData *voice = Get())
+            voice->relative = r;
+        return *this;
+    }
+    Mixer::Voice &Mixer::Voice::rolloff_factor(float f)
+    {
+        if (VoiceData *voice = Get())
+            voice->rolloff_factor = f;
+        return *this;
+    }
+    Mixer::Voice &Mixer::Voice::max_distance(float d)
+    {
+        if (VoiceData *voice = Get())
+            voice->max_distance = d;
+        return *this;
+    }
+    Mixer::Voice &Mixer::Voice::ref_distance(float d)
+    {
+        if (VoiceData *voice = Get())
+            voice->ref_distance = d;
+        return *this;
+    }
+    void Mixer::Voice::stop()
+    {
+        if (VoiceData *voice = Get())
+            mixer->Free(*voice);
+    }
+
+
+    Mixer::Mixer() {}
+
+    Mixer::Mixer(int sampling_rate, std::size_t max_voices) : data(std::make_unique<Data>())
+    {
+        ASSERT(sampling_rate > 0, "Invalid mixer sampling rate.");
+        ASSERT(max_voices > 0, "Invalid mixer voice count.");
+        data->sampling_rate = sampling_rate;
+        data->voices.resize(max_voices);
+    }
+
+    Mixer::Mixer(Mixer &&) noexcept = default;
+    Mixer &Mixer::operator=(Mixer &&) noexcept = default;
+    Mixer::~Mixer() = default;
+
+    int Mixer::SamplingRate() const
+    {
+        return data ? data->sampling_rate : 0;
+    }
+
+    std::size_t Mixer::MaxVoices() const
+    {
+        return data ? data->voices.size() : 0;
+    }
+
+    std::size_t Mixer::ActiveVoices() const
+    {
+        return data ? data->active_voices : 0;
+    }
+
+    const Mixer::Stats &Mixer::GetStats() const
+    {
+        static const Stats null_stats;
+        return data ? data->stats : null_stats;
+    }
+
+    void Mixer::DefaultRolloffFactor(float f)
+    {
+        if (data)
+            data->default_rolloff_fac = f;
+    }
+    void Mixer::DefaultRefDistance(float d)
+    {
+        if (data)
+            data->default_ref_dist = d;
+    }
+    void Mixer::DefaultMaxDistance(float d)
+    {
+        if (data)
+            data->default_max_dist = d;
+    }
+
+    void Mixer::Volume(float vol)
+    {
+        if (data)
+            data->volume = vol;
+    }
+    void Mixer::ListenerPosition(fvec3 pos)
+    {
+        if (data)
+            data->listener_pos = pos;
+    }
+    void Mixer::ListenerOrientation(fvec3 forward, fvec3 up)
+    {
+        if (data)
+            data->listener_right = forward.cross(up).norm();
+    }
+
+    Mixer::Voice Mixer::Play(const Sound &sound, fvec3 pos, float volume, float pitch, float priority)
+    {
+        ASSERT(sound, "Attempt to play a null sound.");
+        if (!data)
+            return {};
+
+        VoiceData *voice_data = data->Allocate(priority);
+        if (!voice_data)
+            return {};
+        voice_data->sound = &sound;
+
+        Voice ret;
+        ret.mixer = data.get();
+        ret.index = std::uint32_t(voice_data - data->voices.data());
+        ret.generation = voice_data->generation;
+        ret.pos(pos).volume(volume).pitch(pitch);
+        return ret;
+    }
+
+    Mixer::Voice Mixer::Play(const Sound &sound, float volume, float pitch, float priority)
+    {
+        return Play(sound, fvec3(), volume, pitch, priority).relative();
+    }
+
+    void Mixer::StopAll()
+    {
+        if (!data)
+            return;
+        for (VoiceData &voice : data->voices)
+        {
+            if (voice.sound)
+                data->Free(voice);
+        }
+    }
+
+    void Mixer::Render(std::int16_t *target, std::size_t block_count)
+    {
+        if (!data)
+        {
+            std::fill_n(target, block_count * 2, std::int16_t(0));
+            return;
+        }
+
+        data->accumulator.assign(block_count * 2, 0);
+
+        if (block_count > 0)
+        {
+            for (VoiceData &voice : data->voices)
+            {
+                if (voice.sound && !data->MixVoice(voice, data->accumulator.data(), block_count))
+                    data->Free(voice);
+            }
+        }
+
+        ConvertToInt16(target, data->accumulator.data(), block_count * 2);
+    }
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "audio/sound.h"
+#include "utils/mat.h"
+
+namespace Audio
+{
+    // Mixes many lightweight voices in software into a single stereo 16-bit stream.
+    // Unlike `Source`s, voices don't use any OpenAL objects, and are cheap to start and to stop.
+    // Use `MixerSource` to play the resulting stream, or call `Render()` directly (this doesn't need an audio device, which is useful for tests).
+    //
+    // The spatialization mimics OpenAL with the default `inverse` clamped distance model (see `Audio::Parameters::Model`),
+    // with the same reference distance, rolloff factor, and max distance semantics as in `Source`.
+    // Mono voices are panned left and right according to their position relative to the listener, stereo voices are not spatialized at all (like in OpenAL).
+    //
+    // When all voices are busy, a new voice steals the voice with the lowest priority, then the quietest one, then the oldest one.
+    // If all playing voices have higher priority than the new one, the new voice is rejected instead.
+    //
+    // The mixer stores references to the sounds, so they must stay alive while they're being played.
+    // The mixer is not thread-safe.
+    class Mixer
+    {
+        struct Data;
+        struct VoiceData;
+        std::unique_ptr<Data> data;
+
+      public:
+        struct Stats
+        {
+            std::uint64_t started_voices = 0;
+            std::uint64_t stolen_voices = 0; // How many playing voices were stopped to make room for new ones.
+            std::uint64_t rejected_voices = 0; // How many voices weren't started, because all playing voices had higher priority.
+        };
+
+        // A handle to a playing voice. All operations on a voice that has finished playing, was stopped, or was stolen, are no-ops.
+        // The handle remains valid when the mixer is moved, but not after it's destroyed.
+        class Voice
+        {
+            friend Mixer;
+            Data *mixer = nullptr;
+            std::uint32_t index = 0;
+            std::uint32_t generation = 0;
+
+            VoiceData *Get() const;
+
+          public:
+            // Create a null handle.
+            Voice() {}
+
+            // Returns false if the handle is null, which also happens if the voice was rejected when starting it.
+            [[nodiscard]] explicit operator bool() const {return bool(mixer);}
+
+            [[nodiscard]] bool IsPlaying() const;
+
+            Voice &volume(float v); // Defaults to 1.
+            Voice &pitch(float p); // Defaults to 0. The preferred range is -1..1.
+            Voice &raw_pitch(float p); // Defaults to 1, must be positive. The playback speed is multiplied by this number.
+            Voice &loop(bool l = true);
+
+            Voice &pos(fvec3 p);
+            Voice &pos(fvec2 p) {return pos(p.to_vec3());}
+            Voice &relative(bool r = true); // If true, the position is relative to the listener.
+
+            Voice &rolloff_factor(float f);
+            Voice &max_distance(float d);
+            Voice &ref_distance(float d);
+
+            // Stops the voice. The handle becomes unusable.
+            void stop();
+        };
+
+        // Create a null mixer.
+        Mixer();
+        // The output is always stereo, at `sampling_rate`.
+        // Sounds with a different sampling rate are resampled on the fly, with linear interpolation.
+        Mixer(int sampling_rate, std::size_t max_voices = 64);
+        Mixer(Mixer &&) noexcept;
+        Mixer &operator=(Mixer &&) noexcept;
+        ~Mixer();
+
+        [[nodiscard]] explicit operator bool() const {return bool(data);}
+
+        [[nodiscard]] int SamplingRate() const;
+        [[nodiscard]] std::size_t MaxVoices() const;
+        [[nodiscard]] std::size_t ActiveVoices() const;
+        [[nodiscard]] const Stats &GetStats() const;
+
+        // The parameters of the new voices, same as `Source::DefaultRolloffFactor()` and others.
+        // Those are per mixer, so you need to set them on both the mixer and the `Source` to get the same results.
+        void DefaultRolloffFactor(float f); // Defaults to 1.
+        void DefaultRefDistance(float d); // Defaults to 1.
+        void DefaultMaxDistance(float d); // Defaults to infinity.
+
+        // Mirrors `Audio::Volume()` and other listener functions from `parameters.h`.
+        void Volume(float vol); // Defaults to 1.
+        void ListenerPosition(fvec3 pos);
+        void ListenerOrientation(fvec3 forward, fvec3 up); // Only the "right" direction, `forward cross up`, matters for panning.
+
+        // Start a new voice. Returns a null handle if the voice was rejected, see above.
+        // The sound must not be null, and must outlive the voice.
+        Voice Play(const Sound &sound, fvec3 pos, float volume = 1, float pitch = 0, float priority = 0);
+        Voice Play(const Sound &sound, fvec2 pos, float volume = 1, float pitch = 0, float priority = 0)
+        {
+            return Play(sound, pos.to_vec3(), volume, pitch, priority);
+        }
+        // Same, but the voice is positioned at the listener, so it's centered and isn't attenuated.
+        Voice Play(const Sound &sound, float volume = 1, float pitch = 0, float priority = 0);
+
+        // Stops all voices.
+        void StopAll();
+
+        // Mixes the next `block_count` blocks of the playing voices into `target`, which receives `block_count * 2` interleaved stereo samples.
+        // The voices that finish playing are removed.
+        void Render(std::int16_t *target, std::size_t block_count);
+    };
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "audio/buffer.h"
+#include "audio/mixer.h"
+#include "audio/openal.h"
+#include "audio/source.h"
+#include "program/errors.h"
+
+// Plays the output of a `Mixer` through a single OpenAL source.
+// `Update()` renders the mix into a small ring of OpenAL buffers queued on the source, on the calling thread.
+// The latency is roughly `num_buffers * chunk_blocks` blocks. `Update()` must be called at least once per `chunk_blocks` blocks, otherwise the source underruns.
+// Usage:
+//     Audio::MixerSource effects(44100);
+//     Audio::Sound boom = ...;
+//     effects.GetMixer().Play(boom, pos);
+//     // Every tick:
+//     effects.Update();
+
+namespace Audio
+{
+    class MixerSource
+    {
+      public:
+        struct Stats
+        {
+            std::uint64_t underruns = 0; // How many times the source ran out of queued buffers.
+            std::uint64_t rendered_chunks = 0;
+        };
+
+      private:
+        struct Data
+        {
+            // The member order matters: the source must be destroyed before the buffers queued on it.
+            Mixer mixer;
+            std::vector<Buffer> buffers;
+            Source source;
+
+            std::vector<ALuint> free_buffers; // The buffers that are not queued on the source.
+            std::size_t chunk_blocks = 0;
+            std::vector<std::int16_t> chunk; // The rendered samples, reused between the updates.
+
+            bool want_playing = false;
+            Stats stats;
+        };
+        Data data;
+
+        void FillBuffers()
+        {
+            while (!data.free_buffers.empty())
+            {
+                data.mixer.Render(data.chunk.data(), data.chunk_blocks);
+
+                ALuint handle = data.free_buffers.back();
+                auto it = std::find_if(data.buffers.begin(), data.buffers.end(), [&](const Buffer &buffer){return buffer.Handle() == handle;});
+                it->SetData(data.mixer.SamplingRate(), stereo, bits_16, data.chunk_blocks, reinterpret_cast<const std::uint8_t *>(data.chunk.data()));
+                alSourceQueueBuffers(data.source.Handle(), 1, &handle);
+                data.free_buffers.pop_back();
+                data.stats.rendered_chunks++;
+            }
+        }
+
+      public:
+        MixerSource() {}
+
+        // See `Mixer::Mixer()` for the meaning of `sampling_rate` and `max_voices`.
+        MixerSource(int sampling_rate, std::size_t max_voices = 64, std::size_t num_buffers = 4, std::size_t chunk_blocks = 512)
+        {
+            ASSERT(num_buffers > 0 && chunk_blocks > 0, "Invalid mixer source buffer size.");
+
+            data.mixer = Mixer(sampling_rate, max_voices);
+            data.chunk_blocks = chunk_blocks;
+            data.chunk.resize(chunk_blocks * 2);
+
+            data.buffers.reserve(num_buffers);
+            for (std::size_t i = 0; i < num_buffers; i++)
+                data.free_buffers.push_back(data.buffers.emplace_back(nullptr).Handle());
+
+            // The mix is already spatialized, so the source must not be attenuated or panned.
+            data.source = Source(nullptr);
+            data.source.relative().pos(fvec3()).rolloff_factor(0);
+        }
+
+        MixerSource(MixerSource &&other) noexcept : data(std::exchange(other.data, {})) {}
+        MixerSource &operator=(MixerSource other) noexcept
+        {
+            std::swap(data, other.data);
+            return *this;
+        }
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return bool(data.mixer);
+        }
+
+        [[nodiscard]] Mixer &GetMixer()
+        {
+            return data.mixer;
+        }
+
+        // Use this to set the overall volume. Don't `play()` the source directly, and don't set its buffer or enable looping on it.
+        [[nodiscard]] Source &GetSource()
+        {
+            return data.source;
+        }
+
+        [[nodiscard]] const Stats &GetStats() const
+        {
+            return data.stats;
+        }
+
+        // Starts or resumes the playback. The mixer keeps playing silence when there are no voices.
+        void Play()
+        {
+            if (!data.mixer)
+                return;
+
+            FillBuffers();
+            data.want_playing = true;
+            data.source.play();
+        }
+
+        // Pauses the playback. The voices are paused too, since they only advance when rendered.
+        void Pause()
+        {
+            data.want_playing = false;
+            data.source.pause();
+        }
+
+        // Recycles the buffers that finished playing, renders new ones, and restarts the source after underruns.
+        // Call this every tick.
+        void Update()
+        {
+            if (!data.mixer)
+                return;
+
+            ALint processed = 0;
+            alGetSourcei(data.source.Handle(), AL_BUFFERS_PROCESSED, &processed);
+            while (processed-- > 0)
+            {
+                ALuint handle = 0;
+                alSourceUnqueueBuffers(data.source.Handle(), 1, &handle);
+                data.free_buffers.push_back(handle);
+            }
+
+            if (!data.want_playing)
+                return;
+
+            FillBuffers();
+
+            if (data.source.GetState() == SourceState::stopped)
+            {
+                data.stats.underruns++;
+                data.source.play();
+            }
+        }
+    };
+}
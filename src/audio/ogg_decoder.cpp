@@ -0,0 +1,270 @@
+#include "ogg_decoder.h"
+
+#include <cstdio>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#include <vorbis/vorbisfile.h>
+
+#include "strings/format.h"
+#include "utils/robust_math.h"
+
+namespace Audio
+{
+    static const ov_callbacks stream_callbacks = []{
+        ov_callbacks ret;
+        ret.close_func = nullptr;
+        ret.tell_func = [](void *stream_ptr) -> long
+        {
+            try
+            {
+                long ret;
+                if (Robust::conversion_fails(static_cast<Stream::Input *>(stream_ptr)->Position(), ret))
+                    return -1;
+                return ret;
+            }
+            catch (...)
+            {
+                return -1;
+            }
+        };
+        ret.seek_func = [](void *stream_ptr, std::int64_t offset, int mode) -> int
+        {
+            try
+            {
+                std::ptrdiff_t converted_offset;
+                if (Robust::conversion_fails(offset, converted_offset))
+                    return -1;
+
+                Stream::SeekMode converted_mode;
+                switch (mode)
+                {
+                  case SEEK_SET:
+                    converted_mode = Stream::absolute;
+                    break;
+                  case SEEK_CUR:
+                    converted_mode = Stream::relative;
+                    break;
+                  case SEEK_END:
+                    converted_mode = Stream::end;
+                    break;
+                  default:
+                    return -1;
+                }
+
+                static_cast<Stream::Input *>(stream_ptr)->Seek(converted_offset, converted_mode);
+                return 0;
+            }
+            catch (...)
+            {
+                return -1;
+            }
+        };
+        ret.read_func = [](void *buffer, std::size_t elem_size, std::size_t elem_count, void *stream_ptr) -> std::size_t
+        {
+            try
+            {
+                if (elem_size == 0 || elem_count == 0)
+                    return 0;
+
+                auto &stream = *static_cast<Stream::Input *>(stream_ptr);
+
+                std::size_t total_size;
+                bool enough_data = true;
+
+                // If the read size is larger than the remaining amount of bytes
+                // OR if the calculation of `total_size` overflowed, clamp the read size.
+                if ((Robust::value(elem_size) * Robust::value(elem_count) >>= total_size) || total_size > stream.RemainingBytes())
+                {
+                    total_size = stream.RemainingBytes();
+                    enough_data = false;
+                }
+
+                stream.Read(static_cast<char *>(buffer), total_size);
+
+                if (enough_data)
+                    return elem_count;
+                else
+                    return total_size / elem_size;
+            }
+            catch (...)
+            {
+                return -1;
+            }
+        };
+        return ret;
+    }();
+
+    struct OggDecoder::Data
+    {
+        Stream::Input input; // The callbacks hold a pointer to this, so the object must not move.
+        OggVorbis_File file_handle;
+        bool file_handle_valid = false;
+
+        int sampling_rate = 0;
+        Channels channel_count = mono;
+        BitResolution resolution = bits_16;
+
+        // An index of the current bitstream (basically a section) of the file.
+        // When it changes, the amount of channels and/or sample rate can also change; if it happens, we throw an exception.
+        int bitstream_index = -1;
+
+        Data() {}
+        Data(const Data &) = delete;
+        Data &operator=(const Data &) = delete;
+
+        ~Data()
+        {
+            if (file_handle_valid)
+                ov_clear(&file_handle);
+        }
+
+        [[noreturn]] void Fail(std::string_view message)
+        {
+            throw std::runtime_error(FMT("While reading a vorbis sound from `{}`:\n{}", input.GetTarget(), message));
+        }
+    };
+
+    OggDecoder::OggDecoder() {}
+
+    OggDecoder::OggDecoder(Stream::Input input, BitResolution resolution) : data(std::make_unique<Data>())
+    {
+        // Stream exceptions aren't supposed to escape the callbacks anyway,
+        // might as well make constructing them as cheap as possible.
+        input.WantExceptionPrefixStyle(Stream::no_prefix);
+
+        data->input = std::move(input);
+        data->resolution = resolution;
+
+        // Open a file with the callbacks.
+        switch (ov_open_callbacks(&data->input, &data->file_handle, nullptr, 0, stream_callbacks))
+        {
+          case 0:
+            break;
+          case OV_EREAD:
+            data->Fail("Unable to read data from the stream.");
+          case OV_ENOTVORBIS:
+            data->Fail("This is not a vorbis sound.");
+          case OV_EVERSION:
+            data->Fail("Vorbis version mismatch.");
+          case OV_EBADHEADER:
+            data->Fail("Invalid header.");
+          case OV_EFAULT:
+            data->Fail("Internal vorbis error.");
+          default:
+            data->Fail("Unknown vorbis error.");
+        }
+        data->file_handle_valid = true;
+
+        // Get some info about the file. No cleanup appears to be necessary.
+        vorbis_info *info = ov_info(&data->file_handle, -1);
+        if (!info)
+            data->Fail("Unable to get information about the file.");
+
+        // Get channel count.
+        if (info->channels != 1 && info->channels != 2)
+            data->Fail("The file has too many channels. Only mono and stereo are supported.");
+        data->channel_count = Channels(info->channels);
+
+        // Get frequency.
+        if (Robust::conversion_fails(info->rate, data->sampling_rate))
+            data->Fail("The sample rate is too high.");
+    }
+
+    OggDecoder::OggDecoder(OggDecoder &&) noexcept = default;
+    OggDecoder &OggDecoder::operator=(OggDecoder &&) noexcept = default;
+    OggDecoder::~OggDecoder() = default;
+
+    int OggDecoder::SamplingRate() const
+    {
+        return data ? data->sampling_rate : 0;
+    }
+
+    Channels OggDecoder::ChannelCount() const
+    {
+        return data ? data->channel_count : mono;
+    }
+
+    BitResolution OggDecoder::Resolution() const
+    {
+        return data ? data->resolution : bits_16;
+    }
+
+    std::size_t OggDecoder::BlockCount() const
+    {
+        if (!data)
+            throw std::runtime_error("Attempt to use a null vorbis decoder.");
+
+        auto total_block_count = ov_pcm_total(&data->file_handle, -1);
+        if (total_block_count == OV_EINVAL)
+            data->Fail("Unable to determine the file length.");
+
+        std::size_t ret;
+        if (Robust::conversion_fails(total_block_count, ret))
+            data->Fail("The file is too long.");
+        return ret;
+    }
+
+    std::size_t OggDecoder::Read(std::uint8_t *target, std::size_t block_count)
+    {
+        if (!data)
+            throw std::runtime_error("Attempt to use a null vorbis decoder.");
+
+        std::size_t bytes_per_block = BytesPerBlock();
+
+        std::size_t byte_size;
+        if (Robust::value(block_count) * Robust::value(bytes_per_block) >>= byte_size)
+            data->Fail("The requested chunk is too large.");
+
+        std::size_t current_offset = 0;
+        while (current_offset < byte_size)
+        {
+            // `ov_read()` accepts an `int` size, and returns at most one packet anyway.
+            int max_segment_size = int(std::min(byte_size - current_offset, std::size_t(1) << 20));
+
+            int bitstream_index;
+            long segment_size = ov_read(&data->file_handle, reinterpret_cast<char *>(target + current_offset), max_segment_size, 0/*little endian*/,
+                GetBytesPerSample(data->resolution), data->resolution == bits_16/*true means numbers are signed*/, &bitstream_index);
+
+            switch (segment_size)
+            {
+              case 0:
+                return current_offset / bytes_per_block; // End of file.
+              case OV_HOLE:
+                data->Fail("The file is corrupted.");
+              case OV_EBADLINK:
+                data->Fail("Bad link.");
+              case OV_EINVAL:
+                data->Fail("Invalid header.");
+            }
+            if (segment_size < 0)
+                data->Fail("Unknown vorbis error.");
+            current_offset += std::size_t(segment_size);
+
+            if (bitstream_index != data->bitstream_index)
+            {
+                data->bitstream_index = bitstream_index;
+
+                vorbis_info *info = ov_info(&data->file_handle, -1); // `-1` means the current bitstream, we could also use `bitstream_index` here.
+                if (!info)
+                    data->Fail("Unable to get information about a section of the file.");
+                if (Robust::not_equal(info->channels, int(data->channel_count)))
+                    data->Fail("Channel count has changed in the middle of the file.");
+                if (Robust::not_equal(info->rate, data->sampling_rate))
+                    data->Fail("Sampling rate has changed in the middle of the file.");
+            }
+        }
+
+        return block_count;
+    }
+
+    void OggDecoder::Rewind()
+    {
+        if (!data)
+            throw std::runtime_error("Attempt to use a null vorbis decoder.");
+
+        if (ov_pcm_seek(&data->file_handle, 0) != 0)
+            data->Fail("Unable to seek to the beginning.");
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "audio/sound.h"
+#include "stream/input.h"
+
+namespace Audio
+{
+    // Decodes a vorbis sound incrementally, a chunk at a time.
+    // `Sound` uses this to decode whole files, and `StreamingSource` uses it to decode music on the fly.
+    // The object can be moved to a different thread after construction, but must not be used from several threads at once.
+    class OggDecoder
+    {
+        struct Data;
+        std::unique_ptr<Data> data;
+
+      public:
+        OggDecoder();
+        // Reads the headers. Throws on failure.
+        // `resolution` is the resolution of the decoded samples.
+        OggDecoder(Stream::Input input, BitResolution resolution = bits_16);
+        OggDecoder(OggDecoder &&) noexcept;
+        OggDecoder &operator=(OggDecoder &&) noexcept;
+        ~OggDecoder();
+
+        [[nodiscard]] explicit operator bool() const {return bool(data);}
+
+        [[nodiscard]] int SamplingRate() const;
+        [[nodiscard]] Channels ChannelCount() const;
+        [[nodiscard]] BitResolution Resolution() const;
+        [[nodiscard]] int BytesPerBlock() const {return GetBytesPerBlock(Resolution(), ChannelCount());}
+
+        // The total length of the sound. Throws if it can't be determined.
+        [[nodiscard]] std::size_t BlockCount() const;
+
+        // Decodes at most `block_count` blocks to `target`. Returns the number of decoded blocks.
+        // Returns less than `block_count` only at the end of the sound. Throws on failure.
+        std::size_t Read(std::uint8_t *target, std::size_t block_count);
+
+        // Returns to the beginning of the sound. Throws on failure.
+        void Rewind();
+    };
+}
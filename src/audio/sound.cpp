@@ -1,10 +1,10 @@
 #include "sound.h"
 
+#include <string>
 #include <string_view>
 
-#include <vorbis/vorbisfile.h>
-
-#include "macros/finally.h"
+#include "audio/ogg_decoder.h"
+#include "audio/sound_conversion.h"
 #include "strings/format.h"
 #include "utils/robust_math.h"
 
@@ -12,11 +12,11 @@ namespace Audio
 {
     Sound::Sound(Format format, std::optional<Channels> expected_channel_count, Stream::Input input, BitResolution preferred_resolution)
     {
-        auto CheckChannelCount = [&]
+        auto CheckChannelCount = [&](std::string_view exception_prefix)
         {
             if (expected_channel_count && *expected_channel_count != channel_count)
             {
-                throw std::runtime_error(FMT("{}Expected a {} sound, but got {}.", input.GetExceptionPrefix(),
+                throw std::runtime_error(FMT("{}Expected a {} sound, but got {}.", exception_prefix,
                     (*expected_channel_count == mono ? "mono" : "stereo"), (channel_count == mono ? "mono" : "stereo")));
             }
         };
@@ -68,7 +68,7 @@ namespace Audio
                         if (channels != 1 && channels != 2)
                             throw std::runtime_error(input.GetExceptionPrefix() + "Only mono and stereo sound is supported.");
                         channel_count = Channels(channels);
-                        CheckChannelCount();
+                        CheckChannelCount(input.GetExceptionPrefix());
 
                         sampling_rate = input.ReadLittle<std::uint32_t>();
                         if (sampling_rate <= 0)
@@ -123,6 +123,13 @@ namespace Audio
                 // We don't need to check `got_format_chunk` because it's implied by `got_data_chunk`.
                 if (!got_data_chunk)
                     throw std::runtime_error("The data chunk is missing.");
+
+                if (resolution != preferred_resolution)
+                {
+                    SoundFormat target_format;
+                    target_format.resolution = preferred_resolution;
+                    *this = ConvertSound(std::move(*this), target_format);
+                }
             }
             catch (std::exception &e)
             {
@@ -130,199 +137,34 @@ namespace Audio
             }
             break;
           case ogg:
-            try
             {
-                // Stream exceptions aren't supposed to escape the callbacks anyway,
-                // might as well make constructing them as cheap as possible.
-                input.WantExceptionPrefixStyle(Stream::no_prefix);
+                std::string target = input.GetTarget();
+                OggDecoder decoder(std::move(input), preferred_resolution); // The exceptions thrown by the decoder already include the file name.
 
-                // Construct callbacks.
-                ov_callbacks callbacks;
-                callbacks.close_func = nullptr;
-                callbacks.tell_func = [](void *stream_ptr) -> long
-                {
-                    try
-                    {
-                        long ret;
-                        if (Robust::conversion_fails(static_cast<Stream::Input *>(stream_ptr)->Position(), ret))
-                            return -1;
-                        return ret;
-                    }
-                    catch (...)
-                    {
-                        return -1;
-                    }
-                };
-                callbacks.seek_func = [](void *stream_ptr, std::int64_t offset, int mode) -> int
-                {
-                    try
-                    {
-                        std::ptrdiff_t converted_offset;
-                        if (Robust::conversion_fails(offset, converted_offset))
-                            return -1;
+                channel_count = decoder.ChannelCount();
+                sampling_rate = decoder.SamplingRate();
+                resolution = decoder.Resolution();
 
-                        Stream::SeekMode converted_mode;
-                        switch (mode)
-                        {
-                          case SEEK_SET:
-                            converted_mode = Stream::absolute;
-                            break;
-                          case SEEK_CUR:
-                            converted_mode = Stream::relative;
-                            break;
-                          case SEEK_END:
-                            converted_mode = Stream::end;
-                            break;
-                          default:
-                            return -1;
-                        }
+                std::size_t block_count = decoder.BlockCount();
 
-                        static_cast<Stream::Input *>(stream_ptr)->Seek(converted_offset, converted_mode);
-                        return 0;
-                    }
-                    catch (...)
-                    {
-                        return -1;
-                    }
-                };
-                callbacks.read_func = [](void *buffer, std::size_t elem_size, std::size_t elem_count, void *stream_ptr) -> std::size_t
+                try
                 {
-                    try
-                    {
-                        if (elem_size == 0 || elem_count == 0)
-                            return 0;
-
-                        auto &stream = *static_cast<Stream::Input *>(stream_ptr);
-
-                        std::size_t total_size;
-                        bool enough_data = true;
-
-                        // If the read size is larger than the remaining amount of bytes
-                        // OR if the calculation of `total_size` overflowed, clamp the read size.
-                        if ((Robust::value(elem_size) * Robust::value(elem_count) >>= total_size) || total_size > stream.RemainingBytes())
-                        {
-                            total_size = stream.RemainingBytes();
-                            enough_data = false;
-                        }
+                    CheckChannelCount("");
 
-                        stream.Read(static_cast<char *>(buffer), total_size);
+                    // Compute the necessary storage size.
+                    std::size_t storage_size;
+                    if (Robust::value(block_count) * Robust::value(BytesPerBlock()).weakly_typed() >>= storage_size)
+                        throw std::runtime_error("The file is too long.");
 
-                        if (enough_data)
-                            return elem_count;
-                        else
-                            return total_size / elem_size;
-                    }
-                    catch (...)
-                    {
-                        return -1;
-                    }
-                };
-
-                // Open a file with those callbacks.
-                OggVorbis_File ogg_file_handle;
-                switch (ov_open_callbacks(&input, &ogg_file_handle, nullptr, 0, callbacks))
-                {
-                  case 0:
-                    break;
-                  case OV_EREAD:
-                    throw std::runtime_error("Unable to read data from the stream.");
-                    break;
-                  case OV_ENOTVORBIS:
-                    throw std::runtime_error("This is not a vorbis sound.");
-                    break;
-                  case OV_EVERSION:
-                    throw std::runtime_error("Vorbis version mismatch.");
-                    break;
-                  case OV_EBADHEADER:
-                    throw std::runtime_error("Invalid header.");
-                    break;
-                  case OV_EFAULT:
-                    throw std::runtime_error("Internal vorbis error.");
-                    break;
-                  default:
-                    throw std::runtime_error("Unknown vorbis error.");
-                    break;
+                    data.resize(storage_size);
                 }
-                FINALLY{ov_clear(&ogg_file_handle);};
-
-
-                // Get some info about the file. No cleanup appears to be necessary.
-                vorbis_info *info = ov_info(&ogg_file_handle, -1);
-                if (!info)
-                    throw std::runtime_error("Unable to get information about the file.");
-
-                // Get channel count.
-                if (info->channels != 1 && info->channels != 2)
-                    throw std::runtime_error("The file has too many channels. Only mono and stereo are supported.");
-                channel_count = Channels(info->channels);
-                CheckChannelCount();
-
-                // Get frequency.
-                if (Robust::conversion_fails(info->rate, sampling_rate))
-                    throw std::runtime_error("The sample rate is too high.");
-
-                // Get the block count.
-                auto total_block_count = ov_pcm_total(&ogg_file_handle, -1);
-                if (total_block_count == OV_EINVAL)
-                    throw std::runtime_error("Unable to determine the file length.");
-
-                // Copy bit resolution from the parameter.
-                resolution = preferred_resolution;
-
-                // Compute the necessary storage size.
-                std::size_t storage_size;
-                if (Robust::value(total_block_count).cast_to<std::size_t>() * Robust::value(BytesPerBlock()).weakly_typed() >>= storage_size)
-                    throw std::runtime_error("The file is too long.");
-
-                data.resize(storage_size);
-
-                std::size_t current_offset = 0;
-
-                // An index of the current bitstream (basically a section) of the file.
-                // When it changes, the amount of channels and/or sample rate can also change; if it happens, we throw an exception.
-                int old_bitstream_index = -1;
-
-                while (current_offset < storage_size)
+                catch (std::exception &e)
                 {
-                    int bitstream_index;
-                    auto segment_size = ov_read(&ogg_file_handle, reinterpret_cast<char *>(data.data() + current_offset), storage_size - current_offset, 0/*little endian*/,
-                        BytesPerSample(), resolution == bits_16/*true means numbers are signed*/, &bitstream_index);
-
-                    switch (segment_size)
-                    {
-                      case 0:
-                        throw std::runtime_error("Unexpected end of file.");
-                        break;
-                      case OV_HOLE:
-                        throw std::runtime_error("The file is corrupted.");
-                        break;
-                      case OV_EBADLINK:
-                        throw std::runtime_error("Bad link.");
-                        break;
-                      case OV_EINVAL:
-                        throw std::runtime_error("Invalid header.");
-                        break;
-                    }
-                    current_offset += segment_size;
-
-                    if (bitstream_index != old_bitstream_index)
-                    {
-                        old_bitstream_index = bitstream_index;
-
-                        info = ov_info(&ogg_file_handle, -1); // `-1` means the current bitstream, we could also use `bitstream_index` here.
-                        if (!info)
-                            throw std::runtime_error("Unable to get information about a section of the file.");
-                        if (Robust::not_equal(info->channels, int(channel_count)))
-                            throw std::runtime_error("Channel count has changed in the middle of the file.");
-                        if (Robust::not_equal(info->rate, sampling_rate))
-                            throw std::runtime_error("Sampling rate has changed in the middle of the file.");
-                    }
+                    throw std::runtime_error(FMT("While reading a vorbis sound from `{}`:\n{}", target, e.what()));
                 }
 
-            }
-            catch (std::exception &e)
-            {
-                throw std::runtime_error(FMT("While reading a vorbis sound from `{}`:\n{}", input.GetTarget(), e.what()));
+                if (decoder.Read(data.data(), block_count) != block_count)
+                    throw std::runtime_error(FMT("While reading a vorbis sound from `{}`:\nUnexpected end of file.", target));
             }
             break;
         }
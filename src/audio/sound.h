@@ -81,7 +81,7 @@ namespace Audio
 
         // Loads a sound from a stream, according to the specified `format.
         // If `expected_channel_count` is not null, will throw if the received data doesn't have the specified amount of channels.
-        // `preferred_resolution` specifies the desired resolution; its effect depends on the format. (Currently it's ignored for WAV, and is used unconditionally for OGG.)
+        // `preferred_resolution` specifies the desired resolution. OGG files are decoded directly to it, and WAV files are converted to it if necessary (see `ConvertSound()`).
         Sound(Format format, std::optional<Channels> expected_channel_count, Stream::Input input, BitResolution preferred_resolution = bits_16);
 
         // Returns true if the object holds any data.
@@ -0,0 +1,290 @@
+#include "sound_conversion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numbers>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "strings/format.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AUDIO_CONVERSION_SSE2 1
+#include <emmintrin.h>
+#else
+#define AUDIO_CONVERSION_SSE2 0
+#endif
+
+namespace Audio
+{
+    // The resampling filter spans this many zero crossings of the sinc function on each side (more when downsampling, since the sinc is wider then).
+    static constexpr int resampler_zero_crossings = 16;
+    // The Kaiser window parameter. Larger values give more stopband attenuation, at the cost of a wider transition band.
+    static constexpr double resampler_kaiser_beta = 8.6;
+    // The cutoff frequency, relative to the Nyquist frequency of the lower of the two rates. Less than 1 to leave room for the transition band.
+    static constexpr double resampler_cutoff = 0.92;
+    // If the rate ratio needs more filter phases than this, the nearest phase is used instead.
+    static constexpr std::size_t resampler_max_phases = 4096;
+
+    // The zeroth-order modified Bessel function of the first kind, for the Kaiser window.
+    // Not using `std::cyl_bessel_i()`, since not all standard libraries implement it.
+    [[nodiscard]] static double BesselI0(double x)
+    {
+        // The power series: `sum((x/2)^2k / (k!)^2)`. The terms decrease quickly for the arguments we need.
+        double quarter_x_sq = x * x / 4;
+        double term = 1;
+        double ret = 1;
+        for (int k = 1; term > ret * 1e-17; k++)
+        {
+            term *= quarter_x_sq / (k * k);
+            ret += term;
+        }
+        return ret;
+    }
+
+    // The samples of a single channel, in the range of `int16_t`.
+    using ChannelSamples = std::vector<float>;
+
+    [[nodiscard]] static std::vector<ChannelSamples> SplitChannels(const Sound &sound)
+    {
+        std::size_t block_count = sound.BlockCount();
+        int channel_count = sound.ChannelCount();
+
+        std::vector<ChannelSamples> ret(channel_count, ChannelSamples(block_count));
+        for (int c = 0; c < channel_count; c++)
+        {
+            if (sound.Resolution() == bits_16)
+            {
+                const std::int16_t *source = sound.Data<std::int16_t>();
+                for (std::size_t i = 0; i < block_count; i++)
+                    ret[c][i] = source[i * channel_count + c];
+            }
+            else
+            {
+                const std::uint8_t *source = sound.Data<std::uint8_t>();
+                for (std::size_t i = 0; i < block_count; i++)
+                    ret[c][i] = float((int(source[i * channel_count + c]) - 128) * 256);
+            }
+        }
+        return ret;
+    }
+
+    static void MixChannels(std::vector<ChannelSamples> &channels, Channels channel_count)
+    {
+        if (channels.size() == std::size_t(channel_count))
+            return;
+
+        if (channel_count == mono)
+        {
+            for (std::size_t i = 0; i < channels[0].size(); i++)
+                channels[0][i] = (channels[0][i] + channels[1][i]) * 0.5f;
+            channels.pop_back();
+        }
+        else
+        {
+            channels.push_back(channels[0]);
+        }
+    }
+
+    // A polyphase windowed-sinc filter for resampling by a rational factor `up / down`.
+    struct ResamplingFilter
+    {
+        std::size_t up = 1;
+        std::size_t down = 1;
+        std::size_t num_phases = 1; // Equal to `up`, unless that's too large.
+        std::size_t half_taps = 0; // The number of taps on each side of the output position. A multiple of 2, so the total is a multiple of 4.
+        std::vector<float> taps; // `num_phases` rows of `half_taps * 2` taps.
+
+        ResamplingFilter(int input_rate, int output_rate)
+        {
+            std::size_t divisor = std::size_t(std::gcd(input_rate, output_rate));
+            up = std::size_t(output_rate) / divisor;
+            down = std::size_t(input_rate) / divisor;
+            num_phases = std::min(up, resampler_max_phases);
+
+            double cutoff = resampler_cutoff * std::min(1.0, double(output_rate) / input_rate); // Relative to the input Nyquist frequency.
+            half_taps = std::size_t(std::ceil(resampler_zero_crossings / cutoff));
+            half_taps += half_taps % 2;
+
+            std::size_t row_size = half_taps * 2;
+            taps.resize(num_phases * row_size);
+            double window_scale = 1 / BesselI0(resampler_kaiser_beta);
+
+            for (std::size_t phase = 0; phase < num_phases; phase++)
+            {
+                double frac = double(phase) / num_phases;
+                float *row = taps.data() + phase * row_size;
+
+                double sum = 0;
+                for (std::size_t i = 0; i < row_size; i++)
+                {
+                    // The distance from the output position to the input sample `i` of the row.
+                    double x = double(i) - double(half_taps - 1) - frac;
+                    double window_x = x / double(half_taps);
+                    double value = 0;
+                    if (std::abs(window_x) < 1)
+                    {
+                        double sinc = x == 0 ? 1 : std::sin(std::numbers::pi * cutoff * x) / (std::numbers::pi * cutoff * x);
+                        value = sinc * BesselI0(resampler_kaiser_beta * std::sqrt(1 - window_x * window_x)) * window_scale;
+                    }
+                    row[i] = float(value);
+                    sum += value;
+                }
+
+                // Normalize the taps, so the silence stays silent and DC stays unchanged.
+                for (std::size_t i = 0; i < row_size; i++)
+                    row[i] = float(row[i] / sum);
+            }
+        }
+
+        [[nodiscard]] std::size_t OutputLength(std::size_t input_length) const
+        {
+            return (input_length * up + down - 1) / down;
+        }
+
+        // Computes the dot product of `count` floats, `count` being a multiple of 4.
+        // The vectorized and the scalar code add the numbers in the same order, so the result is the same.
+        [[nodiscard]] static float DotProduct(const float *a, const float *b, std::size_t count)
+        {
+            float lanes[4];
+
+            #if AUDIO_CONVERSION_SSE2
+            __m128 sum = _mm_setzero_ps();
+            for (std::size_t i = 0; i < count; i += 4)
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+            _mm_storeu_ps(lanes, sum);
+            #else
+            std::fill_n(lanes, 4, 0.f);
+            for (std::size_t i = 0; i < count; i += 4)
+            {
+                for (std::size_t j = 0; j < 4; j++)
+                    lanes[j] += a[i + j] * b[i + j];
+            }
+            #endif
+
+            return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+        }
+
+        [[nodiscard]] ChannelSamples Apply(const ChannelSamples &input) const
+        {
+            // Pad the input with silence, so we don't need to check the bounds.
+            ChannelSamples padded(input.size() + half_taps * 2);
+            std::copy(input.begin(), input.end(), padded.begin() + std::ptrdiff_t(half_taps - 1));
+
+            std::size_t row_size = half_taps * 2;
+            ChannelSamples ret(OutputLength(input.size()));
+            for (std::size_t i = 0; i < ret.size(); i++)
+            {
+                // The position of the output sample in the input is `index + phase / up`.
+                std::uint64_t position = std::uint64_t(i) * down;
+                std::size_t index = std::size_t(position / up);
+                std::size_t phase = std::size_t(position % up);
+
+                std::size_t row = phase;
+                if (num_phases != up)
+                {
+                    row = std::size_t((std::uint64_t(phase) * num_phases + up / 2) / up);
+                    if (row == num_phases)
+                    {
+                        row = 0;
+                        index++;
+                    }
+                }
+
+                ret[i] = DotProduct(padded.data() + index, taps.data() + row * row_size, row_size);
+            }
+            return ret;
+        }
+    };
+
+    [[nodiscard]] static std::int16_t QuantizeTo16(float sample)
+    {
+        return std::int16_t(std::lrint(std::min(std::max(sample, -32768.f), 32767.f)));
+    }
+
+    [[nodiscard]] static std::uint8_t QuantizeTo8(float sample)
+    {
+        return std::uint8_t(std::lrint(std::min(std::max(sample / 256 + 128, 0.f), 255.f)));
+    }
+
+    [[nodiscard]] static Sound MergeChannels(int sampling_rate, BitResolution resolution, const std::vector<ChannelSamples> &channels)
+    {
+        std::size_t block_count = channels[0].size();
+        std::size_t channel_count = channels.size();
+
+        Sound ret(sampling_rate, Channels(channel_count), resolution, block_count);
+
+        if (resolution == bits_16)
+        {
+            std::int16_t *target = ret.Data<std::int16_t>();
+
+            if (channel_count == 1)
+            {
+                std::size_t i = 0;
+
+                #if AUDIO_CONVERSION_SSE2
+                const __m128 min = _mm_set1_ps(-32768), max = _mm_set1_ps(32767);
+                for (; i + 8 <= block_count; i += 8)
+                {
+                    // Clamp before converting, since the conversion turns the large values into INT_MIN.
+                    __m128i lo = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(channels[0].data() + i), min), max));
+                    __m128i hi = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(channels[0].data() + i + 4), min), max));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(target + i), _mm_packs_epi32(lo, hi));
+                }
+                #endif
+
+                for (; i < block_count; i++)
+                    target[i] = QuantizeTo16(channels[0][i]);
+            }
+            else
+            {
+                for (std::size_t i = 0; i < block_count; i++)
+                {
+                    for (std::size_t c = 0; c < channel_count; c++)
+                        target[i * channel_count + c] = QuantizeTo16(channels[c][i]);
+                }
+            }
+        }
+        else
+        {
+            std::uint8_t *target = ret.Data<std::uint8_t>();
+            for (std::size_t i = 0; i < block_count; i++)
+            {
+                for (std::size_t c = 0; c < channel_count; c++)
+                    target[i * channel_count + c] = QuantizeTo8(channels[c][i]);
+            }
+        }
+
+        return ret;
+    }
+
+    Sound ConvertSound(Sound sound, const SoundFormat &format)
+    {
+        if (format.sampling_rate && *format.sampling_rate <= 0)
+            throw std::runtime_error(FMT("Invalid sampling rate to convert a sound to: {}.", *format.sampling_rate));
+
+        if (format.Matches(sound))
+            return sound;
+
+        int sampling_rate = format.sampling_rate.value_or(sound.SamplingRate());
+
+        std::vector<ChannelSamples> channels = SplitChannels(sound);
+        MixChannels(channels, format.channel_count.value_or(sound.ChannelCount()));
+
+        if (sampling_rate != sound.SamplingRate())
+        {
+            if (sound.SamplingRate() <= 0)
+                throw std::runtime_error("Attempt to resample a sound with an invalid sampling rate.");
+
+            ResamplingFilter filter(sound.SamplingRate(), sampling_rate);
+            for (ChannelSamples &channel : channels)
+                channel = filter.Apply(channel);
+        }
+
+        return MergeChannels(sampling_rate, format.resolution.value_or(sound.Resolution()), channels);
+    }
+}
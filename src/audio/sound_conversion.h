@@ -0,0 +1,31 @@
+#pragma once
+
+#include <optional>
+
+#include "audio/sound.h"
+
+namespace Audio
+{
+    // The desired format of a sound. The missing parameters are left unchanged.
+    struct SoundFormat
+    {
+        std::optional<int> sampling_rate;
+        std::optional<Channels> channel_count;
+        std::optional<BitResolution> resolution;
+
+        [[nodiscard]] bool Matches(const Sound &sound) const
+        {
+            return (!sampling_rate || *sampling_rate == sound.SamplingRate())
+                && (!channel_count || *channel_count == sound.ChannelCount())
+                && (!resolution || *resolution == sound.Resolution());
+        }
+    };
+
+    // Converts a sound to a different format. Returns the sound unchanged if it already matches.
+    // Stereo is mixed down to mono by averaging the channels, and mono is mixed up to stereo by duplicating them.
+    // Resampling uses a Kaiser-windowed sinc filter, with a lower cutoff when downsampling to avoid aliasing.
+    // The samples outside of the sound are treated as silence. The resampled sound has `BlockCount() * new_rate / old_rate` blocks, rounded up.
+    // This is meant to be done at load time, so that OpenAL doesn't have to resample the sounds on the fly (see `GlobalData::Load()`).
+    // Throws if the target sampling rate is not positive.
+    [[nodiscard]] Sound ConvertSound(Sound sound, const SoundFormat &format);
+}
@@ -39,23 +39,28 @@ namespace Audio
         // Create a null source.
         Source() {}
 
-        Source(const Audio::Buffer &buffer)
+        // Create a source without a buffer. Buffers can be queued on it manually, see `StreamingSource`.
+        Source(decltype(nullptr))
         {
-            ASSERT(buffer, "Attempt to use a null audio buffer.");
-
             // We don't throw if the handle is null. Instead, we make sure that any operation on a null handle has no effect.
             alGenSources(1, &data.handle);
 
             if (data.handle)
             {
-                alSourcei(data.handle, AL_BUFFER, buffer.Handle());
-
                 alSourcef(data.handle, AL_REFERENCE_DISTANCE, default_ref_dist);
                 alSourcef(data.handle, AL_ROLLOFF_FACTOR,     default_rolloff_fac);
                 alSourcef(data.handle, AL_MAX_DISTANCE,       default_max_dist);
             }
         }
 
+        Source(const Audio::Buffer &buffer) : Source(nullptr)
+        {
+            ASSERT(buffer, "Attempt to use a null audio buffer.");
+
+            if (data.handle)
+                alSourcei(data.handle, AL_BUFFER, buffer.Handle());
+        }
+
         Source(Source &&other) noexcept : data(std::exchange(other.data, {})) {}
         Source &operator=(Source other) noexcept
         {
@@ -181,6 +186,28 @@ namespace Audio
                 alSourcei(data.handle, AL_LOOPING, l);
             return *this;
         }
+        // Attaches a buffer. The source must not be playing.
+        Source &buffer(const Buffer &buffer)
+        {
+            ASSERT(buffer, "Attempt to use a null audio buffer.");
+            if (data.handle)
+                alSourcei(data.handle, AL_BUFFER, buffer.Handle());
+            return *this;
+        }
+
+        // Rewinds the source, detaches the buffer, and restores the default values of all parameters listed in this class.
+        // This makes the source equivalent to a freshly constructed one, which is useful for reusing sources, see `SourceManager`.
+        Source &reset_to_defaults()
+        {
+            if (data.handle)
+            {
+                rewind();
+                alSourcei(data.handle, AL_BUFFER, 0);
+                rolloff_factor(default_rolloff_fac).ref_distance(default_ref_dist).max_distance(default_max_dist);
+                volume(1).raw_pitch(1).loop(false).pos(fvec3()).vel(fvec3()).relative(false);
+            }
+            return *this;
+        }
 
 
         // State control.
@@ -1,69 +1,398 @@
 #pragma once
 
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <queue>
+#include <unordered_map>
 #include <vector>
 
 #include "audio/buffer.h"
+#include "audio/openal.h"
 #include "audio/source.h"
 #include "program/errors.h"
 
 namespace Audio
 {
-    // Keeps a list of `std::shared_ptr`s to sources.
-    // Automatically releases them when they stop playing.
+    // Plays sounds on a fixed-capacity pool of sources, and releases them when they stop playing.
+    // The released sources are recycled, unless you keep your own `std::shared_ptr`s to them.
+    //
+    // `Tick()` doesn't poll every source. Instead, each source is checked when it's expected to finish, based on the buffer length and the pitch.
+    // The sources that are still playing (e.g. looping or slowed down) are rescheduled when checked, and all others, including the paused ones, are released.
+    // This way the work per tick depends only on the number of finished sounds.
+    //
+    // When the pool is full, a new sound stops the playing sound with the lowest priority, and the oldest one among them.
+    // If all playing sounds have higher priority than the new one, the new one is rejected.
+    // You can also limit the number of simultaneous instances of a buffer, see `SetBufferLimit()`. Reaching that limit stops one of the instances in the same manner.
+    // Before stealing or rejecting, the sources that aren't playing anymore are released, even if they aren't due to be checked yet.
+    // Rejected sounds get a new null source, on which all operations are no-ops.
     class SourceManager
     {
-        std::vector<std::shared_ptr<Source>> sources;
+      public:
+        using clock = std::chrono::steady_clock;
+
+        struct Stats
+        {
+            std::uint64_t created_sources = 0; // How many OpenAL sources were created.
+            std::uint64_t recycled_sources = 0; // How many times a released source was reused.
+            std::uint64_t stolen_sources = 0; // How many playing sources were stopped to make room for new ones.
+            std::uint64_t rejected_sources = 0; // How many sounds weren't played, because the playing ones had higher priority.
+        };
+
+      private:
+        struct Slot
+        {
+            std::shared_ptr<Source> source; // Null if the slot is free.
+            ALuint buffer = 0; // For the per-buffer limits.
+            float priority = 0;
+            std::uint64_t start_index = 0; // The number of sources added before this one. Used to find the oldest source.
+            std::uint32_t generation = 0; // Incremented when the slot is released, to invalidate the scheduled checks.
+        };
+
+        struct Check
+        {
+            clock::time_point time;
+            std::uint32_t slot = 0;
+            std::uint32_t generation = 0;
+
+            // Reversed, because `std::priority_queue` puts the largest element on top.
+            [[nodiscard]] bool operator<(const Check &other) const
+            {
+                return time > other.time;
+            }
+        };
+
+        struct BufferInfo
+        {
+            std::size_t limit = 0; // Zero means no limit.
+            std::size_t instances = 0;
+        };
+
+        std::size_t max_sources = 0;
+        std::vector<Slot> slots;
+        std::vector<std::uint32_t> free_slots;
+        std::vector<std::shared_ptr<Source>> free_sources; // The released sources, reset to the default state.
+        std::priority_queue<Check> checks; // When to check the slots. Released slots leave stale checks here, which are skipped.
+        std::unordered_map<ALuint, BufferInfo> buffers; // Only the buffers that have limits or playing instances.
+        std::uint64_t next_start_index = 0;
+        Stats stats;
+
+        // Estimates how long the source will keep playing, assuming it doesn't stop early.
+        [[nodiscard]] static clock::duration RemainingTime(const Source &source)
+        {
+            // If we can't tell, check again after this amount of time.
+            constexpr auto fallback = std::chrono::milliseconds(100);
+            // Check a bit later than expected, in case the source finishes slightly late.
+            constexpr auto margin = std::chrono::milliseconds(5);
+
+            ALint buffer = 0, offset = 0;
+            ALfloat pitch = 1;
+            alGetSourcei(source.Handle(), AL_BUFFER, &buffer);
+            alGetSourcei(source.Handle(), AL_SAMPLE_OFFSET, &offset);
+            alGetSourcef(source.Handle(), AL_PITCH, &pitch);
+            if (!buffer || !(pitch > 0))
+                return fallback;
+
+            ALint size = 0, channels = 0, bits = 0, frequency = 0;
+            alGetBufferi(ALuint(buffer), AL_SIZE, &size);
+            alGetBufferi(ALuint(buffer), AL_CHANNELS, &channels);
+            alGetBufferi(ALuint(buffer), AL_BITS, &bits);
+            alGetBufferi(ALuint(buffer), AL_FREQUENCY, &frequency);
+            if (channels <= 0 || bits <= 0 || frequency <= 0)
+                return fallback;
+
+            // When looping, this is the time until the end of the current iteration.
+            double remaining_blocks = std::max(0.0, double(size) / (channels * (bits / 8)) - offset);
+            return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(remaining_blocks / frequency / pitch)) + margin;
+        }
+
+        void Schedule(std::uint32_t index, clock::time_point time)
+        {
+            checks.push({.time = time, .slot = index, .generation = slots[index].generation});
+        }
+
+        // Frees the slot. Recycles the source, unless someone else holds a reference to it.
+        void Release(std::uint32_t index)
+        {
+            Slot &slot = slots[index];
+
+            if (slot.buffer)
+            {
+                auto it = buffers.find(slot.buffer);
+                if (it != buffers.end() && --it->second.instances == 0 && it->second.limit == 0)
+                    buffers.erase(it);
+            }
+
+            if (slot.source.use_count() == 1)
+            {
+                slot.source->reset_to_defaults();
+                free_sources.push_back(std::move(slot.source));
+            }
+
+            slot.source = nullptr;
+            slot.generation++;
+            free_slots.push_back(index);
+        }
+
+        // Releases all sources matching `pred` that aren't playing, without waiting for their scheduled checks.
+        // The sources that were stopped or rewound early would otherwise occupy their slots until their expected end time.
+        // Returns the number of released sources.
+        std::size_t ReleaseNotPlaying(auto &&pred)
+        {
+            std::size_t ret = 0;
+            for (std::uint32_t i = 0; i < slots.size(); i++)
+            {
+                if (slots[i].source && pred(slots[i]) && !slots[i].source->IsPlaying())
+                {
+                    Release(i);
+                    ret++;
+                }
+            }
+            return ret;
+        }
+
+        // Makes room for a new source with `priority`, among the sources matching `pred`.
+        // First releases the matching sources that aren't playing. If there are none, stops and releases the matching source with the lowest priority,
+        // and the oldest one among them. Returns false if all matching sources are playing and have higher priority.
+        [[nodiscard]] bool Steal(auto &&pred, float priority)
+        {
+            if (ReleaseNotPlaying(pred) > 0)
+                return true;
+
+            Slot *best = nullptr;
+            for (Slot &slot : slots)
+            {
+                if (!slot.source || !pred(slot))
+                    continue;
+                if (!best || slot.priority < best->priority || (slot.priority == best->priority && slot.start_index < best->start_index))
+                    best = &slot;
+            }
+
+            if (!best || best->priority > priority)
+                return false;
+
+            best->source->stop();
+            stats.stolen_sources++;
+            Release(std::uint32_t(best - slots.data()));
+            return true;
+        }
+
+        // Returns a free slot for a new source, stealing one if necessary. Returns null if the new source must be rejected.
+        [[nodiscard]] Slot *Acquire(ALuint buffer, float priority)
+        {
+            if (buffer)
+            {
+                auto it = buffers.find(buffer);
+                if (it != buffers.end() && it->second.limit > 0 && it->second.instances >= it->second.limit)
+                {
+                    if (!Steal([&](const Slot &slot){return slot.buffer == buffer;}, priority))
+                    {
+                        stats.rejected_sources++;
+                        return nullptr;
+                    }
+                }
+            }
+
+            if (free_slots.empty() && slots.size() >= max_sources)
+            {
+                if (!Steal([](const Slot &){return true;}, priority))
+                {
+                    stats.rejected_sources++;
+                    return nullptr;
+                }
+            }
+
+            Slot *slot = nullptr;
+            if (!free_slots.empty())
+            {
+                slot = &slots[free_slots.back()];
+                free_slots.pop_back();
+            }
+            else
+            {
+                slot = &slots.emplace_back();
+            }
+
+            slot->buffer = buffer;
+            slot->priority = priority;
+            slot->start_index = next_start_index++;
+            if (buffer)
+                buffers[buffer].instances++;
+            return slot;
+        }
+
+        // Returns a source with `buffer` attached, in a new slot. Returns a null source if rejected.
+        [[nodiscard]] std::shared_ptr<Source> AddWithoutSchedule(const Buffer &buffer, float priority, std::uint32_t &index)
+        {
+            ASSERT(buffer, "Attempt to use a null audio buffer.");
+
+            Slot *slot = Acquire(buffer.Handle(), priority);
+            if (!slot)
+                return std::make_shared<Source>(); // A new one every time, so that the settings applied to it by the caller don't leak to others.
+            index = std::uint32_t(slot - slots.data());
+
+            if (!free_sources.empty())
+            {
+                slot->source = std::move(free_sources.back());
+                free_sources.pop_back();
+                stats.recycled_sources++;
+            }
+            else
+            {
+                slot->source = std::make_shared<Source>(nullptr);
+                stats.created_sources++;
+            }
+
+            slot->source->buffer(buffer);
+            return slot->source;
+        }
+
+        // Plays the source, and schedules a check for when it's expected to finish.
+        void PlayAndSchedule(std::uint32_t index)
+        {
+            Source &source = *slots[index].source;
+            source.play();
+            Schedule(index, clock::now() + RemainingTime(source));
+        }
 
       public:
-        SourceManager() {}
+        // `max_sources` is the maximum number of sources that can play simultaneously.
+        // The sources are created lazily, so this can be constructed before the audio context.
+        SourceManager(std::size_t max_sources = 64) : max_sources(max_sources)
+        {
+            ASSERT(max_sources > 0 && max_sources <= std::uint32_t(-1), "Invalid source count.");
+            slots.reserve(max_sources);
+        }
 
-        // Add a new source to the manager.
+        // Limits the number of simultaneous instances of a buffer. Zero means no limit, which is the default.
+        // The limit is associated with the buffer handle, so reset it if you destroy the buffer.
+        void SetBufferLimit(const Buffer &buffer, std::size_t max_instances)
+        {
+            ASSERT(buffer, "Attempt to use a null audio buffer.");
+            if (max_instances == 0)
+            {
+                auto it = buffers.find(buffer.Handle());
+                if (it != buffers.end())
+                {
+                    it->second.limit = 0;
+                    if (it->second.instances == 0)
+                        buffers.erase(it);
+                }
+            }
+            else
+            {
+                buffers[buffer.Handle()].limit = max_instances;
+            }
+        }
+
+        // Add an existing source to the manager. Returns false if it was rejected, in which case you shouldn't play it.
         // It should be `play()`ed immediately, otherwise it will be removed at the next `Tick()`.
-        void Add(std::shared_ptr<Source> source)
+        // If you drop all other references to the source, it will be reused for other sounds after it stops.
+        bool Add(std::shared_ptr<Source> source, float priority = 0)
         {
             ASSERT(source, "Passing a null source.");
-            ASSERT(std::find(sources.begin(), sources.end(), source) == sources.end(), "Adding a duplicate source to `Audio::SourceManager`.");
-            sources.push_back(std::move(source));
+            ASSERT(std::none_of(slots.begin(), slots.end(), [&](const Slot &slot){return slot.source == source;}), "Adding a duplicate source to `Audio::SourceManager`.");
+
+            ALint buffer = 0;
+            alGetSourcei(source->Handle(), AL_BUFFER, &buffer);
+
+            Slot *slot = Acquire(ALuint(buffer), priority);
+            if (!slot)
+                return false;
+            slot->source = std::move(source);
+            Schedule(std::uint32_t(slot - slots.data()), clock::now());
+            return true;
         }
-        // Add a new source to the manager.
+        // Add a new source to the manager. Returns a null source if it was rejected.
         // It should be `play()`ed immediately, otherwise it will be removed at the next `Tick()`.
-        [[nodiscard]] std::shared_ptr<Source> Add(const Buffer &buffer)
+        [[nodiscard]] std::shared_ptr<Source> Add(const Buffer &buffer, float priority = 0)
         {
-            return sources.emplace_back(std::make_shared<Source>(buffer));
+            std::uint32_t index = 0;
+            std::shared_ptr<Source> ret = AddWithoutSchedule(buffer, priority, index);
+            if (*ret)
+                Schedule(index, clock::now());
+            return ret;
         }
 
-        // Add a new source and play it immediately.
-        std::shared_ptr<Source> Play(const Buffer &buffer, fvec3 pos, float volume = 1, float pitch = 0)
+        // Add a new source and play it immediately. Returns a null source if it was rejected.
+        std::shared_ptr<Source> Play(const Buffer &buffer, fvec3 pos, float volume = 1, float pitch = 0, float priority = 0)
         {
-            std::shared_ptr<Source> ret = Add(buffer);
-            ret->pos(pos).volume(volume).pitch(pitch).play();
+            std::uint32_t index = 0;
+            std::shared_ptr<Source> ret = AddWithoutSchedule(buffer, priority, index);
+            if (*ret)
+            {
+                ret->pos(pos).volume(volume).pitch(pitch);
+                PlayAndSchedule(index);
+            }
             return ret;
         }
-        std::shared_ptr<Source> Play(const Buffer &buffer, fvec2 pos, float volume = 1, float pitch = 0)
+        std::shared_ptr<Source> Play(const Buffer &buffer, fvec2 pos, float volume = 1, float pitch = 0, float priority = 0)
         {
-            std::shared_ptr<Source> ret = Add(buffer);
-            ret->pos(pos).volume(volume).pitch(pitch).play();
-            return ret;
+            return Play(buffer, pos.to_vec3(), volume, pitch, priority);
         }
-        std::shared_ptr<Source> Play(const Buffer &buffer, float volume = 1, float pitch = 0)
+        std::shared_ptr<Source> Play(const Buffer &buffer, float volume = 1, float pitch = 0, float priority = 0)
         {
-            std::shared_ptr<Source> ret = Add(buffer);
-            ret->relative().volume(volume).pitch(pitch).play();
+            std::uint32_t index = 0;
+            std::shared_ptr<Source> ret = AddWithoutSchedule(buffer, priority, index);
+            if (*ret)
+            {
+                ret->relative().volume(volume).pitch(pitch);
+                PlayAndSchedule(index);
+            }
             return ret;
         }
 
-        // Releases sources that aren't playing (i.e. are stopped, paused, or not played yet).
+        // Releases the sources that aren't playing (i.e. are stopped, paused, or not played yet), among those that are due to be checked.
         // Call this at the end of every tick.
         void Tick()
         {
-            std::erase_if(sources, [](const std::shared_ptr<Source> &ptr){return !ptr->IsPlaying();});
+            clock::time_point now = clock::now();
+            while (!checks.empty() && checks.top().time <= now)
+            {
+                Check check = checks.top();
+                checks.pop();
+
+                Slot &slot = slots[check.slot];
+                if (slot.generation != check.generation)
+                    continue; // A stale check.
+
+                if (slot.source->IsPlaying())
+                    Schedule(check.slot, now + RemainingTime(*slot.source));
+                else
+                    Release(check.slot);
+            }
         }
 
+        // Stops and releases all sources.
+        void StopAll()
+        {
+            for (std::uint32_t i = 0; i < slots.size(); i++)
+            {
+                if (slots[i].source)
+                {
+                    slots[i].source->stop();
+                    Release(i);
+                }
+            }
+            checks = {};
+        }
+
+        // Includes the sources that stopped early but weren't released yet, see `Tick()`.
         [[nodiscard]] std::size_t ActiveSources() const
         {
-            return sources.size();
+            return slots.size() - free_slots.size();
+        }
+
+        [[nodiscard]] std::size_t MaxSources() const
+        {
+            return max_sources;
+        }
+
+        [[nodiscard]] const Stats &GetStats() const
+        {
+            return stats;
         }
     };
 }
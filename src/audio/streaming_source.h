@@ -0,0 +1,394 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "audio/buffer.h"
+#include "audio/ogg_decoder.h"
+#include "audio/openal.h"
+#include "audio/source.h"
+#include "stream/input.h"
+
+// Plays a long vorbis sound (such as music) without decoding it all at once.
+// A background thread decodes the sound in chunks, and `Update()` moves them to a small ring of OpenAL buffers queued on the source.
+// The memory usage is bounded by `2 * num_buffers` chunks.
+// If the decoder falls behind, the source plays all queued buffers and stops. This is called an underrun.
+// `Update()` restarts the source when more data becomes available, and counts the underruns.
+// Usage:
+//     Audio::StreamingSource music("music.ogg", true);
+//     music.GetSource().volume(0.5f);
+//     music.Play();
+//     // Every tick:
+//     music.Update();
+// This works without audio hardware on a loopback context (see `Audio::Context::Loopback()`), in which case `Context::RenderSamples()` advances the playback.
+// Sounds other than vorbis files (e.g. generated ones) can be streamed by passing a `BlockReader` to the constructor.
+
+namespace Audio
+{
+    class StreamingSource
+    {
+      public:
+        struct Stats
+        {
+            std::uint64_t underruns = 0; // How many times the source ran out of queued buffers before the end of the sound.
+            std::uint64_t starved_updates = 0; // How many times `Update()` had free buffers, but no decoded chunks to fill them.
+            std::uint64_t queued_chunks = 0; // How many chunks were queued on the source so far.
+        };
+
+        // Produces the 16-bit samples to play.
+        struct BlockReader
+        {
+            int sampling_rate = 0;
+            Channels channel_count = mono;
+            // Writes at most `block_count` blocks to `target`, and returns the number of written blocks.
+            // Must return less than `block_count` only at the end of the sound. Can throw on failure.
+            std::function<std::size_t(std::uint8_t *target, std::size_t block_count)> read;
+            // Returns to the beginning of the sound. Only used when looping. Can throw on failure.
+            std::function<void()> rewind;
+        };
+
+      private:
+        struct Chunk
+        {
+            std::vector<std::uint8_t> bytes;
+            std::size_t block_count = 0;
+            bool last = false; // The end of the sound, if not looping.
+        };
+
+        // The decoded chunks shared with the decoder thread.
+        struct State
+        {
+            BlockReader reader; // Only touched by the decoder thread, after it starts.
+            bool loop = false;
+            std::size_t chunk_blocks = 0;
+
+            std::vector<Chunk> chunks;
+
+            std::mutex mutex; // Protects everything below.
+            std::condition_variable cond; // Notified when any of the variables below change.
+            // Both indices only increase. Chunk number `i % chunks.size()` belongs to the consumer if `read_index <= i < write_index`, and to the decoder thread otherwise.
+            std::uint64_t write_index = 0; // Only modified by the decoder thread.
+            std::uint64_t read_index = 0; // Only modified by the consumer.
+            bool stop = false;
+            std::exception_ptr exception; // Set by the decoder thread on failure, after which it stops.
+
+            std::thread thread;
+
+            State() {}
+            State(const State &) = delete;
+            State &operator=(const State &) = delete;
+
+            ~State()
+            {
+                if (thread.joinable())
+                {
+                    {
+                        std::lock_guard lock(mutex);
+                        stop = true;
+                    }
+                    cond.notify_all();
+                    thread.join();
+                }
+            }
+
+            // Fills the chunk, rewinding the sound if looping.
+            void Decode(Chunk &chunk)
+            {
+                std::size_t bytes_per_block = GetBytesPerBlock(bits_16, reader.channel_count);
+                chunk.block_count = 0;
+                chunk.last = false;
+
+                bool just_rewound = false; // This stops us from looping forever on an empty sound.
+                while (chunk.block_count < chunk_blocks)
+                {
+                    std::size_t count = reader.read(chunk.bytes.data() + chunk.block_count * bytes_per_block, chunk_blocks - chunk.block_count);
+                    chunk.block_count += count;
+                    if (chunk.block_count == chunk_blocks)
+                        break;
+
+                    if (!loop || (count == 0 && just_rewound))
+                    {
+                        chunk.last = true;
+                        break;
+                    }
+
+                    reader.rewind();
+                    just_rewound = true;
+                }
+            }
+
+            void DecoderLoop()
+            {
+                std::uint64_t index = 0;
+
+                while (true)
+                {
+                    {
+                        std::unique_lock lock(mutex);
+                        cond.wait(lock, [&]{return stop || index - read_index < chunks.size();});
+                        if (stop)
+                            return;
+                    }
+
+                    Chunk &chunk = chunks[index % chunks.size()];
+                    try
+                    {
+                        Decode(chunk);
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard lock(mutex);
+                        exception = std::current_exception();
+                    }
+
+                    {
+                        std::lock_guard lock(mutex);
+                        if (!exception)
+                            write_index = ++index;
+                    }
+                    cond.notify_all();
+
+                    if (exception || chunk.last)
+                        return;
+                }
+            }
+
+            // Returns the next decoded chunk, or null if there's none yet. If the decoder failed, rethrows the exception.
+            // If `wait` is true, waits for the chunk instead of returning null.
+            const Chunk *AcquireChunk(bool wait)
+            {
+                std::unique_lock lock(mutex);
+                if (wait)
+                    cond.wait(lock, [&]{return exception || read_index < write_index;});
+                if (read_index < write_index)
+                    return &chunks[read_index % chunks.size()];
+                if (exception)
+                    std::rethrow_exception(exception);
+                return nullptr;
+            }
+
+            // Returns the chunk returned by `AcquireChunk()` to the decoder thread.
+            void ReleaseChunk()
+            {
+                {
+                    std::lock_guard lock(mutex);
+                    read_index++;
+                }
+                cond.notify_all();
+            }
+        };
+
+        struct Data
+        {
+            // The member order matters: the source must be destroyed before the buffers queued on it.
+            std::unique_ptr<State> state; // This is a pointer, since the decoder thread holds a reference to it.
+            std::vector<Buffer> buffers;
+            Source source;
+
+            std::vector<ALuint> free_buffers; // The buffers that are not queued on the source.
+            int sampling_rate = 0;
+            Channels channel_count = mono;
+
+            bool want_playing = false;
+            bool end_queued = false; // The last chunk was queued. After the queued buffers finish playing, we're done.
+            bool in_underrun = false; // This is set when an underrun is detected, to count it only once.
+            Stats stats;
+        };
+        Data data;
+
+        // Moves the decoded chunks to the free buffers. If `wait` is true, waits for at least one chunk if there are free buffers.
+        void FillBuffers(bool wait)
+        {
+            while (!data.free_buffers.empty() && !data.end_queued)
+            {
+                const Chunk *chunk = data.state->AcquireChunk(wait);
+                wait = false;
+                if (!chunk)
+                {
+                    data.stats.starved_updates++;
+                    break;
+                }
+
+                if (chunk->block_count > 0)
+                {
+                    ALuint handle = data.free_buffers.back();
+                    auto it = std::find_if(data.buffers.begin(), data.buffers.end(), [&](const Buffer &buffer){return buffer.Handle() == handle;});
+                    it->SetData(data.sampling_rate, data.channel_count, bits_16, chunk->block_count, chunk->bytes.data());
+                    alSourceQueueBuffers(data.source.Handle(), 1, &handle);
+                    data.free_buffers.pop_back();
+                    data.stats.queued_chunks++;
+                }
+                if (chunk->last)
+                    data.end_queued = true;
+
+                data.state->ReleaseChunk();
+            }
+        }
+
+      public:
+        StreamingSource() {}
+
+        // Reads the headers, and starts decoding the sound in the background. Throws on failure.
+        // Decoding errors that happen later are thrown by `Update()`.
+        // Each chunk is `chunk_blocks` blocks (samples per channel) long. `num_buffers` of them can be queued on the source,
+        // and `num_buffers` more can be decoded in advance.
+        StreamingSource(Stream::Input input, bool loop = false, std::size_t num_buffers = 4, std::size_t chunk_blocks = 16384)
+            : StreamingSource(MakeOggReader(std::move(input)), loop, num_buffers, chunk_blocks)
+        {}
+
+        // Same, but reads the samples from a custom reader, on the background thread.
+        StreamingSource(BlockReader reader, bool loop = false, std::size_t num_buffers = 4, std::size_t chunk_blocks = 16384)
+        {
+            if (num_buffers == 0 || chunk_blocks == 0)
+                throw std::runtime_error("Invalid streaming audio source buffer size.");
+            if (!reader.read || (loop && !reader.rewind))
+                throw std::runtime_error("Invalid streaming audio source reader.");
+
+            data.state = std::make_unique<State>();
+            data.state->reader = std::move(reader);
+            data.state->loop = loop;
+            data.state->chunk_blocks = chunk_blocks;
+            data.state->chunks.resize(num_buffers);
+            for (Chunk &chunk : data.state->chunks)
+                chunk.bytes.resize(chunk_blocks * GetBytesPerBlock(bits_16, data.state->reader.channel_count));
+
+            data.sampling_rate = data.state->reader.sampling_rate;
+            data.channel_count = data.state->reader.channel_count;
+
+            data.buffers.reserve(num_buffers);
+            for (std::size_t i = 0; i < num_buffers; i++)
+                data.free_buffers.push_back(data.buffers.emplace_back(nullptr).Handle());
+
+            data.source = Source(nullptr);
+
+            data.state->thread = std::thread([state = data.state.get()]{state->DecoderLoop();});
+        }
+
+        // Reads the headers of a vorbis sound, and returns a reader decoding it. Throws on failure.
+        [[nodiscard]] static BlockReader MakeOggReader(Stream::Input input)
+        {
+            // `std::function` needs a copyable functor, so the decoder is shared between the two functions.
+            auto decoder = std::make_shared<OggDecoder>(std::move(input), bits_16);
+
+            BlockReader ret;
+            ret.sampling_rate = decoder->SamplingRate();
+            ret.channel_count = decoder->ChannelCount();
+            ret.read = [decoder](std::uint8_t *target, std::size_t block_count){return decoder->Read(target, block_count);};
+            ret.rewind = [decoder]{decoder->Rewind();};
+            return ret;
+        }
+
+        StreamingSource(StreamingSource &&other) noexcept : data(std::exchange(other.data, {})) {}
+        StreamingSource &operator=(StreamingSource other) noexcept
+        {
+            std::swap(data, other.data);
+            return *this;
+        }
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return bool(data.state);
+        }
+
+        // Use this to set the volume, position, and so on.
+        // Don't `play()` the source directly, and don't set its buffer or enable looping on it.
+        [[nodiscard]] Source &GetSource()
+        {
+            return data.source;
+        }
+
+        [[nodiscard]] const Stats &GetStats() const
+        {
+            return data.stats;
+        }
+
+        [[nodiscard]] int SamplingRate() const {return data.sampling_rate;}
+        [[nodiscard]] Channels ChannelCount() const {return data.channel_count;}
+
+        // Starts or resumes the playback.
+        // When called for the first time, waits until the first chunk is decoded.
+        void Play()
+        {
+            if (!data.state)
+                return;
+
+            FillBuffers(data.stats.queued_chunks == 0);
+            data.want_playing = true;
+            data.source.play();
+        }
+
+        // Pauses the playback. `Play()` resumes it.
+        void Pause()
+        {
+            data.want_playing = false;
+            data.source.pause();
+        }
+
+        // Returns true if the whole sound was played. Never returns true when looping.
+        [[nodiscard]] bool IsFinished() const
+        {
+            if (!data.state || !data.end_queued)
+                return false;
+
+            // A stopped source reports all its buffers as processed.
+            ALint queued = 0, processed = 0;
+            alGetSourcei(data.source.Handle(), AL_BUFFERS_QUEUED, &queued);
+            alGetSourcei(data.source.Handle(), AL_BUFFERS_PROCESSED, &processed);
+            return queued == processed;
+        }
+
+        // Recycles the buffers that finished playing, queues new chunks, and restarts the source after underruns.
+        // Call this every tick. Throws if decoding failed.
+        void Update()
+        {
+            if (!data.state)
+                return;
+
+            ALint processed = 0;
+            alGetSourcei(data.source.Handle(), AL_BUFFERS_PROCESSED, &processed);
+            while (processed-- > 0)
+            {
+                ALuint handle = 0;
+                alSourceUnqueueBuffers(data.source.Handle(), 1, &handle);
+                data.free_buffers.push_back(handle);
+            }
+
+            FillBuffers(false);
+
+            if (data.want_playing && data.source.GetState() == SourceState::stopped)
+            {
+                ALint queued = 0;
+                alGetSourcei(data.source.Handle(), AL_BUFFERS_QUEUED, &queued);
+
+                if (queued == 0 && data.end_queued)
+                {
+                    // Finished playing.
+                    data.want_playing = false;
+                    return;
+                }
+
+                if (!data.in_underrun)
+                {
+                    data.stats.underruns++;
+                    data.in_underrun = true;
+                }
+
+                if (queued > 0)
+                {
+                    data.in_underrun = false;
+                    data.source.play();
+                }
+            }
+        }
+    };
+}
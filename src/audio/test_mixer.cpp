@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <vector>
+
+#include <audio/mixer.h>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    // A mono 16-bit sound, where each sample is equal to `value`.
+    [[nodiscard]] Audio::Sound ConstantSound(int sampling_rate, std::size_t block_count, std::int16_t value)
+    {
+        std::vector<std::int16_t> samples(block_count, value);
+        return Audio::Sound(sampling_rate, Audio::mono, block_count, samples.data());
+    }
+
+    // A mono 16-bit sound, where the sample `i` is equal to `i * step`.
+    [[nodiscard]] Audio::Sound RampSound(int sampling_rate, std::size_t block_count, std::int16_t step)
+    {
+        std::vector<std::int16_t> samples(block_count);
+        for (std::size_t i = 0; i < block_count; i++)
+            samples[i] = std::int16_t(i * step);
+        return Audio::Sound(sampling_rate, Audio::mono, block_count, samples.data());
+    }
+
+    [[nodiscard]] std::vector<std::int16_t> Render(Audio::Mixer &mixer, std::size_t block_count)
+    {
+        std::vector<std::int16_t> ret(block_count * 2);
+        mixer.Render(ret.data(), block_count);
+        return ret;
+    }
+}
+
+TEST_CASE("audio_mixer.silence")
+{
+    Audio::Mixer mixer(44100);
+    for (std::int16_t sample : Render(mixer, 100))
+        REQUIRE(sample == 0);
+
+    Audio::Mixer null_mixer;
+    for (std::int16_t sample : Render(null_mixer, 10))
+        REQUIRE(sample == 0);
+}
+
+TEST_CASE("audio_mixer.centered_voice")
+{
+    Audio::Mixer mixer(44100);
+    Audio::Sound sound = ConstantSound(44100, 100, 10000);
+    Audio::Mixer::Voice voice = mixer.Play(sound);
+    REQUIRE(voice.IsPlaying());
+
+    // A centered mono voice is split equally between the channels, keeping the same power.
+    std::int16_t expected = std::int16_t(std::lround(10000 * std::numbers::sqrt2 / 2));
+    std::vector<std::int16_t> output = Render(mixer, 100);
+    for (std::int16_t sample : output)
+        REQUIRE(std::abs(sample - expected) <= 1);
+
+    // The voice finishes exactly at the end of the sound.
+    REQUIRE_FALSE(voice.IsPlaying());
+    REQUIRE(mixer.ActiveVoices() == 0);
+    for (std::int16_t sample : Render(mixer, 10))
+        REQUIRE(sample == 0);
+}
+
+TEST_CASE("audio_mixer.stereo_voice")
+{
+    Audio::Mixer mixer(44100);
+    std::vector<std::int16_t> samples;
+    for (int i = 0; i < 13; i++)
+    {
+        samples.push_back(std::int16_t(i * 100));
+        samples.push_back(std::int16_t(-i * 100));
+    }
+    Audio::Sound sound(44100, Audio::stereo, 13, samples.data());
+
+    // Stereo voices are not spatialized.
+    mixer.Play(sound, fvec3(1000, 0, 0));
+    REQUIRE(Render(mixer, 13) == samples);
+}
+
+TEST_CASE("audio_mixer.attenuation_and_panning")
+{
+    Audio::Mixer mixer(44100);
+    mixer.DefaultRefDistance(10);
+    Audio::Sound sound = ConstantSound(44100, 64, 10000);
+
+    // At twice the reference distance, the gain is halved. Everything is in the right channel.
+    mixer.ListenerPosition(fvec3(5, 0, 0));
+    mixer.Play(sound, fvec2(25, 0));
+    std::vector<std::int16_t> output = Render(mixer, 64);
+    for (std::size_t i = 0; i < 64; i++)
+    {
+        REQUIRE(output[i * 2] == 0);
+        REQUIRE(output[i * 2 + 1] == 5000);
+    }
+
+    // Inside the reference distance there's no attenuation. Everything is in the left channel.
+    mixer.Play(sound, fvec2(0, 0));
+    output = Render(mixer, 64);
+    for (std::size_t i = 0; i < 64; i++)
+    {
+        REQUIRE(output[i * 2] == 10000);
+        REQUIRE(output[i * 2 + 1] == 0);
+    }
+
+    // The orientation flips the panning, same as in OpenAL.
+    mixer.ListenerOrientation(fvec3(0, 0, 1), fvec3(0, 1, 0));
+    mixer.Play(sound, fvec2(0, 0));
+    output = Render(mixer, 64);
+    for (std::size_t i = 0; i < 64; i++)
+    {
+        REQUIRE(output[i * 2] == 0);
+        REQUIRE(output[i * 2 + 1] == 10000);
+    }
+}
+
+TEST_CASE("audio_mixer.chunking_doesnt_matter")
+{
+    // Renders the same mix at once, and in chunks of growing sizes, which exercises both the vectorized and the scalar code.
+    auto Mix = [](bool at_once)
+    {
+        Audio::Mixer mixer(44100);
+        Audio::Sound a = RampSound(44100, 1000, 7);
+        Audio::Sound b = RampSound(22050, 333, -11);
+        mixer.Play(a, fvec2(1, 0), 0.7f);
+        mixer.Play(b, fvec2(-3, 2), 1.3f).loop();
+        mixer.Play(a, 0.5f, 0.3f).loop();
+
+        const std::size_t total_size = 3000;
+        std::vector<std::int16_t> ret;
+        for (std::size_t size = at_once ? total_size : 1; ret.size() < total_size * 2; size++)
+        {
+            std::vector<std::int16_t> chunk = Render(mixer, std::min(size, total_size - ret.size() / 2));
+            ret.insert(ret.end(), chunk.begin(), chunk.end());
+        }
+        return ret;
+    };
+
+    REQUIRE(Mix(true) == Mix(false));
+}
+
+TEST_CASE("audio_mixer.pitch_and_looping")
+{
+    Audio::Mixer mixer(44100);
+    mixer.Volume(std::numbers::sqrt2);
+    Audio::Sound sound = RampSound(44100, 10, 100);
+
+    // Twice the speed skips every other sample, and wraps around when looping.
+    mixer.Play(sound).raw_pitch(2).loop();
+    std::vector<std::int16_t> output = Render(mixer, 12);
+    const std::int16_t expected[] = {0, 200, 400, 600, 800, 0, 200, 400, 600, 800, 0, 200};
+    for (std::size_t i = 0; i < 12; i++)
+        REQUIRE(std::abs(output[i * 2] - expected[i]) <= 1);
+
+    // Half the speed interpolates between the samples.
+    mixer.StopAll();
+    REQUIRE(mixer.ActiveVoices() == 0);
+    mixer.Play(sound, 1, -1);
+    output = Render(mixer, 19);
+    for (std::size_t i = 0; i < 19; i++)
+        REQUIRE(std::abs(output[i * 2] - int(i * 50)) <= 1);
+    REQUIRE(mixer.ActiveVoices() == 1);
+    output = Render(mixer, 1);
+    REQUIRE(mixer.ActiveVoices() == 0);
+}
+
+TEST_CASE("audio_mixer.saturation")
+{
+    Audio::Mixer mixer(44100);
+    mixer.DefaultRefDistance(100);
+    Audio::Sound loud = ConstantSound(44100, 20, 30000);
+    // A negative volume inverts the waveform.
+    mixer.Play(loud, fvec2(-10, 0));
+    mixer.Play(loud, fvec2(-10, 0));
+    mixer.Play(loud, fvec2(10, 0), -1);
+    mixer.Play(loud, fvec2(10, 0), -1);
+
+    std::vector<std::int16_t> output = Render(mixer, 20);
+    for (std::size_t i = 0; i < 20; i++)
+    {
+        REQUIRE(output[i * 2] == 32767);
+        REQUIRE(output[i * 2 + 1] == -32768);
+    }
+}
+
+TEST_CASE("audio_mixer.voice_stealing")
+{
+    Audio::Mixer mixer(44100, 3);
+    Audio::Sound sound = ConstantSound(44100, 1000, 1000);
+
+    Audio::Mixer::Voice quiet = mixer.Play(sound, 0.1f, 0, 0);
+    Audio::Mixer::Voice loud_old = mixer.Play(sound, 1, 0, 0);
+    Audio::Mixer::Voice important = mixer.Play(sound, 0.01f, 0, 1);
+    REQUIRE(mixer.ActiveVoices() == 3);
+
+    // The quietest voice with the lowest priority is stolen first.
+    Audio::Mixer::Voice loud_new = mixer.Play(sound, 1, 0, 0);
+    REQUIRE(loud_new.IsPlaying());
+    REQUIRE_FALSE(quiet.IsPlaying());
+    REQUIRE(mixer.GetStats().stolen_voices == 1);
+
+    // Then the oldest one, if the volume is the same.
+    Audio::Mixer::Voice another = mixer.Play(sound, 1, 0, 0);
+    REQUIRE(another.IsPlaying());
+    REQUIRE_FALSE(loud_old.IsPlaying());
+    REQUIRE(loud_new.IsPlaying());
+
+    // A voice with a lower priority than all playing voices is rejected.
+    mixer.Play(sound, 1, 0, 1);
+    Audio::Mixer::Voice rejected = mixer.Play(sound, 1, 0, -1);
+    REQUIRE_FALSE(rejected);
+    REQUIRE_FALSE(rejected.IsPlaying());
+    REQUIRE(mixer.GetStats().rejected_voices == 1);
+    REQUIRE(important.IsPlaying());
+
+    // Operations on stolen voices are no-ops, even if their slot is reused.
+    quiet.volume(100).stop();
+    REQUIRE(mixer.ActiveVoices() == 3);
+}
@@ -0,0 +1,148 @@
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numbers>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <audio/sound_conversion.h>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    constexpr double sine_frequency = 1000;
+    constexpr double sine_amplitude = 16000;
+    // The resampled tone should be close to the 16-bit noise floor, which is about 89 dB for this amplitude.
+    constexpr double min_sine_snr = 85;
+
+    [[nodiscard]] Audio::SoundFormat Format(std::optional<int> sampling_rate, std::optional<Audio::Channels> channel_count = {}, std::optional<Audio::BitResolution> resolution = {})
+    {
+        Audio::SoundFormat ret;
+        ret.sampling_rate = sampling_rate;
+        ret.channel_count = channel_count;
+        ret.resolution = resolution;
+        return ret;
+    }
+
+    [[nodiscard]] double SineSample(int sampling_rate, std::size_t index)
+    {
+        return sine_amplitude * std::sin(2 * std::numbers::pi * sine_frequency * double(index) / sampling_rate);
+    }
+
+    // A 16-bit sound with a 1 kHz tone, the same in all channels.
+    [[nodiscard]] Audio::Sound SineSound(int sampling_rate, Audio::Channels channel_count, std::size_t block_count)
+    {
+        std::vector<std::int16_t> samples(block_count * channel_count);
+        for (std::size_t i = 0; i < samples.size(); i++)
+            samples[i] = std::int16_t(std::lrint(SineSample(sampling_rate, i / channel_count)));
+        return Audio::Sound(sampling_rate, channel_count, block_count, samples.data());
+    }
+
+    // The signal to noise ratio of a resampled mono 1 kHz tone, in dB. Skips the samples near the ends, which are affected by the silence outside of the sound.
+    [[nodiscard]] double SineSnr(const Audio::Sound &sound)
+    {
+        const std::int16_t *samples = sound.Data<std::int16_t>();
+        std::size_t margin = std::size_t(sound.SamplingRate() / 100);
+
+        double signal = 0, noise = 0;
+        for (std::size_t i = margin; i + margin < sound.BlockCount(); i++)
+        {
+            double expected = SineSample(sound.SamplingRate(), i);
+            signal += expected * expected;
+            noise += (samples[i] - expected) * (samples[i] - expected);
+        }
+        return 10 * std::log10(signal / noise);
+    }
+}
+
+TEST_CASE("audio_sound_conversion.output_length")
+{
+    // `BlockCount() * new_rate / old_rate`, rounded up.
+    struct Case {int from = 0, to = 0; std::size_t blocks = 0, expected_blocks = 0;};
+    for (Case c : {
+        Case{44100, 48000, 44100, 48000},
+        Case{48000, 44100, 48000, 44100},
+        Case{44100, 48000, 1000, 1089}, // 1088.43
+        Case{48000, 44100, 1000, 919}, // 918.75
+        Case{22050, 44100, 7, 14},
+        Case{44100, 22050, 7, 4},
+        Case{44100, 48000, 1, 2},
+    })
+    {
+        Audio::Sound result = Audio::ConvertSound(SineSound(c.from, Audio::mono, c.blocks), Format(c.to));
+        REQUIRE(result.SamplingRate() == c.to);
+        REQUIRE(result.ChannelCount() == Audio::mono);
+        REQUIRE(result.Resolution() == Audio::bits_16);
+        REQUIRE(result.BlockCount() == c.expected_blocks);
+    }
+}
+
+TEST_CASE("audio_sound_conversion.sine_snr")
+{
+    for (auto [from, to] : {std::pair(44100, 48000), std::pair(48000, 44100), std::pair(22050, 48000), std::pair(48000, 22050), std::pair(22050, 44100)})
+    {
+        Audio::Sound result = Audio::ConvertSound(SineSound(from, Audio::mono, std::size_t(from / 4)), Format(to));
+        REQUIRE(SineSnr(result) > min_sine_snr);
+    }
+}
+
+TEST_CASE("audio_sound_conversion.channels")
+{
+    // Stereo to mono averages the channels.
+    std::vector<std::int16_t> stereo_samples = {100, 300, -1000, 2000, 32767, 32767, -32768, -32768, 5, 6};
+    Audio::Sound mono = Audio::ConvertSound(Audio::Sound(44100, Audio::stereo, 5, stereo_samples.data()), Format({}, Audio::mono));
+    REQUIRE(mono.ChannelCount() == Audio::mono);
+    REQUIRE(mono.BlockCount() == 5);
+    REQUIRE(mono.SamplingRate() == 44100);
+    REQUIRE(std::vector<std::int16_t>(mono.Data<std::int16_t>(), mono.Data<std::int16_t>() + 5) == std::vector<std::int16_t>{200, 500, 32767, -32768, 6});
+
+    // Mono to stereo duplicates the channel.
+    std::vector<std::int16_t> mono_samples = {1, -2, 32767, -32768};
+    Audio::Sound stereo = Audio::ConvertSound(Audio::Sound(44100, Audio::mono, 4, mono_samples.data()), Format({}, Audio::stereo));
+    REQUIRE(stereo.ChannelCount() == Audio::stereo);
+    REQUIRE(stereo.BlockCount() == 4);
+    REQUIRE(std::vector<std::int16_t>(stereo.Data<std::int16_t>(), stereo.Data<std::int16_t>() + 8) == std::vector<std::int16_t>{1, 1, -2, -2, 32767, 32767, -32768, -32768});
+
+    // Mixing and resampling at the same time.
+    Audio::Sound resampled = Audio::ConvertSound(SineSound(44100, Audio::stereo, 11025), Format(48000, Audio::mono));
+    REQUIRE(resampled.ChannelCount() == Audio::mono);
+    REQUIRE(resampled.BlockCount() == 12000);
+    REQUIRE(SineSnr(resampled) > min_sine_snr);
+
+    // 8-bit to 16-bit and back.
+    std::vector<std::uint8_t> bytes = {0, 1, 127, 128, 129, 255};
+    Audio::Sound wide = Audio::ConvertSound(Audio::Sound(44100, Audio::mono, 6, bytes.data()), Format({}, {}, Audio::bits_16));
+    REQUIRE(std::vector<std::int16_t>(wide.Data<std::int16_t>(), wide.Data<std::int16_t>() + 6) == std::vector<std::int16_t>{-32768, -32512, -256, 0, 256, 32512});
+    Audio::Sound narrow = Audio::ConvertSound(wide, Format({}, {}, Audio::bits_8));
+    REQUIRE(std::vector<std::uint8_t>(narrow.Data<std::uint8_t>(), narrow.Data<std::uint8_t>() + 6) == bytes);
+}
+
+TEST_CASE("audio_sound_conversion.identity")
+{
+    // A matching format, or the same sampling rate, leaves the samples unchanged.
+    Audio::Sound sound = SineSound(44100, Audio::stereo, 1000);
+    std::vector<std::uint8_t> original(sound.RawUntypedData(), sound.RawUntypedData() + sound.BlockCount() * 4);
+
+    for (const Audio::SoundFormat &format : {
+        Audio::SoundFormat{},
+        Format(44100),
+        Format(44100, Audio::stereo, Audio::bits_16),
+    })
+    {
+        Audio::Sound result = Audio::ConvertSound(sound, format);
+        REQUIRE(result.SamplingRate() == 44100);
+        REQUIRE(result.ChannelCount() == Audio::stereo);
+        REQUIRE(result.Resolution() == Audio::bits_16);
+        REQUIRE(std::vector<std::uint8_t>(result.RawUntypedData(), result.RawUntypedData() + result.BlockCount() * 4) == original);
+    }
+
+    // The same rate with a different channel count doesn't resample.
+    Audio::Sound mono = Audio::ConvertSound(sound, Format(44100, Audio::mono));
+    for (std::size_t i = 0; i < mono.BlockCount(); i++)
+        REQUIRE(mono.Data<std::int16_t>()[i] == sound.Data<std::int16_t>()[i * 2]);
+
+    REQUIRE_THROWS_AS((void)Audio::ConvertSound(sound, Format(0)), std::runtime_error);
+}
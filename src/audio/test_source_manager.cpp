@@ -0,0 +1,217 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <audio/buffer.h>
+#include <audio/context.h>
+#include <audio/source_manager.h>
+
+#include <doctest/doctest.h>
+
+#ifdef ALC_SOFT_loopback
+namespace
+{
+    constexpr int sampling_rate = 44100;
+
+    // A mono buffer with a constant non-zero signal.
+    [[nodiscard]] Audio::Buffer MakeBuffer(std::size_t block_count)
+    {
+        std::vector<std::int16_t> samples(block_count, 1000);
+        return Audio::Buffer(Audio::Sound(sampling_rate, Audio::mono, block_count, samples.data()));
+    }
+
+    // Advances the playback of the loopback context.
+    void Render(Audio::Context &context, std::size_t block_count)
+    {
+        std::vector<std::int16_t> output(block_count * 2);
+        context.RenderSamples(output.data(), int(block_count));
+    }
+
+    // Calls `Tick()` until the number of active sources drops to `count`. This waits for the scheduled checks.
+    // Fails if that doesn't happen in a reasonable time.
+    void TickUntilActive(Audio::SourceManager &manager, std::size_t count)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (true)
+        {
+            manager.Tick();
+            if (manager.ActiveSources() == count)
+                break;
+            REQUIRE(manager.ActiveSources() > count);
+            REQUIRE(std::chrono::steady_clock::now() < deadline);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+}
+
+TEST_CASE("audio_source_manager.global_limit")
+{
+    Audio::Context context = Audio::Context::Loopback(sampling_rate);
+    Audio::Buffer buffer = MakeBuffer(sampling_rate * 10);
+
+    Audio::SourceManager manager(3);
+    std::vector<std::shared_ptr<Audio::Source>> sources;
+    for (int i = 0; i < 3; i++)
+        sources.push_back(manager.Play(buffer, 1, 0, float(i)));
+    for (const auto &source : sources)
+        REQUIRE(source->IsPlaying());
+    REQUIRE(manager.ActiveSources() == 3);
+
+    // The pool is full, so the sound with the lowest priority is stopped.
+    std::shared_ptr<Audio::Source> stealer = manager.Play(buffer, 1, 0, 1);
+    REQUIRE(stealer->IsPlaying());
+    REQUIRE(sources[0]->GetState() == Audio::SourceState::stopped);
+    REQUIRE(sources[1]->IsPlaying());
+    REQUIRE(sources[2]->IsPlaying());
+    REQUIRE(manager.ActiveSources() == 3);
+    REQUIRE(manager.GetStats().stolen_sources == 1);
+
+    // Among the sounds with the same priority, the oldest one is stopped.
+    std::shared_ptr<Audio::Source> second_stealer = manager.Play(buffer, 1, 0, 1);
+    REQUIRE(second_stealer->IsPlaying());
+    REQUIRE(sources[1]->GetState() == Audio::SourceState::stopped);
+    REQUIRE(stealer->IsPlaying());
+    REQUIRE(manager.GetStats().stolen_sources == 2);
+
+    // If all playing sounds have higher priority, the new one gets a null source. Each rejected sound gets its own.
+    std::shared_ptr<Audio::Source> rejected = manager.Play(buffer, 1, 0, 0);
+    std::shared_ptr<Audio::Source> rejected2 = manager.Play(buffer, 1, 0, 0);
+    REQUIRE(rejected);
+    REQUIRE_FALSE(*rejected);
+    REQUIRE(rejected != rejected2);
+    REQUIRE(manager.GetStats().rejected_sources == 2);
+    REQUIRE(manager.ActiveSources() == 3);
+
+    // The operations on the null source do nothing.
+    rejected->volume(0.5f).pitch(2).loop().play();
+    REQUIRE_FALSE(rejected->IsPlaying());
+    REQUIRE(rejected->GetState() == Audio::SourceState::stopped);
+    REQUIRE(stealer->IsPlaying());
+
+    manager.StopAll();
+    REQUIRE(manager.ActiveSources() == 0);
+    REQUIRE_FALSE(stealer->IsPlaying());
+}
+
+TEST_CASE("audio_source_manager.buffer_limit")
+{
+    Audio::Context context = Audio::Context::Loopback(sampling_rate);
+    Audio::Buffer buffer_a = MakeBuffer(sampling_rate * 10);
+    Audio::Buffer buffer_b = MakeBuffer(sampling_rate * 10);
+
+    Audio::SourceManager manager(8);
+    manager.SetBufferLimit(buffer_a, 2);
+
+    std::shared_ptr<Audio::Source> a1 = manager.Play(buffer_a);
+    std::shared_ptr<Audio::Source> b1 = manager.Play(buffer_b);
+    std::shared_ptr<Audio::Source> a2 = manager.Play(buffer_a, 1, 0, 1);
+
+    // Only the instances of the same buffer are stopped, even though the pool isn't full.
+    std::shared_ptr<Audio::Source> a3 = manager.Play(buffer_a);
+    REQUIRE(a3->IsPlaying());
+    REQUIRE(a1->GetState() == Audio::SourceState::stopped);
+    REQUIRE(a2->IsPlaying());
+    REQUIRE(b1->IsPlaying());
+    REQUIRE(manager.ActiveSources() == 3);
+    REQUIRE(manager.GetStats().stolen_sources == 1);
+
+    // Both remaining instances have higher priority.
+    std::shared_ptr<Audio::Source> a4 = manager.Play(buffer_a, 1, 0, -1);
+    REQUIRE_FALSE(*a4);
+    REQUIRE(manager.GetStats().rejected_sources == 1);
+
+    // Other buffers are unaffected.
+    for (int i = 0; i < 4; i++)
+        REQUIRE(manager.Play(buffer_b)->IsPlaying());
+    REQUIRE(manager.ActiveSources() == 7);
+    REQUIRE(manager.GetStats().stolen_sources == 1);
+
+    // Without the limit, only the pool size matters.
+    manager.SetBufferLimit(buffer_a, 0);
+    REQUIRE(manager.Play(buffer_a, 1, 0, -1)->IsPlaying());
+    REQUIRE(a2->IsPlaying());
+    REQUIRE(a3->IsPlaying());
+    REQUIRE(manager.ActiveSources() == 8);
+    REQUIRE(manager.GetStats().stolen_sources == 1);
+}
+
+TEST_CASE("audio_source_manager.reclaim_stopped")
+{
+    Audio::Context context = Audio::Context::Loopback(sampling_rate);
+    Audio::Buffer long_buffer = MakeBuffer(sampling_rate * 10);
+    Audio::Buffer short_buffer = MakeBuffer(sampling_rate / 100);
+
+    Audio::SourceManager manager(3);
+    std::shared_ptr<Audio::Source> s1 = manager.Play(long_buffer, 1, 0, 1);
+    std::shared_ptr<Audio::Source> s2 = manager.Play(long_buffer, 1, 0, 1);
+    std::shared_ptr<Audio::Source> s3 = manager.Play(long_buffer, 1, 0, 1);
+
+    // The sources that were stopped or paused early are released when there's no room, even though their checks aren't due.
+    // This doesn't count as stealing, and doesn't affect the playing sources, even if they have lower priority than the new one.
+    s2->stop();
+    s3->pause();
+    std::shared_ptr<Audio::Source> s4 = manager.Play(long_buffer, 1, 0, 2);
+    REQUIRE(s4->IsPlaying());
+    REQUIRE(s1->IsPlaying());
+    REQUIRE(manager.ActiveSources() == 2);
+    std::shared_ptr<Audio::Source> s5 = manager.Play(long_buffer, 1, 0, 2);
+    REQUIRE(s5->IsPlaying());
+    REQUIRE(manager.ActiveSources() == 3);
+    REQUIRE(manager.GetStats().stolen_sources == 0);
+    REQUIRE(manager.GetStats().rejected_sources == 0);
+
+    // Same for the sounds that finished on their own.
+    manager.StopAll();
+    s1 = s2 = s3 = s4 = s5 = nullptr;
+    for (int i = 0; i < 3; i++)
+        REQUIRE(manager.Play(short_buffer)->IsPlaying());
+    Render(context, sampling_rate / 10);
+    REQUIRE(manager.ActiveSources() == 3);
+    std::uint64_t created_sources = manager.GetStats().created_sources;
+    std::uint64_t recycled_sources = manager.GetStats().recycled_sources;
+    REQUIRE(manager.Play(long_buffer)->IsPlaying());
+    REQUIRE(manager.ActiveSources() == 1);
+    REQUIRE(manager.GetStats().stolen_sources == 0);
+
+    // The finished source was recycled rather than recreated, because we didn't keep our own references to it.
+    REQUIRE(manager.GetStats().created_sources == created_sources);
+    REQUIRE(manager.GetStats().recycled_sources == recycled_sources + 1);
+}
+
+TEST_CASE("audio_source_manager.tick")
+{
+    Audio::Context context = Audio::Context::Loopback(sampling_rate);
+    Audio::Buffer short_buffer = MakeBuffer(sampling_rate / 100);
+
+    Audio::SourceManager manager;
+
+    // The finished sources are released when checked, and paused ones too.
+    std::shared_ptr<Audio::Source> paused = manager.Play(short_buffer);
+    for (int i = 0; i < 5; i++)
+        (void)manager.Play(short_buffer);
+    paused->pause();
+    REQUIRE(manager.ActiveSources() == 6);
+    Render(context, sampling_rate / 10);
+    TickUntilActive(manager, 0);
+
+    // A looping source keeps playing, so it's rescheduled rather than released.
+    std::shared_ptr<Audio::Source> looping = manager.Play(short_buffer);
+    looping->loop();
+    (void)manager.Play(short_buffer);
+    Render(context, sampling_rate / 10);
+    TickUntilActive(manager, 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    manager.Tick();
+    REQUIRE(manager.ActiveSources() == 1);
+    REQUIRE(looping->IsPlaying());
+
+    // A source that was added, but not played, is released at the next tick.
+    (void)manager.Add(short_buffer);
+    REQUIRE(manager.ActiveSources() == 2);
+    manager.Tick();
+    REQUIRE(manager.ActiveSources() == 1);
+}
+#endif
@@ -0,0 +1,210 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <audio/context.h>
+#include <audio/streaming_source.h>
+#include <macros/finally.h>
+
+#include <doctest/doctest.h>
+
+#ifdef ALC_SOFT_loopback
+namespace
+{
+    constexpr int sampling_rate = 44100;
+    constexpr std::size_t segment_blocks = 500;
+
+    // The test signal is a sequence of constant segments with different levels, so that a skipped or a repeated chunk is easy to notice.
+    [[nodiscard]] std::int16_t SignalLevel(std::size_t block)
+    {
+        return std::int16_t(1000 * (1 + block / segment_blocks % 7));
+    }
+
+    // Streams `SignalLevel()` in mono. `total_blocks` is the length of the sound.
+    // The reader blocks until `*allowed_blocks` is large enough, which lets the tests simulate a slow decoder.
+    [[nodiscard]] Audio::StreamingSource::BlockReader SignalReader(std::size_t total_blocks, std::shared_ptr<std::atomic<std::size_t>> allowed_blocks = nullptr)
+    {
+        auto pos = std::make_shared<std::size_t>(0);
+
+        Audio::StreamingSource::BlockReader ret;
+        ret.sampling_rate = sampling_rate;
+        ret.channel_count = Audio::mono;
+        ret.read = [=](std::uint8_t *target, std::size_t block_count)
+        {
+            block_count = std::min(block_count, total_blocks - *pos);
+            while (allowed_blocks && *allowed_blocks < *pos + block_count)
+                std::this_thread::yield();
+
+            for (std::size_t i = 0; i < block_count; i++)
+            {
+                std::int16_t sample = SignalLevel(*pos + i);
+                std::memcpy(target + i * sizeof sample, &sample, sizeof sample);
+            }
+            *pos += block_count;
+            return block_count;
+        };
+        ret.rewind = [=]{*pos = 0;};
+        return ret;
+    }
+
+    // Calls `Update()` until at least `chunks` chunks are queued in total. This waits for the decoder thread.
+    // Fails if that doesn't happen in a reasonable time, e.g. if the sound ended too early.
+    void UpdateUntilQueued(Audio::StreamingSource &source, std::size_t chunks)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (true)
+        {
+            source.Update();
+            if (source.GetStats().queued_chunks >= chunks)
+                break;
+            REQUIRE(std::chrono::steady_clock::now() < deadline);
+            std::this_thread::yield();
+        }
+    }
+
+    // Renders `block_count` stereo blocks and appends them to `output`.
+    void Render(Audio::Context &context, std::vector<std::int16_t> &output, std::size_t block_count)
+    {
+        std::size_t old_size = output.size();
+        output.resize(old_size + block_count * 2);
+        context.RenderSamples(output.data() + old_size, int(block_count));
+    }
+
+    // The gain that OpenAL applies to a centered mono source in each of the stereo channels, measured in the middle of the first segment.
+    [[nodiscard]] float MeasureGain(const std::vector<std::int16_t> &output, std::size_t output_pos)
+    {
+        float ret = output[(output_pos + segment_blocks / 2) * 2] / float(SignalLevel(0));
+        REQUIRE((ret > 0.3f && ret < 1.1f));
+        return ret;
+    }
+
+    // Checks that `output` (stereo), starting at block `output_pos`, contains `block_count` blocks of the signal, starting at block `signal_pos`.
+    // `signal_length` is the sound length, after which the signal wraps around.
+    // Only the middles of the segments are checked, since OpenAL can delay or smooth the playback a bit, and dithers the output.
+    void RequireSignal(const std::vector<std::int16_t> &output, std::size_t output_pos, std::size_t signal_pos, std::size_t block_count, std::size_t signal_length, float gain)
+    {
+        REQUIRE(output.size() >= (output_pos + block_count) * 2);
+        for (std::size_t i = 0; i < block_count; i++)
+        {
+            std::size_t block = (signal_pos + i) % signal_length;
+            std::size_t pos_in_segment = block % segment_blocks;
+            if (pos_in_segment < segment_blocks * 3 / 10 || pos_in_segment >= segment_blocks * 7 / 10)
+                continue;
+
+            float expected = SignalLevel(block) * gain;
+            for (int channel = 0; channel < 2; channel++)
+                REQUIRE(std::abs(output[(output_pos + i) * 2 + channel] - expected) <= 4 + expected * 0.01f);
+        }
+    }
+
+    void RequireSilence(const std::vector<std::int16_t> &output, std::size_t output_pos, std::size_t block_count)
+    {
+        REQUIRE(output.size() >= (output_pos + block_count) * 2);
+        for (std::size_t i = output_pos * 2; i < (output_pos + block_count) * 2; i++)
+            REQUIRE(std::abs(output[i]) <= 4);
+    }
+}
+
+TEST_CASE("audio_streaming_source.playback")
+{
+    Audio::Context context = Audio::Context::Loopback(sampling_rate);
+
+    constexpr std::size_t num_buffers = 4, chunk_blocks = 1000, total_blocks = 6250; // The last chunk is incomplete.
+    constexpr std::size_t total_chunks = (total_blocks + chunk_blocks - 1) / chunk_blocks;
+    Audio::StreamingSource source(SignalReader(total_blocks), false, num_buffers, chunk_blocks);
+    REQUIRE(source.SamplingRate() == sampling_rate);
+    REQUIRE(source.ChannelCount() == Audio::mono);
+
+    source.Play();
+    UpdateUntilQueued(source, num_buffers);
+
+    // Render the sound in small steps, keeping the buffers filled.
+    std::vector<std::int16_t> output;
+    while (output.size() / 2 < total_blocks + chunk_blocks)
+    {
+        Render(context, output, segment_blocks);
+        UpdateUntilQueued(source, std::min(total_chunks, output.size() / 2 / chunk_blocks + num_buffers));
+    }
+
+    RequireSignal(output, 0, 0, total_blocks, total_blocks, MeasureGain(output, 0));
+    RequireSilence(output, total_blocks + 100, output.size() / 2 - total_blocks - 100);
+
+    REQUIRE(source.IsFinished());
+    REQUIRE(source.GetStats().underruns == 0);
+    REQUIRE(source.GetStats().queued_chunks == total_chunks);
+}
+
+TEST_CASE("audio_streaming_source.looping")
+{
+    Audio::Context context = Audio::Context::Loopback(sampling_rate);
+
+    // The sound length is not a multiple of the chunk size, so the chunks must be stitched across the loop boundary.
+    constexpr std::size_t num_buffers = 3, chunk_blocks = 1000, total_blocks = 2500;
+    Audio::StreamingSource source(SignalReader(total_blocks), true, num_buffers, chunk_blocks);
+
+    source.Play();
+    UpdateUntilQueued(source, num_buffers);
+
+    std::vector<std::int16_t> output;
+    while (output.size() / 2 < total_blocks * 4)
+    {
+        Render(context, output, segment_blocks);
+        UpdateUntilQueued(source, output.size() / 2 / chunk_blocks + num_buffers);
+    }
+
+    RequireSignal(output, 0, 0, output.size() / 2, total_blocks, MeasureGain(output, 0));
+    REQUIRE_FALSE(source.IsFinished());
+    REQUIRE(source.GetStats().underruns == 0);
+}
+
+TEST_CASE("audio_streaming_source.underrun")
+{
+    Audio::Context context = Audio::Context::Loopback(sampling_rate);
+
+    // Only the first two chunks can be decoded at first.
+    constexpr std::size_t num_buffers = 2, chunk_blocks = 1000, total_blocks = 6000;
+    auto allowed_blocks = std::make_shared<std::atomic<std::size_t>>(chunk_blocks * 2);
+    Audio::StreamingSource source(SignalReader(total_blocks, allowed_blocks), false, num_buffers, chunk_blocks);
+    FINALLY{*allowed_blocks = std::numeric_limits<std::size_t>::max();}; // Otherwise the destructor waits for the decoder thread forever if we fail early.
+
+    source.Play();
+    UpdateUntilQueued(source, 2);
+
+    // Play both chunks and run out of data.
+    std::vector<std::int16_t> output;
+    Render(context, output, chunk_blocks * 3);
+    source.Update();
+    REQUIRE(source.GetStats().underruns == 1);
+    REQUIRE(source.GetStats().starved_updates > 0);
+    REQUIRE_FALSE(source.IsFinished());
+
+    float gain = MeasureGain(output, 0);
+    RequireSignal(output, 0, 0, chunk_blocks * 2, total_blocks, gain);
+    RequireSilence(output, chunk_blocks * 2 + 100, chunk_blocks - 100);
+
+    // An underrun is counted only once, no matter how many updates it lasts.
+    source.Update();
+    REQUIRE(source.GetStats().underruns == 1);
+
+    // When the decoder catches up, the playback resumes where it stopped.
+    *allowed_blocks = std::numeric_limits<std::size_t>::max();
+    UpdateUntilQueued(source, 2 + num_buffers);
+    std::size_t resume_pos = output.size() / 2;
+    while (output.size() / 2 < resume_pos + total_blocks - chunk_blocks * 2 + chunk_blocks)
+    {
+        Render(context, output, segment_blocks);
+        UpdateUntilQueued(source, std::min(total_blocks / chunk_blocks, (output.size() / 2 - resume_pos) / chunk_blocks + 2 + num_buffers));
+    }
+
+    RequireSignal(output, resume_pos, chunk_blocks * 2, total_blocks - chunk_blocks * 2, total_blocks, gain);
+    REQUIRE(source.IsFinished());
+    REQUIRE(source.GetStats().underruns == 1);
+}
+#endif
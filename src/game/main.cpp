@@ -3,6 +3,22 @@
 const ivec2 screen_size = ivec2(480, 270);
 const std::string_view window_name = "LD53";
 
+// If the asset pack exists, assets are loaded from it. Otherwise they're loaded from the loose files.
+static const AssetPack::Reader asset_pack = []{
+    std::string file_name = Program::ExeDir() + "assets.pack";
+    bool exists = false;
+    Filesystem::ObjInfo info = Filesystem::GetObjectInfo(file_name, &exists);
+    return exists && info.category == Filesystem::file ? AssetPack::Reader(file_name) : AssetPack::Reader{};
+}();
+
+Stream::ReadOnlyData LoadAsset(const std::string &name)
+{
+    if (asset_pack)
+        return asset_pack.GetData(name);
+    else
+        return Stream::ReadOnlyData::file(Program::ExeDir() + "assets/" + name);
+}
+
 Interface::Window window(std::string(window_name), screen_size * 2, Interface::windowed, adjust_(Interface::WindowSettings{}, .min_size = screen_size));
 static Graphics::DummyVertexArray dummy_vao = nullptr;
 
@@ -12,7 +28,7 @@ Audio::SourceManager audio;
 const Graphics::ShaderConfig shader_config = Graphics::ShaderConfig::Core();
 Interface::ImGuiController gui_controller(Poly::derived<Interface::ImGuiController::GraphicsBackend_Modern>, adjust_(Interface::ImGuiController::Config{}, .shader_header = shader_config.common_header, .store_state_in_file = {}));
 
-Graphics::FontFile Fonts::Files::main(Program::ExeDir() + "assets/Monocat_6x12.ttf", 12);
+Graphics::FontFile Fonts::Files::main(LoadAsset("Monocat_6x12.ttf"), 12);
 Graphics::Font Fonts::main;
 
 GameUtils::AdaptiveViewport adaptive_viewport(shader_config, screen_size);
@@ -91,7 +107,10 @@ struct Application : Program::DefaultBasicState
         ImGui::StyleColorsDark();
 
         { // Load images.
-            Graphics::GlobalData::Load(Program::ExeDir() + "assets/images/");
+            Graphics::GlobalData::LoadParams image_params;
+            image_params.get_data = [](const std::string &name){return LoadAsset("images/" + name + ".png");};
+            image_params.cache_prefix = Program::ExeDir() + "cached_images";
+            Graphics::GlobalData::Load(image_params);
             r.SetAtlas("");
 
             // Load the font atlas.
@@ -118,13 +137,20 @@ struct Application : Program::DefaultBasicState
         // Load various small fonts
         auto monochrome_font_flags = ImGuiFreeTypeBuilderFlags_Monochrome | ImGuiFreeTypeBuilderFlags_MonoHinting;
 
-        gui_controller.LoadFont(Program::ExeDir() + "assets/Monocat_6x12.ttf", 12.0f, adjust(ImFontConfig{}, .FontBuilderFlags = monochrome_font_flags));
+        gui_controller.LoadFont(LoadAsset("Monocat_6x12.ttf"), 12.0f, adjust(ImFontConfig{}, .FontBuilderFlags = monochrome_font_flags));
         gui_controller.LoadDefaultFont();
 
         Graphics::Blending::Enable();
         Graphics::Blending::FuncNormalPre();
 
-        Audio::GlobalData::Load(Audio::mono, Audio::wav, Program::ExeDir() + "assets/sounds/");
+        // Convert the sounds to the device sampling rate, to avoid resampling them on the fly.
+        Audio::SoundFormat sound_format;
+        sound_format.sampling_rate = audio_context.SamplingRate();
+        Audio::GlobalData::Load(Audio::mono, Audio::wav, [](const std::string &name, std::optional<Audio::Channels> channels, Audio::Format format) -> Stream::Input
+        {
+            (void)channels;
+            return LoadAsset("sounds/" + name + (format == Audio::ogg ? ".ogg" : ".wav"));
+        }, sound_format);
 
         state_manager.SetState("World{}");
     }
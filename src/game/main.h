@@ -3,6 +3,10 @@
 extern const ivec2 screen_size;
 extern const std::string_view window_name;
 
+// Loads a file from `assets.pack`, or from the `assets/` directory if there's no pack.
+// `name` is relative to the `assets/` directory.
+[[nodiscard]] Stream::ReadOnlyData LoadAsset(const std::string &name);
+
 extern Interface::Window window;
 
 extern Audio::Context audio_context;
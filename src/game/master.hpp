@@ -20,6 +20,7 @@
 #include "graphics/complete.h"
 #include "input/complete.h"
 #include "interface/gui.h"
+#include "interface/profiler_window.h"
 #include "interface/window.h"
 #include "macros/adjust.h"
 #include "macros/enum_flag_operators.h"
@@ -40,11 +41,14 @@
 #include "strings/format.h"
 #include "strings/lexical_cast.h"
 #include "utils/aabb_tree.h"
+#include "utils/asset_pack.h"
 #include "utils/clock.h"
+#include "utils/filesystem.h"
 #include "utils/hash.h"
 #include "utils/mat.h"
 #include "utils/metronome.h"
 #include "utils/multiarray.h"
 #include "utils/poly_storage.h"
+#include "utils/profiler.h"
 #include "utils/random.h"
 #include "utils/simple_iterator.h"
@@ -50,7 +50,7 @@ namespace States
 
             game.create<BvhTree>();
             auto &map = game.create<Map>();
-            map.Load(Program::ExeDir() + "assets/map.json");
+            map.Load(LoadAsset("map.json"));
 
 
             map.points.ForEachPointNamed("box", [](fvec2 pos)
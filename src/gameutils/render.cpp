@@ -276,6 +276,34 @@ Render::Triangle_t::~Triangle_t()
     ((decltype(Render::Data::queue) *)queue)->Add(out[0], out[1], out[2]);
 }
 
+// Calls `func(offset, symbol)` for every symbol of the text, where `offset` is the symbol position relative to the text position, not counting the `symbol.offset`.
+static void LayoutText(const Graphics::Text &text, const Graphics::Text::Stats &stats, ivec2 align, int align_box_x, auto &&func)
+{
+    ivec2 align_box(align_box_x, align.y);
+
+    fvec2 offset = -stats.size * (1 + align_box) / 2;
+    offset.x += stats.size.x * (1 + align.x) / 2; // Note that we don't change vertical position here.
+
+    float line_start_offset_x = offset.x;
+
+    for (size_t line_index = 0; line_index < text.lines.size(); line_index++)
+    {
+        const Graphics::Text::Line &line = text.lines[line_index];
+        const Graphics::Text::Stats::Line &line_stats = stats.lines[line_index];
+
+        offset.x = line_start_offset_x - line_stats.width * (1 + align.x) / 2;
+        offset.y += line_stats.ascent;
+
+        for (const Graphics::Text::Symbol &symbol : line.symbols)
+        {
+            func(offset, symbol);
+            offset.x += symbol.advance + symbol.kerning;
+        }
+
+        offset.y += line_stats.descent + line_stats.line_gap;
+    }
+}
+
 Render::Text_t::~Text_t()
 {
     if (!renderer)
@@ -283,39 +311,86 @@ Render::Text_t::~Text_t()
 
     Graphics::Text::Stats stats = data.text.ComputeStats();
 
-    ivec2 align_box(data.has_box_alignment ? data.align_box_x : data.align.x, data.align.y);
+    LayoutText(data.text, stats, data.align, data.has_box_alignment ? data.align_box_x : data.align.x, [&](fvec2 offset, const Graphics::Text::Symbol &symbol)
+    {
+        fvec2 symbol_pos;
 
-    fvec2 pos = data.pos;
+        if (!data.has_matrix)
+            symbol_pos = data.pos + offset + symbol.offset;
+        else
+            symbol_pos = data.pos + (data.matrix * (offset + symbol.offset).to_vec3(1)).to_vec2();
 
-    fvec2 offset = -stats.size * (1 + align_box) / 2;
-    offset.x += stats.size.x * (1 + data.align.x) / 2; // Note that we don't change vertical position here.
+        auto quad = renderer->fquad(symbol_pos, symbol.size).tex(symbol.texture_pos).color(data.color).mix(0).alpha(data.alpha).beta(data.beta);
+        if (data.has_matrix)
+            quad.matrix(data.matrix.to_mat2()).pixel_center(fvec2(0));
+    });
+}
 
-    float line_start_offset_x = offset.x;
+bool Render::CachedText::Update(const Graphics::Font &new_font, std::string_view new_string, ivec2 new_align)
+{
+    return Update(new_font, new_string, new_align, new_align.x);
+}
+
+bool Render::CachedText::Update(const Graphics::Font &new_font, std::string_view new_string, ivec2 new_align, int new_align_box_x)
+{
+    new_align = sign(new_align);
+    new_align_box_x = sign(new_align_box_x);
+
+    if (font == &new_font && font_generation == new_font.Generation() && string == new_string && align == new_align && align_box_x == new_align_box_x)
+        return false;
 
-    for (size_t line_index = 0; line_index < data.text.lines.size(); line_index++)
+    font = &new_font;
+    font_generation = new_font.Generation();
+    string = new_string;
+    align = new_align;
+    align_box_x = new_align_box_x;
+
+    Graphics::Text text(new_font, new_string);
+    Graphics::Text::Stats stats = text.ComputeStats();
+    size = stats.size;
+
+    vertices.clear();
+    LayoutText(text, stats, align, align_box_x, [&](fvec2 offset, const Graphics::Text::Symbol &symbol)
     {
-        const Graphics::Text::Line &line = data.text.lines[line_index];
-        const Graphics::Text::Stats::Line &line_stats = stats.lines[line_index];
+        fvec2 a = offset + symbol.offset;
+        fvec2 b = a + symbol.size;
+        fvec2 tex_a = symbol.texture_pos;
+        fvec2 tex_b = tex_a + symbol.size;
+        vertices.push_back({a, tex_a});
+        vertices.push_back({fvec2(b.x, a.y), fvec2(tex_b.x, tex_a.y)});
+        vertices.push_back({b, tex_b});
+        vertices.push_back({fvec2(a.x, b.y), fvec2(tex_a.x, tex_b.y)});
+    });
+
+    return true;
+}
 
-        offset.x = line_start_offset_x - line_stats.width * (1 + data.align.x) / 2;
-        offset.y += line_stats.ascent;
+Render::CachedText_t::~CachedText_t()
+{
+    if (!queue)
+        return;
 
-        for (const Graphics::Text::Symbol &symbol : line.symbols)
-        {
-            fvec2 symbol_pos;
+    auto &render_queue = *(decltype(Render::Data::queue) *)queue;
+
+    Render::Data::Attribs out[4];
+    for (auto &it : out)
+    {
+        it.color = data.color.to_vec4(0);
+        it.factors = fvec3(0, data.alpha, data.beta);
+    }
 
+    const std::vector<CachedText::Vertex> &vertices = data.text->vertices;
+    for (std::size_t i = 0; i < vertices.size(); i += 4)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            const CachedText::Vertex &vertex = vertices[i + j];
             if (!data.has_matrix)
-                symbol_pos = pos + offset + symbol.offset;
+                out[j].pos = data.pos + vertex.pos;
             else
-                symbol_pos = pos + (data.matrix * (offset + symbol.offset).to_vec3(1)).to_vec2();
-
-            auto quad = renderer->fquad(symbol_pos, symbol.size).tex(symbol.texture_pos).color(data.color).mix(0).alpha(data.alpha).beta(data.beta);
-            if (data.has_matrix)
-                quad.matrix(data.matrix.to_mat2()).pixel_center(fvec2(0));
-
-            offset.x += symbol.advance + symbol.kerning;
+                out[j].pos = data.pos + (data.matrix * vertex.pos.to_vec3(1)).to_vec2();
+            out[j].texcoord = vertex.texcoord;
         }
-
-        offset.y += line_stats.descent + line_stats.line_gap;
+        render_queue.Add(out[0], out[1], out[2], out[3]);
     }
 }
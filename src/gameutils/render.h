@@ -1,7 +1,11 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <string_view>
 #include <utility>
+#include <vector>
 
 #include "graphics/global_image_loader.h"
 #include "graphics/text.h"
@@ -554,6 +558,141 @@ class Render
         ~Text_t();
     };
 
+    // A text with a precomputed layout, for the text that rarely changes, such as HUD labels.
+    // Drawing it skips the layout entirely, only the vertex positions are offset and the colors are filled.
+    // Note that the layout references the glyph positions in the texture, so it shouldn't be used with the fonts backed by `Graphics::GlyphCache`.
+    // Usage:
+    //     Render::CachedText label; // Store this somewhere persistent.
+    //     label.Update(Fonts::main, FMT("Score: {}", score), ivec2(-1)); // Does nothing if the arguments didn't change.
+    //     r.itext(ivec2(10), label).color(fvec3(1));
+    class CachedText
+    {
+        friend class Render;
+
+        struct Vertex
+        {
+            fvec2 pos; // Relative to the text position.
+            fvec2 texcoord;
+        };
+
+        const Graphics::Font *font = nullptr;
+        std::uint64_t font_generation = 0; // `Graphics::Font::Generation()`, to notice when the font is reloaded or modified in place.
+        std::string string;
+        ivec2 align = ivec2(0);
+        int align_box_x = 0;
+
+        std::vector<Vertex> vertices; // 4 per glyph.
+        ivec2 size = ivec2(0);
+
+      public:
+        CachedText() {}
+
+        // Recomputes the layout, unless the arguments match the previous call and the font wasn't modified since. Returns true if the layout was recomputed.
+        // `align` and `align_box_x` have the same meaning as in `Text_t`. If `align_box_x` is not specified, it's equal to `align.x`.
+        bool Update(const Graphics::Font &new_font, std::string_view new_string, ivec2 new_align = ivec2(0));
+        bool Update(const Graphics::Font &new_font, std::string_view new_string, ivec2 new_align, int new_align_box_x);
+
+        // The text size, as returned by `Graphics::Text::ComputeStats()`.
+        [[nodiscard]] ivec2 Size() const
+        {
+            return size;
+        }
+    };
+
+    class CachedText_t
+    {
+        friend class Render;
+
+        using ref = CachedText_t &&;
+
+        void *queue = 0; // Actually the type should be `Graphics::SimpleRenderQueue<Attribs, 3> *`, but we don't include "graphics/simple_render_queue.h" for better compilation times.
+
+        struct Data
+        {
+            // The constructor sets those:
+            fvec2 pos;
+            const CachedText *text = nullptr;
+
+            fvec3 color = fvec3(1);
+            float alpha = 1;
+            float beta = 1;
+
+            bool has_matrix = 0;
+            fmat3 matrix = {};
+        };
+        Data data;
+
+        CachedText_t(void *queue, fvec2 pos, const CachedText &text) : queue(queue)
+        {
+            data.pos = pos;
+            data.text = &text;
+        }
+      public:
+        CachedText_t(CachedText_t &&other) noexcept : queue(std::exchange(other.queue, {})), data(std::move(other.data)) {}
+        CachedText_t &operator=(CachedText_t other)
+        {
+            std::swap(queue, other.queue);
+            std::swap(data, other.data);
+            return *this;
+        }
+
+        ref color(fvec3 c)
+        {
+            data.color = c;
+            return (ref)*this;
+        }
+        ref alpha(float x)
+        {
+            data.alpha = x;
+            return (ref)*this;
+        }
+        ref beta(float x)
+        {
+            data.beta = x;
+            return (ref)*this;
+        }
+        ref matrix(fmat3 m) // This can be called multiple times, resulting in multiplying matrices in the order they were passed.
+        {
+            if (data.has_matrix)
+            {
+                data.matrix = data.matrix * m;
+            }
+            else
+            {
+                data.has_matrix = 1;
+                data.matrix = m;
+            }
+            return (ref)*this;
+        }
+        ref matrix(fmat2 m)
+        {
+            matrix(m.to_mat3());
+            return (ref)*this;
+        }
+        ref rotate(float a) // Uses `matrix()`.
+        {
+            matrix(fmat3::rotate(a));
+            return (ref)*this;
+        }
+        ref translate(fvec2 v) // Uses a matrix.
+        {
+            matrix(fmat3::translate(v));
+            return (ref)*this;
+        }
+        ref scale(fvec2 s) // Uses a matrix.
+        {
+            matrix(fmat3::scale(s));
+            return (ref)*this;
+        }
+        ref scale(float s) // Uses a matrix.
+        {
+            scale(fvec2(s));
+            return (ref)*this;
+        }
+
+        ~CachedText_t();
+    };
+
     Quad_t fquad(fvec2 pos, fvec2 size)
     {
         return Quad_t(GetRenderQueuePtr(), pos, size);
@@ -603,4 +742,17 @@ class Render
     {
         return Text_t(this, pos, std::move(text));
     }
+
+    // The text must outlive the returned object.
+    CachedText_t ftext(fvec2 pos, const CachedText &text)
+    {
+        return CachedText_t(GetRenderQueuePtr(), pos, text);
+    }
+    CachedText_t itext(fvec2 pos, const CachedText &text) = delete;
+    CachedText_t itext(ivec2 pos, const CachedText &text)
+    {
+        return CachedText_t(GetRenderQueuePtr(), pos, text);
+    }
+    CachedText_t ftext(fvec2 pos, CachedText &&) = delete;
+    CachedText_t itext(ivec2 pos, CachedText &&) = delete;
 };
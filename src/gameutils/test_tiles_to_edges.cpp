@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <cstddef>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <gameutils/tiles_to_edges.h>
+#include <utils/thread_pool.h>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    using namespace GameUtils::TilesToEdges;
+
+    // An empty tile, a full square, and four triangles.
+    [[nodiscard]] TileSet MakeTileSet()
+    {
+        TileSet::Params params;
+        params.tile_size = ivec2(16);
+        params.vertices = {ivec2(0,0), ivec2(16,0), ivec2(16,16), ivec2(0,16)};
+        params.tiles = {{}, {{0,1,2,3}}, {{0,1,3}}, {{0,1,2}}, {{1,2,3}}, {{0,2,3}}};
+        return TileSet(std::move(params));
+    }
+
+    // Tile 0 is empty, the rest are chosen from `1..num_solid_tiles`.
+    // With only the square tiles, the loops often touch each other at a single vertex.
+    [[nodiscard]] std::size_t RandomTile(std::mt19937 &gen, std::size_t num_solid_tiles, double density)
+    {
+        return std::bernoulli_distribution(density)(gen) ? 1 + gen() % num_solid_tiles : 0;
+    }
+
+    [[nodiscard]] Array2D<std::size_t> RandomMap(std::mt19937 &gen, ivec2 size, std::size_t num_solid_tiles, double density)
+    {
+        Array2D<std::size_t> ret(size);
+        for (ivec2 pos : vector_range(size))
+            ret.safe_throwing_at(pos) = RandomTile(gen, num_solid_tiles, density);
+        return ret;
+    }
+
+    // The loops as reported by `Convert()`.
+    [[nodiscard]] std::vector<Loop> ConvertWithCallback(const Params &params)
+    {
+        std::vector<Loop> ret;
+        bool new_loop = true;
+        Params params_copy = params;
+        params_copy.output_vertex = [&](ivec2 pos, bool last)
+        {
+            if (new_loop)
+                ret.emplace_back();
+            new_loop = last;
+            if (!last)
+                ret.back().push_back(pos);
+            else
+                REQUIRE(pos == ret.back().front());
+        };
+        Convert(params_copy);
+        REQUIRE(new_loop);
+        return ret;
+    }
+
+    // All edges of all loops, sorted. This doesn't depend on how the loops are split at the vertices where they touch.
+    [[nodiscard]] std::vector<std::pair<ivec2, ivec2>> LoopEdges(const std::vector<Loop> &loops)
+    {
+        std::vector<std::pair<ivec2, ivec2>> ret;
+        for (const Loop &loop : loops)
+        {
+            for (std::size_t i = 0; i < loop.size(); i++)
+                ret.emplace_back(loop[i], loop[(i + 1) % loop.size()]);
+        }
+        std::sort(ret.begin(), ret.end(), [](const auto &a, const auto &b){return std::tie(a.first.y, a.first.x, a.second.y, a.second.x) < std::tie(b.first.y, b.first.x, b.second.y, b.second.x);});
+        return ret;
+    }
+
+    [[nodiscard]] std::vector<Loop> IncrementalLoops(const IncrementalConverter &converter)
+    {
+        std::vector<Loop> ret;
+        converter.ForEachLoop([&](IncrementalConverter::LoopId, const Loop &loop){ret.push_back(loop);});
+        return ret;
+    }
+}
+
+TEST_CASE("tiles_to_edges.sequential_and_parallel")
+{
+    TileSet tileset = MakeTileSet();
+    ThreadPool pool(3);
+    ThreadPool null_pool;
+    std::mt19937 gen(42);
+
+    for (int i = 0; i < 20; i++)
+    {
+        Params params;
+        params.tileset = &tileset;
+        params.tiles = RandomMap(gen, ivec2(1 + gen() % 24, 1 + gen() % 24), i % 2 ? 1 : 5, std::uniform_real_distribution<double>(0.1, 0.9)(gen));
+
+        std::vector<Loop> expected = ConvertWithCallback(params);
+        REQUIRE(ConvertToLoops(params) == expected);
+
+        // The parallel conversion must produce exactly the same loops, in the same order.
+        params.thread_pool = &pool;
+        REQUIRE(ConvertWithCallback(params) == expected);
+        REQUIRE(ConvertToLoops(params) == expected);
+
+        // A pool without threads runs everything on this thread.
+        params.thread_pool = &null_pool;
+        REQUIRE(ConvertToLoops(params) == expected);
+    }
+}
+
+TEST_CASE("tiles_to_edges.incremental")
+{
+    TileSet tileset = MakeTileSet();
+    ThreadPool pool(3);
+    std::mt19937 gen(43);
+
+    for (int i = 0; i < 15; i++)
+    {
+        const std::size_t num_solid_tiles = i % 2 ? 1 : 5;
+        const ivec2 size(1 + gen() % 24, 1 + gen() % 24);
+
+        Params params;
+        params.tileset = &tileset;
+        params.tiles = RandomMap(gen, size, num_solid_tiles, std::uniform_real_distribution<double>(0.1, 0.9)(gen));
+
+        IncrementalConverter converter(tileset, params.tiles, i % 3 ? &pool : nullptr);
+        REQUIRE(IncrementalLoops(converter) == ConvertToLoops(params));
+
+        // Mirrors the converter state, using only the returned changes.
+        std::map<IncrementalConverter::LoopId, Loop> loops;
+        converter.ForEachLoop([&](IncrementalConverter::LoopId id, const Loop &loop){loops.try_emplace(id, loop);});
+
+        for (int j = 0; j < 10; j++)
+        {
+            // Modify a few tiles close to each other.
+            ivec2 center(gen() % size.x, gen() % size.y);
+            for (int k = 1 + gen() % 4; k > 0; k--)
+            {
+                ivec2 pos = clamp(center + ivec2(int(gen() % 5) - 2, int(gen() % 5) - 2), ivec2(0), size - 1);
+                std::size_t tile = RandomTile(gen, num_solid_tiles, 0.6);
+                converter.SetTile(pos, tile);
+                params.tiles.safe_throwing_at(pos) = tile;
+            }
+            for (ivec2 pos : vector_range(size))
+                REQUIRE(converter.Tiles().safe_throwing_at(pos) == params.tiles.safe_throwing_at(pos));
+
+            IncrementalConverter::Changes changes = converter.Update();
+            for (IncrementalConverter::LoopId id : changes.removed)
+                REQUIRE(loops.erase(id) == 1);
+            for (IncrementalConverter::LoopId id : changes.added)
+                REQUIRE(loops.try_emplace(id, converter.GetLoop(id)).second);
+
+            std::vector<Loop> actual = IncrementalLoops(converter);
+            REQUIRE(actual.size() == loops.size());
+            REQUIRE(std::equal(actual.begin(), actual.end(), loops.begin(), [](const Loop &a, const auto &b){return a == b.second;}));
+
+            // The loops touching at a single vertex can be split differently than in the full conversion, but the edges must match.
+            std::vector<Loop> expected = ConvertToLoops(params);
+            REQUIRE(LoopEdges(actual) == LoopEdges(expected));
+
+            // Nothing changes without modifications.
+            changes = converter.Update();
+            REQUIRE(changes.removed.empty());
+            REQUIRE(changes.added.empty());
+        }
+    }
+}
+
+TEST_CASE("tiles_to_edges.incremental_failure")
+{
+    // Break the tile set: the top edge of the square tile is cancelled out by any adjacent square, which leaves the loops open.
+    TileSet tileset = MakeTileSet();
+    std::size_t top_edge = tileset.edge_starting_at.safe_throwing_at(xvec2(1, 0));
+    tileset.symmetric_edges[top_edge].fill(top_edge);
+
+    // The isolated squares are fine.
+    Array2D<std::size_t> tiles(ivec2(7, 3));
+    tiles.safe_throwing_at(ivec2(1, 1)) = 1;
+    tiles.safe_throwing_at(ivec2(5, 1)) = 1;
+    IncrementalConverter converter(tileset, tiles);
+    const std::vector<Loop> old_loops = IncrementalLoops(converter);
+    REQUIRE(old_loops.size() == 2);
+
+    // A failed update leaves the loops unchanged, and the modified tile remains pending.
+    converter.SetTile(ivec2(2, 1), 1);
+    REQUIRE_THROWS_AS(converter.Update(), std::runtime_error);
+    REQUIRE(IncrementalLoops(converter) == old_loops);
+    REQUIRE(converter.Tiles().safe_throwing_at(ivec2(2, 1)) == 1);
+    REQUIRE_THROWS_AS(converter.Update(), std::runtime_error);
+    REQUIRE(IncrementalLoops(converter) == old_loops);
+
+    // After undoing the modification, the update succeeds and replaces the loops near it.
+    converter.SetTile(ivec2(2, 1), 0);
+    converter.SetTile(ivec2(3, 1), 1);
+    IncrementalConverter::Changes changes = converter.Update();
+    REQUIRE(changes.removed.size() == 2);
+    REQUIRE(changes.added.size() == 3);
+
+    Params params;
+    params.tileset = &tileset;
+    params.tiles = converter.Tiles();
+    REQUIRE(LoopEdges(IncrementalLoops(converter)) == LoopEdges(ConvertToLoops(params)));
+}
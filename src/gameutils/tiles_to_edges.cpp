@@ -1,5 +1,13 @@
 #include "tiles_to_edges.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include "macros/finally.h"
 #include "strings/format.h"
 #include "utils/bit_vectors.h"
 #include "utils/multiarray.h"
@@ -75,9 +83,9 @@ namespace GameUtils::TilesToEdges
 
         // Fill symmetric edge info.
         symmetric_edges.resize(edge_ids.size());
-        for (int i = 0; i < 4; i++)
+        for (int i = 0; i < 8; i++)
         {
-            ivec2 offset = ivec2::dir8(i) * tile_size;
+            ivec2 offset = -ivec2::dir8(i) * tile_size;
 
             for (const auto &[vertex_pair, edge] : edge_ids)
             {
@@ -158,152 +166,657 @@ namespace GameUtils::TilesToEdges
         }
     }
 
-    void Convert(const Params &params)
+    // A type for bit masks.
+    using bits_t = std::uint64_t;
+
+    // One bit per edge for each tile of a map.
+    class EdgeMask
     {
-        const TileSet &tileset = *params.tileset;
+        // All arrays have the same size, matching the map size.
+        // The outer vector is used in case the mask doesn't fit into a single `bits_t`.
+        std::vector<Array2D<bits_t>> words;
 
-        // A type for bit masks.
-        using bits_t = std::uint64_t;
+      public:
+        EdgeMask() {}
+        EdgeMask(std::size_t num_edges, ivec2 map_size)
+            : words((num_edges + BitVec::bit_width<bits_t> - 1) / BitVec::bit_width<bits_t>)
+        {
+            for (Array2D<bits_t> &arr : words)
+                arr = Array2D<bits_t>(map_size);
+        }
 
+        [[nodiscard]] bool Get(ivec2 tile_pos, std::size_t edge) const
+        {
+            auto loc = BitVec::BitLocation<bits_t>(edge);
+            return words[loc.index].safe_nonthrowing_at(tile_pos) & loc.mask;
+        }
 
-        // Which edges in each tile were already processed.
-        // All sub-arrays have the same size, matching the map size.
-        // The outer vector is used in case the mask doesn't fit into a single `bits_t`.
-        std::vector<Array2D<bits_t>> valid_edges((tileset.edge_points.size() + BitVec::bit_width<bits_t> - 1) / BitVec::bit_width<bits_t>);
-        for (Array2D<bits_t> &arr : valid_edges)
-            arr = Array2D<bits_t>(params.tiles.size());
+        void Set(ivec2 tile_pos, std::size_t edge, bool value)
+        {
+            auto loc = BitVec::BitLocation<bits_t>(edge);
+            bits_t &bits = words[loc.index].safe_nonthrowing_at(tile_pos);
+            if (value)
+                bits |= loc.mask;
+            else
+                bits &= ~loc.mask;
+        }
+    };
+
+    // An edge of a specific tile in the map.
+    struct EdgeRef
+    {
+        ivec2 tile_pos;
+        std::size_t edge = -1zu;
+
+        [[nodiscard]] friend bool operator==(const EdgeRef &, const EdgeRef &) = default;
+    };
 
-        // Fill the edge bit array, and remove the conflicting edges.
-        for (ivec2 tile_pos : vector_range(ivec2(params.tiles.size())))
+    // Calls `func(edge)` for every edge of a tile type, in the order in which the loops are started from them.
+    template <typename F>
+    static void ForEachTileEdge(const TileSet &tileset, std::size_t tile, F &&func)
+    {
+        for (const auto &vertex_loop : tileset.tile_vertices[tile])
+        for (std::size_t vertex : vertex_loop)
+            func(tileset.edge_starting_at.safe_nonthrowing_at(xvec2(tile, vertex)));
+    }
+
+    // Returns the position of `edge` in the order of `ForEachTileEdge()`.
+    [[nodiscard]] static std::size_t EdgeOrderInTile(const TileSet &tileset, std::size_t tile, std::size_t edge)
+    {
+        std::size_t ret = 0;
+        for (const auto &vertex_loop : tileset.tile_vertices[tile])
+        for (std::size_t vertex : vertex_loop)
         {
-            std::size_t tile = params.tiles.unsafe_at(tile_pos);
-            if (tile >= tileset.tile_vertices.size())
-                throw std::runtime_error(FMT("Tile index {} at {} is out of range.", tile, tile_pos));
+            if (tileset.edge_starting_at.safe_nonthrowing_at(xvec2(tile, vertex)) == edge)
+                return ret;
+            ret++;
+        }
+        return ret;
+    }
 
-            for (const auto &vertex_loop : tileset.tile_vertices[tile])
-            for (std::size_t vertex : vertex_loop)
+    static void ValidateTile(const TileSet &tileset, ivec2 tile_pos, std::size_t tile)
+    {
+        if (tile >= tileset.tile_vertices.size())
+            throw std::runtime_error(FMT("Tile index {} at {} is out of range.", tile, tile_pos));
+    }
+
+    // Adds the edges of the tile at `tile_pos` to `mask`, except for the ones that are cancelled out by the symmetric edges of the adjacent tiles.
+    // Only looks at the tile types, so the tiles can be processed in any order.
+    static void AddTileEdges(const TileSet &tileset, const Array2D<std::size_t> &tiles, ivec2 tile_pos, EdgeMask &mask)
+    {
+        ForEachTileEdge(tileset, tiles.safe_nonthrowing_at(tile_pos), [&](std::size_t edge)
+        {
+            for (int dir = 0; dir < 8; dir++)
             {
-                std::size_t edge = tileset.edge_starting_at.safe_nonthrowing_at(xvec2(tile, vertex));
+                std::size_t other_edge = tileset.symmetric_edges[edge][dir];
+                if (other_edge == -1zu)
+                    continue;
 
-                bool ok = true;
-                for (int dir = 0; dir < 4; dir++)
-                {
-                    ivec2 other_tile_pos = tile_pos + ivec2::dir8(dir + 4);
+                ivec2 other_tile_pos = tile_pos + ivec2::dir8(dir);
+                if (!tiles.pos_in_range(other_tile_pos))
+                    continue; // No tile in that direction.
+
+                std::size_t other_tile = tiles.safe_nonthrowing_at(other_tile_pos);
+                if (tileset.edge_starting_at.safe_nonthrowing_at(xvec2(other_tile, tileset.edge_points[other_edge].first)) == other_edge)
+                    return; // Found a conflicting edge, so neither of them exists.
+            }
+
+            mask.Set(tile_pos, edge, true);
+        });
+    }
+
+    [[nodiscard]] static ivec2 EdgeDir(const TileSet &tileset, std::size_t edge)
+    {
+        return tileset.vertices[tileset.edge_points[edge].second] - tileset.vertices[tileset.edge_points[edge].first];
+    }
+
+    // Finds the edge that continues a loop after `cur`, among the edges in `available`.
+    // Returns an edge equal to `-1zu` if there's none.
+    [[nodiscard]] static EdgeRef NextEdge(const TileSet &tileset, const Array2D<std::size_t> &tiles, const EdgeMask &available, EdgeRef cur)
+    {
+        std::size_t vertex = tileset.edge_points[cur.edge].second;
+        ivec2 dir = EdgeDir(tileset, cur.edge);
+
+        EdgeRef ret;
+        ivec2 best_dir(0);
+
+        for (int i = -1; i < 8; i++)
+        {
+            std::size_t next_vertex = i == -1 ? vertex : tileset.matching_vertices[vertex][i];
+            if (next_vertex == -1zu)
+                continue; // No matching vertex.
+            ivec2 next_tile_pos = cur.tile_pos + (i == -1 ? ivec2() : ivec2::dir8(i));
+            if (!tiles.pos_in_range(next_tile_pos))
+                continue; // Out of bounds.
+
+            std::size_t next_edge = tileset.edge_starting_at.safe_nonthrowing_at(xvec2(tiles.safe_nonthrowing_at(next_tile_pos), next_vertex));
+            if (next_edge == -1zu)
+                continue; // No edge.
+
+            if (!available.Get(next_tile_pos, next_edge))
+                continue; // The edge was cancelled out, or already visited.
+
+            ivec2 next_dir = EdgeDir(tileset, next_edge);
+
+            if (ret.edge == -1zu || Math::less_positively_rotated(-dir, next_dir, best_dir))
+            {
+                ret = {.tile_pos = next_tile_pos, .edge = next_edge};
+                best_dir = next_dir;
+            }
+        }
+
+        return ret;
+    }
+
+    // Traces a loop starting at the end of `start`, and removes its edges from `available`. `start` must be available.
+    // Writes the loop edges to `edges`, replacing its contents. The loop vertices are the ends of those edges, in the same order.
+    // The first edge is the one that closes the loop, normally `start` itself.
+    static void TraceLoop(const TileSet &tileset, const Array2D<std::size_t> &tiles, EdgeMask &available, EdgeRef start, std::vector<EdgeRef> &edges)
+    {
+        const std::size_t start_vertex = tileset.edge_points[start.edge].second;
+
+        edges.clear();
+        EdgeRef cur = start;
 
-                    // Note that we don't check the upper limit of Y here, because the offset can never have a positive Y.
-                    if ((other_tile_pos < 0).any() || other_tile_pos.x >= params.tiles.size().x)
-                        continue; // No tile in that direction.
+        while (true)
+        {
+            EdgeRef next = NextEdge(tileset, tiles, available, cur);
+            if (next.edge == -1zu)
+                throw std::runtime_error(FMT("Edge loop unexpectedly ended at tile {} vertex {}.", cur.tile_pos, tileset.edge_points[cur.edge].second));
+
+            // Remove the visited edge.
+            available.Set(next.tile_pos, next.edge, false);
+            edges.push_back(next);
+            cur = next;
+
+            if (next.tile_pos == start.tile_pos && tileset.edge_points[next.edge].second == start_vertex)
+                break;
+        }
+
+        std::rotate(edges.begin(), edges.end() - 1, edges.end());
+    }
+
+    // Returns the position of the end vertex of an edge, in the map coordinates.
+    [[nodiscard]] static ivec2 EdgeEndPos(const TileSet &tileset, EdgeRef ref)
+    {
+        return ref.tile_pos * tileset.tile_size + tileset.vertices[tileset.edge_points[ref.edge].second];
+    }
+
+    [[nodiscard]] static Loop EdgesToLoop(const TileSet &tileset, const std::vector<EdgeRef> &edges)
+    {
+        Loop ret;
+        ret.reserve(edges.size());
+        for (const EdgeRef &ref : edges)
+            ret.push_back(EdgeEndPos(tileset, ref));
+        return ret;
+    }
+
+    // Splits the map into horizontal bands for parallel processing. Returns the first row of each band, followed by the map height.
+    [[nodiscard]] static std::vector<int> SplitIntoBands(int height, const ThreadPool *thread_pool)
+    {
+        // Thinner bands have too many loops crossing the borders.
+        constexpr int min_band_height = 16;
+
+        int num_bands = 1;
+        if (thread_pool)
+            num_bands = std::clamp(height / min_band_height, 1, int(thread_pool->NumThreads()) * 2);
+
+        std::vector<int> ret(std::size_t(num_bands) + 1);
+        for (int i = 0; i <= num_bands; i++)
+            ret[std::size_t(i)] = int(std::int64_t(height) * i / num_bands);
+        return ret;
+    }
+
+    // Calls `func(band)` for each band, in parallel if `thread_pool` isn't null.
+    static void ForEachBand(const std::vector<int> &bands, ThreadPool *thread_pool, const std::function<void(std::size_t band)> &func)
+    {
+        if (thread_pool)
+        {
+            thread_pool->Run(bands.size() - 1, func);
+        }
+        else
+        {
+            for (std::size_t i = 0; i + 1 < bands.size(); i++)
+                func(i);
+        }
+    }
+
+    // Returns the edges of all tiles, except for the ones that cancel out.
+    [[nodiscard]] static EdgeMask ComputeAllEdges(const TileSet &tileset, const Array2D<std::size_t> &tiles, const std::vector<int> &bands, ThreadPool *thread_pool)
+    {
+        // Validate all tiles first, since `AddTileEdges()` also reads the adjacent ones.
+        for (ivec2 tile_pos : vector_range(ivec2(tiles.size())))
+            ValidateTile(tileset, tile_pos, tiles.unsafe_at(tile_pos));
 
-                    std::size_t other_edge = tileset.symmetric_edges[edge][dir];
-                    if (other_edge == -1zu)
-                        continue;
+        EdgeMask ret(tileset.edge_points.size(), ivec2(tiles.size()));
 
-                    auto loc = BitVec::BitLocation<bits_t>(other_edge);
-                    bits_t &bits = valid_edges[loc.index].safe_nonthrowing_at(other_tile_pos);
-                    if (bits & loc.mask)
+        // Each band only writes to its own tiles, so this is thread-safe.
+        ForEachBand(bands, thread_pool, [&](std::size_t band)
+        {
+            for (int y = bands[band]; y < bands[band + 1]; y++)
+            for (int x = 0; x < tiles.size().x; x++)
+                AddTileEdges(tileset, tiles, ivec2(x, y), ret);
+        });
+
+        return ret;
+    }
+
+    // Receives the edges of a loop, see `TraceLoop()`.
+    using LoopCallback = std::function<void(const std::vector<EdgeRef> &edges)>;
+
+    // Traces all loops in the raster order, and removes their edges from `available`.
+    static void TraceAllLoops(const TileSet &tileset, const Array2D<std::size_t> &tiles, EdgeMask &available, const LoopCallback &func)
+    {
+        std::vector<EdgeRef> buffer; // Reusing the same buffer, to avoid allocating each loop.
+
+        for (ivec2 tile_pos : vector_range(ivec2(tiles.size())))
+        {
+            ForEachTileEdge(tileset, tiles.unsafe_at(tile_pos), [&](std::size_t edge)
+            {
+                if (!available.Get(tile_pos, edge))
+                    return;
+                TraceLoop(tileset, tiles, available, {.tile_pos = tile_pos, .edge = edge}, buffer);
+                func(buffer);
+            });
+        }
+    }
+
+    // A part of a loop, that lies in a single band.
+    struct LoopFragment
+    {
+        std::vector<EdgeRef> edges;
+        EdgeRef next; // The edge after the last one, in a different fragment. Unused if `closed`.
+        bool closed = false; // This is a complete loop.
+    };
+
+    // Same as `TraceAllLoops()`, but traces the bands in parallel, then stitches the loops crossing the band borders.
+    // Returns false if the result could be different from `TraceAllLoops()`, then that should be used instead.
+    // This happens when the loops touch each other at some vertices in a way that makes the result depend on the tracing order, which is rare.
+    [[nodiscard]] static bool TraceAllLoopsInBands(const TileSet &tileset, const Array2D<std::size_t> &tiles, const EdgeMask &edges, const std::vector<int> &bands, ThreadPool *thread_pool, std::vector<std::vector<EdgeRef>> &loops)
+    {
+        const ivec2 map_size(tiles.size());
+        const std::size_t num_bands = bands.size() - 1;
+
+        // Unlike `TraceLoop()`, this never removes edges, so the next edge of each edge doesn't depend on the tracing order.
+        // If the loops are unambiguous, every edge is the next edge of exactly one other edge.
+        EdgeMask visited(tileset.edge_points.size(), map_size);
+        std::vector<std::vector<LoopFragment>> band_fragments(num_bands);
+
+        // Each band only writes to `visited` in its own tiles, so this is thread-safe.
+        ForEachBand(bands, thread_pool, [&](std::size_t band)
+        {
+            for (int y = bands[band]; y < bands[band + 1]; y++)
+            for (int x = 0; x < map_size.x; x++)
+            {
+                ivec2 tile_pos(x, y);
+                ForEachTileEdge(tileset, tiles.unsafe_at(tile_pos), [&](std::size_t edge)
+                {
+                    if (!edges.Get(tile_pos, edge) || visited.Get(tile_pos, edge))
+                        return;
+
+                    LoopFragment &fragment = band_fragments[band].emplace_back();
+                    EdgeRef cur = {.tile_pos = tile_pos, .edge = edge};
+                    visited.Set(tile_pos, edge, true);
+                    fragment.edges.push_back(cur);
+
+                    while (true)
                     {
-                        // Found a conflicting edge, remove it and stop.
-                        ok = false;
-                        bits &= ~loc.mask;
-                        break;
+                        EdgeRef next = NextEdge(tileset, tiles, edges, cur);
+                        if (next.edge == -1zu)
+                            throw std::runtime_error(FMT("Edge loop unexpectedly ended at tile {} vertex {}.", cur.tile_pos, tileset.edge_points[cur.edge].second));
+
+                        if (next == fragment.edges.front())
+                        {
+                            fragment.closed = true;
+                            break;
+                        }
+
+                        // Stop at the band border, or when reaching an earlier fragment.
+                        if (next.tile_pos.y < bands[band] || next.tile_pos.y >= bands[band + 1] || visited.Get(next.tile_pos, next.edge))
+                        {
+                            fragment.next = next;
+                            break;
+                        }
+
+                        visited.Set(next.tile_pos, next.edge, true);
+                        fragment.edges.push_back(next);
+                        cur = next;
                     }
+                });
+            }
+        });
+
+        std::vector<LoopFragment> fragments;
+        for (std::vector<LoopFragment> &list : band_fragments)
+            fragments.insert(fragments.end(), std::make_move_iterator(list.begin()), std::make_move_iterator(list.end()));
+        band_fragments = {};
+
+        auto EdgeKey = [&](EdgeRef ref)
+        {
+            return (std::uint64_t(ref.tile_pos.y) * std::uint64_t(map_size.x) + std::uint64_t(ref.tile_pos.x)) * tileset.edge_points.size() + ref.edge;
+        };
+
+        // Connect the fragments.
+        std::unordered_map<std::uint64_t, std::size_t> fragments_by_first_edge;
+        for (std::size_t i = 0; i < fragments.size(); i++)
+        {
+            if (!fragments[i].closed)
+                fragments_by_first_edge.try_emplace(EdgeKey(fragments[i].edges.front()), i);
+        }
+
+        std::vector<std::size_t> next_fragment(fragments.size(), -1zu);
+        std::vector<unsigned char/*boolean*/> has_prev_fragment(fragments.size());
+        for (std::size_t i = 0; i < fragments.size(); i++)
+        {
+            if (fragments[i].closed)
+                continue;
+
+            auto it = fragments_by_first_edge.find(EdgeKey(fragments[i].next));
+            // If the next edge is in the middle of a fragment, or if several fragments lead to the same one, some edge is the next edge of several edges.
+            if (it == fragments_by_first_edge.end() || has_prev_fragment[it->second])
+                return false;
+            has_prev_fragment[it->second] = true;
+            next_fragment[i] = it->second;
+        }
+
+        // Now every fragment has exactly one next and one previous fragment, so they form loops.
+        struct LoopKey
+        {
+            int y = 0;
+            int x = 0;
+            std::size_t edge_order = 0;
+
+            [[nodiscard]] auto operator<=>(const LoopKey &) const = default;
+        };
+        std::vector<std::pair<LoopKey, std::vector<EdgeRef>>> sorted_loops;
+
+        std::vector<unsigned char/*boolean*/> used_fragments(fragments.size());
+        for (std::size_t i = 0; i < fragments.size(); i++)
+        {
+            if (used_fragments[i])
+                continue;
+
+            std::vector<EdgeRef> loop = std::move(fragments[i].edges);
+            used_fragments[i] = true;
+            if (!fragments[i].closed)
+            {
+                for (std::size_t j = next_fragment[i]; j != i; j = next_fragment[j])
+                {
+                    loop.insert(loop.end(), fragments[j].edges.begin(), fragments[j].edges.end());
+                    used_fragments[j] = true;
                 }
+            }
 
-                // If no conflicting edges, create this edge.
-                if (ok)
+            // `TraceAllLoops()` starts each loop from its first edge in the raster order. Find it.
+            std::size_t first = 0;
+            LoopKey first_key;
+            for (std::size_t j = 0; j < loop.size(); j++)
+            {
+                const EdgeRef &ref = loop[j];
+                LoopKey key = {.y = ref.tile_pos.y, .x = ref.tile_pos.x, .edge_order = EdgeOrderInTile(tileset, tiles.unsafe_at(ref.tile_pos), ref.edge)};
+                if (j == 0 || key < first_key)
                 {
-                    auto loc = BitVec::BitLocation<bits_t>(edge);
-                    valid_edges[loc.index].safe_nonthrowing_at(tile_pos) |= loc.mask;
+                    first = j;
+                    first_key = key;
                 }
             }
+            std::rotate(loop.begin(), loop.begin() + std::ptrdiff_t(first), loop.end());
+
+            // If the loop passes through its starting vertex again in the same tile, `TraceLoop()` would've ended it early.
+            const EdgeRef &start = loop.front();
+            for (std::size_t j = 1; j < loop.size(); j++)
+            {
+                if (loop[j].tile_pos == start.tile_pos && tileset.edge_points[loop[j].edge].second == tileset.edge_points[start.edge].second)
+                    return false;
+            }
+
+            sorted_loops.emplace_back(first_key, std::move(loop));
         }
 
-        // Generate loops from the edges.
-        for (const ivec2 starting_tile_pos : vector_range(ivec2(params.tiles.size())))
+        std::sort(sorted_loops.begin(), sorted_loops.end(), [](const auto &a, const auto &b){return a.first < b.first;});
+
+        loops.clear();
+        loops.reserve(sorted_loops.size());
+        for (auto &[key, loop] : sorted_loops)
+            loops.push_back(std::move(loop));
+        return true;
+    }
+
+    // Performs the full conversion. Calls `func` for each loop, in the raster order of their first edges.
+    static void ConvertToEdges(const TileSet &tileset, const Array2D<std::size_t> &tiles, ThreadPool *thread_pool, const LoopCallback &func)
+    {
+        std::vector<int> bands = SplitIntoBands(int(tiles.size().y), thread_pool);
+        EdgeMask edges = ComputeAllEdges(tileset, tiles, bands, thread_pool);
+
+        std::vector<std::vector<EdgeRef>> loops;
+        if (thread_pool && TraceAllLoopsInBands(tileset, tiles, edges, bands, thread_pool, loops))
+        {
+            for (const std::vector<EdgeRef> &loop : loops)
+                func(loop);
+            return;
+        }
+
+        TraceAllLoops(tileset, tiles, edges, func);
+    }
+
+    void Convert(const Params &params)
+    {
+        ConvertToEdges(*params.tileset, params.tiles, params.thread_pool, [&](const std::vector<EdgeRef> &edges)
         {
-            const std::size_t starting_tile = params.tiles.unsafe_at(starting_tile_pos);
+            for (std::size_t i = 0; i <= edges.size(); i++)
+                params.output_vertex(EdgeEndPos(*params.tileset, edges[i % edges.size()]), i == edges.size());
+        });
+    }
+
+    std::vector<Loop> ConvertToLoops(const Params &params)
+    {
+        std::vector<Loop> ret;
+        ConvertToEdges(*params.tileset, params.tiles, params.thread_pool, [&](const std::vector<EdgeRef> &edges)
+        {
+            ret.push_back(EdgesToLoop(*params.tileset, edges));
+        });
+        return ret;
+    }
+
+
+    struct IncrementalConverter::Data
+    {
+        struct LoopEntry
+        {
+            std::vector<EdgeRef> edges; // See `TraceLoop()`.
+            Loop loop;
+        };
+
+        const TileSet *tileset = nullptr;
+        Array2D<std::size_t> tiles;
+
+        // The edges that don't belong to any loop. Those only exist during `Update()`.
+        EdgeMask free_edges;
+        // For each tile, the loops that have edges in it. Can have duplicates.
+        Array2D<std::vector<LoopId>> tile_loops;
+
+        std::map<LoopId, LoopEntry> loops;
+        LoopId next_id = 0;
 
-            for (const auto &vertex_loop : tileset.tile_vertices[starting_tile])
-            for (const std::size_t pre_starting_vertex : vertex_loop)
+        // The tiles modified since the last update.
+        bool have_dirty_rect = false;
+        irect2 dirty_rect;
+
+        // Adds `id` to `tile_loops` for the tiles of those edges.
+        void LinkLoop(LoopId id, const std::vector<EdgeRef> &edges)
+        {
+            for (const EdgeRef &ref : edges)
             {
-                const std::size_t starting_edge = tileset.edge_starting_at.safe_nonthrowing_at(xvec2(starting_tile, pre_starting_vertex));
-                if (auto loc = BitVec::BitLocation<bits_t>(starting_edge); !(valid_edges[loc.index].safe_nonthrowing_at(starting_tile_pos) & loc.mask))
-                    continue; // This edge doesn't exist.
+                std::vector<LoopId> &list = tile_loops.safe_nonthrowing_at(ref.tile_pos);
+                if (list.empty() || list.back() != id)
+                    list.push_back(id);
+            }
+        }
 
-                const std::size_t starting_vertex = tileset.edge_points[starting_edge].second;
+        // Removes `id` from `tile_loops` for the tiles of those edges.
+        void UnlinkLoop(LoopId id, const std::vector<EdgeRef> &edges)
+        {
+            for (const EdgeRef &ref : edges)
+                std::erase(tile_loops.unsafe_at(ref.tile_pos), id);
+        }
 
-                ivec2 tile_pos = starting_tile_pos;
-                std::size_t vertex = starting_vertex;
-                std::size_t edge = starting_edge;
-                ivec2 dir = tileset.vertices[starting_vertex] - tileset.vertices[pre_starting_vertex];
+        LoopId AddLoop(std::vector<EdgeRef> edges)
+        {
+            LoopId id = next_id++;
 
-                bool first = true;
+            Loop loop = EdgesToLoop(*tileset, edges);
+            auto it = loops.try_emplace(id, LoopEntry{.edges = std::move(edges), .loop = std::move(loop)}).first;
+            LinkLoop(id, it->second.edges);
+            return id;
+        }
+    };
 
-                while (true)
-                {
-                    bool finished = !first && tile_pos == starting_tile_pos && vertex == starting_vertex;
+    IncrementalConverter::IncrementalConverter() = default;
 
-                    params.output_vertex(tile_pos * params.tileset->tile_size + tileset.vertices[vertex], finished);
+    IncrementalConverter::IncrementalConverter(const TileSet &tileset, Array2D<std::size_t> tiles, ThreadPool *thread_pool)
+        : data(std::make_unique<Data>())
+    {
+        data->tileset = &tileset;
+        data->tiles = std::move(tiles);
+        data->free_edges = EdgeMask(tileset.edge_points.size(), ivec2(data->tiles.size()));
+        data->tile_loops = Array2D<std::vector<LoopId>>(data->tiles.size());
 
-                    // Remove the visited edge.
-                    if (!first)
-                    {
-                        auto loc = BitVec::BitLocation<bits_t>(edge);
-                        valid_edges[loc.index].safe_nonthrowing_at(tile_pos) &= ~loc.mask;
-                    }
+        ConvertToEdges(tileset, data->tiles, thread_pool, [&](const std::vector<EdgeRef> &edges)
+        {
+            data->AddLoop({edges.begin(), edges.end()});
+        });
+    }
 
-                    first = false;
+    IncrementalConverter::IncrementalConverter(IncrementalConverter &&) noexcept = default;
+    IncrementalConverter &IncrementalConverter::operator=(IncrementalConverter &&) noexcept = default;
+    IncrementalConverter::~IncrementalConverter() = default;
 
-                    if ( finished )
-                        break;
+    const Array2D<std::size_t> &IncrementalConverter::Tiles() const
+    {
+        return data->tiles;
+    }
 
-                    bool found_any = false;
-                    ivec2 best_tile_pos(0);
-                    std::size_t best_vertex = -1zu;
-                    std::size_t best_edge = -1zu;
-                    ivec2 best_dir(0);
+    void IncrementalConverter::SetTile(ivec2 pos, std::size_t tile)
+    {
+        if (!data->tiles.pos_in_range(pos))
+            throw std::runtime_error(FMT("Tile position {} is out of range. The map size is {}.", pos, data->tiles.size()));
+        ValidateTile(*data->tileset, pos, tile);
 
-                    for (int i = -1; i < 8; i++)
-                    {
-                        std::size_t next_vertex_a = i == -1 ? vertex : tileset.matching_vertices[vertex][i];
-                        if (i != -1 && next_vertex_a == -1zu)
-                            continue; // No matching vertex.
-                        ivec2 next_tile_pos = tile_pos + (i == -1 ? ivec2() : ivec2::dir8(i));
-                        if (i != -1 && ((next_tile_pos < 0).any() || (next_tile_pos >= params.tiles.size()).any()))
-                            continue; // Out of bounds.
+        std::size_t &cell = data->tiles.unsafe_at(pos);
+        if (cell == tile)
+            return;
+        cell = tile;
 
-                        std::size_t next_tile = params.tiles.safe_nonthrowing_at(next_tile_pos);
-                        std::size_t next_edge = tileset.edge_starting_at.safe_nonthrowing_at(xvec2(next_tile, next_vertex_a));
-                        if (next_edge == -1zu)
-                            continue; // No edge.
+        data->dirty_rect = data->have_dirty_rect ? data->dirty_rect.combine(pos) : pos.tiny_rect();
+        data->have_dirty_rect = true;
+    }
 
-                        if (auto loc = BitVec::BitLocation<bits_t>(next_edge); !(valid_edges[loc.index].safe_nonthrowing_at(next_tile_pos) & loc.mask))
-                            continue; // Already visited that edge.
+    IncrementalConverter::Changes IncrementalConverter::Update()
+    {
+        Changes ret;
+        if (!data->have_dirty_rect)
+            return ret;
 
-                        std::size_t next_vertex_b = params.tileset->edge_points[next_edge].second;
+        const TileSet &tileset = *data->tileset;
+        const irect2 bounds = ivec2().rect_size(ivec2(data->tiles.size()));
 
-                        ivec2 next_dir = tileset.vertices[next_vertex_b] - tileset.vertices[next_vertex_a];
+        // The edges can be cancelled out by the adjacent tiles, so they can change one tile away from the modified tiles.
+        const irect2 changed_edges_rect = data->dirty_rect.expand(1).intersect(bounds);
+        // The loop tracing looks at the adjacent tiles too, so the loops can change one more tile away.
+        const irect2 changed_loops_rect = data->dirty_rect.expand(2).intersect(bounds);
 
-                        if (!found_any || Math::less_positively_rotated(-dir, next_dir, best_dir))
-                        {
-                            found_any = true;
-                            best_tile_pos = next_tile_pos;
-                            best_vertex = next_vertex_b;
-                            best_edge = next_edge;
-                            best_dir = next_dir;
-                        }
-                    }
+        // The tiles that can have the edges of the new loops.
+        // A tile is added here before any of its edges are freed, so on failure we know where to clean up.
+        std::vector<ivec2> new_loop_tiles;
 
-                    if (!found_any)
-                        throw std::runtime_error(FMT("Edge loop unexpectedly ended at tile {} vertex {}.", tile_pos, vertex));
+        // Find the old loops to remove.
+        for (ivec2 pos : changed_loops_rect.a <= vector_range < changed_loops_rect.b)
+        {
+            const std::vector<LoopId> &list = data->tile_loops.unsafe_at(pos);
+            ret.removed.insert(ret.removed.end(), list.begin(), list.end());
+        }
+        std::sort(ret.removed.begin(), ret.removed.end());
+        ret.removed.erase(std::unique(ret.removed.begin(), ret.removed.end()), ret.removed.end());
+
+        // If the tracing fails (which normally means a broken tile set), put back the old loops and keep the modified tiles dirty,
+        // as if this function wasn't called.
+        const LoopId first_new_id = data->next_id;
+        std::map<LoopId, Data::LoopEntry> removed_loops;
+        FINALLY_ON_THROW
+        {
+            for (ivec2 pos : new_loop_tiles)
+            {
+                std::erase_if(data->tile_loops.unsafe_at(pos), [&](LoopId id){return id >= first_new_id;});
+                ForEachTileEdge(tileset, data->tiles.unsafe_at(pos), [&](std::size_t edge){data->free_edges.Set(pos, edge, false);});
+            }
+            data->loops.erase(data->loops.lower_bound(first_new_id), data->loops.end());
 
-                    tile_pos = best_tile_pos;
-                    vertex = best_vertex;
-                    edge = best_edge;
-                    dir = best_dir;
+            for (const auto &[id, entry] : removed_loops)
+                data->LinkLoop(id, entry.edges);
+            data->loops.merge(removed_loops);
+        };
+
+        // Remove the old loops, and free their edges.
+        for (LoopId id : ret.removed)
+        {
+            auto &entry = removed_loops.insert(data->loops.extract(id)).position->second;
+            data->UnlinkLoop(id, entry.edges);
+
+            for (const EdgeRef &ref : entry.edges)
+            {
+                // The edges in this rect are recomputed below.
+                if (!changed_edges_rect.contains(ref.tile_pos))
+                {
+                    new_loop_tiles.push_back(ref.tile_pos);
+                    data->free_edges.Set(ref.tile_pos, ref.edge, true);
                 }
             }
         }
+
+        // Recompute the edges near the modified tiles. All loops passing there were removed above, so all those edges are free.
+        for (ivec2 pos : changed_edges_rect.a <= vector_range < changed_edges_rect.b)
+        {
+            new_loop_tiles.push_back(pos);
+            AddTileEdges(tileset, data->tiles, pos, data->free_edges);
+        }
+
+        // Trace the new loops, in the same order as the full conversion.
+        std::sort(new_loop_tiles.begin(), new_loop_tiles.end(), [](ivec2 a, ivec2 b){return std::pair(a.y, a.x) < std::pair(b.y, b.x);});
+        new_loop_tiles.erase(std::unique(new_loop_tiles.begin(), new_loop_tiles.end()), new_loop_tiles.end());
+
+        std::vector<EdgeRef> buffer;
+        for (ivec2 pos : new_loop_tiles)
+        {
+            ForEachTileEdge(tileset, data->tiles.unsafe_at(pos), [&](std::size_t edge)
+            {
+                if (!data->free_edges.Get(pos, edge))
+                    return;
+                TraceLoop(tileset, data->tiles, data->free_edges, {.tile_pos = pos, .edge = edge}, buffer);
+                ret.added.push_back(data->AddLoop({buffer.begin(), buffer.end()}));
+            });
+        }
+
+        data->have_dirty_rect = false;
+        return ret;
+    }
+
+    const Loop &IncrementalConverter::GetLoop(LoopId id) const
+    {
+        auto it = data->loops.find(id);
+        if (it == data->loops.end())
+            throw std::runtime_error(FMT("There's no edge loop with id {}.", id));
+        return it->second.loop;
+    }
+
+    void IncrementalConverter::ForEachLoop(const std::function<void(LoopId id, const Loop &loop)> &func) const
+    {
+        for (const auto &[id, entry] : data->loops)
+            func(id, entry.loop);
+    }
+
+    std::size_t IncrementalConverter::NumLoops() const
+    {
+        return data->loops.size();
     }
 }
 
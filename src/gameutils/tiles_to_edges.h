@@ -2,13 +2,16 @@
 
 #include <array>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <map>
+#include <memory>
 #include <vector>
 
 #include "reflection/full.h"
 #include "utils/mat.h"
 #include "utils/multiarray.h"
+#include "utils/thread_pool.h"
 
 
 // Converts a tile map to multiple oriented edge lists, suitable for Box2D (or something else).
@@ -57,8 +60,8 @@ namespace GameUtils::TilesToEdges
         // Maps edge indices to pairs of vertex indices.
         std::vector<std::pair<std::size_t, std::size_t>> edge_points;
 
-        // Maps an edge and a 8-dir (4..7 only) to a symmetric edge that cancels out the original, or -1 if no such edge.
-        std::vector<std::array<std::size_t, 4>> symmetric_edges;
+        // Maps an edge and a 8-dir to a symmetric edge in the tile in that direction that cancels out the original, or -1 if no such edge.
+        std::vector<std::array<std::size_t, 8>> symmetric_edges;
     };
 
     using OutputCallback = std::function<void(ivec2 pos, bool last)>;
@@ -74,8 +77,72 @@ namespace GameUtils::TilesToEdges
         // The resulting edge vertices will be piped to this function.
         // Vertices form loops. `last == true` ends the loop, in that case `pos` will be the same as the first vertex in the loop.
         OutputCallback output_vertex;
+
+        // If not null, the map is split into horizontal bands, which are processed in parallel on this pool,
+        // and then the loops crossing the band borders are stitched together. The result is the same as without the pool.
+        ThreadPool *thread_pool = nullptr;
     };
 
     // Performs the tiles->edges conversion.
     void Convert(const Params &params);
+
+    // A closed edge loop. Unlike in `Params::output_vertex`, the first vertex is not repeated at the end.
+    using Loop = std::vector<ivec2>;
+
+    // Same as `Convert()`, but returns the loops instead of using `params.output_vertex` (which is ignored).
+    [[nodiscard]] std::vector<Loop> ConvertToLoops(const Params &params);
+
+    // Keeps the edge loops of a tile map up to date while the map changes, for editors or destructible terrain.
+    // After modifying some tiles, `Update()` re-traces only the loops near the modified tiles.
+    // The loops are normally the same as after a full conversion, but where several loops touch at a single vertex, they might be split differently.
+    // Usage:
+    //     GameUtils::TilesToEdges::IncrementalConverter converter(tileset, map);
+    //     converter.SetTile(ivec2(3, 4), 0);
+    //     auto changes = converter.Update();
+    //     for (auto id : changes.removed) ...
+    //     for (auto id : changes.added) ... converter.GetLoop(id) ...
+    class IncrementalConverter
+    {
+        struct Data;
+        std::unique_ptr<Data> data;
+
+      public:
+        // Unique for each loop. Never reused.
+        using LoopId = std::uint64_t;
+
+        struct Changes
+        {
+            // Sorted.
+            std::vector<LoopId> removed;
+            std::vector<LoopId> added;
+        };
+
+        // Constructs a null object.
+        IncrementalConverter();
+        // Performs the initial full conversion, see `Params::thread_pool`. The tile set must remain alive.
+        IncrementalConverter(const TileSet &tileset, Array2D<std::size_t> tiles, ThreadPool *thread_pool = nullptr);
+        IncrementalConverter(IncrementalConverter &&) noexcept;
+        IncrementalConverter &operator=(IncrementalConverter &&) noexcept;
+        ~IncrementalConverter();
+
+        [[nodiscard]] explicit operator bool() const {return bool(data);}
+
+        [[nodiscard]] const Array2D<std::size_t> &Tiles() const;
+
+        // Modifies a tile. The loops are not updated until `Update()`.
+        // Throws if the position or the tile index is out of range.
+        void SetTile(ivec2 pos, std::size_t tile);
+
+        // Re-traces the loops near the modified tiles, and returns the changes since the last call.
+        // If this throws (which can only happen with a broken tile set), the loops are left unchanged, and the modified tiles remain pending.
+        Changes Update();
+
+        // Throws if there's no loop with this id.
+        [[nodiscard]] const Loop &GetLoop(LoopId id) const;
+
+        // Calls `func` for all loops, ordered by id.
+        void ForEachLoop(const std::function<void(LoopId id, const Loop &loop)> &func) const;
+
+        [[nodiscard]] std::size_t NumLoops() const;
+    };
 }
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "graphics/image.h"
+#include "graphics/texture.h"
+#include "graphics/texture_atlas.h"
+#include "strings/format.h"
+#include "utils/mat.h"
+#include "utils/packing.h"
+
+namespace Graphics
+{
+    // A texture atlas that can be modified after it's created, without repacking it from scratch.
+    // Unlike `MakeAtlas()`, this is intended for images that are streamed in or hot-reloaded.
+    // The existing images never move, unless they're replaced with an image of a different size.
+    // Only the modified parts of the atlas are uploaded to the texture.
+    // Usage:
+    //     Graphics::DynamicAtlas atlas(ivec2(2048));
+    //     irect2 rect = atlas.Insert("foo", Graphics::Image("foo.png"));
+    //     // Or, decoding directly into the atlas:
+    //     Graphics::PngReader reader("bar.png");
+    //     atlas.Insert("bar", reader.Size(), [&](Graphics::Image &target, ivec2 pos){reader.ReadRegion(reader.Bounds(), target, pos);});
+    //     atlas.Upload(texture_unit);
+    class DynamicAtlas
+    {
+        Image image;
+        Packing::DynamicPacker packer;
+        std::map<std::string, irect2, std::less<>> entries;
+        std::vector<irect2> dirty_rects;
+        bool full_upload_needed = true;
+
+      public:
+        DynamicAtlas() {}
+
+        // The atlas starts empty and transparent.
+        DynamicAtlas(ivec2 size, AtlasFlags flags = AtlasFlags::none)
+            : image(size), packer(size, bool(flags & AtlasFlags::add_gaps))
+        {}
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return bool(image);
+        }
+
+        [[nodiscard]] ivec2 Size() const
+        {
+            return image.Size();
+        }
+
+        // Returns the CPU copy of the atlas.
+        [[nodiscard]] const Image &GetImage() const
+        {
+            return image;
+        }
+
+        // Returns the location of the image, or null if there's no such image.
+        // The pointer remains valid until the image is removed.
+        [[nodiscard]] const irect2 *Find(std::string_view name) const
+        {
+            auto it = entries.find(name);
+            if (it == entries.end())
+                return nullptr;
+            return &it->second;
+        }
+
+        // Adds an image to the atlas, or replaces an existing image with the same name. Returns its location.
+        // If the size of the image didn't change, it stays in place. Otherwise it's moved to a new place.
+        // Throws if there's not enough free space. In that case the atlas isn't modified.
+        irect2 Insert(const std::string &name, const Image &new_image)
+        {
+            if (!new_image)
+                throw std::runtime_error(FMT("Attempt to insert a null image `{}` into an atlas.", name));
+
+            return Insert(name, new_image.Size(), [&](Image &target, ivec2 pos)
+            {
+                target.UnsafeDrawImage(new_image, pos);
+            });
+        }
+
+        // Same, but instead of copying an existing image, calls `draw(atlas_image, pos)` to write an image of size `size` at `pos`.
+        // This allows decoding images directly into the atlas, e.g. with `PngReader::ReadRegion()`.
+        // If `draw` throws, the image is removed from the atlas, and the exception is propagated.
+        irect2 Insert(const std::string &name, ivec2 size, const std::function<void(Image &atlas_image, ivec2 pos)> &draw)
+        {
+            if (!(size > 0).all())
+                throw std::runtime_error(FMT("Attempt to insert an image `{}` of invalid size {}x{} into an atlas.", name, size.x, size.y));
+
+            auto it = entries.find(name);
+
+            irect2 rect;
+            if (it != entries.end() && it->second.size() == size)
+            {
+                // Overwrite in place.
+                rect = it->second;
+            }
+            else
+            {
+                std::optional<ivec2> pos = packer.Allocate(size);
+                if (it != entries.end())
+                {
+                    if (pos)
+                    {
+                        packer.Free(it->second.a, it->second.size());
+                    }
+                    else
+                    {
+                        // Try again after freeing the old image, and restore the old state if that doesn't help either.
+                        Packing::DynamicPacker old_packer = packer;
+                        packer.Free(it->second.a, it->second.size());
+                        pos = packer.Allocate(size);
+                        if (!pos)
+                            packer = std::move(old_packer);
+                    }
+                }
+                if (!pos)
+                    throw std::runtime_error(FMT("Not enough space in the {}x{} atlas for `{}` ({}x{}).", image.Size().x, image.Size().y, name, size.x, size.y));
+
+                rect = pos->rect_size(size);
+                if (it != entries.end())
+                    it->second = rect;
+                else
+                    entries.try_emplace(name, rect);
+            }
+
+            try
+            {
+                draw(image, rect.a);
+            }
+            catch (...)
+            {
+                Remove(name);
+                throw;
+            }
+
+            dirty_rects.push_back(rect);
+            return rect;
+        }
+
+        // Removes an image from the atlas, freeing its space. Returns false if there's no such image.
+        // The pixels are left as is and aren't reuploaded, since nothing should reference them anymore.
+        bool Remove(std::string_view name)
+        {
+            auto it = entries.find(name);
+            if (it == entries.end())
+                return false;
+
+            packer.Free(it->second.a, it->second.size());
+            entries.erase(it);
+            return true;
+        }
+
+        // Removes all images for which `keep(name)` returns false. Returns the number of removed images.
+        std::size_t Evict(std::function<bool(const std::string &name)> keep)
+        {
+            std::size_t ret = 0;
+            for (auto it = entries.begin(); it != entries.end();)
+            {
+                if (keep(it->first))
+                {
+                    it++;
+                    continue;
+                }
+
+                packer.Free(it->second.a, it->second.size());
+                it = entries.erase(it);
+                ret++;
+            }
+            return ret;
+        }
+
+        // Removes all images.
+        void Clear()
+        {
+            packer.Clear();
+            entries.clear();
+        }
+
+        // Uploads the changes to the texture attached to `unit`.
+        // The first call uploads the whole atlas, which also sets the texture size. After that, only the modified rectangles are uploaded.
+        void Upload(TexUnit &unit)
+        {
+            if (!full_upload_needed)
+            {
+                // If most of the atlas was modified, it's cheaper to upload it in one go.
+                std::int64_t dirty_area = 0;
+                for (const irect2 &rect : dirty_rects)
+                    dirty_area += std::int64_t(rect.size().prod());
+                if (dirty_area * 2 >= std::int64_t(image.Size().prod()))
+                    full_upload_needed = true;
+            }
+
+            if (full_upload_needed)
+            {
+                unit.SetData(image);
+                full_upload_needed = false;
+                dirty_rects.clear();
+                return;
+            }
+
+            for (const irect2 &rect : dirty_rects)
+            {
+                // Upload a copy of each rectangle, since `glTexSubImage2D()` can't handle a row stride without `GL_UNPACK_ROW_LENGTH`, which GLES2 lacks.
+                Image region = image.UnsafeGetRegion(rect);
+                unit.SetDataPart(rect.a, rect.size(), region.Data());
+            }
+            dirty_rects.clear();
+        }
+    };
+}
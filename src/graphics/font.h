@@ -1,5 +1,9 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <cstdint>
 #include <functional>
 #include <unordered_map>
 #include <utility>
@@ -19,7 +23,31 @@ namespace Graphics
             int advance = 0;
         };
 
+        // The glyphs with codes below this are stored in a flat array, rather than in a hash map.
+        static constexpr std::uint32_t num_dense_glyphs = 256;
+
       private:
+        // A process-wide unique number, replaced whenever the font is modified or assigned to. See `Generation()`.
+        struct GenerationNumber
+        {
+            std::uint64_t value = Next();
+
+            GenerationNumber() {}
+            GenerationNumber(const GenerationNumber &) {}
+            GenerationNumber &operator=(const GenerationNumber &)
+            {
+                value = Next();
+                return *this;
+            }
+
+            [[nodiscard]] static std::uint64_t Next()
+            {
+                static std::atomic<std::uint64_t> counter = 0;
+                return ++counter;
+            }
+        };
+        GenerationNumber generation;
+
         int ascent = 0;
         int descent = 0;
         int line_skip = 0;
@@ -27,27 +55,67 @@ namespace Graphics
         using kerning_func_t = std::function<int(uint32_t, uint32_t)>;
         kerning_func_t kerning_func = 0;
 
-        // Some code might rely on references not being invalidated on insertion. Keep that in mind if you decide to change the container.
-        std::unordered_map<uint32_t, Glyph> glyphs;
+        // Called by `Get()` for the glyphs that aren't in `glyphs`. Returns null if there's no such glyph.
+        using glyph_loader_func_t = std::function<const Glyph *(uint32_t)>;
+        glyph_loader_func_t glyph_loader = 0;
+
+        // If not empty, this is used instead of `kerning_func`. See `KerningPairKey()` for the key format.
+        std::unordered_map<std::uint64_t, int> kerning_pairs;
+
+        // Some code might rely on references not being invalidated on insertion. Keep that in mind if you decide to change the containers.
+        std::array<Glyph, num_dense_glyphs> dense_glyphs;
+        std::bitset<num_dense_glyphs> dense_glyphs_present;
+        std::unordered_map<uint32_t, Glyph> glyphs; // The glyphs that don't fit into `dense_glyphs`.
         Glyph default_glyph;
 
+        // Call this before any modification.
+        void Modified()
+        {
+            generation.value = GenerationNumber::Next();
+        }
+
       public:
+        // Changes every time the font is modified (with any non-const function, including the ones that return non-const references) or assigned to.
+        // No two fonts share a generation, even at the same address. This lets you cache the data computed from a font, see `Render::CachedText`.
+        [[nodiscard]] std::uint64_t Generation() const
+        {
+            return generation.value;
+        }
+
         void SetAscent(int new_ascent)
         {
+            Modified();
             ascent = new_ascent;
         }
         void SetDescent(int new_descent)
         {
+            Modified();
             descent = new_descent;
         }
         void SetLineSkip(int new_line_skip)
         {
+            Modified();
             line_skip = new_line_skip;
         }
         void SetKerningFunc(kerning_func_t new_kerning_func) // You can use null function if you don't want kerning.
         {
+            Modified();
             kerning_func = std::move(new_kerning_func);
         }
+        // Sets precomputed kerning, see `FontFile::KerningPairs()`. The pairs missing from the map have no kerning.
+        // If the map is not empty, it's used instead of the kerning function.
+        void SetKerningPairs(std::unordered_map<std::uint64_t, int> new_kerning_pairs)
+        {
+            Modified();
+            kerning_pairs = std::move(new_kerning_pairs);
+        }
+
+        // Sets a function that provides the glyphs missing from this font on demand, see `GlyphCache`. You can use null function to disable this.
+        void SetGlyphLoader(glyph_loader_func_t new_glyph_loader)
+        {
+            Modified();
+            glyph_loader = std::move(new_glyph_loader);
+        }
 
         int Ascent() const
         {
@@ -76,18 +144,29 @@ namespace Graphics
         }
         bool HasKerning() const
         {
-            return bool(kerning_func);
+            return kerning_pairs.size() > 0 || bool(kerning_func);
         }
         int Kerning(uint32_t a, uint32_t b) const
         {
+            if (kerning_pairs.size() > 0)
+            {
+                if (auto it = kerning_pairs.find(KerningPairKey(a, b)); it != kerning_pairs.end())
+                    return it->second;
+                return 0;
+            }
             if (kerning_func)
                 return kerning_func(a, b);
-            else
-                return 0;
+            return 0;
+        }
+
+        [[nodiscard]] static constexpr std::uint64_t KerningPairKey(std::uint32_t a, std::uint32_t b)
+        {
+            return std::uint64_t(a) << 32 | b;
         }
 
         Glyph &DefaultGlyph()
         {
+            Modified();
             return default_glyph;
         }
         const Glyph &DefaultGlyph() const
@@ -96,22 +175,46 @@ namespace Graphics
         }
 
         // Note that returned references remain valid even after insertions.
+        // The glyphs returned by the glyph loader are an exception, they might be evicted later, see `GlyphCache` for details.
         const Glyph &Get(uint32_t ch) const
         {
-            if (auto it = glyphs.find(ch); it != glyphs.end())
+            if (ch < num_dense_glyphs)
+            {
+                if (dense_glyphs_present[ch])
+                    return dense_glyphs[ch];
+            }
+            else if (auto it = glyphs.find(ch); it != glyphs.end())
+            {
                 return it->second;
-            else
-                return default_glyph;
+            }
+            if (glyph_loader)
+            {
+                if (const Glyph *glyph = glyph_loader(ch))
+                    return *glyph;
+            }
+            return default_glyph;
         }
         // If the glyph already exists, returns a reference to it instead of creating a new one.
         Glyph &Insert(uint32_t ch)
         {
+            Modified();
+            if (ch < num_dense_glyphs)
+            {
+                dense_glyphs_present[ch] = true;
+                return dense_glyphs[ch];
+            }
             return glyphs.insert({ch, {}}).first->second;
         }
 
         // Offset all regions by this amount.
         void Offset(ivec2 offset)
         {
+            Modified();
+            for (std::uint32_t ch = 0; ch < num_dense_glyphs; ch++)
+            {
+                if (dense_glyphs_present[ch])
+                    dense_glyphs[ch].texture_pos += offset;
+            }
             for (auto &[code, glyph] : glyphs)
                 glyph.texture_pos += offset;
         }
@@ -1,15 +1,21 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
 #include <functional>
 #include <exception>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include <ft2build.h>
 #include FT_FREETYPE_H // Ugh.
+#include FT_TRUETYPE_TABLES_H
+#include FT_TRUETYPE_TAGS_H
 
 #include "graphics/font.h"
 #include "graphics/image.h"
+#include "graphics/image_kernels.h"
 #include "macros/enum_flag_operators.h"
 #include "macros/finally.h"
 #include "stream/readonly_data.h"
@@ -38,6 +44,53 @@ namespace Graphics
 
         Data data;
 
+        // Calls `func(FT_UInt a, FT_UInt b)` for each pair of glyph indices listed in the `kern` table, possibly with duplicates.
+        // Only the subtables that FreeType uses for `FT_Get_Kerning()` are considered (horizontal, format 0), and broken sizes are handled the same way it does.
+        template <typename F>
+        void ForEachKerningTablePair(F &&func) const
+        {
+            FT_ULong length = 0;
+            if (FT_Load_Sfnt_Table(data.ft_font, TTAG_kern, 0, nullptr, &length) || length == 0)
+                return;
+            std::vector<FT_Byte> table(length);
+            if (FT_Load_Sfnt_Table(data.ft_font, TTAG_kern, 0, table.data(), &length))
+                return;
+
+            auto ReadU16 = [&](std::size_t pos) -> unsigned int
+            {
+                return table[pos] << 8 | table[pos + 1];
+            };
+
+            if (table.size() < 4)
+                return;
+
+            std::size_t num_subtables = std::min(ReadU16(2), 32u); // FreeType ignores the subtables past the first 32.
+            std::size_t pos = 4;
+            for (std::size_t i = 0; i < num_subtables; i++)
+            {
+                if (pos + 6 > table.size())
+                    break;
+                std::size_t subtable_length = ReadU16(pos + 2);
+                unsigned int coverage = ReadU16(pos + 4);
+                if (subtable_length <= 6 + 8)
+                    break;
+                std::size_t subtable_end = std::min(pos + subtable_length, table.size());
+
+                // Horizontal, not minimum values, format 0.
+                if ((coverage & 3) == 1 && (coverage >> 8) == 0 && pos + 6 + 8 <= subtable_end)
+                {
+                    std::size_t num_pairs = std::min(std::size_t(ReadU16(pos + 6)), (subtable_end - pos - 6 - 8) / 6);
+                    for (std::size_t j = 0; j < num_pairs; j++)
+                    {
+                        std::size_t pair_pos = pos + 6 + 8 + j * 6;
+                        func(FT_UInt(ReadU16(pair_pos)), FT_UInt(ReadU16(pair_pos + 2)));
+                    }
+                }
+
+                pos = subtable_end;
+            }
+        }
+
       public:
         FontFile() {}
 
@@ -185,6 +238,94 @@ namespace Graphics
             };
         }
 
+        // Returns true if the font has kerning, and it's stored in a TrueType `kern` table.
+        // Then `KerningPairs()` reads the pairs from the table, instead of trying every pair of characters.
+        bool HasKerningTable() const
+        {
+            // FreeType only supports kerning from the `kern` table for SFNT-based fonts (TrueType and OpenType).
+            return HasKerning() && FT_IS_SFNT(data.ft_font);
+        }
+
+        // Returns all characters that have glyphs in the font.
+        std::vector<uint32_t> Chars() const
+        {
+            std::vector<uint32_t> ret;
+            FT_UInt index = 0;
+            for (FT_ULong ch = FT_Get_First_Char(data.ft_font, &index); index != 0; ch = FT_Get_Next_Char(data.ft_font, ch, &index))
+                ret.push_back(uint32_t(ch));
+            return ret;
+        }
+
+        // Precomputes kerning for all pairs of `chars`, to avoid calling FreeType when laying out the text. Only non-zero values are stored.
+        // The result is intended for `Font::SetKerningPairs()`.
+        // If `HasKerningTable()` is true, this is linear in the size of the table and the number of characters. Otherwise it's quadratic in the number of characters.
+        std::unordered_map<std::uint64_t, int> KerningPairs(const std::vector<uint32_t> &chars) const
+        {
+            std::unordered_map<std::uint64_t, int> ret;
+            if (!HasKerning())
+                return ret;
+
+            auto AddPair = [&](uint32_t a, FT_UInt a_index, uint32_t b, FT_UInt b_index)
+            {
+                FT_Vector vec;
+                if (FT_Get_Kerning(data.ft_font, a_index, b_index, FT_KERNING_DEFAULT, &vec))
+                    return;
+                int value = (vec.x + (1 << 5)) >> 6; // See `Kerning()` for why we bit-shift.
+                if (value != 0)
+                    ret.try_emplace(Font::KerningPairKey(a, b), value);
+            };
+
+            if (HasKerningTable())
+            {
+                // Glyph indices and the respective characters, sorted by index. Several characters can share a glyph.
+                std::vector<std::pair<FT_UInt, uint32_t>> glyph_chars;
+                glyph_chars.reserve(chars.size());
+                for (uint32_t ch : chars)
+                {
+                    if (FT_UInt index = FT_Get_Char_Index(data.ft_font, ch))
+                        glyph_chars.emplace_back(index, ch);
+                }
+                std::sort(glyph_chars.begin(), glyph_chars.end());
+
+                auto CharsForGlyph = [&](FT_UInt index)
+                {
+                    return std::equal_range(glyph_chars.begin(), glyph_chars.end(), std::pair<FT_UInt, uint32_t>(index, 0), [](const auto &a, const auto &b){return a.first < b.first;});
+                };
+
+                ForEachKerningTablePair([&](FT_UInt a_index, FT_UInt b_index)
+                {
+                    auto [a_begin, a_end] = CharsForGlyph(a_index);
+                    if (a_begin == a_end)
+                        return;
+                    auto [b_begin, b_end] = CharsForGlyph(b_index);
+                    for (auto a = a_begin; a != a_end; a++)
+                    for (auto b = b_begin; b != b_end; b++)
+                        AddPair(a->second, a_index, b->second, b_index);
+                });
+
+                return ret;
+            }
+
+            std::vector<FT_UInt> indices;
+            indices.reserve(chars.size());
+            for (uint32_t ch : chars)
+                indices.push_back(FT_Get_Char_Index(data.ft_font, ch));
+
+            for (std::size_t a = 0; a < chars.size(); a++)
+            {
+                if (!indices[a])
+                    continue;
+
+                for (std::size_t b = 0; b < chars.size(); b++)
+                {
+                    if (indices[b])
+                        AddPair(chars[a], indices[a], chars[b], indices[b]);
+                }
+            }
+
+            return ret;
+        }
+
         // This always returns `true` for 0xFFFD `Unicode::default_char`, since freetype itself seems to able to draw it if it's not included in the font.
         bool HasGlyph(uint32_t ch) const
         {
@@ -274,8 +415,7 @@ namespace Graphics
                 if (is_antialiased)
                 {
                     for (int y = 0; y < size.y; y++)
-                    for (int x = 0; x < size.x; x++)
-                        ret.image.UnsafeAt(ivec2(x,y)) = u8vec3(255).to_vec4(bitmap.buffer[bitmap.pitch * y + x]);
+                        ImageKernels::AlphaToWhite(bitmap.buffer + bitmap.pitch * y, &ret.image.UnsafeAt(ivec2(0,y)), size.x);
                 }
                 else
                 {
@@ -313,6 +453,10 @@ namespace Graphics
         IMP_ENUM_FLAG_OPERATORS_IN_CLASS(Flags)
         using enum Flags;
 
+        // If an entry has more glyphs than this and its font has no `kern` table (see `FontFile::HasKerningTable()`),
+        // its kerning isn't precomputed, and FreeType is called for every pair during the text layout.
+        static constexpr std::size_t max_precomputed_kerning_glyphs = 512;
+
         Font *target = 0;
         const FontFile *source = 0;
         const Unicode::CharSet *glyphs = 0;
@@ -344,12 +488,15 @@ namespace Graphics
             entry.target->SetAscent(entry.source->Ascent());
             entry.target->SetDescent(entry.source->Descent());
             entry.target->SetLineSkip(bool(entry.flags & entry.no_line_gap) ? entry.source->Height() : entry.source->LineSkip());
-            entry.target->SetKerningFunc(entry.source->KerningFunc());
+
+            std::vector<uint32_t> chars; // Excluding the default glyph.
 
             auto AddGlyph = [&](uint32_t ch)
             {
                 if (!entry.source->HasGlyph(ch))
                     return;
+                if (ch != Unicode::default_char)
+                    chars.push_back(ch);
 
                 // Copy glyph to the font.
                 FontFile::GlyphData glyph_data = entry.source->GetGlyph(ch, entry.render_flags);
@@ -372,6 +519,18 @@ namespace Graphics
             // Save the rest of the glyphs.
             for (uint32_t ch : *entry.glyphs)
                 AddGlyph(ch);
+
+            // Save kerning. Without a `kern` table precomputing it is quadratic, so then we only do it for reasonably small sets of glyphs.
+            if (entry.source->HasKerningTable() || chars.size() <= entry.max_precomputed_kerning_glyphs)
+            {
+                entry.target->SetKerningPairs(entry.source->KerningPairs(chars));
+                entry.target->SetKerningFunc(0);
+            }
+            else
+            {
+                entry.target->SetKerningPairs({});
+                entry.target->SetKerningFunc(entry.source->KerningFunc());
+            }
         }
 
         // Pack rectangles.
@@ -1,17 +1,23 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <map>
+#include <memory>
+#include <set>
+#include <stdexcept>
 #include <string_view>
 #include <string>
 #include <vector>
 
+#include "graphics/dynamic_atlas.h"
 #include "graphics/image.h"
 #include "graphics/texture_atlas.h"
 #include "graphics/texture.h"
 #include "macros/enum_flag_operators.h"
 #include "meta/const_string.h"
 #include "stream/readonly_data.h"
+#include "utils/hash.h"
 #include "utils/mat.h"
 
 namespace Graphics
@@ -39,7 +45,11 @@ namespace Graphics::GlobalData
     {
         TexObject texture;
         ivec2 size; // Since `image` can be null, and the texture doesn't remember its size, we also store it here.
-        Image image; // Normally null, unless `Flags::keep_images` is used.
+        Image image; // Normally null, unless `Flags::keep_images` is used. Always null with `Flags::dynamic`, use `dynamic.GetImage()` instead.
+
+        // Those are only used with `Flags::dynamic`.
+        DynamicAtlas dynamic;
+        std::map<std::string, std::uint64_t, std::less<>> image_hashes; // The hashes of the image files, to skip the unchanged ones when reloading.
     };
 
     using AtlasMap = std::map<std::string, Atlas, std::less<>>;
@@ -113,6 +123,10 @@ namespace Graphics::GlobalData
         none = 0,
         keep_image = 1 << 0, // Preserve the generate image (in RAM, in addition to the texture).
         no_texture = 1 << 1, // Only load the image, don't generate a texture. Implies `keep_image`.
+        // Pack the atlas incrementally using `DynamicAtlas`, which is kept in RAM. Calling `Load()` again then only decodes the images
+        // whose files changed (the others stay in place), and only uploads the changed parts of the texture. Useful for hot-reloading.
+        // The atlas is not cached (`LoadParams::cache_prefix` is ignored), and `AtlasParams::modify_image` can't be used.
+        dynamic = 1 << 2,
     };
     IMP_ENUM_FLAG_OPERATORS(Flags)
     using enum Flags;
@@ -138,6 +152,10 @@ namespace Graphics::GlobalData
         std::function<std::string(const std::string &name)> name_to_atlas; // Optional, maps images to atlases. Assumed to return an empty string by default, putting all images into a single atlas.
         std::function<AtlasParams(const std::string &atlas)> atlas_params; // Optional, returns per-atlas parameters. Returns default-constructed parameters by default.
 
+        // Optional. If not empty, each atlas is cached in a file named `cache_prefix + atlas_name + ".atlas"`, see `MakeAtlasCached()`.
+        // If the images didn't change since the last launch, this skips decoding and packing them.
+        std::string cache_prefix;
+
         LoadParams() {}
 
         // Constructs the minimal viable parameters.
@@ -153,17 +171,76 @@ namespace Graphics::GlobalData
         }
     };
 
+    namespace impl
+    {
+        // Loads the images of a `Flags::dynamic` atlas. The first call inserts all images.
+        // The next calls only decode the images whose files changed, and regenerate the generated ones.
+        inline void LoadDynamicAtlas(Atlas &atlas, const std::vector<State::RegionPair *> &regions, const LoadParams &params, const AtlasParams &atlas_params, TexUnit &tex_unit)
+        {
+            if (atlas_params.modify_image)
+                throw std::runtime_error("`modify_image` can't be used with dynamic atlases.");
+
+            bool new_atlas = !atlas.dynamic || atlas.dynamic.Size() != atlas_params.size;
+            if (new_atlas)
+            {
+                atlas = {};
+                atlas.dynamic = DynamicAtlas(atlas_params.size, atlas_params.atlas_flags);
+            }
+
+            // Remove the images that are no longer in this atlas.
+            std::set<std::string_view> names;
+            for (State::RegionPair *pair : regions)
+                names.insert(pair->first);
+            atlas.dynamic.Evict([&](const std::string &name){return names.contains(name);});
+            std::erase_if(atlas.image_hashes, [&](const auto &elem){return !names.contains(elem.first);});
+
+            for (State::RegionPair *pair : regions)
+            {
+                if (pair->second.make_generator)
+                {
+                    std::unique_ptr<Generator> generator = pair->second.make_generator();
+                    ivec2 size = generator->Size();
+                    pair->second.region = atlas.dynamic.Insert(pair->first, size, [&](Graphics::Image &target, ivec2 pos){generator->Generate(target, pos.rect_size(size));});
+                    continue;
+                }
+
+                Stream::ReadOnlyData data = params.get_data(pair->first);
+                std::uint64_t hash = Hash::Stable{}.AppendBytes(data.data(), data.size()).Result();
+                auto it = atlas.image_hashes.find(pair->first);
+                if (it != atlas.image_hashes.end() && it->second == hash)
+                    continue; // Unchanged, and stays in place.
+
+                pair->second.region = atlas.dynamic.Insert(pair->first, Graphics::Image(std::move(data)));
+                atlas.image_hashes.insert_or_assign(pair->first, hash);
+            }
+
+            atlas.size = atlas.dynamic.Size();
+
+            if (!bool(atlas_params.flags & Flags::no_texture))
+            {
+                // The first upload sets the texture size, and the later ones only upload the changed parts.
+                if (new_atlas)
+                    atlas.texture = nullptr;
+                tex_unit.Attach(atlas.texture);
+                atlas.dynamic.Upload(tex_unit);
+                if (new_atlas)
+                    tex_unit.Wrap(atlas_params.texture_wrap).Interpolation(atlas_params.texture_interpolation);
+            }
+        }
+    }
+
     // Loads all images mentioned in `Image()` calls into atlases.
+    // Calling this again reloads them. The atlases with `Flags::dynamic` are updated incrementally, and the rest are rebuilt from scratch.
     inline void Load(const LoadParams &params)
     {
-        // In case the list of atlases changes.
-        impl::GetState().atlases.clear();
-
         // Group the regions by atlases.
         std::map<std::string, std::vector<impl::State::RegionPair *>, std::less<>> regions_per_atlas;
         for (auto &elem : impl::GetState().regions)
             regions_per_atlas[params.name_to_atlas ? params.name_to_atlas(elem.first) : std::string{}].push_back(&elem);
 
+        // In case the list of atlases changes.
+        std::erase_if(impl::GetState().atlases, [&](const auto &elem){return !regions_per_atlas.contains(elem.first);});
+
         TexUnit tex_unit = nullptr; // We need this to upload images to textures.
 
         // For each atlas...
@@ -175,6 +252,15 @@ namespace Graphics::GlobalData
             if (params.atlas_params)
                 atlas_params = params.atlas_params(atlas_name);
 
+            if (bool(atlas_params.flags & Flags::dynamic))
+            {
+                impl::LoadDynamicAtlas(atlas, regions, params, atlas_params, tex_unit);
+                continue;
+            }
+
+            // Non-dynamic atlases are rebuilt from scratch.
+            atlas = {};
+
             struct GeneratedImage
             {
                 std::unique_ptr<Generator> generator;
@@ -183,7 +269,7 @@ namespace Graphics::GlobalData
             std::vector<GeneratedImage> generated_images;
 
             // Generate the atlas.
-            atlas.image = MakeAtlas(atlas_params.size, [&, &regions = regions](AtlasInputFunc func)
+            auto add_images = [&, &regions = regions](AtlasInputFunc func)
             {
                 for (impl::State::RegionPair *pair : regions)
                 {
@@ -199,9 +285,14 @@ namespace Graphics::GlobalData
                         func(params.get_data(pair->first), pair->second.region);
                     }
                 }
-            }, atlas_params.atlas_flags);
+            };
+            if (params.cache_prefix.empty())
+                atlas.image = MakeAtlas(atlas_params.size, add_images, atlas_params.atlas_flags);
+            else
+                atlas.image = MakeAtlasCached(params.cache_prefix + atlas_name + ".atlas", atlas_params.size, add_images, atlas_params.atlas_flags);
 
             // Insert the custom images into the atlas, if any.
+            // This is done even if the atlas was loaded from the cache, since the cache doesn't store those.
             for (GeneratedImage &generated : generated_images)
                 generated.generator->Generate(atlas.image, generated.region->second.region);
             generated_images.clear();
@@ -0,0 +1,371 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "graphics/font.h"
+#include "graphics/font_file.h"
+#include "graphics/image.h"
+#include "graphics/texture.h"
+#include "utils/mat.h"
+
+namespace Graphics
+{
+    // Rasterizes the glyphs of a `Font` on the first use, instead of rasterizing a whole character set up front like `MakeFontAtlas()`.
+    // This is intended for large character sets (such as CJK), where only a small fraction of glyphs is ever displayed.
+    // The glyphs are stored in a rectangular region of a texture (a "page"), packed into shelves, which are rows of glyphs of similar height.
+    // When the page is full, the least recently used glyphs are evicted, except those used since the last `NextFrame()` call.
+    // If that's not enough, the default glyph is used instead.
+    // Since the texture space of the evicted glyphs is reused, the `Text` objects using this font should be rebuilt every frame.
+    // Usage:
+    //     Graphics::GlyphCache cache(font, font_file, texture_rect); // Then use `font` as usual.
+    //     // Each frame, after building the text and before rendering it:
+    //     cache.Upload(texture_unit);
+    //     cache.NextFrame();
+    class GlyphCache
+    {
+        struct Slot
+        {
+            int shelf_y = -1; // If this is negative, the glyph is empty and doesn't occupy any space.
+            int x = 0;
+            int width = 0; // Includes the gap.
+        };
+
+        struct Shelf
+        {
+            int height = 0; // Includes the gap.
+            int used_width = 0;
+            std::vector<Slot> free_slots;
+        };
+
+        struct Entry
+        {
+            Font::Glyph glyph;
+            Slot slot;
+            std::uint64_t last_used_frame = 0;
+            std::list<std::uint32_t>::iterator lru_iter;
+        };
+
+        struct Data
+        {
+            Font *target = nullptr;
+            const FontFile *source = nullptr;
+            FontFile::RenderFlags render_flags = FontFile::none;
+
+            irect2 rect;
+            int gap = 0;
+            Image page; // A copy of the texture region.
+            std::vector<irect2> dirty_rects; // Relative to `page`.
+            bool full_upload_needed = true;
+
+            std::map<int, Shelf> shelves; // The keys are Y coordinates. The shelves are always adjacent to each other, starting from Y = 0.
+
+            std::unordered_map<std::uint32_t, Entry> entries;
+            std::unordered_set<std::uint32_t> missing_glyphs;
+            std::list<std::uint32_t> lru_list; // Most recently used glyphs first. Doesn't include the default glyph.
+            std::uint64_t frame = 1;
+
+            [[nodiscard]] int ShelvesHeight() const
+            {
+                return shelves.empty() ? 0 : shelves.rbegin()->first + shelves.rbegin()->second.height;
+            }
+
+            // Returns null if there's no space left.
+            std::optional<Slot> Allocate(ivec2 size)
+            {
+                ivec2 box_size = rect.size() + gap; // The gaps of the rightmost and bottommost glyphs can go past the edge.
+                if ((size > box_size).any())
+                    return {};
+
+                // Find the shortest shelf that has enough space, preferring the previously freed slots over appending to the shelf.
+                auto best_shelf = shelves.end();
+                int best_free_slot = -1;
+                for (auto it = shelves.begin(); it != shelves.end(); it++)
+                {
+                    const Shelf &shelf = it->second;
+                    if (shelf.height < size.y || (best_shelf != shelves.end() && shelf.height >= best_shelf->second.height))
+                        continue;
+
+                    int free_slot = -1;
+                    for (int i = 0; i < int(shelf.free_slots.size()); i++)
+                    {
+                        if (shelf.free_slots[i].width >= size.x && (free_slot == -1 || shelf.free_slots[i].width < shelf.free_slots[free_slot].width))
+                            free_slot = i;
+                    }
+
+                    if (free_slot != -1 || shelf.used_width + size.x <= box_size.x)
+                    {
+                        best_shelf = it;
+                        best_free_slot = free_slot;
+                    }
+                }
+
+                // Start a new shelf if there's no suitable one, or if the best one is too tall for this glyph.
+                if (best_shelf == shelves.end() || best_shelf->second.height > size.y * 2)
+                {
+                    if (int y = ShelvesHeight(); y + size.y <= box_size.y)
+                    {
+                        best_shelf = shelves.try_emplace(y).first;
+                        best_shelf->second.height = size.y;
+                        best_free_slot = -1;
+                    }
+                }
+
+                // Otherwise try to merge several adjacent empty shelves into one.
+                if (best_shelf == shelves.end())
+                {
+                    for (auto it = shelves.begin(); it != shelves.end(); it++)
+                    {
+                        int run_height = 0;
+                        auto run_end = it;
+                        while (run_end != shelves.end() && run_end->second.used_width == 0 && run_height < size.y)
+                        {
+                            run_height += run_end->second.height;
+                            run_end++;
+                        }
+                        if (run_height < size.y)
+                            continue;
+
+                        int y = it->first;
+                        shelves.erase(it, run_end);
+                        best_shelf = shelves.try_emplace(y).first;
+                        best_shelf->second.height = size.y;
+                        best_free_slot = -1;
+                        if (run_height > size.y)
+                            shelves.try_emplace(y + size.y).first->second.height = run_height - size.y;
+                        break;
+                    }
+                }
+
+                if (best_shelf == shelves.end())
+                    return {};
+
+                Shelf &shelf = best_shelf->second;
+                if (best_free_slot != -1)
+                {
+                    Slot ret = shelf.free_slots[best_free_slot];
+                    shelf.free_slots.erase(shelf.free_slots.begin() + best_free_slot);
+                    return ret;
+                }
+
+                Slot ret{.shelf_y = best_shelf->first, .x = shelf.used_width, .width = size.x};
+                shelf.used_width += size.x;
+                return ret;
+            }
+
+            void Free(const Slot &slot)
+            {
+                if (slot.shelf_y < 0)
+                    return;
+
+                Shelf &shelf = shelves.at(slot.shelf_y);
+                shelf.free_slots.push_back(slot);
+
+                // Give the free slots at the end of the shelf back to it, so they can be reused for wider glyphs.
+                bool found = true;
+                while (found)
+                {
+                    found = false;
+                    for (std::size_t i = 0; i < shelf.free_slots.size(); i++)
+                    {
+                        if (shelf.free_slots[i].x + shelf.free_slots[i].width == shelf.used_width)
+                        {
+                            shelf.used_width = shelf.free_slots[i].x;
+                            shelf.free_slots.erase(shelf.free_slots.begin() + i);
+                            found = true;
+                            break;
+                        }
+                    }
+                }
+
+                // Remove the empty shelves at the top, to let new shelves of any height use that space.
+                while (!shelves.empty() && shelves.rbegin()->second.used_width == 0)
+                    shelves.erase(std::prev(shelves.end()));
+            }
+
+            // Returns the area of the page occupied by the slot, excluding the gaps that are past the page edge.
+            [[nodiscard]] irect2 SlotRect(const Slot &slot) const
+            {
+                irect2 ret = ivec2(slot.x, slot.shelf_y).rect_size(ivec2(slot.width, shelves.at(slot.shelf_y).height));
+                ret.b = min(ret.b, page.Size());
+                return ret;
+            }
+
+            // Rasterizes a glyph and puts it on the page. Returns false if there's not enough space even after evicting the unused glyphs.
+            bool Rasterize(std::uint32_t ch, Font::Glyph &glyph, Slot &slot)
+            {
+                FontFile::GlyphData glyph_data = source->GetGlyph(ch, render_flags);
+                glyph.size = glyph_data.image.Size();
+                glyph.offset = glyph_data.offset;
+                glyph.advance = glyph_data.advance;
+
+                slot = {};
+                if (!glyph_data.image)
+                    return true;
+
+                std::optional<Slot> new_slot;
+                while (!(new_slot = Allocate(glyph.size + gap)))
+                {
+                    if (lru_list.empty())
+                        return false;
+                    auto it = entries.find(lru_list.back());
+                    if (it->second.last_used_frame == frame)
+                        return false; // Everything on the page is used in this frame.
+                    Free(it->second.slot);
+                    lru_list.pop_back();
+                    entries.erase(it);
+                }
+                slot = *new_slot;
+
+                // Clear the whole slot, since it might be larger than the glyph, and contain leftovers from another glyph.
+                irect2 slot_rect = SlotRect(slot);
+                page.UnsafeFill(slot_rect, u8vec4(0));
+                page.UnsafeDrawImage(glyph_data.image, slot_rect.a);
+                dirty_rects.push_back(slot_rect);
+
+                glyph.texture_pos = rect.a + slot_rect.a;
+                return true;
+            }
+
+            const Font::Glyph *Load(std::uint32_t ch)
+            {
+                if (auto it = entries.find(ch); it != entries.end())
+                {
+                    // Move to the front of the LRU list.
+                    it->second.last_used_frame = frame;
+                    lru_list.splice(lru_list.begin(), lru_list, it->second.lru_iter);
+                    return &it->second.glyph;
+                }
+
+                if (missing_glyphs.contains(ch))
+                    return nullptr;
+                if (!source->HasGlyph(ch))
+                {
+                    missing_glyphs.insert(ch);
+                    return nullptr;
+                }
+
+                Entry entry;
+                if (!Rasterize(ch, entry.glyph, entry.slot))
+                    return nullptr; // Not remembering this as missing, since there might be space for it in the next frame.
+
+                entry.last_used_frame = frame;
+                lru_list.push_front(ch);
+                entry.lru_iter = lru_list.begin();
+                return &entries.try_emplace(ch, std::move(entry)).first->second.glyph;
+            }
+        };
+
+        std::unique_ptr<Data> data;
+
+      public:
+        GlyphCache() {}
+
+        // Sets the metrics and kerning of `target`, and makes it load the glyphs from `source` on demand. Both must outlive this object.
+        // `rect` is the texture region that will contain the glyphs. The glyphs already inserted into `target` remain as is.
+        // The default glyph is rasterized immediately, and is never evicted. Throws if it doesn't fit.
+        GlyphCache(Font &target, const FontFile &source, irect2 rect, FontFile::RenderFlags render_flags = FontFile::none, FontAtlasEntry::Flags flags = FontAtlasEntry::none, bool add_gaps = true)
+            : data(std::make_unique<Data>())
+        {
+            if (!rect.has_area())
+                throw std::runtime_error("Invalid target rectangle for a glyph cache.");
+
+            data->target = &target;
+            data->source = &source;
+            data->render_flags = render_flags;
+            data->rect = rect;
+            data->gap = add_gaps;
+            data->page = Image(rect.size());
+
+            target.SetAscent(source.Ascent());
+            target.SetDescent(source.Descent());
+            target.SetLineSkip(bool(flags & FontAtlasEntry::no_line_gap) ? source.Height() : source.LineSkip());
+
+            // We don't know in advance which glyphs will be loaded, so we precompute kerning for all characters in the font.
+            // This is only feasible if the pairs can be read from the `kern` table, otherwise we call FreeType for every pair during the text layout.
+            if (source.HasKerningTable())
+            {
+                target.SetKerningPairs(source.KerningPairs(source.Chars()));
+                target.SetKerningFunc(0);
+            }
+            else
+            {
+                target.SetKerningPairs({});
+                target.SetKerningFunc(source.KerningFunc());
+            }
+
+            if (!bool(flags & FontAtlasEntry::no_default_glyph) && source.HasGlyph(Unicode::default_char))
+            {
+                Slot slot;
+                if (!data->Rasterize(Unicode::default_char, target.DefaultGlyph(), slot))
+                    throw std::runtime_error(FMT("Unable to fit the default glyph into a {}x{} glyph cache.", rect.size().x, rect.size().y));
+            }
+
+            target.SetGlyphLoader([data = data.get()](std::uint32_t ch){return data->Load(ch);});
+        }
+
+        GlyphCache(GlyphCache &&) = default;
+        GlyphCache &operator=(GlyphCache other) noexcept
+        {
+            std::swap(data, other.data);
+            return *this;
+        }
+
+        ~GlyphCache()
+        {
+            if (data)
+                data->target->SetGlyphLoader(nullptr);
+        }
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return bool(data);
+        }
+
+        // The number of glyphs currently on the page, not counting the default glyph.
+        [[nodiscard]] std::size_t GlyphCount() const
+        {
+            return data ? data->entries.size() : 0;
+        }
+
+        // Marks the start of a new frame. The glyphs used before this call can be evicted after it.
+        void NextFrame()
+        {
+            if (data)
+                data->frame++;
+        }
+
+        // Uploads the new glyphs to the texture attached to `unit`. The texture must already have the right size.
+        // The first call uploads the whole region.
+        void Upload(TexUnit &unit)
+        {
+            if (!data)
+                return;
+
+            if (data->full_upload_needed)
+            {
+                unit.SetDataPart(data->rect.a, data->rect.size(), data->page.Data());
+                data->full_upload_needed = false;
+            }
+            else
+            {
+                for (const irect2 &rect : data->dirty_rects)
+                {
+                    Image region = data->page.UnsafeGetRegion(rect);
+                    unit.SetDataPart(data->rect.a + rect.a, rect.size(), region.Data());
+                }
+            }
+            data->dirty_rects.clear();
+        }
+    };
+}
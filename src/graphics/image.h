@@ -7,6 +7,7 @@
 #include <stb_image.h>
 #include <stb_image_write.h>
 
+#include "graphics/image_kernels.h"
 #include "macros/finally.h"
 #include "stream/readonly_data.h"
 #include "strings/format.h"
@@ -39,7 +40,7 @@ namespace Graphics
         }
         Image(Stream::ReadOnlyData file, FlipMode flip_mode = no_flip) // Throws on failure.
         {
-            stbi_set_flip_vertically_on_load(flip_mode == flip_y);
+            stbi_set_flip_vertically_on_load_thread(flip_mode == flip_y); // The thread-local version, to allow decoding images in parallel.
             ivec2 img_size;
             uint8_t *bytes = stbi_load_from_memory(file.data(), file.size(), &img_size.x, &img_size.y, 0, 4);
             if (!bytes)
@@ -100,8 +101,10 @@ namespace Graphics
 
         void UnsafeFill(irect2 rect, u8vec4 color)
         {
-            for (ivec2 pos : vector_range(rect))
-                UnsafeAt(pos) = color;
+            if (!rect.has_area())
+                return;
+            for (int y = rect.a.y; y < rect.b.y; y++)
+                ImageKernels::FillRow(&UnsafeAt(ivec2(rect.a.x, y)), rect.size().x, color);
         }
 
         void UnsafeDrawImage(const Image &other, ivec2 pos) // Copies other image into this image, at specified location.
@@ -112,5 +115,33 @@ namespace Graphics
                 std::copy(source_address, source_address + other.Size().x, &UnsafeAt(ivec2(pos.x, y + pos.y)));
             }
         }
+
+        void PremultiplyAlpha()
+        {
+            ImageKernels::PremultiplyAlpha(data.data(), data.size());
+        }
+
+        // Multiplies each pixel, as a vector in [0;1] range, by the matrix. The result is clamped and rounded.
+        void ApplyColorMatrix(const fmat4 &matrix)
+        {
+            ImageKernels::ApplyColorMatrix(data.data(), data.size(), matrix);
+        }
+
+        void FlipVertically()
+        {
+            for (int y = 0; y < size.y / 2; y++)
+                ImageKernels::SwapRows(&UnsafeAt(ivec2(0, y)), &UnsafeAt(ivec2(0, size.y - 1 - y)), size.x);
+        }
+
+        Image UnsafeGetRegion(irect2 rect) const // Returns a copy of the specified part of this image.
+        {
+            Image ret(rect.size());
+            for (int y = 0; y < rect.size().y; y++)
+            {
+                auto source_address = &UnsafeAt(ivec2(rect.a.x, y + rect.a.y));
+                std::copy(source_address, source_address + rect.size().x, &ret.UnsafeAt(ivec2(0,y)));
+            }
+            return ret;
+        }
     };
 }
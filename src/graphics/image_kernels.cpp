@@ -0,0 +1,304 @@
+#include "image_kernels.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "program/platform.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMAGE_KERNELS_SSE2 1
+#include <emmintrin.h>
+#else
+#define IMAGE_KERNELS_SSE2 0
+#endif
+
+// AVX2 needs a runtime check and per-function target attributes, so we only use it on GCC and Clang.
+#if IMAGE_KERNELS_SSE2 && (IMP_PLATFORM_IS(gcc) || IMP_PLATFORM_IS(clang))
+#define IMAGE_KERNELS_AVX2 1
+#include <immintrin.h>
+#define IMAGE_KERNELS_TARGET_AVX2 __attribute__((__target__("avx2")))
+#else
+#define IMAGE_KERNELS_AVX2 0
+#endif
+
+namespace Graphics::ImageKernels
+{
+    static InstructionSet DetectInstructionSet()
+    {
+        #if IMAGE_KERNELS_AVX2
+        if (__builtin_cpu_supports("avx2"))
+            return InstructionSet::avx2;
+        #endif
+        #if IMAGE_KERNELS_SSE2
+        return InstructionSet::sse2;
+        #else
+        return InstructionSet::scalar;
+        #endif
+    }
+
+    static InstructionSet current_instruction_set = DetectInstructionSet();
+
+    InstructionSet MaxSupportedInstructionSet()
+    {
+        static const InstructionSet ret = DetectInstructionSet();
+        return ret;
+    }
+
+    InstructionSet CurrentInstructionSet()
+    {
+        return current_instruction_set;
+    }
+
+    void SetInstructionSet(InstructionSet set)
+    {
+        current_instruction_set = std::min(set, MaxSupportedInstructionSet());
+    }
+
+    // Computes `x * a / 255`, rounded to nearest. This formula is exact for all 8-bit inputs.
+    [[nodiscard]] static std::uint8_t MulDiv255(std::uint8_t x, std::uint8_t a)
+    {
+        unsigned t = unsigned(x) * a + 128;
+        return std::uint8_t((t + (t >> 8)) >> 8);
+    }
+
+
+    void FillRow(u8vec4 *target, std::size_t count, u8vec4 color)
+    {
+        std::size_t i = 0;
+
+        #if IMAGE_KERNELS_SSE2
+        if (current_instruction_set >= InstructionSet::sse2)
+        {
+            std::uint32_t value;
+            std::memcpy(&value, &color, sizeof value);
+            __m128i v = _mm_set1_epi32(int(value));
+            for (; i + 4 <= count; i += 4)
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(target + i), v);
+        }
+        #endif
+
+        std::fill(target + i, target + count, color);
+    }
+
+
+    void SwapRows(u8vec4 *a, u8vec4 *b, std::size_t count)
+    {
+        std::size_t i = 0;
+
+        #if IMAGE_KERNELS_SSE2
+        if (current_instruction_set >= InstructionSet::sse2)
+        {
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+                __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(a + i), vb);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(b + i), va);
+            }
+        }
+        #endif
+
+        std::swap_ranges(a + i, a + count, b + i);
+    }
+
+
+    void AlphaToWhite(const std::uint8_t *source, u8vec4 *target, std::size_t count)
+    {
+        std::size_t i = 0;
+
+        #if IMAGE_KERNELS_SSE2
+        if (current_instruction_set >= InstructionSet::sse2)
+        {
+            // Each alpha byte goes to the top byte of a 32-bit pixel, then the color bytes are set to 255.
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i white = _mm_set1_epi32(0x00ffffff);
+            for (; i + 16 <= count; i += 16)
+            {
+                __m128i alpha = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i));
+                __m128i lo = _mm_unpacklo_epi8(zero, alpha); // 16-bit values, alpha in the high byte.
+                __m128i hi = _mm_unpackhi_epi8(zero, alpha);
+                __m128i out[4] = {
+                    _mm_unpacklo_epi16(zero, lo),
+                    _mm_unpackhi_epi16(zero, lo),
+                    _mm_unpacklo_epi16(zero, hi),
+                    _mm_unpackhi_epi16(zero, hi),
+                };
+                for (int j = 0; j < 4; j++)
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(target + i + j * 4), _mm_or_si128(out[j], white));
+            }
+        }
+        #endif
+
+        for (; i < count; i++)
+            target[i] = u8vec4(255, 255, 255, source[i]);
+    }
+
+
+    #if IMAGE_KERNELS_SSE2
+    // Premultiplies 2 pixels stored as 16-bit values.
+    [[nodiscard]] static __m128i PremultiplyAlpha16_SSE2(__m128i pixels)
+    {
+        const __m128i alpha_mask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+        const __m128i bias = _mm_set1_epi16(128);
+
+        // Broadcast the alpha to all components, but multiply the alpha itself by 255.
+        __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, 0xff), 0xff);
+        alpha = _mm_or_si128(_mm_andnot_si128(alpha_mask, alpha), _mm_and_si128(alpha_mask, _mm_set1_epi16(255)));
+
+        __m128i t = _mm_add_epi16(_mm_mullo_epi16(pixels, alpha), bias);
+        return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+    }
+    #endif
+
+    #if IMAGE_KERNELS_AVX2
+    IMAGE_KERNELS_TARGET_AVX2 static std::size_t PremultiplyAlpha_AVX2(u8vec4 *pixels, std::size_t count)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i alpha_mask = _mm256_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0);
+        const __m256i alpha_255 = _mm256_and_si256(alpha_mask, _mm256_set1_epi16(255));
+        const __m256i bias = _mm256_set1_epi16(128);
+
+        std::size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pixels + i));
+            __m256i halves[2] = {_mm256_unpacklo_epi8(v, zero), _mm256_unpackhi_epi8(v, zero)};
+            for (__m256i &half : halves)
+            {
+                __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(half, 0xff), 0xff);
+                alpha = _mm256_or_si256(_mm256_andnot_si256(alpha_mask, alpha), alpha_255);
+                __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(half, alpha), bias);
+                half = _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+            }
+            // Both unpacking and packing work within 128-bit lanes, so this restores the original order.
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(pixels + i), _mm256_packus_epi16(halves[0], halves[1]));
+        }
+        return i;
+    }
+    #endif
+
+    void PremultiplyAlpha(u8vec4 *pixels, std::size_t count)
+    {
+        std::size_t i = 0;
+
+        #if IMAGE_KERNELS_AVX2
+        if (current_instruction_set >= InstructionSet::avx2)
+            i = PremultiplyAlpha_AVX2(pixels, count);
+        #endif
+
+        #if IMAGE_KERNELS_SSE2
+        if (current_instruction_set >= InstructionSet::sse2)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i));
+                __m128i lo = PremultiplyAlpha16_SSE2(_mm_unpacklo_epi8(v, zero));
+                __m128i hi = PremultiplyAlpha16_SSE2(_mm_unpackhi_epi8(v, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + i), _mm_packus_epi16(lo, hi));
+            }
+        }
+        #endif
+
+        for (; i < count; i++)
+        {
+            u8vec4 &pixel = pixels[i];
+            pixel.x = MulDiv255(pixel.x, pixel.w);
+            pixel.y = MulDiv255(pixel.y, pixel.w);
+            pixel.z = MulDiv255(pixel.z, pixel.w);
+        }
+    }
+
+
+    // All implementations compute `((x * p.r + y * p.g) + z * p.b) + w * p.a` in this order, to get identical results.
+
+    #if IMAGE_KERNELS_AVX2
+    IMAGE_KERNELS_TARGET_AVX2 static std::size_t ApplyColorMatrix_AVX2(u8vec4 *pixels, std::size_t count, const fmat4 &matrix)
+    {
+        // Each 128-bit lane processes one pixel.
+        const __m256 scale = _mm256_set1_ps(1 / 255.f);
+        const __m256 col_x = _mm256_setr_ps(matrix.x.x, matrix.x.y, matrix.x.z, matrix.x.w, matrix.x.x, matrix.x.y, matrix.x.z, matrix.x.w);
+        const __m256 col_y = _mm256_setr_ps(matrix.y.x, matrix.y.y, matrix.y.z, matrix.y.w, matrix.y.x, matrix.y.y, matrix.y.z, matrix.y.w);
+        const __m256 col_z = _mm256_setr_ps(matrix.z.x, matrix.z.y, matrix.z.z, matrix.z.w, matrix.z.x, matrix.z.y, matrix.z.z, matrix.z.w);
+        const __m256 col_w = _mm256_setr_ps(matrix.w.x, matrix.w.y, matrix.w.z, matrix.w.w, matrix.w.x, matrix.w.y, matrix.w.z, matrix.w.w);
+        const __m256 out_scale = _mm256_set1_ps(255);
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 zero = _mm256_setzero_ps();
+
+        std::size_t i = 0;
+        for (; i + 2 <= count; i += 2)
+        {
+            __m256 v = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(pixels + i)))), scale);
+
+            __m256 r = _mm256_mul_ps(col_x, _mm256_permute_ps(v, 0x00));
+            r = _mm256_add_ps(r, _mm256_mul_ps(col_y, _mm256_permute_ps(v, 0x55)));
+            r = _mm256_add_ps(r, _mm256_mul_ps(col_z, _mm256_permute_ps(v, 0xaa)));
+            r = _mm256_add_ps(r, _mm256_mul_ps(col_w, _mm256_permute_ps(v, 0xff)));
+
+            r = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(r, out_scale), half), zero), out_scale);
+            __m256i ri = _mm256_cvttps_epi32(r);
+            ri = _mm256_packus_epi16(_mm256_packs_epi32(ri, ri), ri); // The results are in the low 4 bytes of each lane.
+
+            std::uint32_t out[2] = {std::uint32_t(_mm_cvtsi128_si32(_mm256_castsi256_si128(ri))), std::uint32_t(_mm_cvtsi128_si32(_mm256_extracti128_si256(ri, 1)))};
+            std::memcpy(static_cast<void *>(pixels + i), out, sizeof out);
+        }
+        return i;
+    }
+    #endif
+
+    void ApplyColorMatrix(u8vec4 *pixels, std::size_t count, const fmat4 &matrix)
+    {
+        std::size_t i = 0;
+
+        #if IMAGE_KERNELS_AVX2
+        if (current_instruction_set >= InstructionSet::avx2)
+            i = ApplyColorMatrix_AVX2(pixels, count, matrix);
+        #endif
+
+        #if IMAGE_KERNELS_SSE2
+        if (current_instruction_set >= InstructionSet::sse2)
+        {
+            const __m128 scale = _mm_set1_ps(1 / 255.f);
+            const __m128 col_x = _mm_setr_ps(matrix.x.x, matrix.x.y, matrix.x.z, matrix.x.w);
+            const __m128 col_y = _mm_setr_ps(matrix.y.x, matrix.y.y, matrix.y.z, matrix.y.w);
+            const __m128 col_z = _mm_setr_ps(matrix.z.x, matrix.z.y, matrix.z.z, matrix.z.w);
+            const __m128 col_w = _mm_setr_ps(matrix.w.x, matrix.w.y, matrix.w.z, matrix.w.w);
+            const __m128 out_scale = _mm_set1_ps(255);
+            const __m128 half = _mm_set1_ps(0.5f);
+            const __m128 zero_ps = _mm_setzero_ps();
+            const __m128i zero = _mm_setzero_si128();
+
+            for (; i < count; i++)
+            {
+                std::uint32_t in;
+                std::memcpy(&in, pixels + i, sizeof in);
+                __m128 v = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(int(in)), zero), zero)), scale);
+
+                __m128 r = _mm_mul_ps(col_x, _mm_shuffle_ps(v, v, 0x00));
+                r = _mm_add_ps(r, _mm_mul_ps(col_y, _mm_shuffle_ps(v, v, 0x55)));
+                r = _mm_add_ps(r, _mm_mul_ps(col_z, _mm_shuffle_ps(v, v, 0xaa)));
+                r = _mm_add_ps(r, _mm_mul_ps(col_w, _mm_shuffle_ps(v, v, 0xff)));
+
+                r = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(r, out_scale), half), zero_ps), out_scale);
+                __m128i ri = _mm_cvttps_epi32(r);
+                ri = _mm_packus_epi16(_mm_packs_epi32(ri, ri), ri);
+
+                std::uint32_t out = std::uint32_t(_mm_cvtsi128_si32(ri));
+                std::memcpy(static_cast<void *>(pixels + i), &out, sizeof out);
+            }
+        }
+        #endif
+
+        for (; i < count; i++)
+        {
+            u8vec4 &pixel = pixels[i];
+            fvec4 v = fvec4(pixel) * (1 / 255.f);
+            fvec4 r = matrix.x * v.x;
+            r = r + matrix.y * v.y;
+            r = r + matrix.z * v.z;
+            r = r + matrix.w * v.w;
+            r = clamp(r * 255.f + 0.5f, 0.f, 255.f);
+            pixel = u8vec4(r); // Truncates, like `_mm_cvttps_epi32()`.
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "utils/mat.h"
+
+// Vectorized pixel loops for `Graphics::Image`.
+// Each function has SSE2 and scalar implementations, and some also have AVX2 implementations, chosen at runtime.
+// The results don't depend on the chosen implementation.
+
+namespace Graphics::ImageKernels
+{
+    enum class InstructionSet
+    {
+        scalar,
+        sse2,
+        avx2,
+    };
+
+    // Returns the best instruction set supported by both the compiler and the CPU.
+    [[nodiscard]] InstructionSet MaxSupportedInstructionSet();
+    // Returns the instruction set currently in use. Defaults to `MaxSupportedInstructionSet()`.
+    [[nodiscard]] InstructionSet CurrentInstructionSet();
+    // Limits the instruction set. This is intended for testing and benchmarking. Not thread-safe.
+    // If the set is not supported, the best supported one is used instead.
+    void SetInstructionSet(InstructionSet set);
+
+    // Sets `count` pixels to `color`.
+    void FillRow(u8vec4 *target, std::size_t count, u8vec4 color);
+
+    // Swaps two non-overlapping rows of pixels.
+    void SwapRows(u8vec4 *a, u8vec4 *b, std::size_t count);
+
+    // Converts an alpha mask to white pixels with the respective alpha.
+    void AlphaToWhite(const std::uint8_t *source, u8vec4 *target, std::size_t count);
+
+    // Multiplies the color of each pixel by its alpha.
+    void PremultiplyAlpha(u8vec4 *pixels, std::size_t count);
+
+    // Multiplies each pixel, as a vector in [0;1] range, by the matrix. The result is clamped and rounded.
+    void ApplyColorMatrix(u8vec4 *pixels, std::size_t count, const fmat4 &matrix);
+}
@@ -0,0 +1,443 @@
+#include "png_reader.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "strings/format.h"
+#include "utils/archive.h"
+
+namespace Graphics
+{
+    namespace
+    {
+        enum class ColorType
+        {
+            gray = 0,
+            rgb = 2,
+            palette = 3,
+            gray_alpha = 4,
+            rgba = 6,
+        };
+
+        constexpr std::array<std::uint8_t, 8> png_signature = {137, 80, 78, 71, 13, 10, 26, 10};
+    }
+
+    struct PngReader::Data
+    {
+        Stream::Input input;
+
+        ivec2 size;
+        int bit_depth = 0;
+        ColorType color_type = ColorType::rgba;
+        int channels = 0;
+
+        std::vector<u8vec4> palette;
+        std::optional<std::array<std::uint16_t, 3>> transparent_color; // For `gray` and `rgb` images. For `gray`, only the first component is used.
+
+        Archive::StreamUncompressor uncompressor = nullptr;
+        std::size_t chunk_bytes_left = 0; // The remaining bytes in the current `IDAT` chunk.
+        bool image_data_ended = false;
+
+        std::size_t row_bytes = 0; // Excluding the filter type byte.
+        std::size_t filter_step = 0; // Bytes per pixel, rounded up.
+        std::vector<std::uint8_t> row, prev_row; // Both have an extra byte at the beginning, which is the filter type for `row`, and is ignored in `prev_row`.
+        int next_row = 0;
+
+        [[noreturn]] void Fail(std::string_view message)
+        {
+            throw std::runtime_error(FMT("{}Unable to parse PNG image: {}", input.GetExceptionPrefix(), message));
+        }
+
+        // Reads a chunk header. Returns the chunk size, and writes its type to `type`.
+        std::size_t ReadChunkHeader(std::array<char, 4> &type)
+        {
+            std::uint32_t chunk_size = input.ReadBig<std::uint32_t>();
+            input.Read(type.data(), type.size());
+            if (chunk_size > std::uint32_t(std::numeric_limits<std::int32_t>::max()))
+                Fail("Invalid chunk size.");
+            return chunk_size;
+        }
+
+        [[nodiscard]] static bool IsChunk(const std::array<char, 4> &type, std::string_view name)
+        {
+            return std::string_view(type.data(), type.size()) == name;
+        }
+
+        // Reads the signature and the chunks up to the first `IDAT`.
+        void ReadHeader()
+        {
+            std::array<std::uint8_t, 8> signature;
+            input.Read(signature.data(), signature.size());
+            if (signature != png_signature)
+                Fail("Not a PNG file.");
+
+            std::array<char, 4> type;
+            if (ReadChunkHeader(type) != 13 || !IsChunk(type, "IHDR"))
+                Fail("Expected an `IHDR` chunk.");
+
+            std::uint32_t width = input.ReadBig<std::uint32_t>();
+            std::uint32_t height = input.ReadBig<std::uint32_t>();
+            if (width == 0 || height == 0 || std::uint64_t(width) * height > std::uint64_t(std::numeric_limits<int>::max()))
+                Fail(FMT("Invalid image size: {}x{}.", width, height));
+            size = ivec2(width, height);
+
+            bit_depth = input.ReadByte();
+            color_type = ColorType(input.ReadByte());
+            std::uint8_t compression = input.ReadByte();
+            std::uint8_t filter = input.ReadByte();
+            std::uint8_t interlace = input.ReadByte();
+            input.Skip(4); // CRC.
+
+            auto DepthIsOneOf = [&](std::initializer_list<int> list)
+            {
+                return std::find(list.begin(), list.end(), bit_depth) != list.end();
+            };
+            switch (color_type)
+            {
+              case ColorType::gray:
+                channels = 1;
+                if (!DepthIsOneOf({1, 2, 4, 8, 16}))
+                    Fail("Invalid bit depth.");
+                break;
+              case ColorType::rgb:
+                channels = 3;
+                if (!DepthIsOneOf({8, 16}))
+                    Fail("Invalid bit depth.");
+                break;
+              case ColorType::palette:
+                channels = 1;
+                if (!DepthIsOneOf({1, 2, 4, 8}))
+                    Fail("Invalid bit depth.");
+                break;
+              case ColorType::gray_alpha:
+                channels = 2;
+                if (!DepthIsOneOf({8, 16}))
+                    Fail("Invalid bit depth.");
+                break;
+              case ColorType::rgba:
+                channels = 4;
+                if (!DepthIsOneOf({8, 16}))
+                    Fail("Invalid bit depth.");
+                break;
+              default:
+                Fail("Invalid color type.");
+            }
+            if (compression != 0 || filter != 0)
+                Fail("Unknown compression or filter method.");
+            if (interlace != 0)
+                Fail("Interlaced images are not supported by the incremental decoder.");
+
+            // Read the chunks before the image data.
+            while (true)
+            {
+                std::size_t chunk_size = ReadChunkHeader(type);
+
+                if (IsChunk(type, "IDAT"))
+                {
+                    chunk_bytes_left = chunk_size;
+                    break;
+                }
+                else if (IsChunk(type, "PLTE"))
+                {
+                    if (chunk_size % 3 != 0 || chunk_size / 3 > 256)
+                        Fail("Invalid palette size.");
+                    palette.resize(chunk_size / 3);
+                    for (u8vec4 &color : palette)
+                    {
+                        input.Read(reinterpret_cast<std::uint8_t *>(&color), 3);
+                        color.w = 255;
+                    }
+                }
+                else if (IsChunk(type, "tRNS"))
+                {
+                    if (color_type == ColorType::palette)
+                    {
+                        if (chunk_size > palette.size())
+                            Fail("Invalid `tRNS` chunk size.");
+                        for (std::size_t i = 0; i < chunk_size; i++)
+                            palette[i].w = input.ReadByte();
+                    }
+                    else if (color_type == ColorType::gray || color_type == ColorType::rgb)
+                    {
+                        if (chunk_size != std::size_t(channels) * 2)
+                            Fail("Invalid `tRNS` chunk size.");
+                        transparent_color.emplace();
+                        for (int i = 0; i < channels; i++)
+                            (*transparent_color)[i] = input.ReadBig<std::uint16_t>();
+                    }
+                    else
+                    {
+                        Fail("Unexpected `tRNS` chunk.");
+                    }
+                }
+                else if (IsChunk(type, "IEND"))
+                {
+                    Fail("No image data.");
+                }
+                else if ((type[0] & 0x20) == 0)
+                {
+                    // The lowercase first letter means that the chunk can be safely ignored.
+                    Fail(FMT("Unknown critical chunk `{}`.", std::string_view(type.data(), type.size())));
+                }
+                else
+                {
+                    input.Skip(chunk_size);
+                }
+
+                input.Skip(4); // CRC.
+            }
+
+            if (color_type == ColorType::palette && palette.empty())
+                Fail("Missing palette.");
+
+            std::size_t row_bits = std::size_t(size.x) * channels * bit_depth;
+            row_bytes = (row_bits + 7) / 8;
+            filter_step = std::max(1, channels * bit_depth / 8);
+            row.resize(row_bytes + 1);
+            prev_row.resize(row_bytes + 1);
+        }
+
+        // Provides compressed data to the uncompressor, switching to the next `IDAT` chunk as needed.
+        std::size_t ReadImageData(std::uint8_t *buffer, std::size_t capacity)
+        {
+            while (chunk_bytes_left == 0)
+            {
+                if (image_data_ended)
+                    return 0;
+
+                input.Skip(4); // CRC of the previous chunk.
+                std::array<char, 4> type;
+                std::size_t chunk_size = ReadChunkHeader(type);
+                if (!IsChunk(type, "IDAT"))
+                {
+                    image_data_ended = true;
+                    return 0;
+                }
+                chunk_bytes_left = chunk_size;
+            }
+
+            std::size_t size = std::min(capacity, chunk_bytes_left);
+            input.Read(buffer, size);
+            chunk_bytes_left -= size;
+            return size;
+        }
+
+        // Decompresses and unfilters the next row into `row`.
+        void DecodeRow()
+        {
+            if (next_row >= size.y)
+                throw std::runtime_error(FMT("Attempt to read past the last row of a {}x{} PNG image.", size.x, size.y));
+
+            std::swap(row, prev_row);
+            if (next_row == 0)
+                std::fill(prev_row.begin(), prev_row.end(), 0);
+
+            std::uint8_t *end = uncompressor.Read(row.data(), row.data() + row.size(), [this](std::uint8_t *buffer, std::size_t capacity)
+            {
+                return ReadImageData(buffer, capacity);
+            });
+            if (end != row.data() + row.size())
+                Fail("Unexpected end of image data.");
+
+            // Skip the filter type byte in both rows.
+            std::uint8_t *cur = row.data() + 1;
+            const std::uint8_t *prev = prev_row.data() + 1;
+            std::size_t step = filter_step;
+
+            switch (row[0])
+            {
+              case 0: // None.
+                break;
+              case 1: // Sub.
+                for (std::size_t i = step; i < row_bytes; i++)
+                    cur[i] += cur[i - step];
+                break;
+              case 2: // Up.
+                for (std::size_t i = 0; i < row_bytes; i++)
+                    cur[i] += prev[i];
+                break;
+              case 3: // Average.
+                for (std::size_t i = 0; i < step; i++)
+                    cur[i] += prev[i] / 2;
+                for (std::size_t i = step; i < row_bytes; i++)
+                    cur[i] += (cur[i - step] + prev[i]) / 2;
+                break;
+              case 4: // Paeth.
+                for (std::size_t i = 0; i < step; i++)
+                    cur[i] += prev[i];
+                for (std::size_t i = step; i < row_bytes; i++)
+                {
+                    int a = cur[i - step], b = prev[i], c = prev[i - step];
+                    int p = a + b - c;
+                    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                    cur[i] += pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+                }
+                break;
+              default:
+                Fail("Invalid filter type.");
+            }
+
+            next_row++;
+        }
+
+        // Returns the `index`-th sample of the current row, without scaling it to 8 bits.
+        [[nodiscard]] std::uint16_t RawSample(std::size_t index) const
+        {
+            const std::uint8_t *bytes = row.data() + 1;
+            switch (bit_depth)
+            {
+              case 8:
+                return bytes[index];
+              case 16:
+                return std::uint16_t(bytes[index * 2] << 8 | bytes[index * 2 + 1]);
+              default:
+                {
+                    std::size_t bit = index * bit_depth;
+                    int shift = 8 - bit_depth - int(bit % 8);
+                    return (bytes[bit / 8] >> shift) & ((1 << bit_depth) - 1);
+                }
+            }
+        }
+
+        // Scales a sample returned by `RawSample()` to 8 bits.
+        [[nodiscard]] std::uint8_t ScaleSample(std::uint16_t value) const
+        {
+            switch (bit_depth)
+            {
+              case 8:
+                return std::uint8_t(value);
+              case 16:
+                return std::uint8_t(value >> 8);
+              default:
+                return std::uint8_t(value * (255 / ((1 << bit_depth) - 1)));
+            }
+        }
+
+        // Converts pixels `[begin_x, end_x)` of the current row to RGBA, and writes them to `target`.
+        void ConvertRow(u8vec4 *target, int begin_x, int end_x)
+        {
+            if (color_type == ColorType::rgba && bit_depth == 8)
+            {
+                std::memcpy(static_cast<void *>(target), row.data() + 1 + begin_x * 4, std::size_t(end_x - begin_x) * 4);
+                return;
+            }
+
+            for (int x = begin_x; x < end_x; x++)
+            {
+                std::size_t i = std::size_t(x) * channels;
+                u8vec4 &pixel = *target++;
+
+                switch (color_type)
+                {
+                  case ColorType::gray:
+                    {
+                        std::uint16_t value = RawSample(i);
+                        pixel = u8vec3(ScaleSample(value)).to_vec4(transparent_color && value == (*transparent_color)[0] ? 0 : 255);
+                    }
+                    break;
+                  case ColorType::rgb:
+                    {
+                        std::array<std::uint16_t, 3> value = {RawSample(i), RawSample(i + 1), RawSample(i + 2)};
+                        pixel = u8vec4(ScaleSample(value[0]), ScaleSample(value[1]), ScaleSample(value[2]), transparent_color && value == *transparent_color ? 0 : 255);
+                    }
+                    break;
+                  case ColorType::palette:
+                    {
+                        std::uint16_t index = RawSample(i);
+                        if (index >= palette.size())
+                            Fail("Invalid palette index.");
+                        pixel = palette[index];
+                    }
+                    break;
+                  case ColorType::gray_alpha:
+                    pixel = u8vec3(ScaleSample(RawSample(i))).to_vec4(ScaleSample(RawSample(i + 1)));
+                    break;
+                  case ColorType::rgba:
+                    pixel = u8vec4(ScaleSample(RawSample(i)), ScaleSample(RawSample(i + 1)), ScaleSample(RawSample(i + 2)), ScaleSample(RawSample(i + 3)));
+                    break;
+                }
+            }
+        }
+    };
+
+    PngReader::PngReader() {}
+
+    PngReader::PngReader(Stream::Input input) : data(std::make_unique<Data>())
+    {
+        data->input = std::move(input);
+        data->ReadHeader();
+    }
+
+    PngReader::PngReader(PngReader &&) noexcept = default;
+    PngReader &PngReader::operator=(PngReader &&) noexcept = default;
+    PngReader::~PngReader() = default;
+
+    ivec2 PngReader::Size() const
+    {
+        return data ? data->size : ivec2(0);
+    }
+
+    int PngReader::NextRow() const
+    {
+        return data ? data->next_row : 0;
+    }
+
+    void PngReader::ReadRow(u8vec4 *target, int begin_x, int end_x)
+    {
+        if (!data)
+            throw std::runtime_error("Attempt to use a null PNG reader.");
+        if (begin_x < 0 || end_x > data->size.x || begin_x > end_x)
+            throw std::runtime_error(FMT("Invalid pixel range [{},{}) for a {}x{} PNG image.", begin_x, end_x, data->size.x, data->size.y));
+
+        data->DecodeRow();
+        data->ConvertRow(target, begin_x, end_x);
+    }
+
+    void PngReader::SkipRows(int count)
+    {
+        if (!data)
+            throw std::runtime_error("Attempt to use a null PNG reader.");
+
+        for (int i = 0; i < count; i++)
+            data->DecodeRow();
+    }
+
+    void PngReader::ReadRegion(irect2 source_rect, Image &target, ivec2 target_pos, Image::FlipMode flip_mode)
+    {
+        if (!data)
+            throw std::runtime_error("Attempt to use a null PNG reader.");
+        if (!source_rect.has_area() || !Bounds().contains(source_rect) || source_rect.a.y < data->next_row)
+        {
+            throw std::runtime_error(FMT("Unable to decode region [{},{}]-[{},{}) of a {}x{} PNG image, with {} rows already decoded.",
+                source_rect.a.x, source_rect.a.y, source_rect.b.x, source_rect.b.y, data->size.x, data->size.y, data->next_row));
+        }
+        if (!target.Bounds().contains(target_pos.rect_size(source_rect.size())))
+            throw std::runtime_error("The region of a PNG image doesn't fit into the target image.");
+
+        SkipRows(source_rect.a.y - data->next_row);
+
+        for (int y = 0; y < source_rect.size().y; y++)
+        {
+            int target_y = flip_mode == Image::flip_y ? source_rect.size().y - 1 - y : y;
+            ReadRow(&target.UnsafeAt(target_pos + ivec2(0, target_y)), source_rect.a.x, source_rect.b.x);
+        }
+    }
+
+    Image PngReader::ReadRegion(irect2 source_rect, Image::FlipMode flip_mode)
+    {
+        Image ret(source_rect.size());
+        ReadRegion(source_rect, ret, ivec2(0), flip_mode);
+        return ret;
+    }
+}
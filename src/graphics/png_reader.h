@@ -0,0 +1,56 @@
+#pragma once
+
+#include <memory>
+
+#include "graphics/image.h"
+#include "stream/input.h"
+#include "utils/mat.h"
+
+namespace Graphics
+{
+    // Decodes PNG images incrementally, one row at a time, reading the file as needed.
+    // Unlike `Image(Stream::ReadOnlyData)`, this never holds the whole file or the whole decoded image in memory,
+    // and can decode a part of an image directly into an existing image (such as a `DynamicAtlas`).
+    // The rows are decoded from top to bottom, and can't be revisited. Decoding stops after the last requested row.
+    // Interlaced images are not supported, since they can't be decoded row by row.
+    // Usage:
+    //     Graphics::PngReader reader("background.png");
+    //     Graphics::Image part = reader.ReadRegion(ivec2(0, 512).rect_size(ivec2(1024, 512)));
+    class PngReader
+    {
+        struct Data;
+        std::unique_ptr<Data> data;
+
+      public:
+        PngReader();
+        PngReader(Stream::Input input); // Reads the header. Throws on failure.
+        PngReader(PngReader &&) noexcept;
+        PngReader &operator=(PngReader &&) noexcept;
+        ~PngReader();
+
+        [[nodiscard]] explicit operator bool() const {return bool(data);}
+
+        [[nodiscard]] ivec2 Size() const;
+        [[nodiscard]] irect2 Bounds() const {return ivec2().rect_size(Size());}
+
+        // The index of the row that will be decoded next. Equal to `Size().y` when all rows were decoded.
+        [[nodiscard]] int NextRow() const;
+
+        // Decodes the next row, and writes the pixels in range `[begin_x, end_x)` to `target`. Throws on failure.
+        void ReadRow(u8vec4 *target, int begin_x, int end_x);
+        // Decodes and discards `count` rows. Throws on failure.
+        void SkipRows(int count);
+
+        // Decodes `source_rect` of the image into `target`, at `target_pos`. The rows above the rectangle are skipped.
+        // The rectangle must not start above `NextRow()`, and must fit into `target`.
+        // If `flip_mode == flip_y`, the region is flipped vertically. Throws on failure.
+        void ReadRegion(irect2 source_rect, Image &target, ivec2 target_pos, Image::FlipMode flip_mode = Image::no_flip);
+        // Same, but returns a new image.
+        [[nodiscard]] Image ReadRegion(irect2 source_rect, Image::FlipMode flip_mode = Image::no_flip);
+        // Decodes the whole image. No rows must be decoded before calling this.
+        [[nodiscard]] Image ReadImage(Image::FlipMode flip_mode = Image::no_flip)
+        {
+            return ReadRegion(Bounds(), flip_mode);
+        }
+    };
+}
@@ -0,0 +1,121 @@
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include <graphics/dynamic_atlas.h>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    // A solid color, unique for each index.
+    [[nodiscard]] u8vec4 IndexColor(int index)
+    {
+        return u8vec4(index % 256, index / 256 % 256, 128, 255);
+    }
+
+    // Checks that the images are inside of the atlas, don't overlap, and have the expected colors.
+    void CheckAtlas(const Graphics::DynamicAtlas &atlas, const std::map<std::string, int> &images)
+    {
+        for (auto a = images.begin(); a != images.end(); a++)
+        {
+            const irect2 *rect = atlas.Find(a->first);
+            REQUIRE(rect);
+            REQUIRE(atlas.GetImage().Bounds().contains(*rect));
+
+            for (auto b = std::next(a); b != images.end(); b++)
+                REQUIRE_FALSE(rect->touches(*atlas.Find(b->first)));
+
+            for (ivec2 pos : vector_range(*rect))
+                REQUIRE(atlas.GetImage().UnsafeAt(pos) == IndexColor(a->second));
+        }
+    }
+}
+
+TEST_CASE("dynamic_atlas.insert_and_remove")
+{
+    std::mt19937 gen(42);
+    // Small enough to fill up sometimes.
+    Graphics::DynamicAtlas atlas(ivec2(80), Graphics::AtlasFlags::add_gaps);
+
+    std::map<std::string, int> images; // Names and color indices.
+    for (int i = 0; i < 500; i++)
+    {
+        std::string name = FMT("image{}", gen() % 40);
+
+        if (gen() % 3 == 0)
+        {
+            // Removing.
+            REQUIRE(atlas.Remove(name) == bool(images.erase(name)));
+        }
+        else
+        {
+            // Inserting or replacing. Sometimes the replacement has the same size.
+            const irect2 *old_rect = atlas.Find(name);
+            ivec2 size = old_rect && gen() % 2 ? old_rect->size() : ivec2(1 + int(gen() % 24), 1 + int(gen() % 24));
+            std::optional<irect2> old_rect_copy = old_rect ? std::optional(*old_rect) : std::nullopt;
+
+            try
+            {
+                irect2 rect = atlas.Insert(name, Graphics::Image(size, IndexColor(i)));
+                REQUIRE(rect.size() == size);
+                REQUIRE(*atlas.Find(name) == rect);
+                if (old_rect_copy && old_rect_copy->size() == size)
+                    REQUIRE(rect == *old_rect_copy); // Replaced in place.
+                images[name] = i;
+            }
+            catch (std::runtime_error &)
+            {
+                // Not enough space. The old image must be unchanged.
+                REQUIRE(bool(old_rect_copy) == bool(atlas.Find(name)));
+                if (old_rect_copy)
+                    REQUIRE(*atlas.Find(name) == *old_rect_copy);
+            }
+        }
+
+        CheckAtlas(atlas, images);
+    }
+
+    // After removing everything, the whole atlas is available.
+    atlas.Clear();
+    REQUIRE_FALSE(atlas.Find("image0"));
+    REQUIRE(atlas.Insert("big", Graphics::Image(ivec2(80), IndexColor(0))) == ivec2(0).rect_size(80));
+}
+
+TEST_CASE("dynamic_atlas.full")
+{
+    Graphics::DynamicAtlas atlas(ivec2(64, 32));
+    irect2 a = atlas.Insert("a", Graphics::Image(ivec2(32), IndexColor(1)));
+    irect2 b = atlas.Insert("b", Graphics::Image(ivec2(32), IndexColor(2)));
+
+    // There's no space for a new image. The atlas is unchanged.
+    REQUIRE_THROWS_AS(atlas.Insert("c", Graphics::Image(ivec2(1), IndexColor(3))), std::runtime_error);
+    REQUIRE_FALSE(atlas.Find("c"));
+    CheckAtlas(atlas, {{"a", 1}, {"b", 2}});
+
+    // A replacement that doesn't fit even in place of the old image leaves the old image as is.
+    REQUIRE_THROWS_AS(atlas.Insert("a", Graphics::Image(ivec2(33, 32), IndexColor(3))), std::runtime_error);
+    REQUIRE(*atlas.Find("a") == a);
+    CheckAtlas(atlas, {{"a", 1}, {"b", 2}});
+
+    // A smaller replacement fits into the space of the old image.
+    irect2 new_b = atlas.Insert("b", Graphics::Image(ivec2(16), IndexColor(4)));
+    REQUIRE(b.contains(new_b));
+    CheckAtlas(atlas, {{"a", 1}, {"b", 4}});
+
+    // The freed space is reused.
+    REQUIRE(atlas.Remove("a"));
+    REQUIRE_FALSE(atlas.Remove("a"));
+    REQUIRE(atlas.Insert("c", Graphics::Image(ivec2(32), IndexColor(5))) == a);
+    CheckAtlas(atlas, {{"b", 4}, {"c", 5}});
+
+    // If drawing fails, the image is removed.
+    REQUIRE_THROWS_AS(atlas.Insert("c", ivec2(32), [](Graphics::Image &, ivec2){throw std::runtime_error("Failed to decode.");}), std::runtime_error);
+    REQUIRE_FALSE(atlas.Find("c"));
+    REQUIRE(atlas.Insert("d", Graphics::Image(ivec2(32), IndexColor(6))) == a);
+    CheckAtlas(atlas, {{"b", 4}, {"d", 6}});
+}
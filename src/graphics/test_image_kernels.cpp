@@ -0,0 +1,165 @@
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <graphics/image_kernels.h>
+#include <macros/finally.h>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    namespace Kernels = Graphics::ImageKernels;
+
+    constexpr Kernels::InstructionSet all_instruction_sets[] = {Kernels::InstructionSet::scalar, Kernels::InstructionSet::sse2, Kernels::InstructionSet::avx2};
+
+    // Lengths around the vector sizes, and some longer ones.
+    constexpr std::size_t test_lengths[] = {0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 1000, 1001};
+
+    [[nodiscard]] std::vector<u8vec4> RandomPixels(std::mt19937 &gen, std::size_t count)
+    {
+        std::vector<u8vec4> ret(count);
+        for (u8vec4 &pixel : ret)
+        {
+            pixel = u8vec4(gen(), gen(), gen(), gen());
+            // Make the edge cases more common.
+            if (gen() % 8 == 0)
+                pixel.w = gen() % 2 ? 0 : 255;
+        }
+        return ret;
+    }
+
+    // Runs `func(offset, count)` for each instruction set, with different lengths and misalignments, and checks that the results are the same as with the scalar code.
+    // `func` should process `count` elements starting at `offset` in some freshly generated data (always the same for the same arguments), and return the whole result.
+    template <typename F>
+    void CompareWithScalar(F &&func)
+    {
+        FINALLY{Kernels::SetInstructionSet(Kernels::MaxSupportedInstructionSet());};
+
+        for (std::size_t count : test_lengths)
+        for (std::size_t offset = 0; offset < 4; offset++)
+        {
+            Kernels::SetInstructionSet(Kernels::InstructionSet::scalar);
+            auto expected = func(offset, count);
+
+            for (Kernels::InstructionSet set : all_instruction_sets)
+            {
+                Kernels::SetInstructionSet(set);
+                REQUIRE(func(offset, count) == expected);
+            }
+        }
+    }
+}
+
+TEST_CASE("image_kernels.instruction_sets")
+{
+    // Unsupported sets fall back to the best supported one.
+    FINALLY{Kernels::SetInstructionSet(Kernels::MaxSupportedInstructionSet());};
+    for (Kernels::InstructionSet set : all_instruction_sets)
+    {
+        Kernels::SetInstructionSet(set);
+        REQUIRE(int(Kernels::CurrentInstructionSet()) <= int(set));
+        REQUIRE(int(Kernels::CurrentInstructionSet()) <= int(Kernels::MaxSupportedInstructionSet()));
+    }
+}
+
+TEST_CASE("image_kernels.fill_and_swap")
+{
+    CompareWithScalar([](std::size_t offset, std::size_t count)
+    {
+        std::mt19937 gen(count * 4 + offset);
+        std::vector<u8vec4> pixels = RandomPixels(gen, offset + count + 1);
+        u8vec4 color(1, 2, 3, 4);
+        Kernels::FillRow(pixels.data() + offset, count, color);
+
+        // Only the requested pixels are modified.
+        for (std::size_t i = 0; i < pixels.size(); i++)
+            REQUIRE((pixels[i] == color) >= (i >= offset && i < offset + count));
+        return pixels;
+    });
+
+    CompareWithScalar([](std::size_t offset, std::size_t count)
+    {
+        std::mt19937 gen(count * 4 + offset);
+        std::vector<u8vec4> a = RandomPixels(gen, offset + count + 1), b = RandomPixels(gen, count + 1);
+        std::vector<u8vec4> old_a = a, old_b = b;
+        Kernels::SwapRows(a.data() + offset, b.data(), count);
+
+        for (std::size_t i = 0; i < count; i++)
+        {
+            REQUIRE(a[offset + i] == old_b[i]);
+            REQUIRE(b[i] == old_a[offset + i]);
+        }
+        REQUIRE(b.back() == old_b.back());
+        a.insert(a.end(), b.begin(), b.end());
+        return a;
+    });
+}
+
+TEST_CASE("image_kernels.alpha_to_white")
+{
+    CompareWithScalar([](std::size_t offset, std::size_t count)
+    {
+        std::mt19937 gen(count * 4 + offset);
+        std::vector<std::uint8_t> source(offset + count);
+        for (std::uint8_t &byte : source)
+            byte = std::uint8_t(gen());
+        std::vector<u8vec4> target = RandomPixels(gen, offset + count + 1);
+        Kernels::AlphaToWhite(source.data() + offset, target.data() + offset, count);
+
+        for (std::size_t i = 0; i < count; i++)
+            REQUIRE(target[offset + i] == u8vec4(255, 255, 255, source[offset + i]));
+        return target;
+    });
+}
+
+TEST_CASE("image_kernels.premultiply_alpha")
+{
+    CompareWithScalar([](std::size_t offset, std::size_t count)
+    {
+        std::mt19937 gen(count * 4 + offset);
+        std::vector<u8vec4> pixels = RandomPixels(gen, offset + count + 1);
+        std::vector<u8vec4> old_pixels = pixels;
+        Kernels::PremultiplyAlpha(pixels.data() + offset, count);
+
+        for (std::size_t i = offset; i < offset + count; i++)
+        {
+            u8vec4 old = old_pixels[i];
+            u8vec4 expected(std::lround(old.x * old.w / 255.), std::lround(old.y * old.w / 255.), std::lround(old.z * old.w / 255.), old.w);
+            REQUIRE(pixels[i] == expected);
+        }
+        REQUIRE(pixels.back() == old_pixels.back());
+        return pixels;
+    });
+}
+
+TEST_CASE("image_kernels.color_matrix")
+{
+    std::mt19937 matrix_gen(42);
+    std::uniform_real_distribution<float> dist(-1.5f, 1.5f);
+    for (int i = 0; i < 5; i++)
+    {
+        // The identity matrix, and random ones that go out of range.
+        fmat4 matrix;
+        if (i > 0)
+        {
+            for (int j = 0; j < 16; j++)
+                matrix.as_array()[j] = dist(matrix_gen);
+        }
+
+        CompareWithScalar([&](std::size_t offset, std::size_t count)
+        {
+            std::mt19937 gen(count * 4 + offset);
+            std::vector<u8vec4> pixels = RandomPixels(gen, offset + count + 1);
+            std::vector<u8vec4> old_pixels = pixels;
+            Kernels::ApplyColorMatrix(pixels.data() + offset, count, matrix);
+
+            if (i == 0)
+                REQUIRE(pixels == old_pixels);
+            REQUIRE(pixels.back() == old_pixels.back());
+            return pixels;
+        });
+    }
+}
@@ -0,0 +1,327 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include <zlib.h>
+
+#include <graphics/png_reader.h>
+#include <stream/readonly_data.h>
+#include <utils/archive.h>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    struct PngParams
+    {
+        ivec2 size = ivec2(1);
+        int bit_depth = 8;
+        int color_type = 6;
+        std::size_t palette_size = 0; // For `color_type == 3`.
+        std::size_t palette_alpha_size = 0; // For `color_type == 3`, the size of the `tRNS` chunk.
+        bool transparent_color = false; // For `color_type == 0 || color_type == 2`, use the color of the first pixel as transparent.
+    };
+
+    [[nodiscard]] int Channels(int color_type)
+    {
+        switch (color_type)
+        {
+          case 0:
+          case 3:
+            return 1;
+          case 2:
+            return 3;
+          case 4:
+            return 2;
+          case 6:
+            return 4;
+        }
+        throw std::runtime_error("Invalid color type.");
+    }
+
+    void AppendBig(std::vector<std::uint8_t> &target, std::uint32_t value, int bytes = 4)
+    {
+        for (int i = bytes - 1; i >= 0; i--)
+            target.push_back(std::uint8_t(value >> (i * 8)));
+    }
+
+    void AppendChunk(std::vector<std::uint8_t> &target, std::string_view type, const std::vector<std::uint8_t> &data)
+    {
+        AppendBig(target, std::uint32_t(data.size()));
+        std::size_t crc_begin = target.size();
+        target.insert(target.end(), type.begin(), type.end());
+        target.insert(target.end(), data.begin(), data.end());
+        AppendBig(target, std::uint32_t(crc32(0, target.data() + crc_begin, uInt(target.size() - crc_begin))));
+    }
+
+    // Generates a non-interlaced PNG file with random pixels. Each row uses a random filter type, and the image data is split into randomly sized `IDAT` chunks.
+    [[nodiscard]] std::vector<std::uint8_t> RandomPng(std::mt19937 &gen, const PngParams &params)
+    {
+        const int channels = Channels(params.color_type);
+        const std::size_t row_bytes = (std::size_t(params.size.x) * channels * params.bit_depth + 7) / 8;
+        const std::size_t filter_step = std::max(1, channels * params.bit_depth / 8);
+        const std::uint32_t max_sample = params.color_type == 3 ? std::uint32_t(params.palette_size) : std::uint32_t(1) << params.bit_depth;
+
+        // Generate the samples, and pack them into rows.
+        std::vector<std::vector<std::uint8_t>> rows(params.size.y, std::vector<std::uint8_t>(row_bytes));
+        for (std::vector<std::uint8_t> &row : rows)
+        {
+            for (std::size_t i = 0; i < std::size_t(params.size.x) * channels; i++)
+            {
+                std::uint32_t sample = gen() % max_sample;
+                if (params.bit_depth == 16)
+                {
+                    row[i * 2] = std::uint8_t(sample >> 8);
+                    row[i * 2 + 1] = std::uint8_t(sample);
+                }
+                else
+                {
+                    std::size_t bit = i * params.bit_depth;
+                    row[bit / 8] |= std::uint8_t(sample << (8 - params.bit_depth - bit % 8));
+                }
+            }
+        }
+
+        std::vector<std::uint8_t> ret = {137, 80, 78, 71, 13, 10, 26, 10};
+
+        std::vector<std::uint8_t> header;
+        AppendBig(header, std::uint32_t(params.size.x));
+        AppendBig(header, std::uint32_t(params.size.y));
+        header.insert(header.end(), {std::uint8_t(params.bit_depth), std::uint8_t(params.color_type), 0, 0, 0});
+        AppendChunk(ret, "IHDR", header);
+
+        // An ancillary chunk, which must be skipped.
+        AppendChunk(ret, "tEXt", {'C', 'o', 'm', 'm', 'e', 'n', 't', 0, 'h', 'i'});
+
+        if (params.color_type == 3)
+        {
+            std::vector<std::uint8_t> palette(params.palette_size * 3);
+            for (std::uint8_t &byte : palette)
+                byte = std::uint8_t(gen());
+            AppendChunk(ret, "PLTE", palette);
+
+            if (params.palette_alpha_size > 0)
+            {
+                std::vector<std::uint8_t> alpha(params.palette_alpha_size);
+                for (std::uint8_t &byte : alpha)
+                    byte = std::uint8_t(gen());
+                AppendChunk(ret, "tRNS", alpha);
+            }
+        }
+        else if (params.transparent_color)
+        {
+            // Use the first pixel, so that at least one pixel is transparent.
+            std::vector<std::uint8_t> color;
+            for (int i = 0; i < channels; i++)
+            {
+                if (params.bit_depth == 16)
+                    AppendBig(color, std::uint32_t(rows[0][i * 2] << 8 | rows[0][i * 2 + 1]), 2);
+                else if (params.bit_depth == 8)
+                    AppendBig(color, rows[0][i], 2);
+                else
+                    AppendBig(color, rows[0][0] >> (8 - params.bit_depth), 2);
+            }
+            AppendChunk(ret, "tRNS", color);
+        }
+
+        // Filter the rows.
+        std::vector<std::uint8_t> filtered;
+        std::vector<std::uint8_t> zero_row(row_bytes);
+        for (std::size_t y = 0; y < rows.size(); y++)
+        {
+            const std::vector<std::uint8_t> &cur = rows[y], &prev = y > 0 ? rows[y - 1] : zero_row;
+            std::uint8_t filter = std::uint8_t(gen() % 5);
+            filtered.push_back(filter);
+
+            for (std::size_t i = 0; i < row_bytes; i++)
+            {
+                int a = i >= filter_step ? cur[i - filter_step] : 0;
+                int b = prev[i];
+                int c = i >= filter_step ? prev[i - filter_step] : 0;
+                int predictor = 0;
+                switch (filter)
+                {
+                  case 1:
+                    predictor = a;
+                    break;
+                  case 2:
+                    predictor = b;
+                    break;
+                  case 3:
+                    predictor = (a + b) / 2;
+                    break;
+                  case 4:
+                    {
+                        int p = a + b - c;
+                        int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                        predictor = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+                    }
+                    break;
+                }
+                filtered.push_back(std::uint8_t(cur[i] - predictor));
+            }
+        }
+
+        std::vector<std::uint8_t> compressed(Archive::Raw::MaxCompressedSize(filtered.data(), filtered.data() + filtered.size()));
+        compressed.resize(std::size_t(Archive::Raw::Compress(filtered.data(), filtered.data() + filtered.size(), compressed.data(), compressed.data() + compressed.size()) - compressed.data()));
+
+        for (std::size_t pos = 0; pos < compressed.size();)
+        {
+            std::size_t chunk_size = std::min(compressed.size() - pos, std::size_t(1 + gen() % 100));
+            AppendChunk(ret, "IDAT", std::vector<std::uint8_t>(compressed.begin() + pos, compressed.begin() + pos + chunk_size));
+            pos += chunk_size;
+        }
+
+        AppendChunk(ret, "IEND", {});
+        return ret;
+    }
+
+    [[nodiscard]] Graphics::PngReader MakeReader(const std::vector<std::uint8_t> &file)
+    {
+        return Graphics::PngReader(Stream::ReadOnlyData::mem_reference(file));
+    }
+
+    // Decodes the image with stb_image.
+    [[nodiscard]] Graphics::Image ReferenceImage(const std::vector<std::uint8_t> &file)
+    {
+        return Graphics::Image(Stream::ReadOnlyData::mem_reference(file));
+    }
+
+    [[nodiscard]] bool SameRegion(const Graphics::Image &image, const Graphics::Image &reference, ivec2 reference_pos)
+    {
+        for (ivec2 pos : vector_range(image.Bounds()))
+        {
+            if (image.UnsafeAt(pos) != reference.UnsafeAt(reference_pos + pos))
+                return false;
+        }
+        return true;
+    }
+}
+
+TEST_CASE("png_reader.formats")
+{
+    std::mt19937 gen(42);
+
+    std::vector<PngParams> formats;
+    for (int depth : {1, 2, 4, 8, 16})
+    {
+        formats.push_back({.bit_depth = depth, .color_type = 0});
+        formats.push_back({.bit_depth = depth, .color_type = 0, .transparent_color = true});
+    }
+    for (int depth : {8, 16})
+    {
+        formats.push_back({.bit_depth = depth, .color_type = 2});
+        formats.push_back({.bit_depth = depth, .color_type = 2, .transparent_color = true});
+        formats.push_back({.bit_depth = depth, .color_type = 4});
+        formats.push_back({.bit_depth = depth, .color_type = 6});
+    }
+    for (int depth : {1, 2, 4, 8})
+    {
+        std::size_t palette_size = std::size_t(1) << depth;
+        formats.push_back({.bit_depth = depth, .color_type = 3, .palette_size = palette_size});
+        formats.push_back({.bit_depth = depth, .color_type = 3, .palette_size = palette_size, .palette_alpha_size = palette_size});
+        // A partial palette, and a partial `tRNS` chunk.
+        formats.push_back({.bit_depth = depth, .color_type = 3, .palette_size = palette_size / 2 + 1, .palette_alpha_size = palette_size / 4 + 1});
+    }
+
+    for (PngParams params : formats)
+    {
+        for (int i = 0; i < 10; i++)
+        {
+            // Include the widths that don't fill the last byte of a row.
+            params.size = ivec2(1 + int(gen() % 40), 1 + int(gen() % 20));
+            std::vector<std::uint8_t> file = RandomPng(gen, params);
+            Graphics::Image reference = ReferenceImage(file);
+
+            Graphics::PngReader reader = MakeReader(file);
+            REQUIRE(reader.Size() == params.size);
+            Graphics::Image image = reader.ReadImage();
+            REQUIRE(reader.NextRow() == params.size.y);
+            REQUIRE(image.Size() == reference.Size());
+            REQUIRE(std::equal(image.Pixels(), image.Pixels() + image.Size().prod(), reference.Pixels()));
+        }
+    }
+}
+
+TEST_CASE("png_reader.regions")
+{
+    std::mt19937 gen(42);
+
+    for (int i = 0; i < 50; i++)
+    {
+        std::vector<std::uint8_t> file = RandomPng(gen, {.size = ivec2(1 + int(gen() % 40), 1 + int(gen() % 40)), .bit_depth = i % 2 ? 8 : 16, .color_type = 6});
+        Graphics::Image reference = ReferenceImage(file);
+        Graphics::Image flipped_reference = Graphics::Image(Stream::ReadOnlyData::mem_reference(file), Graphics::Image::flip_y);
+
+        ivec2 a(int(gen() % reference.Size().x), int(gen() % reference.Size().y));
+        ivec2 b(a.x + 1 + int(gen() % (reference.Size().x - a.x)), a.y + 1 + int(gen() % (reference.Size().y - a.y)));
+        irect2 rect = a.rect_to(b);
+
+        // A new image.
+        Graphics::PngReader reader = MakeReader(file);
+        Graphics::Image region = reader.ReadRegion(rect);
+        REQUIRE(region.Size() == rect.size());
+        REQUIRE(SameRegion(region, reference, rect.a));
+        REQUIRE(reader.NextRow() == rect.b.y);
+
+        // An existing image, flipped.
+        reader = MakeReader(file);
+        Graphics::Image target(rect.size() + 2, u8vec4(1, 2, 3, 4));
+        reader.ReadRegion(rect, target, ivec2(1), Graphics::Image::flip_y);
+        for (ivec2 pos : vector_range(target.Bounds()))
+        {
+            if (pos.x == 0 || pos.y == 0 || pos.x == target.Size().x - 1 || pos.y == target.Size().y - 1)
+                REQUIRE(target.UnsafeAt(pos) == u8vec4(1, 2, 3, 4));
+            else
+                REQUIRE(target.UnsafeAt(pos) == flipped_reference.UnsafeAt(ivec2(rect.a.x, reference.Size().y - rect.b.y) + pos - 1));
+        }
+
+        // Row by row.
+        reader = MakeReader(file);
+        reader.SkipRows(rect.a.y);
+        std::vector<u8vec4> row(std::size_t(rect.size().x));
+        for (int y = rect.a.y; y < rect.b.y; y++)
+        {
+            REQUIRE(reader.NextRow() == y);
+            reader.ReadRow(row.data(), rect.a.x, rect.b.x);
+            for (int x = rect.a.x; x < rect.b.x; x++)
+                REQUIRE(row[std::size_t(x - rect.a.x)] == reference.UnsafeAt(ivec2(x, y)));
+        }
+    }
+}
+
+TEST_CASE("png_reader.errors")
+{
+    std::mt19937 gen(42);
+    std::vector<std::uint8_t> file = RandomPng(gen, {.size = ivec2(10, 8), .bit_depth = 8, .color_type = 2});
+
+    // Reading past the end, or above the next row.
+    Graphics::PngReader reader = MakeReader(file);
+    REQUIRE_THROWS_AS(reader.ReadRegion(ivec2(0).rect_size(ivec2(11, 1))), std::runtime_error);
+    reader.SkipRows(2);
+    REQUIRE_THROWS_AS(reader.ReadRegion(ivec2(0, 1).rect_size(ivec2(10, 1))), std::runtime_error);
+    REQUIRE_THROWS_AS(reader.SkipRows(7), std::runtime_error);
+
+    // A null reader.
+    REQUIRE_THROWS_AS(Graphics::PngReader{}.SkipRows(1), std::runtime_error);
+
+    // Not a PNG.
+    std::vector<std::uint8_t> broken = file;
+    broken[1] = 'X';
+    REQUIRE_THROWS_AS(MakeReader(broken), std::runtime_error);
+
+    // Interlaced images are rejected. The interlace method is the last byte of `IHDR`, which starts after the signature and the chunk header.
+    broken = file;
+    broken[8 + 8 + 12] = 1;
+    REQUIRE_THROWS_AS(MakeReader(broken), std::runtime_error);
+
+    // Truncated image data. The last 12 bytes are `IEND`.
+    broken = file;
+    broken.resize(broken.size() - 12 - 20);
+    reader = MakeReader(broken);
+    REQUIRE_THROWS_AS(reader.SkipRows(8), std::runtime_error);
+}
@@ -1,31 +1,44 @@
 #include "texture_atlas.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
 #include <vector>
 
 #include "meta/common.h"
+#include "stream/input.h"
+#include "stream/output.h"
 #include "strings/format.h"
+#include "utils/archive.h"
+#include "utils/hash.h"
 #include "utils/packing.h"
 
 namespace Graphics
 {
-    Image MakeAtlas(ivec2 target_size, std::function<void(AtlasInputFunc func)> func, AtlasFlags flags)
+    namespace
     {
-        // Load images.
         struct Elem
         {
+            Stream::ReadOnlyData data; // Encoded image, if any. Null after decoding.
             Image image; // Can be empty for empty images. But the size in `texcoords` is always correct.
             irect2 *texcoords = nullptr;
         };
+    }
+
+    // Collects the images. They are decoded later, in parallel.
+    static std::vector<Elem> CollectImages(const std::function<void(AtlasInputFunc func)> &func)
+    {
         std::vector<Elem> elem_list;
         func([&](std::variant<Stream::ReadOnlyData, ivec2> data, irect2 &texcoords)
         {
             Elem &new_elem = elem_list.emplace_back();
             new_elem.texcoords = &texcoords;
             std::visit(Meta::overload{
-                [&](const Stream::ReadOnlyData &data)
+                [&](Stream::ReadOnlyData &data)
                 {
-                    new_elem.image = data;
-                    texcoords = ivec2().rect_size(new_elem.image.Size());
+                    new_elem.data = std::move(data);
                 },
                 [&](ivec2 size)
                 {
@@ -33,6 +46,21 @@ namespace Graphics
                 },
             }, data);
         });
+        return elem_list;
+    }
+
+    static Image ComposeAtlas(ivec2 target_size, std::vector<Elem> &elem_list, AtlasFlags flags, ThreadPool &thread_pool)
+    {
+        // Decode images.
+        thread_pool.Run(elem_list.size(), [&](std::size_t i)
+        {
+            Elem &elem = elem_list[i];
+            if (!elem.data)
+                return;
+            elem.image = Image(std::move(elem.data));
+            elem.data = {};
+            *elem.texcoords = ivec2().rect_size(elem.image.Size());
+        });
 
         // Construct the rectangle list for packing.
         std::vector<Packing::Rect> rect_list;
@@ -44,18 +72,142 @@ namespace Graphics
         if (Packing::PackRects(target_size, rect_list.data(), rect_list.size(), bool(flags & AtlasFlags::add_gaps)))
             throw std::runtime_error(FMT("Unable to fit texture atlas into a {}x{} texture.", target_size.x, target_size.y));
 
-        // Construct the final image, and output the texture coords.
+        // Construct the final image. The rects don't overlap, so the images can be copied in parallel.
         Image ret = Image(target_size, u8vec4(0));
-        for (size_t i = 0; i < elem_list.size(); i++)
+        thread_pool.Run(elem_list.size(), [&](std::size_t i)
         {
-            // Copy the image, if any.
             if (elem_list[i].image)
                 ret.UnsafeDrawImage(elem_list[i].image, rect_list[i].pos);
+        });
 
-            // Output the coordinates.
+        // Output the texture coords.
+        for (size_t i = 0; i < elem_list.size(); i++)
             *elem_list[i].texcoords = rect_list[i].pos.rect_size(elem_list[i].texcoords->size());
+
+        return ret;
+    }
+
+    Image MakeAtlas(ivec2 target_size, std::function<void(AtlasInputFunc func)> func, AtlasFlags flags, ThreadPool &thread_pool)
+    {
+        std::vector<Elem> elem_list = CollectImages(func);
+        return ComposeAtlas(target_size, elem_list, flags, thread_pool);
+    }
+
+    // The atlas cache format (all integers are little-endian):
+    //     char[8] magic = "IMP-ATLC"
+    //     u32 version
+    //     u64 input_hash
+    //     u32 rect_count
+    //     `rect_count` times:
+    //         i32 x, y, w, h // Texture coordinates of the images, in the input order.
+    //     pixels // RGBA, compressed with `Archive::Parallel::Compress()`.
+    static constexpr char atlas_cache_magic[8] = {'I','M','P','-','A','T','L','C'};
+    static constexpr std::uint32_t atlas_cache_version = 2;
+
+    static std::uint64_t HashAtlasInputs(ivec2 target_size, AtlasFlags flags, const std::vector<Elem> &elem_list)
+    {
+        Hash::Stable hash;
+        hash.AppendInt<std::uint32_t>(atlas_cache_version).AppendInt<std::int32_t>(target_size.x).AppendInt<std::int32_t>(target_size.y);
+        hash.AppendInt<std::uint64_t>(std::uint64_t(flags)).AppendInt<std::uint64_t>(elem_list.size());
+        for (const Elem &elem : elem_list)
+        {
+            // The data size goes first, so that the boundaries between the images are unambiguous.
+            if (elem.data)
+                hash.AppendInt<std::uint8_t>(1).AppendInt<std::uint64_t>(elem.data.size()).AppendBytes(elem.data.data(), elem.data.size());
+            else
+                hash.AppendInt<std::uint8_t>(0).AppendInt<std::int32_t>(elem.texcoords->size().x).AppendInt<std::int32_t>(elem.texcoords->size().y);
         }
+        return hash.Result();
+    }
+
+    // Returns null if the cache is missing, is damaged, or doesn't match the inputs.
+    static std::optional<Image> LoadAtlasCache(const std::string &cache_file_name, std::uint64_t input_hash, ivec2 target_size, const std::vector<Elem> &elem_list)
+    {
+        try
+        {
+            Stream::Input input(cache_file_name);
+
+            char magic[sizeof atlas_cache_magic];
+            input.Read(magic, sizeof magic);
+            if (std::memcmp(magic, atlas_cache_magic, sizeof magic) != 0)
+                return {};
+            if (input.ReadLittle<std::uint32_t>() != atlas_cache_version)
+                return {};
+            if (input.ReadLittle<std::uint64_t>() != input_hash)
+                return {};
+            if (input.ReadLittle<std::uint32_t>() != elem_list.size())
+                return {};
+
+            std::vector<irect2> rects(elem_list.size());
+            for (irect2 &rect : rects)
+            {
+                ivec2 pos, size;
+                pos.x = input.ReadLittle<std::int32_t>();
+                pos.y = input.ReadLittle<std::int32_t>();
+                size.x = input.ReadLittle<std::int32_t>();
+                size.y = input.ReadLittle<std::int32_t>();
+                rect = pos.rect_size(size);
+            }
+
+            std::vector<std::uint8_t> compressed(input.RemainingBytes());
+            input.Read(compressed.data(), compressed.size());
+            if (Archive::Parallel::UncompressedSize(compressed.data(), compressed.data() + compressed.size()) != std::size_t(target_size.prod()) * sizeof(u8vec4))
+                return {};
+
+            Image ret(target_size);
+            if (ret)
+                Archive::Parallel::Uncompress(compressed.data(), compressed.data() + compressed.size(), reinterpret_cast<std::uint8_t *>(&ret.UnsafeAt(ivec2(0))));
+
+            // Only output the coords after everything else succeeds.
+            for (std::size_t i = 0; i < elem_list.size(); i++)
+                *elem_list[i].texcoords = rects[i];
+
+            return ret;
+        }
+        catch (...)
+        {
+            return {};
+        }
+    }
+
+    static void SaveAtlasCache(const std::string &cache_file_name, std::uint64_t input_hash, const Image &image, const std::vector<Elem> &elem_list)
+    {
+        try
+        {
+            const std::uint8_t *pixels_begin = image.Data();
+            const std::uint8_t *pixels_end = pixels_begin + image.Size().prod() * sizeof(u8vec4);
+            std::size_t capacity = Archive::Parallel::MaxCompressedSize(pixels_begin, pixels_end);
+            auto compressed = std::make_unique<std::uint8_t[]>(capacity);
+            std::uint8_t *compressed_end = Archive::Parallel::Compress(pixels_begin, pixels_end, compressed.get(), compressed.get() + capacity);
+
+            Stream::Output output(cache_file_name);
+            output.WriteString(atlas_cache_magic, sizeof atlas_cache_magic);
+            output.WriteLittle<std::uint32_t>(atlas_cache_version);
+            output.WriteLittle<std::uint64_t>(input_hash);
+            output.WriteLittle<std::uint32_t>(elem_list.size());
+            for (const Elem &elem : elem_list)
+            {
+                output.WriteLittle<std::int32_t>(elem.texcoords->a.x);
+                output.WriteLittle<std::int32_t>(elem.texcoords->a.y);
+                output.WriteLittle<std::int32_t>(elem.texcoords->size().x);
+                output.WriteLittle<std::int32_t>(elem.texcoords->size().y);
+            }
+            output.WriteBytes(compressed.get(), compressed_end - compressed.get());
+            output.Flush();
+        }
+        catch (...) {}
+    }
+
+    Image MakeAtlasCached(const std::string &cache_file_name, ivec2 target_size, std::function<void(AtlasInputFunc func)> func, AtlasFlags flags, ThreadPool &thread_pool)
+    {
+        std::vector<Elem> elem_list = CollectImages(func);
+
+        std::uint64_t input_hash = HashAtlasInputs(target_size, flags, elem_list);
+        if (std::optional<Image> cached = LoadAtlasCache(cache_file_name, input_hash, target_size, elem_list))
+            return std::move(*cached);
 
+        Image ret = ComposeAtlas(target_size, elem_list, flags, thread_pool);
+        SaveAtlasCache(cache_file_name, input_hash, ret, elem_list);
         return ret;
     }
 }
@@ -1,12 +1,14 @@
 #pragma once
 
 #include <functional>
+#include <string>
 #include <variant>
 
 #include "graphics/image.h"
 #include "macros/enum_flag_operators.h"
 #include "stream/readonly_data.h"
 #include "utils/mat.h"
+#include "utils/thread_pool.h"
 
 namespace Graphics
 {
@@ -24,5 +26,12 @@ namespace Graphics
 
     // Packs images into an atlas. Throws on failure.
     // Call the `func` you receive once for each image that needs to be loaded.
-    [[nodiscard]] Image MakeAtlas(ivec2 target_size, std::function<void(AtlasInputFunc func)> func, AtlasFlags flags = AtlasFlags::none);
+    // The images are decoded and copied into the atlas using `thread_pool`. The packing doesn't depend on it, and is deterministic.
+    [[nodiscard]] Image MakeAtlas(ivec2 target_size, std::function<void(AtlasInputFunc func)> func, AtlasFlags flags = AtlasFlags::none, ThreadPool &thread_pool = ThreadPool::Global());
+
+    // Same as `MakeAtlas()`, but caches the result in a file.
+    // If the file was created from the same inputs (image file contents, sizes of empty images, the target size and the flags), the atlas is loaded from it, without decoding or packing anything.
+    // Otherwise the atlas is built as usual, and the file is rewritten. Failing to read or write the file is not an error.
+    // Note that the contents of empty images are not cached, since the caller draws them.
+    [[nodiscard]] Image MakeAtlasCached(const std::string &cache_file_name, ivec2 target_size, std::function<void(AtlasInputFunc func)> func, AtlasFlags flags = AtlasFlags::none, ThreadPool &thread_pool = ThreadPool::Global());
 }
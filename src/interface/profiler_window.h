@@ -0,0 +1,171 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <string_view>
+#include <string>
+#include <vector>
+
+#include <imgui.h>
+
+#include "macros/finally.h"
+#include "strings/format.h"
+#include "utils/clock.h"
+#include "utils/profiler.h"
+
+// An ImGui window showing the results of `Profiler::Collector` as a flame graph, one per thread.
+// The width of each zone is proportional to its time in the frame, and the zones called from it are drawn below it.
+// Usage:
+//     Interface::ProfilerWindow profiler_window;
+//     // In `Tick()`, between `ImGuiController::PreTick()` and `PreRender()`:
+//     profiler_window.Show(profiler);
+
+namespace Interface
+{
+    class ProfilerWindow
+    {
+        int selected_frame = 0; // Counted backwards from the newest frame.
+        std::string export_status;
+
+        static constexpr float row_height = 18;
+
+        [[nodiscard]] static ImU32 ZoneColor(const char *name)
+        {
+            std::size_t hash = std::hash<std::string_view>{}(name ? name : "");
+            return ImColor::HSV((hash % 1024) / 1024.f, 0.45f, 0.75f);
+        }
+
+        [[nodiscard]] static int TreeDepth(const Profiler::ThreadTree &tree, std::size_t index)
+        {
+            int ret = 0;
+            for (std::size_t child : tree.nodes[index].children)
+                ret = std::max(ret, TreeDepth(tree, child) + 1);
+            return ret;
+        }
+
+        static void DrawNode(const Profiler::ThreadTree &tree, std::size_t index, fvec2 pos, double pixels_per_tick, std::uint64_t frame_duration)
+        {
+            const Profiler::Node &node = tree.nodes[index];
+
+            float width = float(node.duration * pixels_per_tick);
+            if (width < 1)
+                return;
+
+            ImDrawList &draw_list = *ImGui::GetWindowDrawList();
+            fvec2 a = pos, b = pos + fvec2(width - 1, row_height - 1);
+            draw_list.AddRectFilled(a, b, ZoneColor(node.name));
+
+            fvec4 clip_rect(a.x, a.y, b.x, b.y);
+            ImVec4 im_clip_rect = clip_rect;
+            draw_list.AddText(nullptr, 0, a + fvec2(3, 2), IM_COL32(0, 0, 0, 255), node.name, nullptr, 0, &im_clip_rect);
+
+            if (ImGui::IsWindowHovered() && ImGui::IsMouseHoveringRect(a, b))
+            {
+                ImGui::BeginTooltip();
+                ImGui::TextUnformatted(node.name);
+                ImGui::Text("%.3f ms, %.1f%% of frame", Clock::TicksToSeconds(node.duration) * 1000, node.duration * 100.0 / std::max(frame_duration, std::uint64_t(1)));
+                ImGui::Text("%u call(s)", unsigned(node.calls));
+                ImGui::EndTooltip();
+            }
+
+            // Draw the children below, left to right.
+            fvec2 child_pos = pos + fvec2(0, row_height);
+            for (std::size_t child : node.children)
+            {
+                DrawNode(tree, child, child_pos, pixels_per_tick, frame_duration);
+                child_pos.x += float(tree.nodes[child].duration * pixels_per_tick);
+            }
+        }
+
+      public:
+        ProfilerWindow() {}
+
+        // Shows the window. If `open` isn't null, the window has a close button that sets it to false.
+        // The export button saves the frame history to `export_file_name`, see `Profiler::Collector::SaveFoldedStacks()`.
+        void Show(Profiler::Collector &collector, bool *open = nullptr, const std::string &export_file_name = "profile.folded")
+        {
+            FINALLY{ImGui::End();};
+            if (!ImGui::Begin("Profiler", open))
+                return;
+
+            if (!IMP_PROFILER_ENABLED)
+            {
+                ImGui::TextUnformatted("The profiler is disabled in this build (see `IMP_PROFILER_ENABLED`).");
+                return;
+            }
+
+            bool paused = collector.IsPaused();
+            if (ImGui::Checkbox("Pause", &paused))
+                collector.SetPaused(paused);
+            ImGui::SameLine();
+            if (ImGui::Button("Export"))
+            {
+                try
+                {
+                    collector.SaveFoldedStacks(export_file_name);
+                    export_status = FMT("Saved to `{}`.", export_file_name);
+                }
+                catch (std::exception &e)
+                {
+                    export_status = e.what();
+                }
+            }
+            if (!export_status.empty())
+            {
+                ImGui::SameLine();
+                ImGui::TextUnformatted(export_status.c_str());
+            }
+
+            const auto &frames = collector.Frames();
+            if (frames.empty())
+            {
+                ImGui::TextUnformatted("No frames yet. Call `Profiler::Collector::EndFrame()` once per frame.");
+                return;
+            }
+
+            // The frame times, oldest to newest.
+            std::vector<float> frame_times;
+            frame_times.reserve(frames.size());
+            for (const Profiler::Frame &frame : frames)
+                frame_times.push_back(float(Clock::TicksToSeconds(frame.duration) * 1000));
+            ImGui::PlotHistogram("##frame_times", frame_times.data(), int(frame_times.size()), 0, "Frame times (ms)", 0, FLT_MAX, fvec2(ImGui::GetContentRegionAvail().x, 48));
+
+            // Only allow selecting older frames when paused, since otherwise they scroll away.
+            if (paused)
+                ImGui::SliderInt("Frames ago", &selected_frame, 0, int(frames.size()) - 1);
+            else
+                selected_frame = 0;
+            selected_frame = std::clamp(selected_frame, 0, int(frames.size()) - 1);
+            const Profiler::Frame &frame = frames[frames.size() - 1 - std::size_t(selected_frame)];
+
+            ImGui::Text("Frame: %.3f ms", Clock::TicksToSeconds(frame.duration) * 1000);
+            if (std::uint64_t dropped = collector.DroppedZones())
+            {
+                ImGui::SameLine();
+                ImGui::Text("(%llu zones dropped in total, the buffers were full)", (unsigned long long)dropped);
+            }
+
+            for (const Profiler::ThreadTree &tree : frame.threads)
+            {
+                ImGui::Separator();
+                ImGui::TextUnformatted(tree.thread_name.c_str());
+
+                const Profiler::Node &root = tree.nodes.front();
+                float width = std::max(ImGui::GetContentRegionAvail().x, 1.f);
+                double pixels_per_tick = width / double(std::max({frame.duration, root.duration, std::uint64_t(1)}));
+
+                fvec2 pos = ImGui::GetCursorScreenPos();
+                for (std::size_t child : root.children)
+                {
+                    DrawNode(tree, child, pos, pixels_per_tick, frame.duration);
+                    pos.x += float(tree.nodes[child].duration * pixels_per_tick);
+                }
+
+                ImGui::Dummy(fvec2(width, TreeDepth(tree, 0) * row_height));
+            }
+        }
+    };
+}
@@ -0,0 +1,183 @@
+#include "frame_timings.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "program/errors.h"
+#include "strings/format.h"
+#include "utils/clock.h"
+
+namespace Program
+{
+    const char *FrameTimings::PhaseName(Phase phase)
+    {
+        switch (phase)
+        {
+            case Phase::begin_frame: return "BeginFrame";
+            case Phase::tick:        return "Tick";
+            case Phase::render:      return "Render";
+            case Phase::end_frame:   return "EndFrame";
+            case Phase::sleep:       return "Sleep";
+        }
+
+        ASSERT(false, "Invalid frame phase.");
+        return "";
+    }
+
+    FrameTimings::Percentiles FrameTimings::ComputePercentiles(std::vector<std::uint64_t> durations)
+    {
+        Percentiles ret;
+        if (durations.empty())
+            return ret;
+
+        // Nearest-rank percentiles.
+        auto Percentile = [&](double fraction)
+        {
+            std::size_t rank = std::size_t(std::ceil(fraction * double(durations.size())));
+            auto it = durations.begin() + std::ptrdiff_t(std::clamp(rank, std::size_t(1), durations.size()) - 1);
+            std::nth_element(durations.begin(), it, durations.end());
+            return Clock::TicksToSeconds(*it);
+        };
+
+        ret.p50 = Percentile(0.5);
+        ret.p99 = Percentile(0.99);
+        ret.max = Clock::TicksToSeconds(*std::max_element(durations.begin(), durations.end()));
+        return ret;
+    }
+
+    FrameTimings::FrameTimings(std::size_t capacity)
+    {
+        frames.resize(capacity);
+    }
+
+    const FrameTimings::Frame &FrameTimings::operator[](std::size_t index) const
+    {
+        ASSERT(index < num_frames, "Frame timing index is out of range.");
+        return frames[(next_frame + frames.size() - num_frames + index) % frames.size()];
+    }
+
+    void FrameTimings::AddFrame(const Frame &frame)
+    {
+        if (log)
+        {
+            double ticks_per_us = Clock::TicksPerSecond() / 1e6;
+            std::string line = FMT("{},{:.3f},{}", total_frames, frame.span.duration / ticks_per_us, frame.ticks);
+            for (const Span &span : frame.phases)
+                line += FMT(",{:.3f}", span.duration / ticks_per_us);
+            line += FMT(",{:d},{:d}\n", frame.missed_ticks, frame.pipelined);
+            log.GetStream().WriteString(line);
+        }
+
+        total_frames++;
+        if (frame.missed_ticks)
+            missed_tick_frames++;
+
+        if (frames.empty())
+            return;
+
+        frames[next_frame] = frame;
+        next_frame = (next_frame + 1) % frames.size();
+        if (num_frames < frames.size())
+            num_frames++;
+    }
+
+    void FrameTimings::Clear()
+    {
+        next_frame = 0;
+        num_frames = 0;
+        total_frames = 0;
+        missed_tick_frames = 0;
+    }
+
+    FrameTimings::Percentiles FrameTimings::FramePercentiles() const
+    {
+        std::vector<std::uint64_t> durations(num_frames);
+        for (std::size_t i = 0; i < num_frames; i++)
+            durations[i] = (*this)[i].span.duration;
+        return ComputePercentiles(std::move(durations));
+    }
+
+    FrameTimings::Percentiles FrameTimings::PhasePercentiles(Phase phase) const
+    {
+        std::vector<std::uint64_t> durations(num_frames);
+        for (std::size_t i = 0; i < num_frames; i++)
+            durations[i] = (*this)[i].GetPhase(phase).duration;
+        return ComputePercentiles(std::move(durations));
+    }
+
+    void FrameTimings::WriteChromeTrace(Stream::Output &output) const
+    {
+        // The timestamps are in microseconds, relative to the earliest recorded event.
+        std::uint64_t origin = -1;
+        for (std::size_t i = 0; i < num_frames; i++)
+        {
+            const Frame &frame = (*this)[i];
+            origin = std::min(origin, frame.span.start);
+            if (frame.GetPhase(Phase::tick).duration > 0)
+                origin = std::min(origin, frame.GetPhase(Phase::tick).start);
+        }
+        double ticks_per_us = Clock::TicksPerSecond() / 1e6;
+
+        constexpr int main_thread = 1, tick_thread = 2;
+
+        auto WriteEvent = [&](const char *name, int thread, const Span &span, const std::string &args)
+        {
+            output.WriteString(FMT(",\n" R"({{"name":"{}","cat":"frame","ph":"X","pid":1,"tid":{},"ts":{:.3f},"dur":{:.3f}{}}})",
+                name, thread, (span.start - origin) / ticks_per_us, span.duration / ticks_per_us, args));
+        };
+
+        output.WriteString(R"({"displayTimeUnit":"ms","traceEvents":[)");
+
+        output.WriteString(FMT("\n" R"({{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":"Main"}}}})", main_thread));
+        output.WriteString(FMT(",\n" R"({{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":"Ticks"}}}})", tick_thread));
+
+        for (std::size_t i = 0; i < num_frames; i++)
+        {
+            const Frame &frame = (*this)[i];
+            WriteEvent("Frame", main_thread, frame.span, FMT(R"(,"args":{{"ticks":{}}})", frame.ticks));
+
+            for (std::size_t j = 0; j < num_phases; j++)
+            {
+                Phase phase = Phase(j);
+                const Span &span = frame.GetPhase(phase);
+                if (span.duration == 0)
+                    continue;
+                WriteEvent(PhaseName(phase), phase == Phase::tick && frame.pipelined ? tick_thread : main_thread, span, "");
+            }
+
+            if (frame.missed_ticks)
+            {
+                output.WriteString(FMT(",\n" R"({{"name":"MissedTicks","cat":"frame","ph":"i","s":"g","pid":1,"tid":{},"ts":{:.3f}}})",
+                    main_thread, (frame.span.start - origin) / ticks_per_us));
+            }
+        }
+
+        output.WriteString("\n]}\n");
+    }
+
+    void FrameTimings::SaveChromeTrace(const std::string &file_name) const
+    {
+        Stream::Output output(file_name, Stream::text);
+        WriteChromeTrace(output);
+        output.Flush();
+    }
+
+    void FrameTimings::StartLog(Stream::Output target)
+    {
+        StopLog();
+
+        log = Stream::AsyncOutput(std::move(target));
+        std::string header = "frame,frame_us,ticks";
+        for (std::size_t i = 0; i < num_phases; i++)
+            header += FMT(",{}_us", PhaseName(Phase(i)));
+        header += ",missed_ticks,pipelined\n";
+        log.GetStream().WriteString(header);
+    }
+
+    void FrameTimings::StopLog()
+    {
+        if (log)
+            log.Finish();
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "stream/async_output.h"
+#include "stream/output.h"
+
+// Records how long each part of a frame takes, for the last N frames.
+// `DefaultBasicState` fills it automatically, if you return it from `GetFrameTimings()`.
+// Usage:
+//     Program::FrameTimings timings = Program::FrameTimings(1024);
+//     Program::FrameTimings *GetFrameTimings() override {return &timings;}
+//     // Later:
+//     auto render = timings.PhasePercentiles(Program::FrameTimings::Phase::render);
+//     Log(FMT("p50={}s p99={}s max={}s", render.p50, render.p99, render.max));
+//     timings.SaveChromeTrace("frames.json"); // Open in `chrome://tracing` or Perfetto.
+// To record every frame rather than the last N, use `StartLog()`.
+
+namespace Program
+{
+    class FrameTimings
+    {
+      public:
+        enum class Phase
+        {
+            begin_frame,
+            tick, // All ticks of the frame together.
+            render,
+            end_frame,
+            sleep, // The FPS cap delay.
+        };
+        static constexpr std::size_t num_phases = 5;
+
+        [[nodiscard]] static const char *PhaseName(Phase phase);
+
+        // A time interval, in clock ticks (see `Clock::Time()`).
+        struct Span
+        {
+            std::uint64_t start = 0;
+            std::uint64_t duration = 0;
+        };
+
+        struct Frame
+        {
+            Span span; // The whole frame, including the sleep.
+            std::array<Span, num_phases> phases{}; // Indexed by `Phase`. The phases that didn't happen have zero duration.
+            int ticks = 0; // How many ticks were performed.
+            bool missed_ticks = false; // The metronome hit its limit of ticks per frame, so some time was dropped (see `Metronome::Lag()`).
+            bool pipelined = false; // The ticks ran on a separate thread (see `DefaultBasicState::PipelineTicks()`), and `tick` is the batch of ticks published in this frame.
+
+            [[nodiscard]] const Span &GetPhase(Phase phase) const
+            {
+                return phases[std::size_t(phase)];
+            }
+            [[nodiscard]] Span &GetPhase(Phase phase)
+            {
+                return phases[std::size_t(phase)];
+            }
+        };
+
+        // Durations in seconds.
+        struct Percentiles
+        {
+            double p50 = 0;
+            double p99 = 0;
+            double max = 0;
+        };
+
+      private:
+        std::vector<Frame> frames; // A ring buffer.
+        std::size_t next_frame = 0; // The index in `frames` where the next frame is written.
+        std::size_t num_frames = 0;
+        std::uint64_t total_frames = 0;
+        std::uint64_t missed_tick_frames = 0;
+        Stream::AsyncOutput log; // See `StartLog()`.
+
+        [[nodiscard]] static Percentiles ComputePercentiles(std::vector<std::uint64_t> durations);
+
+      public:
+        FrameTimings() {}
+
+        // Remembers the last `capacity` frames. The counters (`TotalFrames()` and `MissedTickFrames()`) cover all frames.
+        explicit FrameTimings(std::size_t capacity);
+
+        [[nodiscard]] std::size_t Capacity() const {return frames.size();}
+        [[nodiscard]] std::size_t Size() const {return num_frames;}
+
+        // The frames are ordered from the oldest to the newest.
+        [[nodiscard]] const Frame &operator[](std::size_t index) const;
+
+        [[nodiscard]] std::uint64_t TotalFrames() const {return total_frames;}
+        [[nodiscard]] std::uint64_t MissedTickFrames() const {return missed_tick_frames;}
+
+        // Does nothing if the capacity is zero, except for updating the counters and the log.
+        void AddFrame(const Frame &frame);
+
+        // Forgets the frames and resets the counters.
+        void Clear();
+
+        // The durations of the whole frames, including the sleep.
+        [[nodiscard]] Percentiles FramePercentiles() const;
+        // The durations of a single phase. The frames where it didn't happen are counted as zeroes.
+        [[nodiscard]] Percentiles PhasePercentiles(Phase phase) const;
+
+        // Writes the frames in the Chrome trace event format (a JSON file that `chrome://tracing` and Perfetto can open).
+        // The pipelined ticks are shown on a separate thread, and the frames with missed ticks are marked with instant events.
+        void WriteChromeTrace(Stream::Output &output) const;
+        // Same, but writes to a file. Throws on failure.
+        void SaveChromeTrace(const std::string &file_name) const;
+
+        // Starts writing each added frame to `target` as a CSV line: the frame number, the durations of the frame and of each phase in microseconds, and the flags.
+        // The first line is the header. Stops the previous log first, if any.
+        // The log is written on a background thread (see `Stream::AsyncOutput`), so a slow disk doesn't stall the frames.
+        // The write errors are reported by `StopLog()`.
+        void StartLog(Stream::Output target);
+        // Writes the rest of the log, and closes the target. Throws if writing failed. Does nothing if there's no log.
+        void StopLog();
+        [[nodiscard]] bool IsLogging() const {return bool(log);}
+    };
+}
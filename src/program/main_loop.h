@@ -1,8 +1,14 @@
 #pragma once
 
+#include <array>
+#include <condition_variable>
 #include <cstdint>
+#include <exception>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <thread>
 #include <type_traits>
 #include <utility>
 
@@ -10,6 +16,7 @@
 
 #include "interface/window.h"
 #include "macros/finally.h"
+#include "program/frame_timings.h"
 #include "utils/clock.h"
 #include "utils/metronome.h"
 
@@ -43,14 +50,186 @@ namespace Program
         }
     };
 
+    // Stores the render-relevant state of the last two ticks, for the pipelined mode of `DefaultBasicState` (see `PipelineTicks()`).
+    // The tick thread calls `Push()` after each tick, then the main thread calls `Publish()` from `PublishTickState()`,
+    // and then `Render()` interpolates between `Previous()` and `Current()` using `TickInterpolationFactor()`.
+    template <typename T>
+    class TickSnapshots
+    {
+        std::array<T, 2> tick_side; // Written by the tick thread. The older snapshot goes first.
+        std::array<T, 2> render_side; // Read by the render thread.
+
+      public:
+        TickSnapshots() {}
+
+        // Call on the tick thread, after each tick.
+        void Push(T snapshot)
+        {
+            tick_side[0] = std::move(tick_side[1]);
+            tick_side[1] = std::move(snapshot);
+        }
+
+        // Call when neither thread is using the snapshots, i.e. from `PublishTickState()`.
+        void Publish()
+        {
+            render_side = tick_side;
+        }
+
+        // The snapshots of the two last published ticks, for rendering.
+        [[nodiscard]] const T &Previous() const {return render_side[0];}
+        [[nodiscard]] const T &Current() const {return render_side[1];}
+    };
+
     class DefaultBasicState : public BasicState
     {
+        // Runs the ticks in the pipelined mode.
+        struct TickThread
+        {
+            std::thread thread;
+
+            std::mutex mutex; // Protects everything below.
+            std::condition_variable start_cond, finish_cond;
+            bool stop = false;
+            bool busy = false;
+            std::uint64_t delta = 0; // The time for the metronome, passed to the thread along with the job.
+            bool timed = false; // Same, whether to record `last_tick_batch`.
+            std::exception_ptr exception; // Thrown by the last job.
+
+            TickThread() {}
+            TickThread(const TickThread &) = delete;
+            TickThread &operator=(const TickThread &) = delete;
+
+            ~TickThread()
+            {
+                {
+                    std::unique_lock lock(mutex);
+                    finish_cond.wait(lock, [&]{return !busy;});
+                    stop = true;
+                }
+                start_cond.notify_one();
+                thread.join();
+            }
+        };
+        std::unique_ptr<TickThread> tick_thread; // Created on the first pipelined frame.
+
         bool executing_frame = false;
         std::uint64_t frame_start = -1;
+        std::uint64_t pending_tick_delta = 0; // The time that wasn't given to the tick thread yet, because it was busy.
+        double tick_interpolation_factor = 1;
+        Clock::PreciseWaiter fps_cap_waiter;
+
+        // The timing of the last batch of ticks, for `GetFrameTimings()`.
+        struct TickBatchTiming
+        {
+            FrameTimings::Span span;
+            int ticks = 0;
+            bool missed_ticks = false;
+        };
+        TickBatchTiming last_tick_batch;
+
+        // Runs the ticks for one frame: either as many as the metronome wants, or exactly one if there's no metronome.
+        // If `timed` is true, records the timing into `last_tick_batch`.
+        void RunTicks(Metronome *metronome, std::uint64_t delta, bool timed)
+        {
+            std::uint64_t start = timed ? Clock::Time() : 0;
+            std::uint64_t lag_count = metronome ? metronome->LagCount() : 0;
+            int ticks = 0;
+
+            if (metronome)
+            {
+                while (metronome->Tick(delta))
+                {
+                    Tick();
+                    ticks++;
+                }
+            }
+            else
+            {
+                Tick();
+                ticks++;
+            }
+
+            if (timed)
+            {
+                last_tick_batch.span.start = start;
+                last_tick_batch.span.duration = Clock::Time() - start;
+                last_tick_batch.ticks = ticks;
+                last_tick_batch.missed_ticks = metronome && metronome->LagCount() != lag_count;
+            }
+        }
+
+        // Returns true if the tick thread doesn't exist or has finished its job, rethrowing the exception from it if any.
+        [[nodiscard]] bool TickThreadIdle(bool wait)
+        {
+            if (!tick_thread)
+                return true;
+
+            std::unique_lock lock(tick_thread->mutex);
+            if (wait)
+                tick_thread->finish_cond.wait(lock, [&]{return !tick_thread->busy;});
+            else if (tick_thread->busy)
+                return false;
+
+            if (tick_thread->exception)
+                std::rethrow_exception(std::exchange(tick_thread->exception, nullptr));
+            return true;
+        }
+
+        void StartTickThreadJob(std::uint64_t delta, bool timed)
+        {
+            if (!tick_thread)
+            {
+                tick_thread = std::make_unique<TickThread>();
+                tick_thread->thread = std::thread([this, &data = *tick_thread]
+                {
+                    std::unique_lock lock(data.mutex);
+                    while (true)
+                    {
+                        data.start_cond.wait(lock, [&]{return data.stop || data.busy;});
+                        if (data.stop)
+                            return;
+
+                        lock.unlock();
+                        std::exception_ptr exception;
+                        try
+                        {
+                            RunTicks(GetTickMetronome(), data.delta, data.timed);
+                        }
+                        catch (...)
+                        {
+                            exception = std::current_exception();
+                        }
+                        lock.lock();
+
+                        data.exception = exception;
+                        data.busy = false;
+                        data.finish_cond.notify_one();
+                    }
+                });
+            }
+
+            {
+                std::lock_guard lock(tick_thread->mutex);
+                tick_thread->busy = true;
+                tick_thread->delta = delta;
+                tick_thread->timed = timed;
+            }
+            tick_thread->start_cond.notify_one();
+        }
 
       protected:
         bool stop = false;
 
+        // Waits for the pipelined ticks to finish (ignoring the exceptions from them), and joins the tick thread, if any.
+        // This is called automatically when the loop stops. The thread would otherwise only be joined by the destructor of this class,
+        // after the derived class is already destroyed, while the thread might still be calling its `Tick()`.
+        // So if your state can be destroyed without stopping the loop (e.g. with `Program::Exit()`), call this in its destructor.
+        // The thread is restarted on the next pipelined frame, if any.
+        void StopTickThread()
+        {
+            tick_thread = nullptr;
+        }
+
       public:
         // Returns the tick metronome, or `nullptr` if want to run one tick per frame.
         // The intended way of overriding is to add a metronome as a class member, and return a pointer to it.
@@ -72,10 +251,46 @@ namespace Program
         // FPS is capped by adding a delay after frames that are too short.
         // The delay will be partially created using a `sleep` function, and partially using a busy loop.
         // This function returns the preferred duration of the busy loop.
+        // If it returns `fps_cap_adaptive_busy_loop` (the default), the busy loop is as short as the measured imprecision of `sleep` allows (see `Clock::PreciseWaiter`).
         // If it returns -1, the busy loop will not be used. It lowers CPU load, but might make the timing less precise.
         // If it returns 0, the busy loop will be used as little as possible.
         // If it returns a large value, `sleep` will not be used at all, which increases CPU loads but improves precision.
-        virtual int GetFpsCapPreferredBusyLoopDurationMs() {return 1;}
+        virtual int GetFpsCapPreferredBusyLoopDurationMs() {return fps_cap_adaptive_busy_loop;}
+        static constexpr int fps_cap_adaptive_busy_loop = -2;
+
+        // The waiter used by the FPS cap in the adaptive mode (see `GetFpsCapPreferredBusyLoopDurationMs()`).
+        // Check its statistics to see how much time was spent sleeping vs busy-waiting.
+        [[nodiscard]] const Clock::PreciseWaiter &GetFpsCapWaiter() const
+        {
+            return fps_cap_waiter;
+        }
+
+        // Returns the frame timing recorder, or `nullptr` if the timings shouldn't be recorded.
+        // Like with the metronome, the intended way of overriding is to add a `FrameTimings` as a class member, and return a pointer to it.
+        virtual FrameTimings *GetFrameTimings() {return nullptr;}
+
+        // If this returns true, the ticks run on a separate thread, in parallel with `Render()`.
+        // Each frame, the ticks for that frame are started on the tick thread, and then the result of the previous batch of ticks is rendered.
+        // This adds one frame of latency, but the frame time becomes the longest of tick and render times rather than their sum.
+        // If the ticks take longer than a frame, the frames keep being rendered from the last published state, instead of waiting for them.
+        // In this mode, `Tick()` must not call anything that has to run on the main thread (such as processing window events, or any rendering),
+        // and `Render()`, `BeginFrame()` and `EndFrame()` must not touch the state modified by the ticks. Instead, the ticks should save
+        // the render-relevant state into snapshots (see `TickSnapshots`), which `PublishTickState()` then hands to `Render()`.
+        // `Tick()` also shouldn't call `Program::Exit()`, since that would destroy the state while it's being rendered. Set `stop` instead.
+        // The value can change between frames. When it becomes false, the pending ticks are finished before the next frame.
+        virtual bool PipelineTicks() {return false;}
+
+        // Called on the main thread in the pipelined mode (see `PipelineTicks()`), before starting a new batch of ticks,
+        // when neither the ticks nor the rendering are running. Should make the state saved by the ticks visible to `Render()`.
+        virtual void PublishTickState() {}
+
+        // In the pipelined mode (see `PipelineTicks()`), returns the fractional time point between the two last published ticks,
+        // for interpolating between them in `Render()`. Otherwise returns the fractional time point after the current tick.
+        // If there's no metronome, returns 1.
+        [[nodiscard]] double TickInterpolationFactor() const
+        {
+            return tick_interpolation_factor;
+        }
 
         bool RunSingleFrame() override
         {
@@ -88,10 +303,11 @@ namespace Program
             auto *metronome = GetTickMetronome();
             auto fps_cap = GetFpsCap();
             bool have_fps_cap = fps_cap > 0;
+            auto *timings = GetFrameTimings();
 
             // Compute timings if needed.
             std::uint64_t delta = 0;
-            if (metronome || have_fps_cap)
+            if (metronome || have_fps_cap || timings)
             {
                 std::uint64_t new_frame_start = Clock::Time();
 
@@ -101,25 +317,78 @@ namespace Program
                 frame_start = new_frame_start;
             }
 
+            // Records the duration of a part of the frame, if needed.
+            FrameTimings::Frame frame_timing;
+            auto TimePhase = [&](FrameTimings::Phase phase, auto &&func)
+            {
+                if (!timings)
+                {
+                    func();
+                    return;
+                }
+                FrameTimings::Span &span = frame_timing.GetPhase(phase);
+                span.start = Clock::Time();
+                func();
+                span.duration = Clock::Time() - span.start;
+            };
+            // Copies the timing of the last batch of ticks into `frame_timing`.
+            auto SaveTickTiming = [&]
+            {
+                frame_timing.GetPhase(FrameTimings::Phase::tick) = last_tick_batch.span;
+                frame_timing.ticks = last_tick_batch.ticks;
+                frame_timing.missed_ticks = last_tick_batch.missed_ticks;
+            };
+
             // Begin frame.
-            BeginFrame();
+            TimePhase(FrameTimings::Phase::begin_frame, [&]{BeginFrame();});
 
-            // Tick.
-            if (metronome)
+            bool pipelined = PipelineTicks();
+            bool stop_requested = false;
+
+            // If something throws while the ticks are running, stop them, since they might use the state that's about to be destroyed.
+            FINALLY_ON_THROW{StopTickThread();};
+
+            if (pipelined)
             {
-                while (metronome->Tick(delta))
-                    Tick();
+                pending_tick_delta += delta;
+
+                // Publish the results of the previous ticks and start new ones, unless the tick thread is still busy.
+                // If it is, we render the same state again, and the time is given to the next batch of ticks.
+                if (TickThreadIdle(false))
+                {
+                    stop_requested = stop;
+                    tick_interpolation_factor = metronome ? metronome->Time() : 1;
+                    PublishTickState();
+                    if (timings && std::exchange(last_tick_batch.ticks, 0) > 0)
+                    {
+                        frame_timing.pipelined = true;
+                        SaveTickTiming();
+                    }
+                    if (!stop_requested)
+                        StartTickThreadJob(std::exchange(pending_tick_delta, 0), timings != nullptr);
+                }
+
+                // Render, while the ticks are running.
+                TimePhase(FrameTimings::Phase::render, [&]{Render();});
             }
             else
             {
-                Tick();
-            }
+                // Finish the ticks from the pipelined mode, if it was just disabled.
+                (void)TickThreadIdle(true);
+                delta += std::exchange(pending_tick_delta, 0);
+
+                // Tick.
+                RunTicks(metronome, delta, timings != nullptr);
+                tick_interpolation_factor = metronome ? metronome->Time() : 1;
+                if (timings)
+                    SaveTickTiming();
 
-            // Render.
-            Render();
+                // Render.
+                TimePhase(FrameTimings::Phase::render, [&]{Render();});
+            }
 
             // End frame.
-            EndFrame();
+            TimePhase(FrameTimings::Phase::end_frame, [&]{EndFrame();});
 
             // Cap FPS.
             if (have_fps_cap)
@@ -131,28 +400,52 @@ namespace Program
                 // If necessary, add a delay.
                 if (frame_len < desired_frame_len)
                 {
-                    int sleep_ms = (desired_frame_len - frame_len) * 1000 / clock_ticks_per_sec;
+                    TimePhase(FrameTimings::Phase::sleep, [&]
+                    {
+                        auto busy_loop_len_ms = GetFpsCapPreferredBusyLoopDurationMs();
 
-                    auto busy_loop_len_ms = GetFpsCapPreferredBusyLoopDurationMs();
-                    bool busy_loop_allowed = busy_loop_len_ms >= 0;
+                        if (busy_loop_len_ms == fps_cap_adaptive_busy_loop)
+                        {
+                            fps_cap_waiter.WaitUntil(frame_start + desired_frame_len);
+                            return;
+                        }
 
-                    if (busy_loop_allowed)
-                        sleep_ms -= busy_loop_len_ms;
+                        int sleep_ms = (desired_frame_len - frame_len) * 1000 / clock_ticks_per_sec;
 
-                    // Sleep.
-                    if (sleep_ms > 0)
-                        SDL_Delay(sleep_ms);
+                        bool busy_loop_allowed = busy_loop_len_ms >= 0;
 
-                    // Busy loop.
-                    if (busy_loop_allowed)
-                    {
-                        std::uint64_t busy_loop_end = frame_start + desired_frame_len;
-                        while (Clock::Time() < busy_loop_end) {}
-                    }
+                        if (busy_loop_allowed)
+                            sleep_ms -= busy_loop_len_ms;
+
+                        // Sleep.
+                        if (sleep_ms > 0)
+                            SDL_Delay(sleep_ms);
+
+                        // Busy loop.
+                        if (busy_loop_allowed)
+                        {
+                            std::uint64_t busy_loop_end = frame_start + desired_frame_len;
+                            while (Clock::Time() < busy_loop_end) {}
+                        }
+                    });
                 }
             }
 
-            return !stop;
+            // Record the frame timing.
+            if (timings)
+            {
+                frame_timing.span.start = frame_start;
+                frame_timing.span.duration = Clock::Time() - frame_start;
+                timings->AddFrame(frame_timing);
+            }
+
+            // In the pipelined mode, `stop` was checked above, when the ticks weren't running. Otherwise check it at the very end of the frame.
+            if (!pipelined)
+                stop_requested = stop;
+
+            if (stop_requested)
+                StopTickThread();
+            return !stop_requested;
         }
     };
 }
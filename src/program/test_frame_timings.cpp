@@ -0,0 +1,80 @@
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <program/frame_timings.h>
+#include <utils/clock.h>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    [[nodiscard]] std::vector<std::string> SplitLines(const std::vector<char> &text)
+    {
+        std::vector<std::string> ret;
+        std::istringstream stream(std::string(text.begin(), text.end()));
+        for (std::string line; std::getline(stream, line);)
+            ret.push_back(line);
+        return ret;
+    }
+
+    // A frame where each phase takes `i + 1` milliseconds, and the whole frame takes 20 ms.
+    [[nodiscard]] Program::FrameTimings::Frame TestFrame(int ticks)
+    {
+        const std::uint64_t ms = Clock::TicksPerSecond() / 1000;
+
+        Program::FrameTimings::Frame ret;
+        ret.span = {.start = 0, .duration = 20 * ms};
+        for (std::size_t i = 0; i < Program::FrameTimings::num_phases; i++)
+            ret.phases[i] = {.start = 0, .duration = (i + 1) * ms};
+        ret.ticks = ticks;
+        ret.missed_ticks = ticks > 1;
+        return ret;
+    }
+}
+
+TEST_CASE("frame_timings.log")
+{
+    // The log isn't limited by the capacity.
+    Program::FrameTimings timings(2);
+    timings.AddFrame(TestFrame(0)); // Not logged.
+
+    std::vector<char> text;
+    timings.StartLog(Stream::Output::Container(text));
+    REQUIRE(timings.IsLogging());
+    for (int i = 0; i < 5; i++)
+        timings.AddFrame(TestFrame(i));
+    timings.StopLog();
+    REQUIRE_FALSE(timings.IsLogging());
+    timings.AddFrame(TestFrame(0)); // Not logged.
+
+    std::vector<std::string> lines = SplitLines(text);
+    REQUIRE(lines.size() == 6);
+    REQUIRE(lines[0] == "frame,frame_us,ticks,BeginFrame_us,Tick_us,Render_us,EndFrame_us,Sleep_us,missed_ticks,pipelined");
+    REQUIRE(lines[1] == "1,20000.000,0,1000.000,2000.000,3000.000,4000.000,5000.000,0,0");
+    REQUIRE(lines[5] == "5,20000.000,4,1000.000,2000.000,3000.000,4000.000,5000.000,1,0");
+    REQUIRE(timings.Size() == 2);
+    REQUIRE(timings.TotalFrames() == 7);
+
+    // Stopping without a log does nothing.
+    timings.StopLog();
+}
+
+TEST_CASE("frame_timings.log_errors")
+{
+    Program::FrameTimings timings;
+
+    // The write errors don't affect adding the frames, and are reported when stopping.
+    timings.StartLog(Stream::Output("failing output", [](Stream::Output &, const std::uint8_t *, std::size_t)
+    {
+        throw std::runtime_error("Unable to write.");
+    }));
+    for (int i = 0; i < 1000; i++)
+        timings.AddFrame(TestFrame(1));
+    REQUIRE_THROWS_AS(timings.StopLog(), std::runtime_error);
+    REQUIRE_FALSE(timings.IsLogging());
+    REQUIRE(timings.TotalFrames() == 1000);
+}
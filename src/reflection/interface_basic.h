@@ -9,6 +9,7 @@
 #include <utility>
 
 #include "meta/common.h"
+#include "meta/constexpr_hash.h"
 #include "reflection/utils.h"
 #include "stream/input.h"
 #include "stream/output.h"
@@ -36,7 +37,13 @@ namespace Refl
         bool ignore_missing_fields = false;
     };
 
-    struct ToBinaryOptions {};
+    struct ToBinaryOptions
+    {
+        // Contiguous containers of trivially serializable elements (see `impl::TriviallySerializable`) store
+        // the element schema hash after the length, and are copied in bulk when possible.
+        // Set this to false to write the format used before that, where the hash is missing. It's still compatible with all other containers.
+        bool bulk_containers = true;
+    };
 
     struct FromBinaryOptions
     {
@@ -44,6 +51,9 @@ namespace Refl
         // This prevents malformed serialized data from causing
         // too much temporary memory to be allocated.
         std::size_t max_reserved_size = 1024 * 1024;
+
+        // See `ToBinaryOptions::bulk_containers`. Set this to false to read the data written before the bulk format was added.
+        bool bulk_containers = true;
     };
 
 
@@ -202,6 +212,22 @@ namespace Refl
         // that all nested objects have this flag set too), otherwise conversion to string can yield weird results.
         template <typename T, typename = void>
         struct HasShortStringRepresentation : std::false_type {};
+
+        // Specialize this for types that can be [de]serialized to binary with a plain memory copy, on some platforms.
+        // Contiguous containers of such types are [de]serialized in bulk, bypassing the per-element interface calls.
+        // Specializations must contain:
+        //     static constexpr Meta::hash_t schema_hash = ...; // Must change whenever the binary representation changes. It's embedded in the binary data.
+        //     static bool MatchesMemoryLayout(); // Returns true if the binary representation matches the in-memory representation on the current platform.
+        // `T` will never be cv-qualified or a reference.
+        template <typename T, typename = void>
+        struct TriviallySerializable {};
+
+        template <typename T>
+        concept trivially_serializable = requires
+        {
+            requires std::is_same_v<decltype(TriviallySerializable<T>::schema_hash), const Meta::hash_t>;
+            {TriviallySerializable<T>::MatchesMemoryLayout()} -> std::same_as<bool>;
+        };
     }
 
 
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <exception>
 #include <functional>
 #include <tuple>
@@ -8,7 +10,9 @@
 #include <utility>
 
 #include "meta/common.h"
+#include "meta/constexpr_hash.h"
 #include "reflection/interface_basic.h"
+#include "strings/format.h"
 #include "utils/robust_math.h"
 
 namespace Refl
@@ -205,6 +209,14 @@ namespace Refl
             std::enable_if_t<std::is_reference_v<decltype(*std::declval<T &>().begin())>>()
         );
 
+        template <typename T> using has_resize =
+            decltype(std::declval<T &>().resize(std::size_t{}));
+
+        // Checks for `data()` pointing to contiguous storage. This rejects `std::vector<bool>`.
+        template <typename T> using has_contiguous_data = std::enable_if_t<
+            std::contiguous_iterator<iter_t<T>> && std::is_same_v<decltype(std::declval<T &>().data()), typename ContainerElem<T>::type *>
+        >;
+
         // Check if a type looks like a container.
         // It has to have sane `begin()` and `end()`, and either `push_back` or single-arg `insert` (so only variable-length arrays are allowed).
         template <typename T> inline constexpr bool is_container =
@@ -216,6 +228,14 @@ namespace Refl
     {
         static constexpr bool has_push_back = Meta::is_detected<impl::StdContainer::has_push_back, T>;
 
+        // Whether we use the bulk binary format. It's the same as the regular one, except that the length is followed by the element schema hash,
+        // unless disabled with `{To|From}BinaryOptions::bulk_containers` for compatibility with the older data.
+        // On platforms where the element layout matches the binary representation, the elements are copied with a single `memcpy`, in both formats.
+        static constexpr bool bulk_binary =
+            impl::trivially_serializable<typename impl::ContainerElem<T>::type> &&
+            Meta::is_detected<impl::StdContainer::has_resize, T> &&
+            Meta::is_detected<impl::StdContainer::has_contiguous_data, T>;
+
       public:
         using typename Interface_BasicContainer<T>::elem_t;
 
@@ -250,6 +270,73 @@ namespace Refl
             for (auto it = object.begin(); it != object.end(); it++)
                 func(*it);
         }
+
+        void ToBinary(const T &object, Stream::Output &output, const ToBinaryOptions &options, impl::ToBinaryState state) const override
+        {
+            if constexpr (!bulk_binary)
+            {
+                Interface_BasicContainer<T>::ToBinary(object, output, options, state);
+            }
+            else
+            {
+                impl::container_length_binary_t len;
+                if (Robust::conversion_fails(object.size(), len))
+                    throw std::runtime_error(output.GetExceptionPrefix() + "The container is too long.");
+                output.WriteWithByteOrder<impl::container_length_binary_t>(impl::container_length_byte_order, len);
+                if (options.bulk_containers)
+                    output.WriteWithByteOrder<Meta::hash_t>(impl::container_length_byte_order, impl::TriviallySerializable<elem_t>::schema_hash);
+
+                if (impl::TriviallySerializable<elem_t>::MatchesMemoryLayout())
+                {
+                    output.WriteBytes(reinterpret_cast<const std::uint8_t *>(object.data()), object.size() * sizeof(elem_t));
+                }
+                else
+                {
+                    auto next_state = state.MemberOrElem(options);
+                    for (const elem_t &elem : object)
+                        Interface<elem_t>().ToBinary(elem, output, options, next_state);
+                }
+            }
+        }
+
+        void FromBinary(T &object, Stream::Input &input, const FromBinaryOptions &options, impl::FromBinaryState state) const override
+        {
+            if constexpr (!bulk_binary)
+            {
+                Interface_BasicContainer<T>::FromBinary(object, input, options, state);
+            }
+            else
+            {
+                std::size_t len;
+                if (Robust::conversion_fails(input.ReadWithByteOrder<impl::container_length_binary_t>(impl::container_length_byte_order), len))
+                    throw std::runtime_error(input.GetExceptionPrefix() + "The container is too long.");
+
+                if (options.bulk_containers)
+                {
+                    Meta::hash_t hash = input.ReadWithByteOrder<Meta::hash_t>(impl::container_length_byte_order);
+                    if (hash != impl::TriviallySerializable<elem_t>::schema_hash)
+                        throw std::runtime_error(FMT("{}Element schema hash mismatch: expected 0x{:08x}, got 0x{:08x}.", input.GetExceptionPrefix(), impl::TriviallySerializable<elem_t>::schema_hash, hash));
+                }
+
+                // Since each element takes `sizeof(elem_t)` bytes, we can validate the length before allocating anything.
+                if (len > input.RemainingBytes() / sizeof(elem_t))
+                    throw std::runtime_error(input.GetExceptionPrefix() + "The container length exceeds the remaining data.");
+
+                Clear(object);
+                object.resize(len);
+
+                if (impl::TriviallySerializable<elem_t>::MatchesMemoryLayout())
+                {
+                    input.Read(reinterpret_cast<std::uint8_t *>(object.data()), len * sizeof(elem_t));
+                }
+                else
+                {
+                    auto next_state = state.MemberOrElem(options);
+                    for (elem_t &elem : object)
+                        Interface<elem_t>().FromBinary(elem, input, options, next_state);
+                }
+            }
+        }
     };
 
     template <typename T>
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <exception>
+#include <string_view>
 #include <type_traits>
 
 #include "reflection/interface_basic.h"
@@ -78,4 +79,16 @@ namespace Refl
 
     template <typename T>
     struct impl::HasShortStringRepresentation<T, std::enable_if_t<std::is_arithmetic_v<T>>> : std::true_type {};
+
+    // `bool` is excluded, since not every byte value is a valid `bool`.
+    template <typename T>
+    struct impl::TriviallySerializable<T, std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>>>
+    {
+        static constexpr Meta::hash_t schema_hash = Meta::cexpr_hash(std::string_view(std::is_floating_point_v<T> ? "float" : std::is_signed_v<T> ? "int" : "uint"), Meta::hash_t(sizeof(T)));
+
+        [[nodiscard]] static bool MatchesMemoryLayout()
+        {
+            return ByteOrder::native == impl::scalar_byte_order;
+        }
+    };
 }
@@ -5,6 +5,7 @@
 #include <cctype>
 #include <cstddef>
 #include <exception>
+#include <memory>
 #include <string_view>
 #include <type_traits>
 #include <utility>
@@ -584,6 +585,85 @@ namespace Refl
         using type = Interface_Struct<T>;
     };
 
+    namespace impl::Class
+    {
+        // Checks if a struct can be [de]serialized with a plain memory copy (see `impl::TriviallySerializable`).
+        // It must be trivially copyable, have no bases, no padding, no custom callbacks, and all its members must be trivially serializable.
+        template <typename T>
+        constexpr bool IsTriviallySerializableStruct()
+        {
+            if constexpr (!Refl::Class::members_known<T> || !std::is_trivially_copyable_v<T> || !std::is_default_constructible_v<T>)
+            {
+                return false;
+            }
+            else if constexpr (Meta::list_size<Refl::Class::combined_bases<T>> > 0)
+            {
+                return false;
+            }
+            else if constexpr (
+                &StructCallbacks<T>::PreSerialize    != &DefaultStructCallbacks<T>::PreSerialize    ||
+                &StructCallbacks<T>::PostSerialize   != &DefaultStructCallbacks<T>::PostSerialize   ||
+                &StructCallbacks<T>::PreDeserialize  != &DefaultStructCallbacks<T>::PreDeserialize  ||
+                &StructCallbacks<T>::PostDeserialize != &DefaultStructCallbacks<T>::PostDeserialize
+            )
+            {
+                return false;
+            }
+            else
+            {
+                bool ok = true;
+                std::size_t size = 0;
+                Meta::cexpr_for<Refl::Class::member_count<T>>([&](auto index)
+                {
+                    using type = Refl::Class::member_type<T, index.value>;
+                    if constexpr (std::is_const_v<type> || !trivially_serializable<type>)
+                        ok = false;
+                    else
+                        size += sizeof(type);
+                });
+                return ok && size == sizeof(T);
+            }
+        }
+    }
+
+    // The schema hash includes the member names (if known), to catch reordered members of the same type.
+    template <typename T>
+    struct impl::TriviallySerializable<T, std::enable_if_t<impl::Class::IsTriviallySerializableStruct<T>()>>
+    {
+        static constexpr Meta::hash_t schema_hash = []{
+            Meta::hash_t ret = Meta::cexpr_hash(std::string_view("struct"), Meta::hash_t(Refl::Class::member_count<T>));
+            Meta::cexpr_for<Refl::Class::member_count<T>>([&](auto index)
+            {
+                constexpr auto i = index.value;
+                if constexpr (Refl::Class::member_names_known<T>)
+                    ret = Meta::cexpr_hash(std::string_view(Refl::Class::MemberName<T>(i)), ret);
+                ret = Meta::cexpr_hash(std::string_view(), ret ^ TriviallySerializable<Refl::Class::member_type<T, i>>::schema_hash);
+            });
+            return ret;
+        }();
+
+        [[nodiscard]] static bool MatchesMemoryLayout()
+        {
+            // Member offsets are not available at compile-time, so we check them once at runtime.
+            static const bool ret = []{
+                T object{};
+                const char *base = reinterpret_cast<const char *>(std::addressof(object));
+                std::size_t offset = 0;
+                bool ok = true;
+                Meta::cexpr_for<Refl::Class::member_count<T>>([&](auto index)
+                {
+                    auto &member = Refl::Class::Member<index.value>(object);
+                    using type = std::remove_reference_t<decltype(member)>;
+                    if (reinterpret_cast<const char *>(std::addressof(member)) - base != std::ptrdiff_t(offset) || !TriviallySerializable<type>::MatchesMemoryLayout())
+                        ok = false;
+                    offset += sizeof(type);
+                });
+                return ok;
+            }();
+            return ret;
+        }
+    };
+
     template <typename T>
     struct impl::HasShortStringRepresentation<T, std::enable_if_t<Class::members_known<T>>>
     {
@@ -0,0 +1,169 @@
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include <reflection/full.h>
+#include <stream/readonly_data.h>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    // More members than the length of the strings in the schema hash, which used to break it.
+    REFL_SIMPLE_STRUCT( Vertex
+        REFL_DECL(float REFL_INIT =0) x
+        REFL_DECL(float REFL_INIT =0) y
+        REFL_DECL(float REFL_INIT =0) z
+        REFL_DECL(float REFL_INIT =0) u
+        REFL_DECL(float REFL_INIT =0) v
+        REFL_DECL(std::int32_t REFL_INIT =0) material
+        REFL_DECL(std::uint32_t REFL_INIT =0) color
+        REFL_DECL(std::uint32_t REFL_INIT =0) flags
+        REFL_DECL(double REFL_INIT =0) weight
+    )
+
+    [[nodiscard]] bool operator==(const Vertex &a, const Vertex &b)
+    {
+        return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+    }
+
+    // Same as `Vertex`, but two members are swapped.
+    REFL_SIMPLE_STRUCT( ReorderedVertex
+        REFL_DECL(float REFL_INIT =0) x
+        REFL_DECL(float REFL_INIT =0) y
+        REFL_DECL(float REFL_INIT =0) z
+        REFL_DECL(float REFL_INIT =0) u
+        REFL_DECL(float REFL_INIT =0) v
+        REFL_DECL(std::int32_t REFL_INIT =0) material
+        REFL_DECL(std::uint32_t REFL_INIT =0) flags
+        REFL_DECL(std::uint32_t REFL_INIT =0) color
+        REFL_DECL(double REFL_INIT =0) weight
+    )
+
+    // Has padding before `b`, so it's serialized element by element, in the old format.
+    REFL_SIMPLE_STRUCT( Padded
+        REFL_DECL(std::uint8_t REFL_INIT =0) a
+        REFL_DECL(std::int32_t REFL_INIT =0) b
+    )
+
+    template <typename T>
+    [[nodiscard]] std::vector<T> RandomVector(std::mt19937 &gen, std::size_t size)
+    {
+        std::vector<T> ret(size);
+        for (T &elem : ret)
+        {
+            if constexpr (std::is_floating_point_v<T>)
+                elem = std::uniform_real_distribution<T>(-1e6, 1e6)(gen);
+            else
+                elem = std::uniform_int_distribution<std::conditional_t<std::is_signed_v<T>, long long, unsigned long long>>(std::numeric_limits<T>::min(), std::numeric_limits<T>::max())(gen);
+        }
+        return ret;
+    }
+
+    [[nodiscard]] std::vector<Vertex> RandomVertices(std::mt19937 &gen, std::size_t size)
+    {
+        std::vector<Vertex> ret(size);
+        for (Vertex &v : ret)
+        {
+            v.x = float(gen()) / 7;
+            v.y = -float(gen()) / 3;
+            v.z = float(gen() % 100);
+            v.u = float(gen()) * 1e-9f;
+            v.v = 0.5f;
+            v.material = std::int32_t(gen());
+            v.color = std::uint32_t(gen());
+            v.flags = std::uint32_t(gen());
+            v.weight = double(gen()) / 13;
+        }
+        return ret;
+    }
+
+    // Serializes each element separately, prefixed with the length. This is the format used for all containers before the bulk format was added.
+    template <typename T>
+    [[nodiscard]] std::vector<unsigned char> ToOldBinary(const std::vector<T> &vec)
+    {
+        std::vector<unsigned char> ret = Refl::ToBinary<std::vector<unsigned char>>(std::uint32_t(vec.size()));
+        for (const T &elem : vec)
+        {
+            std::vector<unsigned char> elem_bytes = Refl::ToBinary<std::vector<unsigned char>>(elem);
+            ret.insert(ret.end(), elem_bytes.begin(), elem_bytes.end());
+        }
+        return ret;
+    }
+
+    template <typename T>
+    void CheckRoundTrip(const std::vector<T> &vec)
+    {
+        std::vector<unsigned char> bytes = Refl::ToBinary<std::vector<unsigned char>>(vec);
+
+        // The length, the element schema hash, then the elements themselves, same as if they were serialized separately.
+        std::vector<unsigned char> old_bytes = ToOldBinary(vec);
+        REQUIRE(bytes.size() == old_bytes.size() + sizeof(Meta::hash_t));
+        REQUIRE(std::equal(old_bytes.begin(), old_bytes.begin() + 4, bytes.begin()));
+        REQUIRE(std::equal(old_bytes.begin() + 4, old_bytes.end(), bytes.begin() + 4 + sizeof(Meta::hash_t)));
+
+        REQUIRE(Refl::FromBinary<std::vector<T>>(Stream::ReadOnlyData::mem_reference(bytes)) == vec);
+
+        // The old format can be loaded with an option, and is rejected without it.
+        REQUIRE(Refl::FromBinary<std::vector<T>>(Stream::ReadOnlyData::mem_reference(old_bytes), {.bulk_containers = false}) == vec);
+        if (!vec.empty())
+            REQUIRE_THROWS_AS((void)Refl::FromBinary<std::vector<T>>(Stream::ReadOnlyData::mem_reference(old_bytes)), std::runtime_error);
+
+        // Writing the old format.
+        REQUIRE(Refl::ToBinary<std::vector<unsigned char>>(vec, {.bulk_containers = false}) == old_bytes);
+    }
+}
+
+TEST_CASE("reflection_binary.bulk_arithmetic_containers")
+{
+    std::mt19937 gen(42);
+    for (std::size_t size : {0, 1, 7, 1000})
+    {
+        CheckRoundTrip(RandomVector<std::int8_t>(gen, size));
+        CheckRoundTrip(RandomVector<std::uint8_t>(gen, size));
+        CheckRoundTrip(RandomVector<std::int16_t>(gen, size));
+        CheckRoundTrip(RandomVector<std::int32_t>(gen, size));
+        CheckRoundTrip(RandomVector<std::uint32_t>(gen, size));
+        CheckRoundTrip(RandomVector<std::int64_t>(gen, size));
+        CheckRoundTrip(RandomVector<std::uint64_t>(gen, size));
+        CheckRoundTrip(RandomVector<float>(gen, size));
+        CheckRoundTrip(RandomVector<double>(gen, size));
+    }
+}
+
+TEST_CASE("reflection_binary.bulk_struct_containers")
+{
+    static_assert(Refl::impl::trivially_serializable<Vertex>);
+    static_assert(Refl::impl::TriviallySerializable<Vertex>::schema_hash != Refl::impl::TriviallySerializable<ReorderedVertex>::schema_hash);
+
+    std::mt19937 gen(43);
+    for (std::size_t size : {0, 1, 100})
+        CheckRoundTrip(RandomVertices(gen, size));
+
+    // The structs with padding use the old format regardless of the options.
+    static_assert(!Refl::impl::trivially_serializable<Padded>);
+    std::vector<Padded> padded = {{.a = 1, .b = -2}, {.a = 200, .b = 1 << 30}};
+    std::vector<unsigned char> bytes = Refl::ToBinary<std::vector<unsigned char>>(padded);
+    REQUIRE(bytes == ToOldBinary(padded));
+    std::vector<Padded> loaded = Refl::FromBinary<std::vector<Padded>>(Stream::ReadOnlyData::mem_reference(bytes));
+    REQUIRE(loaded.size() == 2);
+    REQUIRE((loaded[0].a == 1 && loaded[0].b == -2 && loaded[1].a == 200 && loaded[1].b == 1 << 30));
+}
+
+TEST_CASE("reflection_binary.schema_hashes")
+{
+    // The element types with the same size but different kinds, or different sizes, must not be confused.
+    using Refl::impl::TriviallySerializable;
+    static_assert(TriviallySerializable<std::int32_t>::schema_hash != TriviallySerializable<std::uint32_t>::schema_hash);
+    static_assert(TriviallySerializable<std::int32_t>::schema_hash != TriviallySerializable<float>::schema_hash);
+    static_assert(TriviallySerializable<std::int32_t>::schema_hash != TriviallySerializable<std::int64_t>::schema_hash);
+    static_assert(TriviallySerializable<float>::schema_hash != TriviallySerializable<double>::schema_hash);
+
+    // Loading a container of a different element type is an error, rather than garbage.
+    std::vector<unsigned char> bytes = Refl::ToBinary<std::vector<unsigned char>>(std::vector<float>{1, 2, 3, 4});
+    REQUIRE_THROWS_AS((void)Refl::FromBinary<std::vector<std::int32_t>>(Stream::ReadOnlyData::mem_reference(bytes)), std::runtime_error);
+}
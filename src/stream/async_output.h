@@ -0,0 +1,249 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "stream/output.h"
+
+// An output stream that writes to another output stream on a background thread, so the calling thread doesn't stall on I/O.
+// The data is passed to the thread through a fixed ring of recycled buffers, which bounds the memory usage.
+// If the background thread falls behind, writing blocks until a buffer becomes free.
+// The ring is a lock-free single-producer single-consumer queue, so only one thread at a time should write to the stream.
+// Usage:
+//     Stream::AsyncOutput async(Stream::Output("replay.bin"));
+//     async.GetStream().WriteLittle<std::uint32_t>(42);
+//     async.Sync(); // Optional. Waits until everything written so far reaches the target stream.
+//     async.Finish();
+
+namespace Stream
+{
+    class AsyncOutput
+    {
+        struct Buffer
+        {
+            std::unique_ptr<std::uint8_t[]> bytes;
+            std::size_t size = 0; // Empty buffers tell the writer thread to stop.
+        };
+
+        struct State
+        {
+            Output target; // Only touched by the writer thread, except when the queue is empty.
+            std::vector<Buffer> buffers;
+            std::size_t buffer_capacity = 0;
+
+            // Both indices only increase. Buffer number `i % buffers.size()` belongs to the writer thread if `read_index <= i < write_index`, and to the producer otherwise.
+            std::atomic<std::uint64_t> write_index = 0; // Only modified by the producer.
+            std::atomic<std::uint64_t> read_index = 0; // Only modified by the writer thread.
+
+            std::atomic<bool> failed = false;
+            std::exception_ptr exception; // Set by the writer thread before setting `failed`.
+
+            std::thread thread;
+
+            State() {}
+            State(const State &) = delete;
+            State &operator=(const State &) = delete;
+
+            ~State()
+            {
+                if (thread.joinable())
+                    Stop();
+            }
+
+            void WriterLoop()
+            {
+                std::uint64_t index = 0;
+
+                while (true)
+                {
+                    std::uint64_t end = write_index.load(std::memory_order_acquire);
+                    if (index == end)
+                    {
+                        write_index.wait(end, std::memory_order_acquire);
+                        continue;
+                    }
+
+                    const Buffer &buffer = buffers[index % buffers.size()];
+                    if (buffer.size == 0)
+                        return;
+
+                    if (!failed.load(std::memory_order_relaxed))
+                    {
+                        try
+                        {
+                            target.WriteBytes(buffer.bytes.get(), buffer.size);
+                        }
+                        catch (...)
+                        {
+                            // Remember the exception, and discard the remaining data.
+                            exception = std::current_exception();
+                            failed.store(true, std::memory_order_release);
+                        }
+                    }
+
+                    read_index.store(++index, std::memory_order_release);
+                    read_index.notify_one();
+                }
+            }
+
+            void ThrowIfFailed()
+            {
+                if (failed.load(std::memory_order_acquire))
+                    std::rethrow_exception(exception);
+            }
+
+            // Returns the next free buffer, waiting for one if necessary.
+            Buffer &AcquireBuffer()
+            {
+                std::uint64_t index = write_index.load(std::memory_order_relaxed);
+                while (true)
+                {
+                    std::uint64_t read = read_index.load(std::memory_order_acquire);
+                    if (index - read < buffers.size())
+                        break;
+                    read_index.wait(read, std::memory_order_acquire);
+                }
+                return buffers[index % buffers.size()];
+            }
+
+            // Hands the buffer returned by `AcquireBuffer()` to the writer thread.
+            void PublishBuffer()
+            {
+                write_index.fetch_add(1, std::memory_order_release);
+                write_index.notify_one();
+            }
+
+            void Write(const std::uint8_t *data, std::size_t size)
+            {
+                // After a failure, discard everything. The error is reported by `Sync()` and `Finish()`.
+                if (failed.load(std::memory_order_relaxed))
+                    return;
+
+                while (size > 0)
+                {
+                    Buffer &buffer = AcquireBuffer();
+                    buffer.size = std::min(size, buffer_capacity);
+                    std::copy_n(data, buffer.size, buffer.bytes.get());
+                    PublishBuffer();
+
+                    data += buffer.size;
+                    size -= buffer.size;
+                }
+            }
+
+            // Waits until the writer thread processes all published buffers.
+            void WaitUntilEmpty()
+            {
+                std::uint64_t end = write_index.load(std::memory_order_relaxed);
+                while (true)
+                {
+                    std::uint64_t read = read_index.load(std::memory_order_acquire);
+                    if (read == end)
+                        break;
+                    read_index.wait(read, std::memory_order_acquire);
+                }
+            }
+
+            void Stop()
+            {
+                Buffer &buffer = AcquireBuffer();
+                buffer.size = 0;
+                PublishBuffer();
+                thread.join();
+            }
+        };
+        std::unique_ptr<State> state; // This is a pointer, since `stream` and the writer thread hold references to it.
+        Output stream;
+
+      public:
+        // Constructs a null object.
+        AsyncOutput() {}
+
+        // Takes ownership of the target stream, and starts the writer thread.
+        // The memory usage is bounded by `num_buffers * buffer_capacity`, plus the same capacity for the buffer of `GetStream()` itself.
+        AsyncOutput(Output target, std::size_t num_buffers = 4, capacity_t buffer_capacity = capacity_t(64 * 1024))
+            : state(std::make_unique<State>())
+        {
+            if (!target)
+                throw std::runtime_error("Attempt to create an asynchronous stream with a null target.");
+            if (num_buffers == 0 || std::size_t(buffer_capacity) == 0)
+                throw std::runtime_error("Invalid asynchronous stream buffer size.");
+
+            std::string name = target.GetTarget() + " (async)";
+
+            state->target = std::move(target);
+            state->buffer_capacity = std::size_t(buffer_capacity);
+            state->buffers.resize(num_buffers);
+            for (Buffer &buffer : state->buffers)
+                buffer.bytes = std::make_unique<std::uint8_t[]>(state->buffer_capacity);
+
+            stream = Output(std::move(name),
+                [state = state.get()](Output &, const std::uint8_t *data, std::size_t size)
+                {
+                    state->Write(data, size);
+                },
+                buffer_capacity);
+
+            state->thread = std::thread([state = state.get()]{state->WriterLoop();});
+        }
+
+        AsyncOutput(AsyncOutput &&) = default;
+        AsyncOutput &operator=(AsyncOutput other) noexcept
+        {
+            // Swapping rather than assigning member-wise, to make sure the old `stream` is destroyed before the old `state`.
+            std::swap(state, other.state);
+            std::swap(stream, other.stream);
+            return *this;
+        }
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return bool(state);
+        }
+
+        // Returns the stream you should write to.
+        // `GetStream().Flush()` hands the buffered data to the writer thread without waiting for it to be written. Use `Sync()` for that.
+        // Writing never throws because of the target stream errors, those are reported by `Sync()` and `Finish()`.
+        [[nodiscard]] Output &GetStream()
+        {
+            return stream;
+        }
+
+        // Waits until everything written so far reaches the target stream, then flushes the target stream.
+        // If writing to the target failed, rethrows the exception. Any data written after the failure is discarded.
+        void Sync()
+        {
+            if (!state)
+                throw std::runtime_error("Attempt to sync a null asynchronous stream.");
+
+            stream.Flush();
+            state->WaitUntilEmpty();
+            state->ThrowIfFailed();
+            state->target.Flush(); // The writer thread is idle now, so we can touch the target.
+        }
+
+        // Writes the remaining data, stops the writer thread, flushes and destroys the target stream.
+        // After this, the object becomes null, even if this throws.
+        void Finish()
+        {
+            if (!state)
+                throw std::runtime_error("Attempt to finish a null asynchronous stream.");
+
+            stream.Flush();
+            stream = {};
+
+            std::unique_ptr<State> old_state = std::move(state);
+            old_state->Stop();
+            old_state->ThrowIfFailed();
+            old_state->target.Flush();
+        }
+    };
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "meta/common.h"
+#include "program/errors.h"
+#include "stream/input.h"
+#include "stream/output.h"
+#include "strings/format.h"
+#include "utils/archive.h"
+#include "utils/robust_math.h"
+
+// Streaming compression adapters for `Stream::Input` and `Stream::Output`.
+// The format is a zlib stream (see `Archive::StreamCompressor`), followed by the uncompressed size as a 64-bit little-endian integer.
+// The size is stored at the end rather than at the beginning, because it's not known until the compression is finished.
+// Note that this format is not compatible with the size-prefixed one produced by `Archive::Compress()`.
+
+namespace Stream
+{
+    namespace impl
+    {
+        using compressed_size_t = std::uint64_t;
+    }
+
+    // An output stream that compresses everything written to it, and writes the result to another output stream.
+    // Write to `GetStream()`, then call `Finish()`. After that, flush the target stream as usual.
+    class CompressingOutput
+    {
+        struct State
+        {
+            Archive::StreamCompressor compressor = nullptr;
+            Output *target = nullptr;
+            impl::compressed_size_t size = 0;
+        };
+        std::unique_ptr<State> state; // This is a pointer, since `stream` holds a reference to it.
+        Output stream;
+
+      public:
+        // Constructs a null object.
+        CompressingOutput() {}
+
+        // The target stream must stay alive until `Finish()` is called.
+        CompressingOutput(Output &target, capacity_t capacity = Output::default_capacity)
+            : state(std::make_unique<State>())
+        {
+            state->target = &target;
+
+            stream = Output(target.GetTarget() + " (compressed)",
+                [state = state.get()](Output &, const std::uint8_t *data, std::size_t size)
+                {
+                    state->size += size;
+                    state->compressor.Write(data, data + size, [state](const std::uint8_t *begin, const std::uint8_t *end)
+                    {
+                        state->target->WriteBytes(begin, end - begin);
+                    });
+                },
+                capacity);
+        }
+
+        CompressingOutput(CompressingOutput &&) = default;
+        CompressingOutput &operator=(CompressingOutput &&) = default;
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return bool(state);
+        }
+
+        // Returns the stream you should write the uncompressed data to.
+        [[nodiscard]] Output &GetStream()
+        {
+            return stream;
+        }
+
+        // Flushes the remaining data to the target stream, and writes the trailing size.
+        // After this, the object becomes null. The target stream is not flushed.
+        void Finish()
+        {
+            if (!state)
+                throw std::runtime_error("Attempt to finish a null compressing stream.");
+
+            stream.Flush();
+
+            Output &target = *state->target;
+            state->compressor.Finish([&target](const std::uint8_t *begin, const std::uint8_t *end)
+            {
+                target.WriteBytes(begin, end - begin);
+            });
+            target.WriteLittle<impl::compressed_size_t>(state->size);
+
+            stream = {};
+            state = nullptr;
+        }
+    };
+
+    // Returns an input stream that uncompresses the data produced by `CompressingOutput`.
+    // The compressed data must span from the current position of `source` to its end.
+    // The data is uncompressed on demand. Reading sequentially is the fastest, while seeking backwards restarts the uncompression from the beginning.
+    [[nodiscard]] inline Input UncompressingInput(Input source, capacity_t capacity = Input::default_capacity)
+    {
+        std::size_t begin = source.Position();
+        if (source.RemainingBytes() < sizeof(impl::compressed_size_t))
+            throw std::runtime_error(source.GetExceptionPrefix() + "Compressed data is too short.");
+
+        source.Seek(-std::ptrdiff_t(sizeof(impl::compressed_size_t)), end);
+        std::size_t compressed_end = source.Position();
+        std::size_t size = 0;
+        if (Robust::conversion_fails(source.ReadLittle<impl::compressed_size_t>(), size))
+            throw std::runtime_error(source.GetExceptionPrefix() + "The uncompressed data is too large.");
+        source.Seek(begin, absolute);
+
+        struct State
+        {
+            Input source;
+            std::size_t compressed_begin = 0;
+            std::size_t compressed_end = 0;
+            Archive::StreamUncompressor uncompressor = nullptr;
+            std::size_t position = 0; // Position in the uncompressed data.
+
+            std::size_t ReadSource(std::uint8_t *buffer, std::size_t capacity)
+            {
+                std::size_t step = std::min(capacity, compressed_end - source.Position());
+                source.Read(buffer, step);
+                return step;
+            }
+
+            void ReadUncompressed(Input &stream, std::uint8_t *dst, std::size_t size)
+            {
+                std::uint8_t *dst_end = uncompressor.Read(dst, dst + size, [this](std::uint8_t *buffer, std::size_t capacity){return ReadSource(buffer, capacity);});
+                if (dst_end != dst + size)
+                    throw std::runtime_error(stream.GetExceptionPrefix() + "Unexpected end of compressed data.");
+                position += size;
+            }
+        };
+
+        std::string name = source.GetTarget() + " (uncompressed)";
+
+        auto lambda = Meta::fake_copyable([state = std::make_unique<State>(State{.source = std::move(source), .compressed_begin = begin, .compressed_end = compressed_end})]
+            (Input &stream, std::size_t offset, std::size_t size, std::uint8_t *dst)
+        {
+            if (offset < state->position)
+            {
+                // Restart from the beginning.
+                state->uncompressor.Reset();
+                state->source.Seek(state->compressed_begin, absolute);
+                state->position = 0;
+            }
+
+            // Skip until the requested position.
+            if (offset > state->position)
+            {
+                std::uint8_t buffer[1024];
+                while (state->position < offset)
+                    state->ReadUncompressed(stream, buffer, std::min(offset - state->position, sizeof buffer));
+            }
+
+            state->ReadUncompressed(stream, dst, size);
+        });
+
+        return Input(std::move(name), size, std::move(lambda), capacity);
+    }
+}
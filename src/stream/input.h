@@ -769,7 +769,8 @@ namespace Stream
                 std::size_t first_size = second_segment - data.position;
                 NeedSegment(first_segment).Read(data.position, first_size, buffer);
 
-                data.read(*this, second_segment, last_segment - second_segment, buffer + first_size);
+                if (last_segment != second_segment)
+                    data.read(*this, second_segment, last_segment - second_segment, buffer + first_size);
 
                 std::size_t last_size = data.position + size - last_segment;
                 NeedSegment(last_segment).Read(last_segment, last_size, buffer + size - last_size);
@@ -11,6 +11,7 @@
 #include <optional>
 #include <string>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "macros/finally.h"
@@ -201,12 +202,13 @@ namespace Stream
         // is a bad idea (and silently ignoring the exception isn't good too).
         // In a debug build, destroying an unflushed stream raises an assertion;
         // in a release build it's flushed automatically, ignoring any possible exceptions.
+        // If this throws, the buffered data is discarded, so the stream can then be destroyed without an assertion.
         void Flush()
         {
             if (data.buffer_pos > 0)
             {
-                data.flush(*this, data.buffer.get(), data.buffer_pos);
-                data.buffer_pos = 0;
+                std::size_t size = std::exchange(data.buffer_pos, 0);
+                data.flush(*this, data.buffer.get(), size);
             }
             else if (!*this)
             {
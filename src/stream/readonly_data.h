@@ -26,6 +26,7 @@ namespace Stream
         struct Data
         {
             std::unique_ptr<std::uint8_t[]> storage;
+            std::shared_ptr<const void> owner; // Optional. Keeps alive the memory that `begin` and `end` point to, if it's not in `storage`.
 
             const std::uint8_t *begin = 0, *end = 0;
             bool extra_null_terminator = false; // If this is `true`, there is an extra null terminator past the `end`.
@@ -69,6 +70,20 @@ namespace Stream
         {
             return mem_reference(reinterpret_cast<const std::uint8_t *>(begin), reinterpret_cast<const std::uint8_t *>(end));
         }
+        // Stores a reference to an existing memory block, and keeps `owner` alive as long as this object (or a copy of it) exists.
+        [[nodiscard]] static ReadOnlyData mem_reference(std::string name, const std::uint8_t *begin, const std::uint8_t *end, std::shared_ptr<const void> owner)
+        {
+            ReadOnlyData ret;
+            ret.ref = std::make_shared<Data>();
+
+            ret.ref->owner = std::move(owner);
+            ret.ref->begin = begin;
+            ret.ref->end = end;
+
+            ret.ref->name = std::move(name);
+
+            return ret;
+        }
         // Stores a reference to an existing contaner.
         template <impl::FlatByteContainer T>
         [[nodiscard]] static ReadOnlyData mem_reference(const T &container)
@@ -219,6 +234,16 @@ namespace Stream
             return reinterpret_cast<const char *>(ref->end);
         }
 
+        // Returns a part of the data without copying it. The result keeps this object alive.
+        // Throws if the range is out of bounds.
+        [[nodiscard]] ReadOnlyData subrange(std::size_t offset, std::size_t size, std::string name) const
+        {
+            if (offset > this->size() || size > this->size() - offset)
+                throw std::runtime_error(FMT("Unable to get a subrange of `{}`: the range is out of bounds.", this->name()));
+
+            return mem_reference(std::move(name), begin() + offset, begin() + offset + size, ref);
+        }
+
         // Returns an uncompressed copy of the file.
         // The data is assumed to be size-prefixed, see `archive.h` for the details.
         [[nodiscard]] ReadOnlyData uncompress() const
@@ -0,0 +1,79 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <stream/async_output.h>
+#include <stream/output.h>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    // Writes to `target`, throwing after `max_size` bytes.
+    [[nodiscard]] Stream::Output LimitedOutput(std::vector<std::uint8_t> &target, std::size_t max_size)
+    {
+        return Stream::Output("limited output", [&target, max_size](Stream::Output &, const std::uint8_t *data, std::size_t size)
+        {
+            if (target.size() + size > max_size)
+                throw std::runtime_error("The output is full.");
+            target.insert(target.end(), data, data + size);
+        }, Stream::capacity_t(16));
+    }
+}
+
+TEST_CASE("stream_async_output.round_trip")
+{
+    std::mt19937 gen(42);
+    std::vector<std::uint8_t> data(1'000'000);
+    for (std::uint8_t &byte : data)
+        byte = std::uint8_t(gen());
+
+    // Few small buffers, so the writer thread falls behind.
+    std::vector<std::uint8_t> result;
+    Stream::AsyncOutput output(Stream::Output::Container(result), 3, Stream::capacity_t(1000));
+
+    std::size_t pos = 0;
+    while (pos < data.size())
+    {
+        std::size_t step = std::min(data.size() - pos, std::size_t(gen() % 5000));
+        output.GetStream().WriteBytes(data.data() + pos, step);
+        pos += step;
+
+        // After a sync, everything written so far is in the target.
+        if (gen() % 20 == 0)
+        {
+            output.Sync();
+            REQUIRE(result.size() == pos);
+        }
+    }
+
+    output.Finish();
+    REQUIRE_FALSE(output);
+    REQUIRE(result == data);
+}
+
+TEST_CASE("stream_async_output.errors")
+{
+    REQUIRE_THROWS_AS((void)Stream::AsyncOutput(Stream::Output{}), std::runtime_error);
+
+    std::vector<std::uint8_t> result;
+    Stream::AsyncOutput output(LimitedOutput(result, 100), 2, Stream::capacity_t(10));
+
+    // Writing doesn't throw, only syncing does. Everything after the failure is discarded.
+    std::vector<std::uint8_t> data(1000, 7);
+    output.GetStream().WriteBytes(data.data(), data.size());
+    output.GetStream().Flush();
+    REQUIRE_THROWS_AS(output.Sync(), std::runtime_error);
+    REQUIRE(result.size() <= 100);
+    output.GetStream().WriteBytes(data.data(), data.size());
+
+    // The object becomes null even if finishing throws.
+    REQUIRE_THROWS_AS(output.Finish(), std::runtime_error);
+    REQUIRE_FALSE(output);
+    REQUIRE(result.size() <= 100);
+}
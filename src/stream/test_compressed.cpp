@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <stream/compressed.h>
+#include <stream/input.h>
+#include <stream/output.h>
+#include <stream/readonly_data.h>
+#include <utils/archive.h>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    // Half of the data is compressible (a repeating pattern), and half is random, so that zlib produces both kinds of blocks.
+    [[nodiscard]] std::vector<std::uint8_t> TestData(std::mt19937 &gen, std::size_t size)
+    {
+        std::vector<std::uint8_t> ret(size);
+        for (std::size_t i = 0; i < size; i++)
+            ret[i] = i / 4096 % 2 ? std::uint8_t(gen()) : std::uint8_t(i % 17);
+        return ret;
+    }
+
+    // Compresses with `Stream::CompressingOutput`, writing the data in chunks of random sizes.
+    [[nodiscard]] std::vector<std::uint8_t> Compress(std::mt19937 &gen, const std::vector<std::uint8_t> &data)
+    {
+        std::vector<std::uint8_t> ret;
+        Stream::Output target = Stream::Output::Container(ret);
+        Stream::CompressingOutput output(target, Stream::capacity_t(1000));
+
+        std::size_t pos = 0;
+        while (pos < data.size())
+        {
+            std::size_t step = std::min(data.size() - pos, std::size_t(gen() % 5000));
+            output.GetStream().WriteBytes(data.data() + pos, step);
+            pos += step;
+        }
+
+        output.Finish();
+        REQUIRE_FALSE(output);
+        target.Flush();
+        return ret;
+    }
+
+    [[nodiscard]] Stream::Input UncompressingInput(const std::vector<std::uint8_t> &compressed)
+    {
+        return Stream::UncompressingInput(Stream::ReadOnlyData::mem_reference(compressed), Stream::capacity_t(1000));
+    }
+
+    [[nodiscard]] std::vector<std::uint8_t> ReadAll(Stream::Input &input)
+    {
+        std::vector<std::uint8_t> ret(input.RemainingBytes());
+        input.Read(ret.data(), ret.size());
+        return ret;
+    }
+}
+
+TEST_CASE("stream_compressed.round_trip")
+{
+    std::mt19937 gen(42);
+
+    // Empty, smaller than one chunk, and much larger than all internal buffers.
+    for (std::size_t size : {0, 1, 100, 3'000'000})
+    {
+        std::vector<std::uint8_t> data = TestData(gen, size);
+        std::vector<std::uint8_t> compressed = Compress(gen, data);
+        REQUIRE(compressed.size() >= sizeof(std::uint64_t));
+
+        Stream::Input input = UncompressingInput(compressed);
+        REQUIRE(input.Size() == size);
+        REQUIRE(ReadAll(input) == data);
+    }
+}
+
+TEST_CASE("stream_compressed.seeking")
+{
+    std::mt19937 gen(43);
+    std::vector<std::uint8_t> data = TestData(gen, 100'000);
+    Stream::Input input = UncompressingInput(Compress(gen, data));
+
+    // Seeking backwards restarts the uncompression, seeking forward skips the data.
+    for (std::size_t pos : {50'000, 10'000, 99'000, 0, 60'000})
+    {
+        input.Seek(pos, Stream::absolute);
+        std::uint8_t bytes[1000];
+        std::size_t size = std::min(sizeof bytes, data.size() - pos);
+        input.Read(bytes, size);
+        REQUIRE(std::equal(bytes, bytes + size, data.begin() + std::ptrdiff_t(pos)));
+    }
+}
+
+TEST_CASE("stream_compressed.raw_format_compatibility")
+{
+    // `StreamUncompressor` accepts the output of `Archive::Raw::Compress()`.
+    std::mt19937 gen(44);
+    std::vector<std::uint8_t> data = TestData(gen, 200'000);
+    std::vector<std::uint8_t> compressed(Archive::Raw::MaxCompressedSize(data.data(), data.data() + data.size()));
+    compressed.resize(std::size_t(Archive::Raw::Compress(data.data(), data.data() + data.size(), compressed.data(), compressed.data() + compressed.size()) - compressed.data()));
+
+    Archive::StreamUncompressor uncompressor(nullptr);
+    std::size_t input_pos = 0;
+    std::vector<std::uint8_t> result(data.size() + 1);
+    std::uint8_t *end = uncompressor.Read(result.data(), result.data() + result.size(), [&](std::uint8_t *buffer, std::size_t capacity)
+    {
+        std::size_t step = std::min({capacity, compressed.size() - input_pos, std::size_t(777)});
+        std::copy_n(compressed.data() + input_pos, step, buffer);
+        input_pos += step;
+        return step;
+    });
+    REQUIRE(uncompressor.Finished());
+    result.resize(std::size_t(end - result.data()));
+    REQUIRE(result == data);
+}
+
+TEST_CASE("stream_compressed.corrupted")
+{
+    std::mt19937 gen(45);
+    std::vector<std::uint8_t> data = TestData(gen, 50'000);
+    const std::vector<std::uint8_t> compressed = Compress(gen, data);
+
+    // Too short to contain the size.
+    REQUIRE_THROWS_AS((void)UncompressingInput(std::vector<std::uint8_t>(compressed.begin(), compressed.begin() + 3)), std::runtime_error);
+
+    // A broken zlib header.
+    {
+        std::vector<std::uint8_t> broken = compressed;
+        broken[0] ^= 0xff;
+        Stream::Input input = UncompressingInput(broken);
+        REQUIRE_THROWS_AS((void)ReadAll(input), std::runtime_error);
+    }
+
+    // The compressed data is truncated.
+    {
+        std::vector<std::uint8_t> broken(compressed.begin(), compressed.begin() + std::ptrdiff_t(compressed.size() / 2));
+        broken.insert(broken.end(), compressed.end() - sizeof(std::uint64_t), compressed.end());
+        Stream::Input input = UncompressingInput(broken);
+        REQUIRE_THROWS_AS((void)ReadAll(input), std::runtime_error);
+    }
+
+    // The stored size is larger than the actual data.
+    {
+        std::vector<std::uint8_t> broken = compressed;
+        broken[broken.size() - sizeof(std::uint64_t)]++;
+        Stream::Input input = UncompressingInput(broken);
+        REQUIRE(input.Size() == data.size() + 1);
+        REQUIRE_THROWS_AS((void)ReadAll(input), std::runtime_error);
+    }
+}
@@ -1,10 +1,15 @@
 #include "archive.h"
 
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
 #include <type_traits>
+#include <vector>
 
 #include <zlib.h>
 
 #include "utils/robust_math.h"
+#include "utils/thread_pool.h"
 
 namespace Archive
 {
@@ -37,6 +42,20 @@ namespace Archive
     using size_type = uint64_t;
     static_assert(std::is_unsigned_v<size_type> && sizeof(size_type) >= sizeof(std::size_t), "`size_type` must be an unsigned type not smaller than `std::size_t`.");
 
+    static void WriteSize(uint8_t *dst, size_type size)
+    {
+        for (std::size_t i = 0; i < sizeof(size_type); i++)
+            dst[i] = (size >> (i * 8)) & 0xff;
+    }
+
+    [[nodiscard]] static size_type ReadSize(const uint8_t *src)
+    {
+        size_type size = 0;
+        for (std::size_t i = 0; i < sizeof(size_type); i++)
+            size |= (size_type(src[i]) << (i * 8));
+        return size;
+    }
+
     [[nodiscard]] std::size_t MaxCompressedSize(const uint8_t *src_begin, const uint8_t *src_end)
     {
         return sizeof(size_type) + Raw::MaxCompressedSize(src_begin, src_end);
@@ -52,8 +71,7 @@ namespace Archive
         if (size > std::numeric_limits<size_type>::max())
             throw std::runtime_error("Compression failure.");
 
-        for (std::size_t i = 0; i < sizeof(size_type); i++)
-            dst_begin[i] = (size >> (i * 8)) & 0xff;
+        WriteSize(dst_begin, size);
 
         return Raw::Compress(src_begin, src_end, dst_begin + sizeof(size_type), dst_end);
     }
@@ -63,12 +81,8 @@ namespace Archive
         if (src_end - src_begin < std::ptrdiff_t(sizeof(size_type)))
             throw std::runtime_error("Uncompression failure.");
 
-        size_type size = 0;
-        for (std::size_t i = 0; i < sizeof(size_type); i++)
-            size |= (size_type(src_begin[i]) << (i * 8));
-
         std::size_t ret;
-        if (Robust::conversion_fails(size, ret))
+        if (Robust::conversion_fails(ReadSize(src_begin), ret))
             throw std::runtime_error("Unable to uncompress: The object is too large.");
 
         return ret;
@@ -79,4 +93,271 @@ namespace Archive
         std::size_t size = UncompressedSize(src_begin, src_end);
         Raw::Uncompress(src_begin + sizeof(size_type), src_end, dst_begin, dst_begin + size);
     }
+
+
+    namespace Parallel
+    {
+        // The number of blocks the data is split into.
+        [[nodiscard]] static std::size_t NumBlocks(std::size_t size, std::size_t block_size)
+        {
+            return (size + block_size - 1) / block_size;
+        }
+
+        // The size of the header, including the block table.
+        [[nodiscard]] static std::size_t HeaderSize(std::size_t num_blocks)
+        {
+            return sizeof(size_type) * (2 + num_blocks);
+        }
+
+        std::size_t MaxCompressedSize(const uint8_t *src_begin, const uint8_t *src_end, std::size_t block_size)
+        {
+            if (block_size == 0)
+                throw std::runtime_error("Compression failure: The block size can't be zero.");
+
+            std::size_t size = src_end - src_begin;
+            std::size_t num_blocks = NumBlocks(size, block_size);
+            std::size_t ret = HeaderSize(num_blocks);
+            if (num_blocks > 0)
+                ret += compressBound(block_size) * (num_blocks - 1) + compressBound(size - block_size * (num_blocks - 1));
+            return ret;
+        }
+
+        uint8_t *Compress(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin, uint8_t *dst_end, std::size_t block_size)
+        {
+            if (block_size == 0)
+                throw std::runtime_error("Compression failure: The block size can't be zero.");
+
+            std::size_t size = src_end - src_begin;
+            if (size > std::numeric_limits<size_type>::max())
+                throw std::runtime_error("Compression failure.");
+
+            std::size_t num_blocks = NumBlocks(size, block_size);
+            std::size_t header_size = HeaderSize(num_blocks);
+            if (dst_end - dst_begin < std::ptrdiff_t(header_size))
+                throw std::runtime_error("Compression failure.");
+
+            // Compress the blocks into separate buffers, since we don't know their final positions yet.
+            std::vector<std::unique_ptr<uint8_t[]>> buffers(num_blocks);
+            std::vector<std::size_t> compressed_sizes(num_blocks);
+            ThreadPool::Global().Run(num_blocks, [&](std::size_t i)
+            {
+                const uint8_t *block_begin = src_begin + i * block_size;
+                const uint8_t *block_end = i == num_blocks - 1 ? src_end : block_begin + block_size;
+                std::size_t capacity = Raw::MaxCompressedSize(block_begin, block_end);
+                buffers[i] = std::make_unique<uint8_t[]>(capacity);
+                compressed_sizes[i] = Raw::Compress(block_begin, block_end, buffers[i].get(), buffers[i].get() + capacity) - buffers[i].get();
+            });
+
+            WriteSize(dst_begin, size);
+            WriteSize(dst_begin + sizeof(size_type), block_size);
+            uint8_t *dst = dst_begin + header_size;
+            for (std::size_t i = 0; i < num_blocks; i++)
+            {
+                WriteSize(dst_begin + sizeof(size_type) * (2 + i), compressed_sizes[i]);
+
+                if (std::size_t(dst_end - dst) < compressed_sizes[i])
+                    throw std::runtime_error("Compression failure.");
+                dst = std::copy_n(buffers[i].get(), compressed_sizes[i], dst);
+            }
+
+            return dst;
+        }
+
+        std::size_t UncompressedSize(const uint8_t *src_begin, const uint8_t *src_end)
+        {
+            // Same as in the non-parallel format.
+            return Archive::UncompressedSize(src_begin, src_end);
+        }
+
+        void Uncompress(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin)
+        {
+            std::size_t size = UncompressedSize(src_begin, src_end);
+
+            if (src_end - src_begin < std::ptrdiff_t(sizeof(size_type) * 2))
+                throw std::runtime_error("Uncompression failure.");
+
+            std::size_t block_size;
+            if (Robust::conversion_fails(ReadSize(src_begin + sizeof(size_type)), block_size) || block_size == 0)
+                throw std::runtime_error("Uncompression failure.");
+
+            std::size_t num_blocks = NumBlocks(size, block_size);
+            if (std::size_t(src_end - src_begin) / sizeof(size_type) - 2 < num_blocks)
+                throw std::runtime_error("Uncompression failure.");
+
+            // Compute the block offsets from the table.
+            std::vector<const uint8_t *> block_starts(num_blocks + 1);
+            block_starts[0] = src_begin + HeaderSize(num_blocks);
+            for (std::size_t i = 0; i < num_blocks; i++)
+            {
+                size_type compressed_size = ReadSize(src_begin + sizeof(size_type) * (2 + i));
+                if (compressed_size > size_type(src_end - block_starts[i]))
+                    throw std::runtime_error("Uncompression failure.");
+                block_starts[i + 1] = block_starts[i] + compressed_size;
+            }
+            if (block_starts.back() != src_end)
+                throw std::runtime_error("Uncompression failure: Unexpected data after the last block.");
+
+            ThreadPool::Global().Run(num_blocks, [&](std::size_t i)
+            {
+                uint8_t *block_begin = dst_begin + i * block_size;
+                uint8_t *block_end = i == num_blocks - 1 ? dst_begin + size : block_begin + block_size;
+                Raw::Uncompress(block_starts[i], block_starts[i + 1], block_begin, block_end);
+            });
+        }
+    }
+
+
+    // Intermediate buffer size for the streaming (de)compression.
+    static constexpr std::size_t stream_chunk_size = 1 << 14;
+
+    // zlib can't process more than this amount of bytes at once, because it uses `uInt` for sizes.
+    static constexpr std::size_t stream_max_step = std::numeric_limits<uInt>::max();
+
+
+    struct StreamCompressor::Data
+    {
+        z_stream stream{};
+        uint8_t buffer[stream_chunk_size];
+
+        Data()
+        {
+            if (deflateInit(&stream, Z_DEFAULT_COMPRESSION) != Z_OK)
+                throw std::runtime_error("Unable to initialize the compressor.");
+        }
+        Data(const Data &) = delete;
+        Data &operator=(const Data &) = delete;
+
+        ~Data()
+        {
+            deflateEnd(&stream);
+        }
+
+        // Runs `deflate()` on the current input until it's fully consumed (or, when finishing, until the stream ends).
+        void Process(int flush, const output_func_t &output)
+        {
+            while (true)
+            {
+                stream.next_out = buffer;
+                stream.avail_out = stream_chunk_size;
+
+                int status = deflate(&stream, flush);
+                if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR)
+                    throw std::runtime_error("Compression failure.");
+
+                if (stream.next_out != buffer)
+                    output(buffer, stream.next_out);
+
+                if (flush == Z_FINISH ? status == Z_STREAM_END : stream.avail_out != 0)
+                    break;
+            }
+        }
+    };
+
+    StreamCompressor::StreamCompressor() {}
+    StreamCompressor::StreamCompressor(std::nullptr_t) : data(std::make_unique<Data>()) {}
+    StreamCompressor::StreamCompressor(StreamCompressor &&) noexcept = default;
+    StreamCompressor &StreamCompressor::operator=(StreamCompressor &&) noexcept = default;
+    StreamCompressor::~StreamCompressor() = default;
+
+    void StreamCompressor::Write(const uint8_t *src_begin, const uint8_t *src_end, const output_func_t &output)
+    {
+        if (!data)
+            throw std::runtime_error("Attempt to use a null compressor.");
+
+        while (src_begin != src_end)
+        {
+            std::size_t step = std::min(std::size_t(src_end - src_begin), stream_max_step);
+            data->stream.next_in = const_cast<uint8_t *>(src_begin); // Old zlib versions lack `const` here.
+            data->stream.avail_in = step;
+            data->Process(Z_NO_FLUSH, output);
+            src_begin += step;
+        }
+    }
+
+    void StreamCompressor::Finish(const output_func_t &output)
+    {
+        if (!data)
+            throw std::runtime_error("Attempt to use a null compressor.");
+
+        data->stream.next_in = nullptr;
+        data->stream.avail_in = 0;
+        data->Process(Z_FINISH, output);
+        data = nullptr;
+    }
+
+
+    struct StreamUncompressor::Data
+    {
+        z_stream stream{};
+        bool finished = false;
+        uint8_t buffer[stream_chunk_size];
+
+        Data()
+        {
+            if (inflateInit(&stream) != Z_OK)
+                throw std::runtime_error("Unable to initialize the uncompressor.");
+        }
+        Data(const Data &) = delete;
+        Data &operator=(const Data &) = delete;
+
+        ~Data()
+        {
+            inflateEnd(&stream);
+        }
+    };
+
+    StreamUncompressor::StreamUncompressor() {}
+    StreamUncompressor::StreamUncompressor(std::nullptr_t) : data(std::make_unique<Data>()) {}
+    StreamUncompressor::StreamUncompressor(StreamUncompressor &&) noexcept = default;
+    StreamUncompressor &StreamUncompressor::operator=(StreamUncompressor &&) noexcept = default;
+    StreamUncompressor::~StreamUncompressor() = default;
+
+    uint8_t *StreamUncompressor::Read(uint8_t *dst_begin, uint8_t *dst_end, const input_func_t &input)
+    {
+        if (!data)
+            throw std::runtime_error("Attempt to use a null uncompressor.");
+
+        while (dst_begin != dst_end && !data->finished)
+        {
+            if (data->stream.avail_in == 0)
+            {
+                std::size_t size = input(data->buffer, stream_chunk_size);
+                if (size == 0)
+                    throw std::runtime_error("Uncompression failure: Unexpected end of compressed data.");
+                data->stream.next_in = data->buffer;
+                data->stream.avail_in = size;
+            }
+
+            std::size_t step = std::min(std::size_t(dst_end - dst_begin), stream_max_step);
+            data->stream.next_out = dst_begin;
+            data->stream.avail_out = step;
+
+            int status = inflate(&data->stream, Z_NO_FLUSH);
+            if (status == Z_STREAM_END)
+                data->finished = true;
+            else if (status != Z_OK && status != Z_BUF_ERROR)
+                throw std::runtime_error("Uncompression failure.");
+
+            dst_begin = data->stream.next_out;
+        }
+
+        return dst_begin;
+    }
+
+    bool StreamUncompressor::Finished() const
+    {
+        return data && data->finished;
+    }
+
+    void StreamUncompressor::Reset()
+    {
+        if (!data)
+            throw std::runtime_error("Attempt to use a null uncompressor.");
+
+        if (inflateReset(&data->stream) != Z_OK)
+            throw std::runtime_error("Unable to reset the uncompressor.");
+        data->stream.next_in = nullptr;
+        data->stream.avail_in = 0;
+        data->finished = false;
+    }
 }
@@ -2,6 +2,8 @@
 
 #include <cstdint>
 #include <cstddef>
+#include <functional>
+#include <memory>
 
 namespace Archive
 {
@@ -18,4 +20,78 @@ namespace Archive
     [[nodiscard]] uint8_t *Compress(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin, uint8_t *dst_end); // Compresses and returns compressed data end. Throws on failure.
     [[nodiscard]] std::size_t UncompressedSize(const uint8_t *src_begin, const uint8_t *src_end); // Extracts size from decompressed data. Throws on failure.
     void Uncompress(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin); // Decompresses. Throws on failure. The buffer must have size returned by `UncompressedSize()`.
+
+    // Those functions split the data into independently compressed blocks, which are processed in parallel on `ThreadPool::Global()`.
+    // The format is: total uncompressed size, block size, a table of compressed block sizes (all of them are 64-bit little-endian), then the compressed blocks.
+    // This is not compatible with the functions above.
+    // They can be called from a `ThreadPool::Global()` job, then the blocks are processed sequentially on that thread.
+    namespace Parallel
+    {
+        // The block size used by default. Smaller blocks parallelize better, but compress worse.
+        inline constexpr std::size_t default_block_size = std::size_t(1) << 20;
+
+        [[nodiscard]] std::size_t MaxCompressedSize(const uint8_t *src_begin, const uint8_t *src_end, std::size_t block_size = default_block_size); // Determines max destination buffer size.
+        [[nodiscard]] uint8_t *Compress(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin, uint8_t *dst_end, std::size_t block_size = default_block_size); // Compresses and returns compressed data end. Throws on failure.
+        [[nodiscard]] std::size_t UncompressedSize(const uint8_t *src_begin, const uint8_t *src_end); // Extracts size from decompressed data. Throws on failure.
+        void Uncompress(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin); // Decompresses. Throws on failure. The buffer must have size returned by `UncompressedSize()`.
+    }
+
+
+    // Incremental compression, using the zlib streaming API.
+    // The output has the same format as `Raw::Compress()`, so it's not size-prefixed.
+    class StreamCompressor
+    {
+        struct Data;
+        std::unique_ptr<Data> data;
+
+      public:
+        // Receives chunks of compressed data.
+        using output_func_t = std::function<void(const uint8_t *begin, const uint8_t *end)>;
+
+        StreamCompressor();
+        StreamCompressor(std::nullptr_t); // Constructs a working compressor. Throws on failure.
+        StreamCompressor(StreamCompressor &&) noexcept;
+        StreamCompressor &operator=(StreamCompressor &&) noexcept;
+        ~StreamCompressor();
+
+        [[nodiscard]] explicit operator bool() const {return bool(data);}
+
+        // Compresses a chunk of data. Sends any compressed data that became available to `output`. Throws on failure.
+        void Write(const uint8_t *src_begin, const uint8_t *src_end, const output_func_t &output);
+        // Compresses any remaining data and terminates the compressed stream. Throws on failure.
+        // After this, the object is reset to the null state.
+        void Finish(const output_func_t &output);
+    };
+
+    // Incremental decompression, using the zlib streaming API.
+    // Accepts the format produced by `Raw::Compress()` and `StreamCompressor`.
+    class StreamUncompressor
+    {
+        struct Data;
+        std::unique_ptr<Data> data;
+
+      public:
+        // Writes at most `capacity` bytes of compressed data to `buffer`, returns the number of bytes written.
+        // Returning zero means that there is no more data.
+        using input_func_t = std::function<std::size_t(uint8_t *buffer, std::size_t capacity)>;
+
+        StreamUncompressor();
+        StreamUncompressor(std::nullptr_t); // Constructs a working uncompressor. Throws on failure.
+        StreamUncompressor(StreamUncompressor &&) noexcept;
+        StreamUncompressor &operator=(StreamUncompressor &&) noexcept;
+        ~StreamUncompressor();
+
+        [[nodiscard]] explicit operator bool() const {return bool(data);}
+
+        // Fills `[dst_begin, dst_end)` with uncompressed data, requesting compressed data from `input` as needed.
+        // Returns the end of the written data, which can be less than `dst_end` only if the compressed stream has ended.
+        // Throws on failure, including if `input` runs out of data before the compressed stream ends.
+        [[nodiscard]] uint8_t *Read(uint8_t *dst_begin, uint8_t *dst_end, const input_func_t &input);
+
+        // Returns true if the end of the compressed stream was reached.
+        [[nodiscard]] bool Finished() const;
+
+        // Starts decompressing a new stream from scratch. Discards any buffered input.
+        void Reset();
+    };
 }
@@ -0,0 +1,247 @@
+#include "asset_pack.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+#include "macros/finally.h"
+#include "program/platform.h"
+#include "strings/format.h"
+#include "utils/archive.h"
+#include "utils/filesystem.h"
+#include "utils/robust_math.h"
+
+#if IMP_PLATFORM_IS(windows)
+#include <filesystem>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace AssetPack
+{
+    static constexpr char magic[8] = {'I','M','P','-','P','A','C','K'};
+    static constexpr std::uint32_t current_version = 1;
+
+    // Memory-maps a file for reading. Returns a null object on failure.
+    static Stream::ReadOnlyData MapFile(const std::string &file_name)
+    {
+        #if IMP_PLATFORM_IS(windows)
+        HANDLE file = CreateFileW(std::filesystem::u8path(file_name).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return {};
+        FINALLY{CloseHandle(file);};
+
+        LARGE_INTEGER size{};
+        if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0)
+            return {};
+
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping)
+            return {};
+        FINALLY{CloseHandle(mapping);}; // The view keeps the mapping alive.
+
+        const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!view)
+            return {};
+
+        std::shared_ptr<const void> owner(view, [](const void *view){UnmapViewOfFile(view);});
+        const std::uint8_t *begin = static_cast<const std::uint8_t *>(view);
+        return Stream::ReadOnlyData::mem_reference(file_name, begin, begin + size.QuadPart, std::move(owner));
+        #else
+        int file = open(file_name.c_str(), O_RDONLY);
+        if (file == -1)
+            return {};
+        FINALLY{close(file);}; // The mapping stays valid after closing the file.
+
+        struct stat info;
+        if (fstat(file, &info) || info.st_size <= 0)
+            return {};
+
+        std::size_t size = info.st_size;
+        void *view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (view == MAP_FAILED)
+            return {};
+
+        std::shared_ptr<const void> owner(view, [size](const void *view){munmap(const_cast<void *>(view), size);});
+        const std::uint8_t *begin = static_cast<const std::uint8_t *>(view);
+        return Stream::ReadOnlyData::mem_reference(file_name, begin, begin + size, std::move(owner));
+        #endif
+    }
+
+    Reader::Reader(const std::string &file_name)
+    {
+        Stream::ReadOnlyData data = MapFile(file_name);
+        if (!data)
+            data = Stream::ReadOnlyData::file(file_name);
+        *this = FromMemory(std::move(data));
+    }
+
+    Reader Reader::FromMemory(Stream::ReadOnlyData data)
+    {
+        Reader ret;
+        std::vector<EntryInfo> &entries = ret.entries;
+
+        Stream::Input input(data);
+
+        try
+        {
+            char file_magic[sizeof magic];
+            input.Read(file_magic, sizeof file_magic);
+            if (std::memcmp(file_magic, magic, sizeof magic) != 0)
+                throw std::runtime_error("This is not an asset pack.");
+
+            std::uint32_t version = input.ReadLittle<std::uint32_t>();
+            if (version != current_version)
+                throw std::runtime_error(FMT("Unsupported asset pack version {}, expected {}.", version, current_version));
+
+            std::uint32_t entry_count = input.ReadLittle<std::uint32_t>();
+            entries.reserve(std::min(std::size_t(entry_count), input.RemainingBytes()));
+
+            for (std::uint32_t i = 0; i < entry_count; i++)
+            {
+                EntryInfo &entry = entries.emplace_back();
+
+                std::uint32_t name_size = input.ReadLittle<std::uint32_t>();
+                if (name_size > input.RemainingBytes())
+                    throw std::runtime_error("Entry name is too long.");
+                entry.name.resize(name_size);
+                input.Read(entry.name.data(), name_size);
+
+                entry.offset = input.ReadLittle<std::uint64_t>();
+                entry.stored_size = input.ReadLittle<std::uint64_t>();
+                entry.size = input.ReadLittle<std::uint64_t>();
+                entry.compression = Compression(input.ReadLittle<std::uint8_t>());
+
+                if (entry.compression != Compression::none && entry.compression != Compression::zlib)
+                    throw std::runtime_error(FMT("Entry `{}` uses an unknown compression mode.", entry.name));
+                if (entry.compression == Compression::none && entry.size != entry.stored_size)
+                    throw std::runtime_error(FMT("Entry `{}` is uncompressed, but has mismatching sizes.", entry.name));
+                if (entry.offset > data.size() || entry.stored_size > data.size() - entry.offset)
+                    throw std::runtime_error(FMT("Entry `{}` is out of bounds.", entry.name));
+                if (i > 0 && !(entries[i-1].name < entry.name))
+                    throw std::runtime_error(FMT("Entry `{}` is not sorted or duplicated.", entry.name));
+            }
+        }
+        catch (std::exception &e)
+        {
+            throw std::runtime_error(FMT("Unable to load asset pack `{}`:\n{}", data.name(), e.what()));
+        }
+
+        ret.file = std::move(data);
+        return ret;
+    }
+
+    const EntryInfo *Reader::Find(std::string_view name) const
+    {
+        auto it = std::lower_bound(entries.begin(), entries.end(), name, [](const EntryInfo &entry, std::string_view name){return entry.name < name;});
+        if (it == entries.end() || it->name != name)
+            return nullptr;
+        return &*it;
+    }
+
+    Stream::ReadOnlyData Reader::GetData(std::string_view name) const
+    {
+        const EntryInfo *entry = Find(name);
+        if (!entry)
+            throw std::runtime_error(FMT("Asset pack `{}` doesn't contain `{}`.", file.name(), name));
+
+        Stream::ReadOnlyData ret = file.subrange(entry->offset, entry->stored_size, FMT("{}/{}", file.name(), name));
+
+        if (entry->compression == Compression::zlib)
+        {
+            ret = ret.uncompress();
+            if (ret.size() != entry->size)
+                throw std::runtime_error(FMT("Entry `{}` in asset pack `{}` has a wrong uncompressed size.", name, file.name()));
+        }
+
+        return ret;
+    }
+
+    void Write(Stream::Output &output, std::vector<WriterEntry> entries)
+    {
+        std::sort(entries.begin(), entries.end(), [](const WriterEntry &a, const WriterEntry &b){return a.name < b.name;});
+        if (auto it = std::adjacent_find(entries.begin(), entries.end(), [](const WriterEntry &a, const WriterEntry &b){return a.name == b.name;}); it != entries.end())
+            throw std::runtime_error(FMT("Duplicate asset pack entry: `{}`.", it->name));
+
+        if (Robust::not_representable_as<std::uint32_t>(entries.size()))
+            throw std::runtime_error("Too many asset pack entries.");
+
+        // Compress the entries first, since the index needs the resulting sizes.
+        std::vector<Stream::ReadOnlyData> stored_data;
+        stored_data.reserve(entries.size());
+        for (const WriterEntry &entry : entries)
+        {
+            if (entry.compression == Compression::none)
+            {
+                stored_data.push_back(entry.data);
+            }
+            else
+            {
+                std::size_t capacity = Archive::MaxCompressedSize(entry.data.begin(), entry.data.end());
+                auto buffer = std::make_unique<std::uint8_t[]>(capacity);
+                std::uint8_t *end = Archive::Compress(entry.data.begin(), entry.data.end(), buffer.get(), buffer.get() + capacity);
+                stored_data.push_back(Stream::ReadOnlyData::mem_copy(buffer.get(), end));
+            }
+        }
+
+        // Compute the index size to get the data offsets.
+        std::uint64_t offset = sizeof magic + sizeof(std::uint32_t) * 2;
+        for (const WriterEntry &entry : entries)
+            offset += sizeof(std::uint32_t) + entry.name.size() + sizeof(std::uint64_t) * 3 + sizeof(std::uint8_t);
+
+        output.WriteString(magic, sizeof magic);
+        output.WriteLittle<std::uint32_t>(current_version);
+        output.WriteLittle<std::uint32_t>(entries.size());
+
+        for (std::size_t i = 0; i < entries.size(); i++)
+        {
+            const WriterEntry &entry = entries[i];
+
+            if (Robust::not_representable_as<std::uint32_t>(entry.name.size()))
+                throw std::runtime_error(FMT("Asset pack entry name is too long: `{}`.", entry.name));
+
+            output.WriteLittle<std::uint32_t>(entry.name.size());
+            output.WriteString(entry.name);
+            output.WriteLittle<std::uint64_t>(offset);
+            output.WriteLittle<std::uint64_t>(stored_data[i].size());
+            output.WriteLittle<std::uint64_t>(entry.data.size());
+            output.WriteLittle<std::uint8_t>(std::uint8_t(entry.compression));
+
+            offset += stored_data[i].size();
+        }
+
+        for (const Stream::ReadOnlyData &data : stored_data)
+            output.WriteBytes(data.data(), data.size());
+    }
+
+    void WriteDirectory(Stream::Output &output, const std::string &dir, std::function<std::optional<Compression>(const std::string &name)> choose_compression)
+    {
+        std::vector<WriterEntry> entries;
+
+        auto AddNode = [&](auto &AddNode, const Filesystem::TreeNode &node, const std::string &name) -> void
+        {
+            if (node.info.category == Filesystem::directory)
+            {
+                for (const Filesystem::TreeNode &sub_node : node.contents)
+                    AddNode(AddNode, sub_node, name.empty() ? sub_node.name : name + '/' + sub_node.name);
+            }
+            else if (node.info.category == Filesystem::file)
+            {
+                std::optional<Compression> compression = choose_compression ? choose_compression(name) : Compression::zlib;
+                if (compression)
+                    entries.push_back({.name = name, .data = Stream::ReadOnlyData::file(node.path), .compression = *compression});
+            }
+        };
+        Filesystem::TreeNode tree = Filesystem::GetObjectTree(dir, -1);
+        if (tree.info.category != Filesystem::directory)
+            throw std::runtime_error(FMT("Unable to pack `{}`: not a directory.", dir));
+        AddNode(AddNode, tree, "");
+
+        Write(output, std::move(entries));
+    }
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string_view>
+#include <string>
+#include <vector>
+
+#include "stream/input.h"
+#include "stream/output.h"
+#include "stream/readonly_data.h"
+
+// A single-file container for assets, to avoid opening hundreds of loose files at startup.
+// The file starts with an index of entries sorted by name, followed by the entry contents.
+// Each entry can optionally be compressed (see `archive.h`).
+//
+// Format (all integers are little-endian):
+//     char[8] magic = "IMP-PACK"
+//     u32 version
+//     u32 entry_count
+//     `entry_count` times:
+//         u32 name_size
+//         char[name_size] name
+//         u64 offset      // From the beginning of the file.
+//         u64 stored_size // Size of the data in the file.
+//         u64 size        // Size of the data after uncompressing it.
+//         u8 compression  // See `enum Compression`.
+//     entry contents...
+
+namespace AssetPack
+{
+    enum class Compression : std::uint8_t
+    {
+        none, // The data is stored as is.
+        zlib, // The data is compressed with `Archive::Compress()`.
+    };
+
+    struct EntryInfo
+    {
+        std::string name;
+        std::uint64_t offset = 0;
+        std::uint64_t stored_size = 0;
+        std::uint64_t size = 0;
+        Compression compression = Compression::none;
+    };
+
+    // Loads a pack, and provides access to the individual files in it.
+    class Reader
+    {
+        Stream::ReadOnlyData file;
+        std::vector<EntryInfo> entries; // Sorted by name.
+
+      public:
+        // Constructs a null pack.
+        Reader() {}
+
+        // Opens a pack file. Tries to memory-map it, and falls back to loading it into memory if that fails.
+        // Throws on failure.
+        Reader(const std::string &file_name);
+
+        // Uses an existing memory block as a pack. Throws on failure.
+        [[nodiscard]] static Reader FromMemory(Stream::ReadOnlyData data);
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return bool(file);
+        }
+
+        // Returns the entries, sorted by name.
+        [[nodiscard]] const std::vector<EntryInfo> &GetEntries() const
+        {
+            return entries;
+        }
+
+        // Returns the entry with this name, or null if there is no such entry.
+        [[nodiscard]] const EntryInfo *Find(std::string_view name) const;
+
+        // Returns the contents of an entry, uncompressed if necessary. Throws if there is no such entry.
+        // Doesn't copy the uncompressed entries. The result keeps the pack file alive.
+        [[nodiscard]] Stream::ReadOnlyData GetData(std::string_view name) const;
+
+        // Returns an input stream reading an entry. Throws if there is no such entry.
+        [[nodiscard]] Stream::Input GetStream(std::string_view name) const
+        {
+            return GetData(name);
+        }
+    };
+
+    struct WriterEntry
+    {
+        std::string name;
+        Stream::ReadOnlyData data;
+        Compression compression = Compression::none;
+    };
+
+    // Writes a pack to a stream. The entries don't have to be sorted. Throws on failure, including on duplicate names.
+    void Write(Stream::Output &output, std::vector<WriterEntry> entries);
+
+    // Writes a pack containing all files from a directory, recursively. The names are relative to `dir`, with `/` as a separator.
+    // `choose_compression` is optional. If specified, it's called for every file, and can return null to skip the file. By default everything is compressed.
+    void WriteDirectory(Stream::Output &output, const std::string &dir, std::function<std::optional<Compression>(const std::string &name)> choose_compression = nullptr);
+}
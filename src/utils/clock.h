@@ -1,10 +1,25 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <thread>
 
 #include <SDL_timer.h>
 
+#include "program/platform.h"
+
+#if IMP_PLATFORM_IS(linux) || IMP_PLATFORM_IS(android)
+#include <time.h>
+#define IMP_CLOCK_USE_CLOCK_NANOSLEEP 1
+#else
+#define IMP_CLOCK_USE_CLOCK_NANOSLEEP 0
+#endif
+
 namespace Clock
 {
     inline uint64_t Time()
@@ -32,6 +47,91 @@ namespace Clock
         SDL_Delay(int(secs * 1000));
     }
 
+    // Sleeps for approximately the specified amount of clock ticks, with the best precision the platform offers (unlike `WaitSeconds()`).
+    // The actual sleep is usually a bit longer, by the timer slack of the OS.
+    inline void SleepTicks(uint64_t ticks)
+    {
+        uint64_t ns = uint64_t(ticks * (1e9 / TicksPerSecond()));
+        #if IMP_CLOCK_USE_CLOCK_NANOSLEEP
+        timespec duration{};
+        duration.tv_sec = time_t(ns / 1000000000);
+        duration.tv_nsec = long(ns % 1000000000);
+        while (clock_nanosleep(CLOCK_MONOTONIC, 0, &duration, &duration) == EINTR) {} // Resume after signals.
+        #else
+        std::this_thread::sleep_for(std::chrono::nanoseconds(ns));
+        #endif
+    }
+
+    // Waits until a time point, sleeping for most of the time and busy-waiting only for the last bit, to be precise without burning CPU.
+    // The length of the busy wait is adjusted automatically, based on how much the recent sleeps overshot.
+    class PreciseWaiter
+    {
+        // The busy wait covers this fraction of the recent sleep overshoots. The rest of them make the wait a bit late.
+        static constexpr double overshoot_percentile = 0.9;
+        // The busy wait is never longer than this, in seconds, even if the sleeps are very imprecise.
+        static constexpr double max_busy_wait_seconds = 0.002;
+        // Before the first sleep, the busy wait lasts this long, in seconds.
+        static constexpr double initial_busy_wait_seconds = 0.001;
+
+        // The overshoots of the recent sleeps, in clock ticks. A ring buffer.
+        std::array<uint64_t, 64> overshoots{};
+        std::size_t num_overshoots = 0;
+        std::size_t next_overshoot = 0;
+
+        uint64_t slept_ticks = 0;
+        uint64_t busy_ticks = 0;
+
+      public:
+        PreciseWaiter() {}
+
+        // The current length of the busy wait, in clock ticks.
+        [[nodiscard]] uint64_t BusyWaitTicks() const
+        {
+            if (num_overshoots == 0)
+                return SecondsToTicks(initial_busy_wait_seconds);
+
+            decltype(overshoots) sorted = overshoots;
+            auto it = sorted.begin() + std::ptrdiff_t(std::min(num_overshoots - 1, std::size_t(num_overshoots * overshoot_percentile)));
+            std::nth_element(sorted.begin(), it, sorted.begin() + std::ptrdiff_t(num_overshoots));
+            return std::min(*it, SecondsToTicks(max_busy_wait_seconds));
+        }
+
+        // Waits until `Time()` reaches `target`. If `allow_busy_wait` is false, only sleeps, which is less precise.
+        void WaitUntil(uint64_t target, bool allow_busy_wait = true)
+        {
+            uint64_t now = Time();
+            if (now >= target)
+                return;
+
+            uint64_t margin = allow_busy_wait ? BusyWaitTicks() : 0;
+            if (target - now > margin)
+            {
+                uint64_t requested = target - now - margin;
+                SleepTicks(requested);
+                uint64_t after = Time();
+                slept_ticks += after - now;
+
+                overshoots[next_overshoot] = after - now > requested ? after - now - requested : 0;
+                next_overshoot = (next_overshoot + 1) % overshoots.size();
+                num_overshoots = std::min(num_overshoots + 1, overshoots.size());
+
+                now = after;
+            }
+
+            if (allow_busy_wait && now < target)
+            {
+                uint64_t busy_start = now;
+                while ((now = Time()) < target) {}
+                busy_ticks += now - busy_start;
+            }
+        }
+
+        // The total time spent sleeping and busy-waiting, in clock ticks.
+        // The sleeping time is the CPU time saved, compared to waiting in a pure busy loop.
+        [[nodiscard]] uint64_t TotalSleepTicks() const {return slept_ticks;}
+        [[nodiscard]] uint64_t TotalBusyWaitTicks() const {return busy_ticks;}
+    };
+
     class DeltaTimer
     {
         uint64_t time = 0;
@@ -2,9 +2,11 @@
 
 #include <concepts>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <initializer_list>
 #include <tuple>
+#include <type_traits>
 #include <utility>
 
 #include "meta/common.h"
@@ -159,3 +161,84 @@ namespace Hash
         }
     };
 }
+
+// A hash with a fixed specification, for the hashes that are saved to files.
+namespace Hash
+{
+    // A 64-bit content hash that gives the same results on all platforms and with all standard libraries, unlike `Compute()`.
+    // Use this for the hashes that are saved to files, such as the cache keys. This is not a cryptographic hash.
+    // The input bytes are split into 64-bit little-endian words, the last one padded with zeros. Starting from `h = initial_state`,
+    // each word `w` updates the state as `h = Mix(h ^ w)`, where `Mix()` is the SplitMix64 finalizer. The result is `Mix(h ^ total_byte_count)`.
+    // The results only depend on the concatenation of the bytes, not on how they're split between the calls.
+    // Usage:
+    //     std::uint64_t hash = Hash::Stable{}.AppendInt<std::uint32_t>(version).AppendBytes(data.data(), data.size()).Result();
+    class Stable
+    {
+        static constexpr std::uint64_t initial_state = 0x9e3779b97f4a7c15;
+
+        std::uint64_t state = initial_state;
+        std::uint64_t byte_count = 0;
+        std::uint64_t partial_word = 0; // The bytes after the last complete word.
+
+        [[nodiscard]] static constexpr std::uint64_t Mix(std::uint64_t x)
+        {
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+            return x ^ (x >> 31);
+        }
+
+      public:
+        Stable &AppendBytes(const void *data, std::size_t size)
+        {
+            const unsigned char *bytes = static_cast<const unsigned char *>(data);
+
+            // Complete the partial word.
+            while (size > 0 && byte_count % 8 != 0)
+            {
+                partial_word |= std::uint64_t(*bytes++) << (byte_count % 8 * 8);
+                byte_count++;
+                size--;
+                if (byte_count % 8 == 0)
+                {
+                    state = Mix(state ^ partial_word);
+                    partial_word = 0;
+                }
+            }
+
+            // The complete words.
+            for (; size >= 8; size -= 8, bytes += 8)
+            {
+                std::uint64_t word = 0;
+                for (int i = 0; i < 8; i++)
+                    word |= std::uint64_t(bytes[i]) << (i * 8); // Compilers optimize this to a single load.
+                state = Mix(state ^ word);
+                byte_count += 8;
+            }
+
+            // Start the next partial word.
+            for (; size > 0; size--)
+                partial_word |= std::uint64_t(*bytes++) << (byte_count++ % 8 * 8);
+
+            return *this;
+        }
+
+        // Appends the little-endian bytes of an integer. Specify the type explicitly, since its size matters.
+        template <std::integral T>
+        Stable &AppendInt(std::type_identity_t<T> value)
+        {
+            auto unsigned_value = std::make_unsigned_t<T>(value);
+            unsigned char bytes[sizeof(T)];
+            for (std::size_t i = 0; i < sizeof(T); i++)
+                bytes[i] = (unsigned_value >> (i * 8)) & 0xff;
+            return AppendBytes(bytes, sizeof(T));
+        }
+
+        [[nodiscard]] std::uint64_t Result() const
+        {
+            std::uint64_t ret = state;
+            if (byte_count % 8 != 0)
+                ret = Mix(ret ^ partial_word);
+            return Mix(ret ^ byte_count);
+        }
+    };
+}
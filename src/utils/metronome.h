@@ -18,6 +18,8 @@ class Metronome
     bool new_frame = false;
     // This is set to true whenever the `max_ticks` limit is reached.
     bool lag = false;
+    // How many times the `max_ticks` limit was reached in total. Unlike `lag`, this isn't reset when read.
+    std::uint64_t lag_count = 0;
 
     // Compensation logic. This makes the clock run more smooth.
     // When `accumulator` is very close to `tick_len` (absolute difference less than `comp_th * tick_len`),
@@ -65,6 +67,7 @@ class Metronome
         lag = false;
         comp_dir = 0;
         ticks = 0;
+        lag_count = 0;
     }
 
     [[nodiscard]] bool Lag() // Flag resets after this function is called. The flag is set to 1 if the amount of ticks per last frame is at maximum value.
@@ -77,6 +80,12 @@ class Metronome
         return false;
     }
 
+    // How many frames hit the limit on ticks per frame (see `Lag()`), since the last `Reset()`. Reading this doesn't reset it.
+    [[nodiscard]] std::uint64_t LagCount() const
+    {
+        return lag_count;
+    }
+
     [[nodiscard]] double Frequency() const
     {
         return Clock::TicksPerSecond() / double(tick_len);
@@ -120,6 +129,7 @@ class Metronome
             {
                 accumulator = tick_len * max_ticks;
                 lag = true;
+                lag_count++;
             }
             accumulator -= tick_len;
             new_frame = false;
@@ -1,11 +1,14 @@
 #include "packing.h"
 
 #include <algorithm>
+#include <cstddef>
 #include <memory>
 #include <vector>
 
 #include <stb_rect_pack.h>
 
+#include "program/errors.h"
+
 namespace Packing
 {
     int PackRects(ivec2 target_size, Rect *data, int count, int inner_gaps, int outer_gaps)
@@ -49,4 +52,108 @@ namespace Packing
 
         return rects_not_packed;
     }
+
+    DynamicPacker::DynamicPacker(ivec2 size, int inner_gaps)
+        : size(size), inner_gaps(inner_gaps)
+    {
+        Clear();
+    }
+
+    std::optional<ivec2> DynamicPacker::Allocate(ivec2 rect_size)
+    {
+        // Each rectangle reserves the gap to the right and below it.
+        ivec2 needed_size = rect_size + inner_gaps;
+
+        // Find the free rectangle that fits best, i.e. has the least area left over.
+        // Break ties by position, to keep the result deterministic.
+        auto best = free_rects.end();
+        for (auto it = free_rects.begin(); it != free_rects.end(); it++)
+        {
+            if ((it->size() < needed_size).any())
+                continue;
+            if (best == free_rects.end())
+            {
+                best = it;
+                continue;
+            }
+
+            auto best_area = best->size().prod(), area = it->size().prod();
+            if (area < best_area || (area == best_area && (it->a.y < best->a.y || (it->a.y == best->a.y && it->a.x < best->a.x))))
+                best = it;
+        }
+
+        if (best == free_rects.end())
+            return {};
+
+        irect2 free_rect = *best;
+        free_rects.erase(best);
+
+        // Split the remaining space along the shorter leftover axis, which tends to keep the remaining rectangles closer to squares.
+        ivec2 leftover = free_rect.size() - needed_size;
+        irect2 right, bottom;
+        if (leftover.x < leftover.y)
+        {
+            right = ivec2(free_rect.a.x + needed_size.x, free_rect.a.y).rect_to(ivec2(free_rect.b.x, free_rect.a.y + needed_size.y));
+            bottom = ivec2(free_rect.a.x, free_rect.a.y + needed_size.y).rect_to(free_rect.b);
+        }
+        else
+        {
+            right = ivec2(free_rect.a.x + needed_size.x, free_rect.a.y).rect_to(free_rect.b);
+            bottom = ivec2(free_rect.a.x, free_rect.a.y + needed_size.y).rect_to(ivec2(free_rect.a.x + needed_size.x, free_rect.b.y));
+        }
+        for (const irect2 &rect : {right, bottom})
+        {
+            if (rect.has_area())
+                free_rects.push_back(rect);
+        }
+
+        num_allocated++;
+        return free_rect.a;
+    }
+
+    void DynamicPacker::Free(ivec2 pos, ivec2 rect_size)
+    {
+        ASSERT(num_allocated > 0, "Attempt to free a rectangle that wasn't allocated.");
+        if (--num_allocated == 0)
+        {
+            Clear();
+            return;
+        }
+
+        free_rects.push_back(pos.rect_size(rect_size + inner_gaps));
+
+        // Merge the adjacent free rectangles that share a whole edge, until there's nothing left to merge.
+        bool merged = true;
+        while (merged)
+        {
+            merged = false;
+            for (std::size_t i = 0; i < free_rects.size() && !merged; i++)
+            for (std::size_t j = 0; j < free_rects.size() && !merged; j++)
+            {
+                irect2 &a = free_rects[i];
+                const irect2 &b = free_rects[j];
+                if (i == j)
+                    continue;
+
+                if (a.a.y == b.a.y && a.b.y == b.b.y && a.b.x == b.a.x)
+                    a.b.x = b.b.x;
+                else if (a.a.x == b.a.x && a.b.x == b.b.x && a.b.y == b.a.y)
+                    a.b.y = b.b.y;
+                else
+                    continue;
+
+                free_rects.erase(free_rects.begin() + j);
+                merged = true;
+            }
+        }
+    }
+
+    void DynamicPacker::Clear()
+    {
+        num_allocated = 0;
+        free_rects.clear();
+        ivec2 box_size = size + inner_gaps; // The gaps of the rightmost and bottommost rectangles can go past the edge.
+        if ((box_size > 0).all())
+            free_rects.push_back(ivec2().rect_size(box_size));
+    }
 }
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <cstddef>
+#include <optional>
+#include <vector>
+
 #include "utils/mat.h"
 
 namespace Packing
@@ -20,4 +24,31 @@ namespace Packing
     // Returns 0 on success. On failure returns the amount of rectangles that didn't fit into the box.
     // Note that coordinates outside of [0;65535] range are not supported by default. This can be changed in `stb_rect_pack.h`.
     int PackRects(ivec2 target_size, Rect *data, int count, int inner_gaps = 0, int outer_gaps = 0);
+
+    // Packs rectangles into a box one at a time, and lets you remove them later, without moving the remaining ones.
+    // Uses the guillotine algorithm: the free space is stored as a list of non-overlapping rectangles.
+    // Each allocation takes the best fitting free rectangle and splits the remainder in two. Freeing merges the adjacent free rectangles back when possible.
+    // The merging can't always undo the fragmentation, but once every rectangle is freed, the whole box becomes available again.
+    class DynamicPacker
+    {
+        ivec2 size = ivec2(0);
+        int inner_gaps = 0;
+        std::vector<irect2> free_rects; // Those include the gaps.
+        std::size_t num_allocated = 0;
+
+      public:
+        DynamicPacker() {}
+        DynamicPacker(ivec2 size, int inner_gaps = 0);
+
+        [[nodiscard]] ivec2 Size() const {return size;}
+
+        // Returns the position of the new rectangle, or null if it doesn't fit.
+        [[nodiscard]] std::optional<ivec2> Allocate(ivec2 rect_size);
+
+        // Frees a rectangle previously returned by `Allocate()`.
+        void Free(ivec2 pos, ivec2 rect_size);
+
+        // Frees all rectangles.
+        void Clear();
+    };
 }
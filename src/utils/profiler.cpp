@@ -0,0 +1,267 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include "strings/format.h"
+
+namespace Profiler
+{
+    // All thread buffers. The threads hold references to their buffers too, so the registry knows when they exit.
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<std::shared_ptr<impl::ThreadBuffer>> buffers;
+        std::size_t next_thread_index = 0;
+        std::uint64_t dropped_zones_in_removed_buffers = 0;
+    };
+
+    [[nodiscard]] static Registry &GetRegistry()
+    {
+        static Registry ret;
+        return ret;
+    }
+
+    impl::ThreadBuffer &impl::CurrentThreadBuffer()
+    {
+        thread_local std::shared_ptr<ThreadBuffer> buffer = []{
+            Registry &registry = GetRegistry();
+            std::lock_guard lock(registry.mutex);
+            auto ret = std::make_shared<ThreadBuffer>();
+            ret->thread_index = registry.next_thread_index++;
+            ret->thread_name = FMT("Thread {}", ret->thread_index + 1);
+            registry.buffers.push_back(ret);
+            return ret;
+        }();
+        return *buffer;
+    }
+
+    void SetThreadName(std::string name)
+    {
+        impl::ThreadBuffer &buffer = impl::CurrentThreadBuffer();
+        std::lock_guard lock(GetRegistry().mutex);
+        buffer.thread_name = std::move(name);
+    }
+
+    struct Collector::Data
+    {
+        // A zone that began, but didn't end yet.
+        struct OpenZone
+        {
+            std::uint64_t start = 0;
+            std::size_t node = 0; // In the tree of the current frame.
+        };
+
+        // What we know about a thread between the frames.
+        struct ThreadState
+        {
+            std::vector<const char *> names; // Names of the open zones.
+            std::vector<OpenZone> open_zones;
+            ThreadTree tree; // The tree of the current frame.
+        };
+
+        std::size_t history_size = 0;
+        bool paused = false;
+
+        std::deque<Frame> frames;
+        std::map<std::size_t, ThreadState> threads; // By `ThreadBuffer::thread_index`.
+        std::uint64_t frame_start = 0;
+
+        [[nodiscard]] static std::size_t FindOrAddChild(ThreadTree &tree, std::size_t parent, const char *name)
+        {
+            for (std::size_t child : tree.nodes[parent].children)
+            {
+                // Not comparing the strings, since the names are usually string literals, and this is faster.
+                // The worst case is that the same zone is listed several times.
+                if (tree.nodes[child].name == name)
+                    return child;
+            }
+
+            std::size_t ret = tree.nodes.size();
+            tree.nodes[parent].children.push_back(ret);
+            tree.nodes.push_back({.name = name, .duration = 0, .calls = 0, .children = {}});
+            return ret;
+        }
+
+        static void ResetTree(ThreadState &state)
+        {
+            state.tree.nodes.clear();
+            state.tree.nodes.emplace_back();
+        }
+
+        void ProcessEvent(ThreadState &state, const impl::Event &event)
+        {
+            if (event.name)
+            {
+                std::size_t parent = state.open_zones.empty() ? 0 : state.open_zones.back().node;
+                state.names.push_back(event.name);
+                state.open_zones.push_back({.start = event.time, .node = FindOrAddChild(state.tree, parent, event.name)});
+            }
+            else if (!state.open_zones.empty()) // This should always be true, but just in case.
+            {
+                Node &node = state.tree.nodes[state.open_zones.back().node];
+                node.duration += event.time - state.open_zones.back().start;
+                node.calls++;
+                state.names.pop_back();
+                state.open_zones.pop_back();
+            }
+        }
+
+        // Finishes the tree of the current frame, and starts a new one. The open zones are split at `time`.
+        [[nodiscard]] ThreadTree FinishTree(ThreadState &state, std::uint64_t time)
+        {
+            for (OpenZone &zone : state.open_zones)
+                state.tree.nodes[zone.node].duration += time - zone.start;
+
+            ThreadTree ret = std::move(state.tree);
+            ResetTree(state);
+
+            std::size_t parent = 0;
+            for (std::size_t i = 0; i < state.open_zones.size(); i++)
+            {
+                parent = FindOrAddChild(state.tree, parent, state.names[i]);
+                state.open_zones[i] = {.start = time, .node = parent};
+            }
+
+            for (std::size_t child : ret.nodes.front().children)
+                ret.nodes.front().duration += ret.nodes[child].duration;
+            return ret;
+        }
+    };
+
+    Collector::Collector(std::size_t history_size) : data(std::make_unique<Data>())
+    {
+        data->history_size = history_size;
+        data->frame_start = Clock::Time();
+    }
+
+    Collector::Collector(Collector &&) noexcept = default;
+    Collector &Collector::operator=(Collector &&) noexcept = default;
+    Collector::~Collector() = default;
+
+    void Collector::EndFrame()
+    {
+        std::uint64_t now = Clock::Time();
+
+        Frame frame;
+        frame.start = data->frame_start;
+        frame.duration = now - data->frame_start;
+        data->frame_start = now;
+
+        Registry &registry = GetRegistry();
+        std::lock_guard lock(registry.mutex);
+
+        for (auto it = registry.buffers.begin(); it != registry.buffers.end();)
+        {
+            impl::ThreadBuffer &buffer = **it;
+            // Check this before reading the events, so we don't miss the last ones.
+            bool thread_exited = it->use_count() == 1;
+
+            auto [state_iter, is_new] = data->threads.try_emplace(buffer.thread_index);
+            Data::ThreadState &state = state_iter->second;
+            if (is_new)
+                Data::ResetTree(state);
+
+            // Read the events.
+            std::uint64_t read = buffer.read_index.load(std::memory_order_relaxed);
+            std::uint64_t write = buffer.write_index.load(std::memory_order_acquire);
+            for (; read < write; read++)
+                data->ProcessEvent(state, buffer.events[read % impl::ThreadBuffer::capacity]);
+            buffer.read_index.store(read, std::memory_order_release);
+
+            ThreadTree tree = data->FinishTree(state, now);
+            if (tree.nodes.size() > 1)
+            {
+                tree.thread_index = buffer.thread_index;
+                tree.thread_name = buffer.thread_name;
+                frame.threads.push_back(std::move(tree));
+            }
+
+            // Forget the threads that exited.
+            if (thread_exited)
+            {
+                registry.dropped_zones_in_removed_buffers += buffer.dropped_zones.load(std::memory_order_relaxed);
+                data->threads.erase(buffer.thread_index);
+                it = registry.buffers.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        if (data->paused || data->history_size == 0)
+            return;
+
+        std::sort(frame.threads.begin(), frame.threads.end(), [](const ThreadTree &a, const ThreadTree &b){return a.thread_index < b.thread_index;});
+        if (data->frames.size() >= data->history_size)
+            data->frames.pop_front();
+        data->frames.push_back(std::move(frame));
+    }
+
+    void Collector::SetPaused(bool paused)
+    {
+        data->paused = paused;
+    }
+
+    bool Collector::IsPaused() const
+    {
+        return data->paused;
+    }
+
+    const std::deque<Frame> &Collector::Frames() const
+    {
+        return data->frames;
+    }
+
+    std::uint64_t Collector::DroppedZones() const
+    {
+        Registry &registry = GetRegistry();
+        std::lock_guard lock(registry.mutex);
+        std::uint64_t ret = registry.dropped_zones_in_removed_buffers;
+        for (const auto &buffer : registry.buffers)
+            ret += buffer->dropped_zones.load(std::memory_order_relaxed);
+        return ret;
+    }
+
+    void Collector::WriteFoldedStacks(Stream::Output &output) const
+    {
+        // Self times by the call stack.
+        std::map<std::string, std::uint64_t> stacks;
+
+        auto AddNode = [&](auto &self, const ThreadTree &tree, std::size_t index, const std::string &stack) -> void
+        {
+            const Node &node = tree.nodes[index];
+            std::uint64_t self_time = node.duration;
+            for (std::size_t child : node.children)
+            {
+                self_time -= std::min(self_time, tree.nodes[child].duration);
+                self(self, tree, child, stack + ';' + tree.nodes[child].name);
+            }
+            if (index != 0)
+                stacks[stack] += self_time;
+        };
+
+        for (const Frame &frame : data->frames)
+        {
+            for (const ThreadTree &tree : frame.threads)
+                AddNode(AddNode, tree, 0, tree.thread_name);
+        }
+
+        for (const auto &[stack, ticks] : stacks)
+        {
+            auto us = std::uint64_t(Clock::TicksToSeconds(ticks) * 1e6);
+            if (us > 0)
+                output.WriteString(FMT("{} {}\n", stack, us));
+        }
+    }
+
+    void Collector::SaveFoldedStacks(const std::string &file_name) const
+    {
+        Stream::Output output(file_name, Stream::text);
+        WriteFoldedStacks(output);
+        output.Flush();
+    }
+}
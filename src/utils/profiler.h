@@ -0,0 +1,210 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "program/platform.h"
+#include "stream/output.h"
+#include "utils/clock.h"
+
+// A lightweight instrumenting CPU profiler.
+// Mark the interesting scopes with `PROFILE_ZONE("name")` (or `PROFILE_FUNCTION()`), and call `Collector::EndFrame()` once per frame.
+// The collector then builds a call tree for each thread for each frame, which can be shown with `Interface::ProfilerWindow()`,
+// or exported in the "folded stacks" format understood by most flame graph tools.
+// Each thread records the zone boundaries into its own lock-free ring buffer, so the zones are cheap, and can be used on any thread.
+// If `IMP_PROFILER_ENABLED` is 0 (the default in production builds), the zone macros expand to nothing.
+// Usage:
+//     Profiler::Collector profiler;
+//     void Tick()
+//     {
+//         PROFILE_ZONE("Tick");
+//         {
+//             PROFILE_ZONE("Physics");
+//             ...
+//         }
+//     }
+//     void EndFrame()
+//     {
+//         profiler.EndFrame();
+//     }
+
+#ifndef IMP_PROFILER_ENABLED
+#  if IMP_PLATFORM_IS(prod)
+#    define IMP_PROFILER_ENABLED 0
+#  else
+#    define IMP_PROFILER_ENABLED 1
+#  endif
+#endif
+
+#if IMP_PROFILER_ENABLED
+// Profiles the rest of the current scope. The name must be a string literal, or otherwise live until the profiling data is destroyed.
+#  define PROFILE_ZONE(name) ::Profiler::ScopedZone PROFILE_ZONE_impl_cat(_profiler_zone_,__LINE__)(name)
+#else
+#  define PROFILE_ZONE(name) do {} while (false)
+#endif
+
+// Profiles the rest of the current function, using its name as the zone name.
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+
+#define PROFILE_ZONE_impl_cat(a, b) PROFILE_ZONE_impl_cat_(a, b)
+#define PROFILE_ZONE_impl_cat_(a, b) a##b
+
+namespace Profiler
+{
+    namespace impl
+    {
+        // A zone boundary.
+        struct Event
+        {
+            const char *name = nullptr; // Null for the end of a zone.
+            std::uint64_t time = 0;
+        };
+
+        // The events of a single thread. Written only by that thread, and read only by `Collector::EndFrame()`.
+        struct ThreadBuffer
+        {
+            static constexpr std::size_t capacity = 1 << 14;
+
+            std::array<Event, capacity> events;
+
+            // Both indices only increase. Event number `i % capacity` belongs to the reader if `read_index <= i < write_index`, and to the writer otherwise.
+            std::atomic<std::uint64_t> write_index = 0; // Only modified by the writer.
+            std::atomic<std::uint64_t> read_index = 0; // Only modified by the reader.
+
+            // Those are only used by the writer.
+            std::size_t open_zones = 0; // The zones that were recorded, but not ended yet. We always keep enough space to end them.
+            std::size_t dropped_depth = 0; // If not zero, we're inside of a zone that didn't fit into the buffer, and drop all events until it ends.
+
+            std::atomic<std::uint64_t> dropped_zones = 0;
+
+            std::size_t thread_index = 0; // In the order of the first zone on each thread.
+            std::string thread_name; // Protected by the registry mutex.
+
+            ThreadBuffer() {}
+            ThreadBuffer(const ThreadBuffer &) = delete;
+            ThreadBuffer &operator=(const ThreadBuffer &) = delete;
+
+            void BeginZone(const char *name)
+            {
+                std::uint64_t write = write_index.load(std::memory_order_relaxed);
+                std::uint64_t free = capacity - (write - read_index.load(std::memory_order_acquire));
+
+                // Need space for this event, for its end, and for the ends of all open zones.
+                if (dropped_depth > 0 || free < open_zones + 2)
+                {
+                    if (dropped_depth++ == 0)
+                        dropped_zones.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+
+                events[write % capacity] = {.name = name, .time = Clock::Time()};
+                write_index.store(write + 1, std::memory_order_release);
+                open_zones++;
+            }
+
+            void EndZone()
+            {
+                if (dropped_depth > 0)
+                {
+                    dropped_depth--;
+                    return;
+                }
+
+                std::uint64_t write = write_index.load(std::memory_order_relaxed);
+                events[write % capacity] = {.name = nullptr, .time = Clock::Time()};
+                write_index.store(write + 1, std::memory_order_release);
+                open_zones--;
+            }
+        };
+
+        // Returns the buffer of the current thread, creating it on the first call.
+        [[nodiscard]] ThreadBuffer &CurrentThreadBuffer();
+    }
+
+    class ScopedZone
+    {
+        impl::ThreadBuffer *buffer = nullptr;
+
+      public:
+        explicit ScopedZone(const char *name) : buffer(&impl::CurrentThreadBuffer())
+        {
+            buffer->BeginZone(name);
+        }
+
+        ScopedZone(const ScopedZone &) = delete;
+        ScopedZone &operator=(const ScopedZone &) = delete;
+
+        ~ScopedZone()
+        {
+            buffer->EndZone();
+        }
+    };
+
+    // Sets the name of the current thread, as shown in the profiling results.
+    // By default the threads are named `Thread 1`, `Thread 2`, etc, in the order of their first zone.
+    void SetThreadName(std::string name);
+
+    // A zone in a call tree. The zones with the same name and the same parent are merged together.
+    struct Node
+    {
+        const char *name = nullptr; // Null for the root.
+        std::uint64_t duration = 0; // In clock ticks. For the root, this is the sum of its children.
+        std::uint32_t calls = 0; // How many times this zone ended in this frame.
+        std::vector<std::size_t> children; // Indices in `ThreadTree::nodes`, in the order of the first call.
+    };
+
+    struct ThreadTree
+    {
+        std::size_t thread_index = 0;
+        std::string thread_name;
+        std::vector<Node> nodes; // The first node is the root.
+    };
+
+    struct Frame
+    {
+        std::uint64_t start = 0; // In clock ticks.
+        std::uint64_t duration = 0;
+        std::vector<ThreadTree> threads; // Sorted by `thread_index`. Only the threads that had zones in this frame are listed.
+    };
+
+    // Collects the zones from all threads into per-frame call trees.
+    // The zones that cross a frame boundary are split between the frames, and only counted as calls in the frame where they end.
+    class Collector
+    {
+        struct Data;
+        std::unique_ptr<Data> data;
+
+      public:
+        // Remembers the last `history_size` frames.
+        Collector(std::size_t history_size = 240);
+        Collector(Collector &&) noexcept;
+        Collector &operator=(Collector &&) noexcept;
+        ~Collector();
+
+        // Collects the events since the last call, and finishes the current frame.
+        // Only one collector should exist at a time, since this removes the events from the thread buffers.
+        void EndFrame();
+
+        // While paused, `EndFrame()` still consumes the events, but discards them, so the history doesn't change.
+        void SetPaused(bool paused);
+        [[nodiscard]] bool IsPaused() const;
+
+        // The frames are ordered from the oldest to the newest.
+        [[nodiscard]] const std::deque<Frame> &Frames() const;
+
+        // How many zones were dropped because the thread buffers were full. Call `EndFrame()` more often if this grows.
+        [[nodiscard]] std::uint64_t DroppedZones() const;
+
+        // Writes the remembered frames in the "folded stacks" format: one line per call stack, with its self time in microseconds summed over all frames.
+        // For example, `Thread 1;Tick;Physics 1234`. Most flame graph tools (`flamegraph.pl`, speedscope, etc) can read this.
+        void WriteFoldedStacks(Stream::Output &output) const;
+        // Same, but writes to a file. Throws on failure.
+        void SaveFoldedStacks(const std::string &file_name) const;
+    };
+}
@@ -13,12 +13,15 @@
 #include "meta/common.h"
 #include "program/errors.h"
 #include "utils/mat.h"
+#include "utils/random_generators.h"
 #include "utils/robust_math.h"
 
 /* Convenient random number generation helpers.
 Suggested minimal setup:
     auto random_generator = Random::MakeGeneratorFromRandomDevice();
     Random::DefaultInterfaces ra(random_generator);
+For a smaller and faster generator, use `MakeGeneratorFromRandomDevice<Random::Xoshiro256>()`. See `random_generators.h` for more generators,
+and for the bulk and the stateless (counter-based) generation.
 
 Usage:
 
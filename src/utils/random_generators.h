@@ -0,0 +1,355 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include "program/errors.h"
+#include "strings/format.h"
+#include "utils/mat.h"
+
+// Small and fast random number generators, as alternatives to `std::mt19937` (which has 2.5 KB of state).
+// They satisfy the standard "uniform random bit generator" requirements, so they work with `Random::Interface`, `Random::Misc`,
+// `Random::MakeGenerator()`, and the standard distributions.
+// Unlike the standard distributions, the `Random::Generate...()` functions below give the same results on all platforms.
+// Usage:
+//     auto gen = Random::MakeGeneratorFromRandomDevice<Random::Xoshiro256>();
+//     Random::DefaultInterfaces ra(gen);
+//     // Or, for the parallel code, a generator per item, independent of the iteration order:
+//     auto tile_gen = Random::SplitMix64::ForIndex(world_seed, tile_index);
+
+namespace Random
+{
+    namespace impl
+    {
+        // A `std::seed_seq`-like class.
+        template <typename T>
+        concept SeedSequence = requires(T &t, std::uint32_t *ptr){t.generate(ptr, ptr);};
+
+        // Fills `N` 64-bit words from a seed sequence.
+        template <std::size_t N>
+        [[nodiscard]] std::array<std::uint64_t, N> WordsFromSeedSequence(SeedSequence auto &seq)
+        {
+            std::array<std::uint32_t, N * 2> halves{};
+            seq.generate(halves.begin(), halves.end());
+            std::array<std::uint64_t, N> ret{};
+            for (std::size_t i = 0; i < N; i++)
+                ret[i] = halves[i * 2] | std::uint64_t(halves[i * 2 + 1]) << 32;
+            return ret;
+        }
+    }
+
+    // SplitMix64, by Sebastiano Vigna. A 64-bit state, and each output is a hash of the state.
+    // Mostly useful for seeding other generators, and as a counter-based generator: `Hash(seed, index)` is a random number for any index.
+    class SplitMix64
+    {
+        std::uint64_t state = 0;
+
+      public:
+        using result_type = std::uint64_t;
+
+        static constexpr std::uint64_t increment = 0x9e3779b97f4a7c15;
+
+        constexpr SplitMix64() {}
+        constexpr explicit SplitMix64(std::uint64_t seed) : state(seed) {}
+        explicit SplitMix64(impl::SeedSequence auto &seq) : state(impl::WordsFromSeedSequence<1>(seq)[0]) {}
+
+        // The output function. A good 64-bit hash on its own.
+        [[nodiscard]] static constexpr std::uint64_t Mix(std::uint64_t x)
+        {
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+            return x ^ (x >> 31);
+        }
+
+        // A random number for the specified index, without any state. Same as the `index`-th output of `SplitMix64(seed)`, counting from 0.
+        // Use this to generate random numbers in parallel, or in any order.
+        [[nodiscard]] static constexpr std::uint64_t Hash(std::uint64_t seed, std::uint64_t index)
+        {
+            return Mix(seed + (index + 1) * increment);
+        }
+
+        // Returns a generator for the specified index, independent from the generators for the other indices.
+        // Use this when a single number per index isn't enough.
+        [[nodiscard]] static constexpr SplitMix64 ForIndex(std::uint64_t seed, std::uint64_t index)
+        {
+            // Mixing the index, since the streams of `SplitMix64(seed + index * increment)` would be shifted copies of each other.
+            return SplitMix64(Mix(seed ^ Mix(index + increment)));
+        }
+
+        [[nodiscard]] static constexpr result_type min() {return 0;}
+        [[nodiscard]] static constexpr result_type max() {return std::numeric_limits<result_type>::max();}
+
+        constexpr result_type operator()()
+        {
+            state += increment;
+            return Mix(state);
+        }
+    };
+
+    // xoshiro256**, by David Blackman and Sebastiano Vigna. A 256-bit state, and a very fast and high-quality output.
+    // A good general-purpose replacement for `std::mt19937`.
+    class Xoshiro256
+    {
+        std::array<std::uint64_t, 4> state{};
+
+        void SeedFrom(SplitMix64 gen)
+        {
+            for (std::uint64_t &word : state)
+                word = gen();
+        }
+
+      public:
+        using result_type = std::uint64_t;
+
+        // The state is initialized with the outputs of `SplitMix64(0)`, since an all-zero state is invalid.
+        Xoshiro256() {SeedFrom(SplitMix64());}
+        explicit Xoshiro256(std::uint64_t seed) {SeedFrom(SplitMix64(seed));}
+        explicit Xoshiro256(impl::SeedSequence auto &seq)
+        {
+            state = impl::WordsFromSeedSequence<4>(seq);
+            if (state == decltype(state){})
+                SeedFrom(SplitMix64());
+        }
+
+        // Sets the state directly. It must not be all zeroes.
+        [[nodiscard]] static Xoshiro256 FromState(const std::array<std::uint64_t, 4> &state)
+        {
+            ASSERT(state != std::array<std::uint64_t, 4>{}, "The xoshiro256 state must not be all zeroes.");
+            Xoshiro256 ret;
+            ret.state = state;
+            return ret;
+        }
+
+        [[nodiscard]] static constexpr result_type min() {return 0;}
+        [[nodiscard]] static constexpr result_type max() {return std::numeric_limits<result_type>::max();}
+
+        result_type operator()()
+        {
+            std::uint64_t ret = std::rotl(state[1] * 5, 7) * 9;
+            std::uint64_t t = state[1] << 17;
+            state[2] ^= state[0];
+            state[3] ^= state[1];
+            state[1] ^= state[2];
+            state[0] ^= state[3];
+            state[2] ^= t;
+            state[3] = std::rotl(state[3], 45);
+            return ret;
+        }
+
+        // Advances the state by 2^128 steps. Calling this repeatedly on a copy gives non-overlapping streams for parallel use.
+        void Jump()
+        {
+            static constexpr std::uint64_t polynomial[] = {0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c};
+
+            std::array<std::uint64_t, 4> result{};
+            for (std::uint64_t word : polynomial)
+            {
+                for (int bit = 0; bit < 64; bit++)
+                {
+                    if (word & std::uint64_t(1) << bit)
+                    {
+                        for (std::size_t i = 0; i < 4; i++)
+                            result[i] ^= state[i];
+                    }
+                    (void)operator()();
+                }
+            }
+            state = result;
+        }
+    };
+
+    // PCG32 (XSH-RR variant), by Melissa O'Neill. A 128-bit state (including the stream selector), 32-bit output.
+    // Different `stream` values give independent sequences for the same seed.
+    class Pcg32
+    {
+        std::uint64_t state = 0;
+        std::uint64_t inc = 1; // Must be odd.
+
+        static constexpr std::uint64_t multiplier = 6364136223846793005;
+
+      public:
+        using result_type = std::uint32_t;
+
+        Pcg32() : Pcg32(0) {}
+        explicit Pcg32(std::uint64_t seed, std::uint64_t stream = 0)
+        {
+            inc = stream << 1 | 1;
+            (void)operator()();
+            state += seed;
+            (void)operator()();
+        }
+        explicit Pcg32(impl::SeedSequence auto &seq)
+        {
+            auto words = impl::WordsFromSeedSequence<2>(seq);
+            *this = Pcg32(words[0], words[1]);
+        }
+
+        [[nodiscard]] static constexpr result_type min() {return 0;}
+        [[nodiscard]] static constexpr result_type max() {return std::numeric_limits<result_type>::max();}
+
+        result_type operator()()
+        {
+            std::uint64_t old_state = state;
+            state = old_state * multiplier + inc;
+            auto xorshifted = std::uint32_t(((old_state >> 18) ^ old_state) >> 27);
+            auto rotation = int(old_state >> 59);
+            return std::rotr(xorshifted, rotation);
+        }
+    };
+
+    // Reads 32-bit words from a generator, splitting the 64-bit outputs in halves. This is itself a 32-bit generator.
+    // `GenerateUniform()` wraps the generator in this, so if you pass a 64-bit generator directly, the unused upper half of its last output
+    // is discarded at the end of each call. Pass a `WordReader` instead to keep that half for the next call,
+    // then the results won't depend on how they're split into batches.
+    template <typename Generator>
+    class WordReader
+    {
+        static_assert(Generator::min() == 0 && (Generator::max() == 0xffffffff || Generator::max() == 0xffffffffffffffff),
+            "The generator must produce all 32 or 64 bits.");
+
+        Generator *gen = nullptr;
+        std::uint32_t saved = 0;
+        bool have_saved = false;
+
+      public:
+        using result_type = std::uint32_t;
+
+        explicit WordReader(Generator &gen) : gen(&gen) {}
+
+        [[nodiscard]] static constexpr result_type min() {return 0;}
+        [[nodiscard]] static constexpr result_type max() {return std::numeric_limits<result_type>::max();}
+
+        result_type operator()()
+        {
+            if constexpr (Generator::max() == 0xffffffff)
+            {
+                return std::uint32_t((*gen)());
+            }
+            else
+            {
+                if (have_saved)
+                {
+                    have_saved = false;
+                    return saved;
+                }
+                std::uint64_t word = (*gen)();
+                saved = std::uint32_t(word >> 32);
+                have_saved = true;
+                return std::uint32_t(word);
+            }
+        }
+    };
+
+    namespace impl
+    {
+        // A float in `[0,1)`, from the top 24 bits.
+        [[nodiscard]] inline float WordToUnitFloat(std::uint32_t word)
+        {
+            return float(word >> 8) * 0x1p-24f;
+        }
+
+        // An integer in `[0,range)`, using Lemire's multiply-shift method with rejection, which is unbiased. `range` must be positive.
+        template <typename Reader>
+        [[nodiscard]] std::uint32_t WordsToBoundedInt(Reader &reader, std::uint32_t range)
+        {
+            std::uint64_t product = std::uint64_t(reader()) * range;
+            auto low = std::uint32_t(product);
+            if (low < range)
+            {
+                std::uint32_t threshold = -range % range;
+                while (low < threshold)
+                {
+                    product = std::uint64_t(reader()) * range;
+                    low = std::uint32_t(product);
+                }
+            }
+            return std::uint32_t(product >> 32);
+        }
+
+        template <typename T>
+        concept BulkScalar = std::same_as<T, int> || std::same_as<T, float>;
+    }
+
+    // A 32-bit `int` or `float`, or a vector of them.
+    template <typename T>
+    concept BulkScalarOrVec = impl::BulkScalar<Math::vec_base_t<T>>;
+
+    // Fills `output` with random values, `min <= x <= max`, independently for each vector component.
+    // This is faster than `Random::Interface`, since it doesn't use the standard distributions, and also gives the same results on all platforms.
+    // The floats have 24 random bits (the upper bound is reachable only through rounding), and the integers are unbiased.
+    // `Generator` must produce 32-bit or 64-bit outputs, such as `Xoshiro256` or `Pcg32`. The 64-bit outputs are split into two 32-bit numbers.
+    // With a 64-bit generator, an odd number of 32-bit numbers used by a call wastes a half of the last output, so splitting the same output
+    // into batches differently gives different results. To avoid that, wrap the generator in a `WordReader` and pass that instead.
+    template <BulkScalarOrVec T, typename Generator>
+    void GenerateUniform(Generator &gen, std::span<T> output, T min, T max)
+    {
+        using scalar_t = Math::vec_base_t<T>;
+        constexpr int size = Math::vec_size_v<T>;
+
+        WordReader<Generator> reader(gen);
+
+        if constexpr (std::is_floating_point_v<scalar_t>)
+        {
+            T range = max - min;
+
+            // Generate the numbers in chunks, so the conversion loop can be vectorized.
+            constexpr std::size_t chunk_size = 64;
+            std::array<std::uint32_t, chunk_size * size> words;
+            for (std::size_t chunk_start = 0; chunk_start < output.size(); chunk_start += chunk_size)
+            {
+                std::size_t count = std::min(chunk_size, output.size() - chunk_start);
+                for (std::size_t i = 0; i < count * size; i++)
+                    words[i] = reader();
+
+                for (std::size_t i = 0; i < count; i++)
+                {
+                    T &target = output[chunk_start + i];
+                    for (int j = 0; j < size; j++)
+                        Math::vec_elem(j, target) = Math::vec_elem(j, min) + impl::WordToUnitFloat(words[i * size + j]) * Math::vec_elem(j, range);
+                }
+            }
+        }
+        else
+        {
+            std::array<std::uint32_t, size> ranges{}; // Zero means the full 32-bit range.
+            for (int j = 0; j < size; j++)
+            {
+                // Make sure the range is valid.
+                if (Math::vec_elem(j, min) > Math::vec_elem(j, max))
+                {
+                    ASSERT(false, FMT("Invalid random number range: min={} is greater than max={}.", Math::vec_elem(j, min), Math::vec_elem(j, max)));
+                    std::swap(Math::vec_elem(j, min), Math::vec_elem(j, max));
+                }
+                ranges[j] = std::uint32_t(Math::vec_elem(j, max)) - std::uint32_t(Math::vec_elem(j, min)) + 1;
+            }
+
+            for (T &target : output)
+            {
+                for (int j = 0; j < size; j++)
+                {
+                    std::uint32_t offset = ranges[j] == 0 ? reader() : impl::WordsToBoundedInt(reader, ranges[j]);
+                    Math::vec_elem(j, target) = scalar_t(std::uint32_t(Math::vec_elem(j, min)) + offset);
+                }
+            }
+        }
+    }
+
+    // Returns a random value, `min <= x <= max`, that depends only on `seed` and `index`. See `GenerateUniform()` for the details.
+    // Use this for the parallel code, and for things like per-tile randomness, where the value must not depend on the iteration order.
+    template <BulkScalarOrVec T>
+    [[nodiscard]] T GenerateUniformAt(std::uint64_t seed, std::uint64_t index, T min, T max)
+    {
+        SplitMix64 gen = SplitMix64::ForIndex(seed, index);
+        T ret{};
+        GenerateUniform(gen, std::span(&ret, 1), min, max);
+        return ret;
+    }
+}
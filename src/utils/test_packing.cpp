@@ -0,0 +1,109 @@
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <random>
+
+#include <utils/packing.h>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    // Checks that the rectangles are inside of the box, and don't overlap each other or their gaps.
+    void CheckRects(const std::map<int, irect2> &rects, ivec2 box_size, int gaps)
+    {
+        for (auto a = rects.begin(); a != rects.end(); a++)
+        {
+            REQUIRE((a->second.a >= 0).all());
+            REQUIRE((a->second.b <= box_size).all());
+
+            irect2 a_with_gaps = a->second.a.rect_size(a->second.size() + gaps);
+            for (auto b = std::next(a); b != rects.end(); b++)
+                REQUIRE_FALSE(a_with_gaps.touches(b->second.a.rect_size(b->second.size() + gaps)));
+        }
+    }
+}
+
+TEST_CASE("packing.dynamic_packer_random")
+{
+    std::mt19937 gen(42);
+
+    for (int gaps : {0, 1, 3})
+    {
+        const ivec2 box_size(200, 150);
+        Packing::DynamicPacker packer(box_size, gaps);
+        REQUIRE(packer.Size() == box_size);
+
+        std::map<int, irect2> rects;
+        int next_id = 0;
+
+        for (int i = 0; i < 2000; i++)
+        {
+            if (rects.empty() || gen() % 3 != 0)
+            {
+                ivec2 size(1 + int(gen() % 40), 1 + int(gen() % 40));
+                if (std::optional<ivec2> pos = packer.Allocate(size))
+                    rects.try_emplace(next_id++, pos->rect_size(size));
+            }
+            else
+            {
+                auto it = std::next(rects.begin(), std::ptrdiff_t(gen() % rects.size()));
+                packer.Free(it->second.a, it->second.size());
+                rects.erase(it);
+            }
+
+            CheckRects(rects, box_size, gaps);
+        }
+
+        // Once everything is freed, the whole box is available again.
+        for (const auto &[id, rect] : rects)
+            packer.Free(rect.a, rect.size());
+        REQUIRE(packer.Allocate(box_size) == ivec2(0));
+    }
+}
+
+TEST_CASE("packing.dynamic_packer_reuse")
+{
+    Packing::DynamicPacker packer(ivec2(64), 0);
+
+    // Fill the box exactly.
+    std::map<int, irect2> rects;
+    for (int i = 0; i < 4; i++)
+    {
+        std::optional<ivec2> pos = packer.Allocate(ivec2(32));
+        REQUIRE(pos);
+        rects.try_emplace(i, pos->rect_size(ivec2(32)));
+    }
+    CheckRects(rects, ivec2(64), 0);
+
+    // The box is full.
+    REQUIRE_FALSE(packer.Allocate(ivec2(1)));
+
+    // The freed space is reused.
+    packer.Free(rects.at(2).a, ivec2(32));
+    std::optional<ivec2> pos = packer.Allocate(ivec2(32));
+    REQUIRE(pos == rects.at(2).a);
+    REQUIRE_FALSE(packer.Allocate(ivec2(1)));
+
+    // The adjacent freed rectangles are merged, so a larger one fits.
+    packer.Free(ivec2(0, 0), ivec2(32));
+    packer.Free(ivec2(32, 0), ivec2(32));
+    REQUIRE_FALSE(packer.Allocate(ivec2(64, 33)));
+    REQUIRE(packer.Allocate(ivec2(64, 32)) == ivec2(0));
+    REQUIRE_FALSE(packer.Allocate(ivec2(1)));
+
+    // Too large to ever fit.
+    packer.Clear();
+    REQUIRE_FALSE(packer.Allocate(ivec2(65, 1)));
+    REQUIRE(packer.Allocate(ivec2(64)) == ivec2(0));
+}
+
+TEST_CASE("packing.dynamic_packer_gaps")
+{
+    // The gaps are only needed between the rectangles, not at the edges of the box.
+    Packing::DynamicPacker packer(ivec2(21, 10), 1);
+    REQUIRE(packer.Allocate(ivec2(10)) == ivec2(0));
+    REQUIRE(packer.Allocate(ivec2(10)) == ivec2(11, 0));
+    REQUIRE_FALSE(packer.Allocate(ivec2(1)));
+}
@@ -0,0 +1,156 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <utils/profiler.h>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    [[nodiscard]] const Profiler::ThreadTree *FindThread(const Profiler::Frame &frame, std::string_view name)
+    {
+        for (const Profiler::ThreadTree &tree : frame.threads)
+        {
+            if (tree.thread_name == name)
+                return &tree;
+        }
+        return nullptr;
+    }
+
+    // The names of the children of a node, in order.
+    [[nodiscard]] std::vector<std::string> ChildNames(const Profiler::ThreadTree &tree, std::size_t index)
+    {
+        std::vector<std::string> ret;
+        for (std::size_t child : tree.nodes[index].children)
+            ret.push_back(tree.nodes[child].name);
+        return ret;
+    }
+
+    // Checks that each node takes at least as long as its children, and that the root is the sum of its children.
+    void CheckDurations(const Profiler::ThreadTree &tree)
+    {
+        std::uint64_t root_sum = 0;
+        for (std::size_t child : tree.nodes.front().children)
+            root_sum += tree.nodes[child].duration;
+        REQUIRE(tree.nodes.front().duration == root_sum);
+
+        for (std::size_t i = 1; i < tree.nodes.size(); i++)
+        {
+            std::uint64_t sum = 0;
+            for (std::size_t child : tree.nodes[i].children)
+                sum += tree.nodes[child].duration;
+            REQUIRE(tree.nodes[i].duration >= sum);
+        }
+    }
+
+    void WorkerJob()
+    {
+        Profiler::SetThreadName("test worker");
+        Profiler::ScopedZone zone("Job");
+        for (int i = 0; i < 3; i++)
+            Profiler::ScopedZone step("Step");
+    }
+}
+
+TEST_CASE("profiler.two_threads")
+{
+    Profiler::Collector collector;
+    collector.EndFrame(); // Discard the events recorded earlier, if any.
+
+    Profiler::SetThreadName("test main");
+    {
+        Profiler::ScopedZone outer("Outer");
+        std::thread thread(WorkerJob);
+        for (int i = 0; i < 2; i++)
+            Profiler::ScopedZone inner("Inner");
+        {
+            Profiler::ScopedZone other("Other");
+            Profiler::ScopedZone nested("Nested");
+        }
+        thread.join();
+    }
+    collector.EndFrame();
+
+    REQUIRE(collector.Frames().size() == 2);
+    const Profiler::Frame &frame = collector.Frames().back();
+
+    const Profiler::ThreadTree *main_tree = FindThread(frame, "test main");
+    REQUIRE(main_tree);
+    REQUIRE(main_tree->nodes.size() == 5);
+    REQUIRE(ChildNames(*main_tree, 0) == std::vector<std::string>{"Outer"});
+    std::size_t outer = main_tree->nodes.front().children.front();
+    REQUIRE(main_tree->nodes[outer].calls == 1);
+    REQUIRE(ChildNames(*main_tree, outer) == std::vector<std::string>{"Inner", "Other"});
+    const Profiler::Node &inner = main_tree->nodes[main_tree->nodes[outer].children[0]];
+    REQUIRE(inner.calls == 2);
+    REQUIRE(inner.children.empty());
+    std::size_t other = main_tree->nodes[outer].children[1];
+    REQUIRE(main_tree->nodes[other].calls == 1);
+    REQUIRE(ChildNames(*main_tree, other) == std::vector<std::string>{"Nested"});
+    CheckDurations(*main_tree);
+
+    // The worker thread has already exited, but its zones are still collected.
+    const Profiler::ThreadTree *worker_tree = FindThread(frame, "test worker");
+    REQUIRE(worker_tree);
+    REQUIRE(worker_tree->thread_index != main_tree->thread_index);
+    REQUIRE(worker_tree->nodes.size() == 3);
+    REQUIRE(ChildNames(*worker_tree, 0) == std::vector<std::string>{"Job"});
+    std::size_t job = worker_tree->nodes.front().children.front();
+    REQUIRE(worker_tree->nodes[job].calls == 1);
+    REQUIRE(ChildNames(*worker_tree, job) == std::vector<std::string>{"Step"});
+    REQUIRE(worker_tree->nodes[worker_tree->nodes[job].children.front()].calls == 3);
+    CheckDurations(*worker_tree);
+
+    // The threads are sorted.
+    for (std::size_t i = 1; i < frame.threads.size(); i++)
+        REQUIRE(frame.threads[i - 1].thread_index < frame.threads[i].thread_index);
+
+    // The exited thread is forgotten.
+    collector.EndFrame();
+    REQUIRE_FALSE(FindThread(collector.Frames().back(), "test worker"));
+}
+
+TEST_CASE("profiler.zones_crossing_frames")
+{
+    Profiler::Collector collector;
+    collector.EndFrame();
+
+    Profiler::SetThreadName("test main");
+    {
+        Profiler::ScopedZone outer("Long");
+        {
+            Profiler::ScopedZone inner("Short");
+        }
+        collector.EndFrame();
+        Profiler::ScopedZone inner("Short");
+        collector.EndFrame();
+    }
+    collector.EndFrame();
+
+    // The open zones are split between the frames, and are counted as calls only in the frame where they end.
+    REQUIRE(collector.Frames().size() == 4);
+    const std::vector<std::uint32_t> expected_long_calls = {0, 0, 1}, expected_short_calls = {1, 0, 1};
+    for (std::size_t i = 0; i < 3; i++)
+    {
+        const Profiler::ThreadTree *tree = FindThread(collector.Frames()[i + 1], "test main");
+        REQUIRE(tree);
+        REQUIRE(ChildNames(*tree, 0) == std::vector<std::string>{"Long"});
+        std::size_t outer = tree->nodes.front().children.front();
+        REQUIRE(tree->nodes[outer].calls == expected_long_calls[i]);
+        REQUIRE(ChildNames(*tree, outer) == std::vector<std::string>{"Short"});
+        REQUIRE(tree->nodes[tree->nodes[outer].children.front()].calls == expected_short_calls[i]);
+        CheckDurations(*tree);
+    }
+
+    // A paused collector discards the frames.
+    collector.SetPaused(true);
+    {
+        Profiler::ScopedZone zone("Long");
+    }
+    collector.EndFrame();
+    REQUIRE(collector.Frames().size() == 4);
+}
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <utils/random.h>
+
+#include <doctest/doctest.h>
+
+TEST_CASE("random_generators.reference_outputs")
+{
+    // The reference values are from the original implementations.
+    Random::SplitMix64 splitmix(1234567);
+    REQUIRE(splitmix() == 6457827717110365317ull);
+    REQUIRE(splitmix() == 3203168211198807973ull);
+    REQUIRE(Random::SplitMix64::Hash(1234567, 1) == 3203168211198807973ull);
+
+    Random::Xoshiro256 xoshiro = Random::Xoshiro256::FromState({1, 2, 3, 4});
+    REQUIRE(xoshiro() == 11520);
+    REQUIRE(xoshiro() == 0);
+    REQUIRE(xoshiro() == 1509978240);
+    REQUIRE(xoshiro() == 1215971899390074240ull);
+
+    Random::Pcg32 pcg(42, 54);
+    const std::uint32_t expected_pcg[] = {0xa15c02b7, 0x7b47f409, 0xba1d3330, 0x83d2f293, 0xbfa4784b, 0xcbed606e};
+    for (std::uint32_t expected : expected_pcg)
+        REQUIRE(pcg() == expected);
+}
+
+TEST_CASE("random_generators.interfaces")
+{
+    // The generators work with the existing helpers.
+    auto gen = Random::MakeGeneratorFromRandomDevice<Random::Xoshiro256>();
+    Random::DefaultInterfaces ra(gen);
+    for (int i = 0; i < 1000; i++)
+    {
+        int x = -3 <= ra.i <= 5;
+        REQUIRE((x >= -3 && x <= 5));
+        ivec2 v = ra.ivec2 < 4;
+        REQUIRE((v >= 0 && v < 4).all());
+    }
+
+    Random::Pcg32 pcg(1);
+    std::uniform_int_distribution<int> dist(0, 9);
+    REQUIRE(dist(pcg) < 10);
+}
+
+TEST_CASE("random_generators.bulk")
+{
+    Random::Xoshiro256 gen(42);
+
+    std::vector<fvec2> points(1000);
+    Random::GenerateUniform<fvec2>(gen, points, fvec2(-1, 10), fvec2(1, 20));
+    fvec2 sum;
+    for (fvec2 point : points)
+    {
+        REQUIRE((point >= fvec2(-1, 10) && point <= fvec2(1, 20)).all());
+        sum += point;
+    }
+    sum /= float(points.size());
+    REQUIRE((sum.x > -0.1f && sum.x < 0.1f));
+    REQUIRE((sum.y > 14.5f && sum.y < 15.5f));
+
+    // Every value of a small range is generated, and nothing else.
+    std::vector<ivec2> cells(1000);
+    Random::GenerateUniform<ivec2>(gen, cells, ivec2(-2, 0), ivec2(2, 0));
+    std::array<int, 5> counts{};
+    for (ivec2 cell : cells)
+    {
+        REQUIRE(cell.y == 0);
+        REQUIRE((cell.x >= -2 && cell.x <= 2));
+        counts[cell.x + 2]++;
+    }
+    for (int count : counts)
+        REQUIRE(count > 100);
+
+    // The full range works too.
+    std::vector<int> full(100);
+    Random::GenerateUniform<int>(gen, full, std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+
+    // With a 64-bit generator, each call discards the unused half of its last output.
+    // An even split gives the same results, an odd split doesn't.
+    Random::Xoshiro256 a(7), b(7), c(7);
+    std::vector<float> at_once(200), in_even_parts(200), in_odd_parts(200);
+    Random::GenerateUniform<float>(a, at_once, 0, 1);
+    Random::GenerateUniform<float>(b, std::span(in_even_parts).first(100), 0, 1);
+    Random::GenerateUniform<float>(b, std::span(in_even_parts).subspan(100), 0, 1);
+    REQUIRE(at_once == in_even_parts);
+    Random::GenerateUniform<float>(c, std::span(in_odd_parts).first(99), 0, 1);
+    Random::GenerateUniform<float>(c, std::span(in_odd_parts).subspan(99), 0, 1);
+    REQUIRE(std::equal(at_once.begin(), at_once.begin() + 99, in_odd_parts.begin()));
+    REQUIRE(at_once[99] != in_odd_parts[99]);
+    REQUIRE(at_once[100] == in_odd_parts[99]);
+
+    // Wrapping the generator in a `WordReader` keeps the unused half for the next call, so any split gives the same results.
+    // Check this with the integers too, which can use more than one word per number.
+    for (bool use_ints : {false, true})
+    {
+        Random::Xoshiro256 d(7), e(7);
+        Random::WordReader d_words(d), e_words(e);
+        std::vector<int> ints_at_once(200), ints_in_parts(200);
+        std::vector<float> floats_at_once(200), floats_in_parts(200);
+        if (use_ints)
+        {
+            Random::GenerateUniform<int>(d_words, ints_at_once, 0, 1000000000);
+            Random::GenerateUniform<int>(e_words, std::span(ints_in_parts).first(99), 0, 1000000000);
+            Random::GenerateUniform<int>(e_words, std::span(ints_in_parts).subspan(99), 0, 1000000000);
+        }
+        else
+        {
+            Random::GenerateUniform<float>(d_words, floats_at_once, 0, 1);
+            Random::GenerateUniform<float>(e_words, std::span(floats_in_parts).first(99), 0, 1);
+            Random::GenerateUniform<float>(e_words, std::span(floats_in_parts).subspan(99), 0, 1);
+        }
+        REQUIRE(ints_at_once == ints_in_parts);
+        REQUIRE(floats_at_once == floats_in_parts);
+    }
+
+    // The wrapped generator gives the same numbers as the unwrapped one, for a single call.
+    Random::Xoshiro256 f(7);
+    Random::WordReader f_words(f);
+    std::vector<float> wrapped(200);
+    Random::GenerateUniform<float>(f_words, wrapped, 0, 1);
+    REQUIRE(wrapped == at_once);
+}
+
+TEST_CASE("random_generators.stateless")
+{
+    // The stateless values depend only on the seed and the index.
+    REQUIRE(Random::GenerateUniformAt(1, 100, 0, 1000) == Random::GenerateUniformAt(1, 100, 0, 1000));
+
+    int differences = 0;
+    for (int i = 0; i < 100; i++)
+        differences += Random::GenerateUniformAt(1, i, 0, 1000000) != Random::GenerateUniformAt(2, i, 0, 1000000);
+    REQUIRE(differences > 90);
+
+    // The per-index generators are not shifted copies of each other.
+    Random::SplitMix64 first = Random::SplitMix64::ForIndex(5, 0), second = Random::SplitMix64::ForIndex(5, 1);
+    std::uint64_t second_first_value = second();
+    for (int i = 0; i < 1000; i++)
+        REQUIRE(first() != second_first_value);
+
+    // Jumping gives a different stream.
+    Random::Xoshiro256 gen(3), jumped = gen;
+    jumped.Jump();
+    REQUIRE(gen() != jumped());
+}
@@ -0,0 +1,125 @@
+#include <cstddef>
+#include <random>
+#include <vector>
+
+#include <utils/transitive_closure.h>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    // Adjacency lists, sorted.
+    using Graph = std::vector<std::vector<std::size_t>>;
+
+    [[nodiscard]] Graph RandomGraph(std::mt19937 &gen, std::size_t n, double edge_probability)
+    {
+        Graph ret(n);
+        std::bernoulli_distribution dist(edge_probability);
+        for (std::size_t a = 0; a < n; a++)
+        {
+            for (std::size_t b = 0; b < n; b++)
+            {
+                if (dist(gen))
+                    ret[a].push_back(b);
+            }
+        }
+        return ret;
+    }
+
+    // `ret[a][b]` is true if `b` is reachable from `a` in 1+ steps. Uses a plain BFS from each node.
+    [[nodiscard]] std::vector<std::vector<bool>> BruteForceClosure(const Graph &graph)
+    {
+        std::size_t n = graph.size();
+        std::vector<std::vector<bool>> ret(n, std::vector<bool>(n));
+        for (std::size_t a = 0; a < n; a++)
+        {
+            std::vector<std::size_t> queue = graph[a];
+            for (std::size_t b : queue)
+                ret[a][b] = true;
+            for (std::size_t i = 0; i < queue.size(); i++)
+            {
+                for (std::size_t c : graph[queue[i]])
+                {
+                    if (!ret[a][c])
+                    {
+                        ret[a][c] = true;
+                        queue.push_back(c);
+                    }
+                }
+            }
+        }
+        return ret;
+    }
+
+    void CheckAgainstBruteForce(const Graph &graph)
+    {
+        std::size_t n = graph.size();
+        TransitiveClosure::Data data = TransitiveClosure::Compute(n, [&](std::size_t a, TransitiveClosure::next_func_t func)
+        {
+            for (std::size_t b : graph[a])
+                func(b);
+        });
+        std::vector<std::vector<bool>> closure = BruteForceClosure(graph);
+
+        REQUIRE(data.nodes.size() == n);
+
+        std::size_t num_nodes_in_components = 0;
+        for (std::size_t c = 0; c < data.components.size(); c++)
+        {
+            num_nodes_in_components += data.components[c].nodes.size();
+            for (std::size_t node : data.components[c].nodes)
+                REQUIRE(data.nodes[node].comp == c);
+
+            // Only the components with smaller indices are reachable.
+            data.components[c].ForEachNext([&](std::size_t next){REQUIRE(next <= c);});
+        }
+        REQUIRE(num_nodes_in_components == n);
+
+        for (std::size_t a = 0; a < n; a++)
+        {
+            // The root must be in the same component.
+            REQUIRE(data.nodes[data.nodes[a].root].comp == data.nodes[a].comp);
+
+            for (std::size_t b = 0; b < n; b++)
+            {
+                // Two nodes are in the same component if and only if they reach each other.
+                bool same_component = a == b || (closure[a][b] && closure[b][a]);
+                REQUIRE((data.nodes[a].comp == data.nodes[b].comp) == same_component);
+
+                REQUIRE(data.IsReachable(a, b) == closure[a][b]);
+            }
+        }
+    }
+}
+
+TEST_CASE("transitive_closure.regression_root_order")
+{
+    // The nodes are visited in order 0,5,2,4,1. Nodes 1,2,4,5 form a cycle, which used to be split into several components,
+    // because the roots were compared by their indices (2 < 5) instead of the visiting order (5 before 2).
+    Graph graph = {
+        {5},
+        {2},
+        {4, 5},
+        {1},
+        {1},
+        {2, 7},
+        {1, 5, 6},
+        {},
+    };
+    CheckAgainstBruteForce(graph);
+}
+
+TEST_CASE("transitive_closure.random_graphs")
+{
+    std::mt19937 gen(42);
+    for (int i = 0; i < 300; i++)
+    {
+        std::size_t n = 1 + gen() % 80;
+        double edge_probability = std::uniform_real_distribution<double>(0, 4.0 / double(n))(gen);
+        CheckAgainstBruteForce(RandomGraph(gen, n, edge_probability));
+    }
+
+    // Larger graphs, to cover multiple bit words per component.
+    for (int i = 0; i < 10; i++)
+        CheckAgainstBruteForce(RandomGraph(gen, 200 + gen() % 200, 0.005 + 0.001 * i));
+}
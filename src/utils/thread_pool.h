@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// A simple fixed-size thread pool for data-parallel loops.
+// `Run(n, func)` calls `func(i)` for every `i` in `[0,n)`, distributing the calls between the workers and the calling thread.
+// Usage:
+//     ThreadPool::Global().Run(images.size(), [&](std::size_t i){Decode(images[i]);});
+
+class ThreadPool
+{
+    struct Data
+    {
+        std::vector<std::thread> threads;
+
+        std::mutex run_mutex; // Serializes `Run()` calls.
+
+        std::mutex mutex; // Protects everything below, except `next_index`.
+        std::condition_variable start_cond, finish_cond;
+        bool stop = false;
+        std::uint64_t generation = 0; // Incremented for each new job.
+        std::size_t busy_threads = 0; // How many workers haven't finished the current job yet.
+
+        const std::function<void(std::size_t)> *func = nullptr;
+        std::size_t job_size = 0;
+        std::atomic<std::size_t> next_index = 0;
+        std::exception_ptr exception; // The first exception thrown by the current job.
+
+        Data() {}
+        Data(const Data &) = delete;
+        Data &operator=(const Data &) = delete;
+
+        ~Data()
+        {
+            {
+                std::lock_guard lock(mutex);
+                stop = true;
+            }
+            start_cond.notify_all();
+            for (std::thread &thread : threads)
+                thread.join();
+        }
+
+        // Runs the current job until there are no indices left.
+        void ProcessJob()
+        {
+            const Data *old_job_pool = std::exchange(current_job_pool, this);
+
+            while (true)
+            {
+                std::size_t i = next_index.fetch_add(1, std::memory_order_relaxed);
+                if (i >= job_size)
+                    break;
+
+                try
+                {
+                    (*func)(i);
+                }
+                catch (...)
+                {
+                    std::lock_guard lock(mutex);
+                    if (!exception)
+                        exception = std::current_exception();
+                    next_index.store(job_size, std::memory_order_relaxed); // Stop the other threads early.
+                }
+            }
+
+            current_job_pool = old_job_pool;
+        }
+
+        void WorkerLoop()
+        {
+            std::uint64_t last_generation = 0;
+
+            while (true)
+            {
+                {
+                    std::unique_lock lock(mutex);
+                    start_cond.wait(lock, [&]{return stop || generation != last_generation;});
+                    if (stop)
+                        return;
+                    last_generation = generation;
+                }
+
+                ProcessJob();
+
+                {
+                    std::lock_guard lock(mutex);
+                    if (--busy_threads == 0)
+                        finish_cond.notify_one();
+                }
+            }
+        }
+    };
+
+    std::unique_ptr<Data> data;
+
+    // The pool whose job the current thread is processing, if any. This is used to detect nested `Run()` calls.
+    inline static thread_local const Data *current_job_pool = nullptr;
+
+  public:
+    // Constructs a null pool. It's still usable, and runs everything on the calling thread.
+    ThreadPool() {}
+
+    // Starts `num_threads` worker threads. The calling thread of `Run()` also participates, so `0` means "run everything on the calling thread".
+    ThreadPool(std::size_t num_threads)
+        : data(std::make_unique<Data>())
+    {
+        data->threads.reserve(num_threads);
+        for (std::size_t i = 0; i < num_threads; i++)
+            data->threads.emplace_back([data = data.get()]{data->WorkerLoop();});
+    }
+
+    ThreadPool(ThreadPool &&) = default;
+    ThreadPool &operator=(ThreadPool &&) = default;
+
+    [[nodiscard]] explicit operator bool() const
+    {
+        return bool(data);
+    }
+
+    // Returns the number of threads participating in `Run()`, including the calling thread.
+    [[nodiscard]] std::size_t NumThreads() const
+    {
+        return data ? data->threads.size() + 1 : 1;
+    }
+
+    // Returns the number of worker threads to use to saturate the CPU, taking the calling thread into account.
+    [[nodiscard]] static std::size_t DefaultNumWorkers()
+    {
+        return std::max(std::thread::hardware_concurrency(), 1u) - 1;
+    }
+
+    // A lazily created pool with `DefaultNumWorkers()` workers.
+    [[nodiscard]] static ThreadPool &Global()
+    {
+        static ThreadPool ret(DefaultNumWorkers());
+        return ret;
+    }
+
+    // Calls `func(i)` for every `i` in `[0,count)`, in an unspecified order and on unspecified threads. Blocks until all calls finish.
+    // If any call throws, the remaining calls might be skipped, and the first exception is rethrown.
+    // Calling `Run()` from inside of `func` on the same pool runs the nested loop sequentially on the calling thread,
+    // since all workers are busy with the outer loop anyway.
+    void Run(std::size_t count, const std::function<void(std::size_t)> &func)
+    {
+        if (count == 0)
+            return;
+
+        if (!data || data->threads.empty() || count == 1 || current_job_pool == data.get())
+        {
+            for (std::size_t i = 0; i < count; i++)
+                func(i);
+            return;
+        }
+
+        std::lock_guard run_lock(data->run_mutex);
+
+        {
+            std::lock_guard lock(data->mutex);
+            data->func = &func;
+            data->job_size = count;
+            data->next_index.store(0, std::memory_order_relaxed);
+            data->exception = nullptr;
+            data->busy_threads = data->threads.size();
+            data->generation++;
+        }
+        data->start_cond.notify_all();
+
+        data->ProcessJob();
+
+        std::exception_ptr exception;
+        {
+            std::unique_lock lock(data->mutex);
+            data->finish_cond.wait(lock, [&]{return data->busy_threads == 0;});
+            data->func = nullptr;
+            exception = std::exchange(data->exception, nullptr);
+        }
+
+        if (exception)
+            std::rethrow_exception(exception);
+    }
+};
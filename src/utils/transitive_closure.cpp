@@ -1,7 +1,9 @@
 #include "transitive_closure.h"
 
 #include <algorithm>
+#include <bit>
 #include <iostream>
+#include <utility>
 
 #include "program/errors.h"
 
@@ -9,15 +11,41 @@ namespace TransitiveClosure
 {
     std::size_t Data::FindUnorderedComponentPairs(std::function<void(std::size_t a, std::size_t b)> callback) const
     {
+        constexpr std::size_t word_bits = BitVec::bit_width<std::uint64_t>;
+
         std::size_t ret = 0;
         for (std::size_t i = 0; i < components.size(); i++)
-        for (std::size_t j = 0; j < i; j++)
         {
-            if (components[i].next_flags[j])
+            const Component &comp = components[i];
+
+            if (!callback)
+            {
+                // All components before `i`, minus the reachable ones.
+                std::size_t num_reachable = 0;
+                for (std::uint64_t word : comp.next_bits)
+                    num_reachable += std::size_t(std::popcount(word));
+                if (comp.IsNext(i))
+                    num_reachable--;
+                ret += i - num_reachable;
                 continue;
-            if (callback)
-                callback(j, i);
-            ret++;
+            }
+
+            // Check the components before `i`, a word at a time.
+            for (std::size_t word = 0; word * word_bits < i; word++)
+            {
+                std::uint64_t bits = -1;
+                if (word >= comp.first_next_word && word - comp.first_next_word < comp.next_bits.size())
+                    bits = ~comp.next_bits[word - comp.first_next_word];
+                if ((word + 1) * word_bits > i)
+                    bits &= (std::uint64_t(1) << i % word_bits) - 1; // Only the components before `i`.
+
+                while (bits)
+                {
+                    callback(word * word_bits + std::size_t(std::countr_zero(bits)), i);
+                    bits &= bits - 1;
+                    ret++;
+                }
+            }
         }
         return ret;
     }
@@ -27,7 +55,7 @@ namespace TransitiveClosure
         std::size_t ret = 0;
         for (std::size_t i = 0; i < components.size(); i++)
         {
-            if (!components[i].next_flags[i])
+            if (!components[i].IsNext(i))
                 continue;
             if (callback)
                 callback(i);
@@ -40,8 +68,10 @@ namespace TransitiveClosure
     {
         // Implementation of the 'STACK_TC' algorithm, described by Esko Nuutila (1995), in
         // 'Efficient Transitive Closure Computation in Large Digraphs'.
+        // The recursion is replaced with an explicit stack, to support deep graphs.
 
         constexpr std::size_t nil = -1;
+        constexpr std::size_t word_bits = BitVec::bit_width<std::uint64_t>;
 
         Data ret;
         ret.nodes.resize(n);
@@ -49,106 +79,154 @@ namespace TransitiveClosure
         vstack.reserve(n);
         cstack.reserve(n);
 
-        auto StackTc = [&](auto &StackTc, std::size_t v)
+        // The order in which the nodes were visited. The roots are compared by this, not by their indices.
+        std::vector<std::size_t> discovery_order(n);
+        std::size_t num_discovered = 0;
+
+        // A node that we're visiting. This replaces the recursive calls.
+        struct Frame
+        {
+            std::size_t v = 0;
+            std::size_t first_edge = 0; // The successors of `v` are `edges[first_edge..]`.
+            std::size_t next_edge = 0; // The next successor to visit.
+            std::size_t saved_height = 0; // The `cstack` size when we started visiting `v`.
+            bool self_loop = false;
+        };
+        std::vector<Frame> frames;
+        std::vector<std::size_t> edges; // The successors of all nodes in `frames`, in the same order.
+
+        // Starts visiting `v`, unless it was already visited. Returns true if `v` was added to `frames`.
+        auto BeginNode = [&](std::size_t v) -> bool
         {
             if (ret.nodes[v].root != nil)
-                return; // We already visited `v`.
+                return false; // We already visited `v`.
             ret.nodes[v].root = v;
             ret.nodes[v].comp = nil;
+            discovery_order[v] = num_discovered++;
             vstack.push_back(v);
-            std::size_t saved_height = cstack.size();
-            bool self_loop = false;
+
+            Frame &frame = frames.emplace_back();
+            frame.v = v;
+            frame.first_edge = edges.size();
+            frame.next_edge = edges.size();
+            frame.saved_height = cstack.size();
+
             [[maybe_unused]] std::size_t prev_w = nil; // Used only to check that the callback is sane.
             for_each_connected_node(v, [&](std::size_t w)
             {
                 ASSERT(w < n && (w > prev_w || prev_w == nil) && (prev_w = w, true), "Bad callback.");
 
                 if (v == w)
-                {
-                    self_loop = true;
-                }
+                    frames.back().self_loop = true;
                 else
-                {
-                    StackTc(StackTc, w);
-                    if (ret.nodes[w].comp == nil)
-                        ret.nodes[v].root = std::min(ret.nodes[v].root, ret.nodes[w].root);
-                    else
-                        cstack.push_back(ret.nodes[w].comp);
-
-                    // The paper that this is based on had an extra condition on this last `else` branch,
-                    // which I wasn't able to understand: `if (v,w) is not a forward edge`.
-                    // However! Ivo Gabe de Wolff (2019) in "Higher ranked region inference for compile-time garbage collection"
-                    // says that it doesn't affect correctness:
-                    // > In the loop over the successors, the original algorithm Stack_TC checks whether
-                    // > an edge is a so called forward edge. We do not perform this check, which may cause
-                    // > that a component is pushed multiple times to cstack. As duplicates are removed in the
-                    // > topological sort, these will be removed later on and not cause problems with correctness.
-                }
+                    edges.push_back(w);
             });
-            if (ret.nodes[v].root == v)
+            return true;
+        };
+
+        // Finishes visiting `v`, after all its successors were visited.
+        auto EndNode = [&](const Frame &frame)
+        {
+            std::size_t v = frame.v;
+            if (ret.nodes[v].root != v)
+                return;
+
+            std::size_t c = ret.components.size();
+            Data::Component this_comp;
+
+            // Sort the part of the component stack, and remove duplicates.
+            // Since a component can only reach the components with smaller indices, this is a topological sort.
+            std::sort(cstack.begin() + std::ptrdiff_t(frame.saved_height), cstack.end());
+            cstack.erase(std::unique(cstack.begin() + std::ptrdiff_t(frame.saved_height), cstack.end()), cstack.end());
+
+            // Allocate the bits, skipping the leading zero words.
+            this_comp.first_next_word = c / word_bits;
+            for (std::size_t i = frame.saved_height; i < cstack.size(); i++)
+                this_comp.first_next_word = std::min(this_comp.first_next_word, ret.components[cstack[i]].first_next_word);
+            this_comp.next_bits.resize(c / word_bits - this_comp.first_next_word + 1);
+
+            auto SetBit = [&](std::size_t i)
             {
-                std::size_t c = ret.components.size();
-                ret.components.emplace_back();
-                Data::Component &this_comp = ret.components.back();
+                BitVec::SetBitOrThrow(this_comp.next_bits, i - this_comp.first_next_word * word_bits);
+            };
 
-                this_comp.next_flags.assign(ret.components.size(), false); // Sic.
+            if (vstack.back() != v || frame.self_loop)
+                SetBit(c);
 
-                if (vstack.back() != v || self_loop)
-                {
-                    this_comp.next.push_back(c);
-                    this_comp.next_flags[c] = true;
-                }
+            // Starting from the largest index, so that if `x` is reachable from another component in the stack, it's already added when we get to it.
+            while (cstack.size() != frame.saved_height)
+            {
+                std::size_t x = cstack.back();
+                cstack.pop_back();
+                if (this_comp.IsNext(x))
+                    continue;
 
-                // Topologically sort a part of the component stack.
-                std::sort(cstack.begin() + saved_height, cstack.end(), [&comp = ret.components](std::size_t a, std::size_t b) -> bool
-                {
-                    if (a == b)
-                        return false; // This can happen when we have cycles. Libstdc++ sometiems checks this in debug mode, it seems.
-                    if (b >= comp[a].next_flags.size())
-                        return false;
-                    return comp[a].next_flags[b];
-                });
-                // Remove duplicates.
-                cstack.erase(std::unique(cstack.begin() + saved_height, cstack.end()), cstack.end());
-
-                while (cstack.size() != saved_height)
+                SetBit(x);
+
+                // Merge the successors of `x`, a word at a time.
+                const Data::Component &x_comp = ret.components[x];
+                std::uint64_t *target = this_comp.next_bits.data() + (x_comp.first_next_word - this_comp.first_next_word);
+                for (std::size_t i = 0; i < x_comp.next_bits.size(); i++)
+                    target[i] |= x_comp.next_bits[i];
+            }
+
+            std::size_t w;
+            do
+            {
+                w = vstack.back();
+                vstack.pop_back();
+                ret.nodes[w].comp = c;
+                this_comp.nodes.push_back(w);
+            }
+            while (w != v);
+
+            ret.components.push_back(std::move(this_comp));
+        };
+
+        for (std::size_t start = 0; start < n; start++)
+        {
+            if (!BeginNode(start))
+                continue;
+
+            while (!frames.empty())
+            {
+                Frame &frame = frames.back();
+
+                if (frame.next_edge == edges.size())
                 {
-                    std::size_t x = cstack.back();
-                    cstack.pop_back();
-                    if (!this_comp.next_flags[x])
-                    {
-                        if (!this_comp.next_flags[x])
-                        {
-                            this_comp.next.push_back(x);
-                            this_comp.next_flags[x] = true;
-                        }
-
-                        this_comp.next.reserve(this_comp.next.size() + ret.components[x].next.size());
-                        for (std::size_t c : ret.components[x].next)
-                        {
-                            if (!this_comp.next_flags[c])
-                            {
-                                this_comp.next.push_back(c);
-                                this_comp.next_flags[c] = true;
-                            }
-                        }
-                    }
+                    // All successors are visited.
+                    EndNode(frame);
+                    edges.resize(frame.first_edge);
+                    frames.pop_back();
+                    continue;
                 }
 
-                std::size_t w;
-                do
+                std::size_t w = edges[frame.next_edge];
+                // If `w` wasn't visited yet, visit it first. Then we come back here, and this returns false.
+                if (BeginNode(w))
+                    continue;
+                frame.next_edge++;
+
+                std::size_t v = frame.v;
+                if (ret.nodes[w].comp == nil)
                 {
-                    w = vstack.back();
-                    vstack.pop_back();
-                    ret.nodes[w].comp = c;
-                    this_comp.nodes.push_back(w);
+                    std::size_t &root = ret.nodes[v].root;
+                    if (discovery_order[ret.nodes[w].root] < discovery_order[root])
+                        root = ret.nodes[w].root;
                 }
-                while (w != v);
-            }
-        };
+                else
+                    cstack.push_back(ret.nodes[w].comp);
 
-        for (std::size_t v = 0; v < n; v++)
-            StackTc(StackTc, v);
+                // The paper that this is based on had an extra condition on this last `else` branch,
+                // which I wasn't able to understand: `if (v,w) is not a forward edge`.
+                // However! Ivo Gabe de Wolff (2019) in "Higher ranked region inference for compile-time garbage collection"
+                // says that it doesn't affect correctness:
+                // > In the loop over the successors, the original algorithm Stack_TC checks whether
+                // > an edge is a so called forward edge. We do not perform this check, which may cause
+                // > that a component is pushed multiple times to cstack. As duplicates are removed in the
+                // > topological sort, these will be removed later on and not cause problems with correctness.
+            }
+        }
 
         return ret;
     }
@@ -196,7 +274,7 @@ namespace TransitiveClosure
                     {0,0,0,0,0,1,0,0},
                 };
                 return arr[a][b];
-            }, "{nodes=[(0,3),(0,3),(0,3),(3,2),(4,0),(5,1),(4,0),(5,1)],components=[{nodes=[6,4],next=[0],next_flags=[1]},{nodes=[7,5],next=[1,0],next_flags=[1,1]},{nodes=[3],next=[0,1],next_flags=[1,1,0]},{nodes=[2,1,0],next=[3,2,0,1],next_flags=[1,1,1,1]}]}");
+            }, "{nodes=[(0,3),(0,3),(0,3),(3,2),(4,0),(5,1),(4,0),(5,1)],components=[{nodes=[6,4],next=[0]},{nodes=[7,5],next=[0,1]},{nodes=[3],next=[0,1]},{nodes=[2,1,0],next=[0,1,2,3]}]}");
 
 
             test(10, [](std::size_t a, std::size_t b)
@@ -215,7 +293,7 @@ namespace TransitiveClosure
                     /* j */{0,0,0,0,0,0,0,0,0,0},
                 };
                 return arr[a][b];
-            }, "{nodes=[(0,3),(0,3),(0,3),(3,0),(3,0),(5,1),(5,1),(0,3),(0,3),(9,2)],components=[{nodes=[4,3],next=[0],next_flags=[1]},{nodes=[6,5],next=[1,0],next_flags=[1,1]},{nodes=[9],next=[],next_flags=[0,0,0]},{nodes=[8,7,2,1,0],next=[3,2,0,1],next_flags=[1,1,1,1]}]}");
+            }, "{nodes=[(0,3),(0,3),(0,3),(3,0),(3,0),(5,1),(5,1),(0,3),(0,3),(9,2)],components=[{nodes=[4,3],next=[0]},{nodes=[6,5],next=[0,1]},{nodes=[9],next=[]},{nodes=[8,7,2,1,0],next=[0,1,2,3]}]}");
 
             std::cout << "All tests passed.\n";
         }
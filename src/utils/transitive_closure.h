@@ -1,10 +1,13 @@
 #pragma once
 
+#include <bit>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <vector>
 
 #include "strings/format.h"
+#include "utils/bit_vectors.h"
 
 // A 'transitive closure' of an oriented graph is a similar graph with edges added.
 // If in the original graph, B is reachable from A in 1+ steps, then in the transitive closure it will be reachable in 1 step.
@@ -39,24 +42,42 @@ namespace TransitiveClosure
         {
             // Nodes that are a part of this component.
             std::vector<std::size_t> nodes;
-            // Which components are reachable (possibly indirectly) from this one.
-            // Unordered, but has no duplicates. May or may not contain itself.
-            std::vector<std::size_t> next;
-            // A convenience array.
-            // `next_flags[i]` is 1 if and only if `next` contains `i`.
-            // Some trailing zeroes might be missing, check the size before accessing it.
-            // More specifically, i-th component has i+1 numbers in this array.
-            std::vector<unsigned char/*boolean*/> next_flags;
+
+            // Which components are reachable (possibly indirectly) from this one. May or may not contain itself.
+            // This is a bit vector (see `namespace BitVec`), where bit `i` is component `first_next_word * 64 + i`.
+            // Since the i-th component can only reach components `<= i`, this has at most `i / 64 + 1` words.
+            // The words before `first_next_word` are omitted, since they're all zero.
+            // Use `IsNext()` and `ForEachNext()` instead of accessing this directly.
+            std::vector<std::uint64_t> next_bits;
+            std::size_t first_next_word = 0;
 
             // Returns true if component `i` is reachable from this one, possibly indirectly.
             [[nodiscard]] bool IsNext(std::size_t i) const
             {
-                return i < next_flags.size() && bool(next_flags[i]);
+                std::size_t offset = first_next_word * BitVec::bit_width<std::uint64_t>;
+                return i >= offset && BitVec::GetBitOrZero(next_bits, i - offset);
+            }
+
+            // Calls `func(i)` for every component `i` reachable from this one, in ascending order.
+            template <typename F>
+            void ForEachNext(F &&func) const
+            {
+                for (std::size_t word = 0; word < next_bits.size(); word++)
+                {
+                    std::uint64_t bits = next_bits[word];
+                    while (bits)
+                    {
+                        func((first_next_word + word) * BitVec::bit_width<std::uint64_t> + std::size_t(std::countr_zero(bits)));
+                        bits &= bits - 1;
+                    }
+                }
             }
 
             [[nodiscard]] std::string DebugToString() const
             {
-                return FMT("{{nodes=[{}],next=[{}],next_flags=[{}]}}", fmt::join(nodes, ","), fmt::join(next, ","), fmt::join(next_flags, ","));
+                std::vector<std::size_t> next;
+                ForEachNext([&](std::size_t i){next.push_back(i);});
+                return FMT("{{nodes=[{}],next=[{}]}}", fmt::join(nodes, ","), fmt::join(next, ","));
             }
         };
         // Size is the number of components.
@@ -80,9 +101,16 @@ namespace TransitiveClosure
             return ret;
         }
 
+        // Returns true if node `b` is reachable (possibly indirectly) from node `a`.
+        // A node is only reachable from itself if it's a part of a cycle.
+        [[nodiscard]] bool IsReachable(std::size_t a, std::size_t b) const
+        {
+            return components[nodes[a].comp].IsNext(nodes[b].comp);
+        }
+
         // Invokes the callback for every pair of components that's unordered relative to each other.
         // Only checks pairs such that `a < b`.
-        // Returns the number of such pairs.
+        // Returns the number of such pairs. This is fast when there's no callback, since it only counts the bits.
         // The presence of such pairs indicates that the resulting order is not unique.
         std::size_t FindUnorderedComponentPairs(std::function<void(std::size_t a, std::size_t b)> callback = nullptr) const;
 
@@ -98,7 +126,9 @@ namespace TransitiveClosure
     // Unsure if a different order would break the algorithm or not.
     using func_t = std::function<void(std::size_t a, next_func_t func)>;
 
-    // Performs the calculations.
+    // Performs the calculations. Doesn't use recursion, so the graph can be arbitrarily deep.
+    // Needs `O(n + m)` time plus the time to combine the reachability bit vectors, and `O(c * r / 8)` bytes for them,
+    // where `c` is the number of components, and `r` is the average range of component indices reachable from a component.
     [[nodiscard]] Data Compute(std::size_t n, func_t for_each_connected_node);
 
     namespace Tests
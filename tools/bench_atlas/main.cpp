@@ -0,0 +1,104 @@
+// Measures how long it takes to build a texture atlas from a large number of small PNG images, like at the game startup.
+// Usage: `bench_atlas [image_count [cache_file]]`
+// The images are generated in memory, so this measures only the decoding and the atlas composition, not the file I/O.
+// If `cache_file` is specified, also measures `MakeAtlasCached()`: first with a cache miss (the file is overwritten), then with a cache hit.
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string_view>
+#include <string>
+#include <vector>
+
+#include <stb_image_write.h>
+
+#include "graphics/image.h"
+#include "graphics/texture_atlas.h"
+#include "program/entry_point.h"
+#include "program/errors.h"
+#include "strings/format.h"
+#include "utils/thread_pool.h"
+
+IMP_MAIN(argc, argv)
+{
+    try
+    {
+        std::size_t image_count = argc > 1 ? std::stoul(argv[1]) : 3000;
+        const ivec2 atlas_size(4096);
+
+        // Generate the images. Use noise, to make sure the images are not trivially compressible.
+        std::mt19937 rng(42);
+        std::vector<std::vector<std::uint8_t>> png_files(image_count);
+        for (std::vector<std::uint8_t> &png : png_files)
+        {
+            ivec2 size(8 + rng() % 41, 8 + rng() % 41);
+            std::vector<u8vec4> pixels(size.prod());
+            for (u8vec4 &pixel : pixels)
+                pixel = u8vec4(rng() % 4 * 64, rng() % 4 * 64, rng() % 4 * 64, 255);
+
+            auto write = [](void *context, void *data, int size)
+            {
+                auto &vec = *static_cast<std::vector<std::uint8_t> *>(context);
+                vec.insert(vec.end(), static_cast<std::uint8_t *>(data), static_cast<std::uint8_t *>(data) + size);
+            };
+            if (!stbi_write_png_to_func(write, &png, size.x, size.y, 4, pixels.data(), 0))
+                throw std::runtime_error("Unable to encode a test image.");
+        }
+
+        std::vector<irect2> rects(image_count);
+        auto add_images = [&](Graphics::AtlasInputFunc func)
+        {
+            for (std::size_t i = 0; i < image_count; i++)
+                func(Stream::ReadOnlyData::mem_reference(png_files[i].data(), png_files[i].data() + png_files[i].size()), rects[i]);
+        };
+
+        auto Measure = [&](std::string_view label, auto &&make_atlas) -> Graphics::Image
+        {
+            auto time_begin = std::chrono::steady_clock::now();
+            Graphics::Image atlas = make_atlas();
+            auto time_end = std::chrono::steady_clock::now();
+
+            std::cout << FMT("{:<20} {:.1f} ms\n", label, std::chrono::duration<double, std::milli>(time_end - time_begin).count());
+            return atlas;
+        };
+
+        std::cout << FMT("Building a {}x{} atlas from {} images...\n", atlas_size.x, atlas_size.y, image_count);
+        auto CheckEqual = [&](const Graphics::Image &a, const Graphics::Image &b)
+        {
+            if (!std::equal(a.Pixels(), a.Pixels() + a.Size().prod(), b.Pixels()))
+                throw std::runtime_error("The atlases don't match.");
+        };
+
+        ThreadPool serial;
+        Graphics::Image serial_atlas = Measure("1 thread:", [&]{return Graphics::MakeAtlas(atlas_size, add_images, Graphics::AtlasFlags::add_gaps, serial);});
+        Graphics::Image parallel_atlas = Measure(FMT("Global pool ({}):", ThreadPool::Global().NumThreads()), [&]{return Graphics::MakeAtlas(atlas_size, add_images, Graphics::AtlasFlags::add_gaps);});
+        CheckEqual(serial_atlas, parallel_atlas); // The packing must not depend on the thread count.
+
+        if (argc > 2)
+        {
+            std::string cache_file_name = argv[2];
+            std::remove(cache_file_name.c_str());
+
+            Graphics::Image miss_atlas = Measure("Cache miss:", [&]{return Graphics::MakeAtlasCached(cache_file_name, atlas_size, add_images, Graphics::AtlasFlags::add_gaps);});
+            CheckEqual(serial_atlas, miss_atlas);
+
+            std::vector<irect2> expected_rects = rects;
+            rects.assign(rects.size(), irect2{});
+            Graphics::Image hit_atlas = Measure("Cache hit:", [&]{return Graphics::MakeAtlasCached(cache_file_name, atlas_size, add_images, Graphics::AtlasFlags::add_gaps);});
+            CheckEqual(serial_atlas, hit_atlas);
+            if (rects != expected_rects)
+                throw std::runtime_error("The cached texture coordinates don't match.");
+        }
+    }
+    catch (std::exception &e)
+    {
+        Program::ExceptionToString(e, [](const char *message){std::cerr << message << '\n';});
+        return 1;
+    }
+
+    return 0;
+}
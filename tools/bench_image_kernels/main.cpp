@@ -0,0 +1,188 @@
+// Compares the vectorized image kernels (see `src/graphics/image_kernels.h`) against the plain per-pixel loops they replace.
+// Usage: `bench_image_kernels [image_size]`
+// Every kernel is measured with each supported instruction set, and the results are checked against the scalar implementation.
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "graphics/image.h"
+#include "graphics/image_kernels.h"
+#include "program/entry_point.h"
+#include "program/errors.h"
+#include "strings/format.h"
+
+namespace Kernels = Graphics::ImageKernels;
+
+static constexpr int repeat_count = 20;
+
+IMP_MAIN(argc, argv)
+{
+    try
+    {
+        int image_size = argc > 1 ? std::stoi(argv[1]) : 2048;
+        if (image_size <= 0)
+            throw std::runtime_error("Invalid image size.");
+        const ivec2 size(image_size);
+
+        std::mt19937 rng(42);
+        Graphics::Image source(size);
+        for (int y = 0; y < size.y; y++)
+        for (int x = 0; x < size.x; x++)
+            source.UnsafeAt(ivec2(x, y)) = u8vec4(rng() % 256, rng() % 256, rng() % 256, rng() % 256);
+
+        std::vector<std::uint8_t> alpha_mask(size.prod());
+        for (std::uint8_t &alpha : alpha_mask)
+            alpha = rng() % 256;
+
+        const fmat4 color_matrix(0.393f, 0.769f, 0.189f, 0,  0.349f, 0.686f, 0.168f, 0,  0.272f, 0.534f, 0.131f, 0,  0, 0, 0, 1); // Sepia.
+
+        std::vector<Kernels::InstructionSet> sets = {Kernels::InstructionSet::scalar};
+        if (Kernels::MaxSupportedInstructionSet() >= Kernels::InstructionSet::sse2)
+            sets.push_back(Kernels::InstructionSet::sse2);
+        if (Kernels::MaxSupportedInstructionSet() >= Kernels::InstructionSet::avx2)
+            sets.push_back(Kernels::InstructionSet::avx2);
+
+        auto SetName = [](Kernels::InstructionSet set) -> std::string_view
+        {
+            switch (set)
+            {
+                case Kernels::InstructionSet::scalar: return "scalar";
+                case Kernels::InstructionSet::sse2:   return "sse2";
+                case Kernels::InstructionSet::avx2:   return "avx2";
+            }
+            return "?";
+        };
+
+        // Runs `func(image)` on a fresh copy of the source image several times, and prints the average time.
+        auto Measure = [&](std::string_view label, auto &&func) -> Graphics::Image
+        {
+            Graphics::Image image;
+            double total_ms = 0;
+            for (int i = 0; i < repeat_count; i++)
+            {
+                image = source;
+                auto time_begin = std::chrono::steady_clock::now();
+                func(image);
+                auto time_end = std::chrono::steady_clock::now();
+                total_ms += std::chrono::duration<double, std::milli>(time_end - time_begin).count();
+            }
+            std::cout << FMT("  {:<12} {:.3f} ms\n", label, total_ms / repeat_count);
+            return image;
+        };
+
+        auto CheckEqual = [&](std::string_view name, const Graphics::Image &a, const Graphics::Image &b)
+        {
+            if (!std::equal(a.Pixels(), a.Pixels() + a.Size().prod(), b.Pixels()))
+                throw std::runtime_error(FMT("`{}` results don't match.", name));
+        };
+
+        // Measures the old per-pixel loop, then the kernel with each instruction set.
+        auto Compare = [&](std::string_view name, bool reference_must_match, auto &&reference, auto &&kernel)
+        {
+            std::cout << FMT("{} ({}x{}):\n", name, size.x, size.y);
+            Graphics::Image reference_result = Measure("per-pixel", reference);
+
+            Graphics::Image scalar_result;
+            for (Kernels::InstructionSet set : sets)
+            {
+                Kernels::SetInstructionSet(set);
+                Graphics::Image result = Measure(SetName(set), kernel);
+                if (set == Kernels::InstructionSet::scalar)
+                    scalar_result = std::move(result);
+                else
+                    CheckEqual(name, scalar_result, result);
+            }
+            Kernels::SetInstructionSet(Kernels::MaxSupportedInstructionSet());
+
+            if (reference_must_match)
+                CheckEqual(name, reference_result, scalar_result);
+        };
+
+        Compare("Fill", true,
+            [&](Graphics::Image &image)
+            {
+                irect2 rect = image.Bounds().shrink(1);
+                for (int y = rect.a.y; y < rect.b.y; y++)
+                for (int x = rect.a.x; x < rect.b.x; x++)
+                    image.UnsafeAt(ivec2(x,y)) = u8vec4(1, 2, 3, 4);
+            },
+            [&](Graphics::Image &image)
+            {
+                image.UnsafeFill(image.Bounds().shrink(1), u8vec4(1, 2, 3, 4));
+            }
+        );
+
+        Compare("Alpha to white", true,
+            [&](Graphics::Image &image)
+            {
+                for (int y = 0; y < size.y; y++)
+                for (int x = 0; x < size.x; x++)
+                    image.UnsafeAt(ivec2(x,y)) = u8vec3(255).to_vec4(alpha_mask[size.x * y + x]);
+            },
+            [&](Graphics::Image &image)
+            {
+                for (int y = 0; y < size.y; y++)
+                    Kernels::AlphaToWhite(alpha_mask.data() + size.x * y, &image.UnsafeAt(ivec2(0,y)), size.x);
+            }
+        );
+
+        Compare("Flip", true,
+            [&](Graphics::Image &image)
+            {
+                for (int y = 0; y < size.y / 2; y++)
+                for (int x = 0; x < size.x; x++)
+                    std::swap(image.UnsafeAt(ivec2(x, y)), image.UnsafeAt(ivec2(x, size.y - 1 - y)));
+            },
+            [&](Graphics::Image &image)
+            {
+                image.FlipVertically();
+            }
+        );
+
+        Compare("Premultiply", true,
+            [&](Graphics::Image &image)
+            {
+                for (int y = 0; y < size.y; y++)
+                for (int x = 0; x < size.x; x++)
+                {
+                    u8vec4 &pixel = image.UnsafeAt(ivec2(x,y));
+                    pixel = u8vec4(iround((fvec3(pixel.to_vec3()) * pixel.w / 255.f).to_vec4(pixel.w)));
+                }
+            },
+            [&](Graphics::Image &image)
+            {
+                image.PremultiplyAlpha();
+            }
+        );
+
+        Compare("Color matrix", false,
+            [&](Graphics::Image &image)
+            {
+                for (int y = 0; y < size.y; y++)
+                for (int x = 0; x < size.x; x++)
+                {
+                    u8vec4 &pixel = image.UnsafeAt(ivec2(x,y));
+                    pixel = u8vec4(iround(clamp(color_matrix * (fvec4(pixel) / 255) * 255, 0, 255)));
+                }
+            },
+            [&](Graphics::Image &image)
+            {
+                image.ApplyColorMatrix(color_matrix);
+            }
+        );
+    }
+    catch (std::exception &e)
+    {
+        Program::ExceptionToString(e, [](const char *message){std::cerr << message << '\n';});
+        return 1;
+    }
+
+    return 0;
+}
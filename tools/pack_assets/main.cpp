@@ -0,0 +1,53 @@
+// Packs a directory of assets into a single file, readable with `AssetPack::Reader`.
+// Usage: `pack_assets <source_dir> <output_file>`
+// Files and directories starting with `_` are skipped, to match `ASSETS_IGNORED_PATTERNS` in the makefile.
+// Formats that are already compressed are stored as is, everything else is compressed.
+
+#include <iostream>
+#include <string_view>
+
+#include "program/entry_point.h"
+#include "program/errors.h"
+#include "stream/output.h"
+#include "utils/asset_pack.h"
+
+IMP_MAIN(argc, argv)
+{
+    if (argc != 3)
+    {
+        std::cerr << "Usage: pack_assets <source_dir> <output_file>\n";
+        return 1;
+    }
+
+    try
+    {
+        Stream::Output output(argv[2]);
+        AssetPack::WriteDirectory(output, argv[1], [](const std::string &name) -> std::optional<AssetPack::Compression>
+        {
+            for (std::string_view part = name;;)
+            {
+                if (part.starts_with('_'))
+                    return {};
+                std::size_t slash = part.find('/');
+                if (slash == std::string_view::npos)
+                    break;
+                part.remove_prefix(slash + 1);
+            }
+
+            for (std::string_view ext : {".png", ".ogg"})
+            {
+                if (name.ends_with(ext))
+                    return AssetPack::Compression::none;
+            }
+            return AssetPack::Compression::zlib;
+        });
+        output.Flush();
+    }
+    catch (std::exception &e)
+    {
+        Program::ExceptionToString(e, [](const char *message){std::cerr << message << '\n';});
+        return 1;
+    }
+
+    return 0;
+}